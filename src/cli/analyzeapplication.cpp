@@ -0,0 +1,144 @@
+/*
+ * bluecheese
+ * Copyright (C) 2022-2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QTextStream>
+#include "aiplayerfactory.h"
+#include "analyzeapplication.h"
+#include "applicationfacade.h"
+#include "batchanalyser.h"
+#include "clioptions.h"
+#include "enginepool.h"
+#include "nativeaiplayer.h"
+#include "stockfishaiplayer.h"
+
+AnalyzeApplication::AnalyzeApplication(const CliOptions &options, QObject *parent)
+    : CliApplicationBase{options, parent}
+{
+    QMetaObject::invokeMethod(this, &AnalyzeApplication::start, Qt::QueuedConnection);
+}
+
+AnalyzeApplication::~AnalyzeApplication()
+{
+    // The analyser cancels its requests, so it must go before the pool.
+    delete m_analyser;
+    delete m_pool;
+}
+
+void AnalyzeApplication::start()
+{
+    const CliOptions& cliOptions = options<CliOptions>();
+    m_input.setFileName(cliOptions.analyzeFile);
+    if (!m_input.open(QIODevice::ReadOnly)) {
+        onAnalysisError(tr("%1: %2").arg(cliOptions.analyzeFile, m_input.errorString()));
+        return;
+    }
+    QString errorMessage;
+    if (!openOutput(&errorMessage)) {
+        onAnalysisError(errorMessage);
+        return;
+    }
+    const BatchAnalyser::Format format = (cliOptions.format == CliOptions::Format::Csv) ?
+        BatchAnalyser::Csv : BatchAnalyser::Json;
+    QSet<BatchAnalyser::MoveKey> completed;
+    if (!cliOptions.outputFile.isEmpty() && m_output.size() > 0) {
+        // Resume an earlier run, dropping any record it was part way through.
+        qint64 validSize = 0;
+        if (!BatchAnalyser::readCompleted(&m_output, format, &completed, &validSize, &errorMessage)) {
+            onAnalysisError(tr("%1: %2").arg(cliOptions.outputFile, errorMessage));
+            return;
+        }
+        m_output.resize(validSize);
+        m_output.seek(validSize);
+        if (!isQuiet() && !completed.isEmpty()) {
+            QTextStream ts(stderr, QIODevice::WriteOnly);
+            ts << tr("Resuming: %n move(s) already analysed.", nullptr, completed.size()) << "\n";
+        }
+    }
+
+    const QString stockfishPath = facade()->stockfishPath();
+    if (stockfishPath.isEmpty())
+        m_factory.reset(new NativeAiPlayerFactory);
+    else
+        m_factory.reset(new StockfishAiPlayerFactory(stockfishPath));
+    m_pool = new EnginePool(m_factory.get(), cliOptions.engines);
+    m_pool->setResources(facade()->engineResources());
+
+    m_analyser = new BatchAnalyser(m_pool, &m_output, format);
+    m_analyser->setMoveTime(cliOptions.moveTime);
+    m_analyser->setAssistanceLevel(cliOptions.assistanceLevel);
+    m_analyser->setCompleted(completed);
+    connect(m_analyser, &BatchAnalyser::gameFinished, this, &AnalyzeApplication::onGameFinished);
+    connect(m_analyser, &BatchAnalyser::warning, this, &AnalyzeApplication::onWarning);
+    connect(m_analyser, &BatchAnalyser::error, this, &AnalyzeApplication::onAnalysisError);
+    connect(m_analyser, &BatchAnalyser::finished, this, &AnalyzeApplication::onFinished);
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Analysing with %n engine(s).", nullptr, m_pool->engineCount()) << "\n";
+    }
+    m_analyser->analyse(&m_input);
+}
+
+bool AnalyzeApplication::openOutput(QString *errorMessage)
+{
+    const QString& outputFile = options<CliOptions>().outputFile;
+    if (outputFile.isEmpty()) {
+        if (!m_output.open(stdout, QIODevice::WriteOnly)) {
+            *errorMessage = m_output.errorString();
+            return false;
+        }
+        return true;
+    }
+    m_output.setFileName(outputFile);
+    if (!m_output.open(QIODevice::ReadWrite)) {
+        *errorMessage = tr("%1: %2").arg(outputFile, m_output.errorString());
+        return false;
+    }
+    return true;
+}
+
+void AnalyzeApplication::onGameFinished(int game)
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Game %1 analysed.").arg(game) << "\n";
+    }
+}
+
+void AnalyzeApplication::onWarning(const QString& message)
+{
+    QTextStream ts(stderr, QIODevice::WriteOnly);
+    ts << tr("Warning: %1").arg(message) << "\n";
+}
+
+void AnalyzeApplication::onAnalysisError(const QString& message)
+{
+    QTextStream ts(stderr, QIODevice::WriteOnly);
+    ts << tr("Error: %1").arg(message) << "\n";
+    QCoreApplication::exit(1);
+}
+
+void AnalyzeApplication::onFinished()
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Analysed %1 move(s) in %2 game(s).").arg(m_analyser->movesAnalysed()).arg(m_analyser->gamesAnalysed()) << "\n";
+    }
+    m_output.flush();
+    QCoreApplication::exit(0);
+}
@@ -0,0 +1,52 @@
+/*
+ * bluecheese
+ * Copyright (C) 2022-2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANALYZEAPPLICATION_H
+#define ANALYZEAPPLICATION_H
+
+#include <QFile>
+#include <memory>
+#include "cliapplicationbase.h"
+
+class AiPlayerFactory;
+class BatchAnalyser;
+class EnginePool;
+
+class AnalyzeApplication : public CliApplicationBase
+{
+    Q_OBJECT
+public:
+    explicit AnalyzeApplication(const CliOptions &options, QObject *parent = nullptr);
+    ~AnalyzeApplication();
+private slots:
+    void start();
+    void onGameFinished(int game);
+    void onWarning(const QString& message);
+    void onAnalysisError(const QString& message);
+    void onFinished();
+private:
+    bool openOutput(QString *errorMessage);
+
+    QFile m_input;
+    QFile m_output;
+    std::unique_ptr<AiPlayerFactory> m_factory;
+    EnginePool *m_pool {};
+    BatchAnalyser *m_analyser {};
+};
+
+#endif // ANALYZEAPPLICATION_H
@@ -32,6 +32,8 @@ CliApplicationBase::CliApplicationBase(const CliOptions &options, QObject *paren
 {
     connect(facade(), &ApplicationFacade::connected, this, &CliApplicationBase::onConnected);
     connect(facade(), &ApplicationFacade::disconnected, this, &CliApplicationBase::onDisconnected);
+    connect(facade(), &ApplicationFacade::reconnecting, this, &CliApplicationBase::onReconnecting);
+    connect(facade(), &ApplicationFacade::reconnected, this, &CliApplicationBase::onReconnected);
     connect(facade(), &ApplicationFacade::localOutOfSyncWithRemote, this, &CliApplicationBase::onOutOfSync);
     connect(facade(), &ApplicationFacade::noBoardsDiscovered, this, &CliApplicationBase::onNoBoardsDiscovered);
     connect(facade(), &ApplicationFacade::error, this, &CliApplicationBase::onError);
@@ -61,6 +63,22 @@ void CliApplicationBase::onDisconnected()
     QCoreApplication::exit(1);
 }
 
+void CliApplicationBase::onReconnecting(int attempt)
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Connection lost, reconnecting (attempt %1).").arg(attempt) << "\n";
+    }
+}
+
+void CliApplicationBase::onReconnected()
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Reconnected.") << "\n";
+    }
+}
+
 void CliApplicationBase::onOutOfSync()
 {
     QTextStream ts(stderr, QIODevice::WriteOnly);
@@ -33,6 +33,8 @@ public:
 private slots:
     void onConnected(Chessboard::RemoteBoard *board);
     void onDisconnected();
+    void onReconnecting(int attempt);
+    void onReconnected();
     void onOutOfSync();
     void onNoBoardsDiscovered();
     void onError(const QString& errorMessage);
@@ -20,12 +20,15 @@
 #include <QCoreApplication>
 #include <QIODevice>
 #include <QTextStream>
+#include "analyzeapplication.h"
 #include "chessboard.h"
 #include "cliapplicationfactory.h"
 #include "clioptions.h"
 #include "discoverapplication.h"
 #include "getfenapplication.h"
 #include "listenapplication.h"
+#include "matchapplication.h"
+#include "roomapplication.h"
 #include "sendfenapplication.h"
 
 namespace {
@@ -38,6 +41,7 @@ using namespace Chessboard;
 CliApplicationFactory::CliApplicationFactory() :
     ApplicationFactoryBase(APPLICATION_NAME, TRANSLATION_NAME),
     m_quietOption{"quiet", QCoreApplication::translate("main", "Quiet mode. Don't print informational output.")},
+    m_listenOption{"listen", QCoreApplication::translate("main", "Print a FEN record after every move (the default).")},
     m_discoverOption{"discover", QCoreApplication::translate("main", "Discover and print available boards.")},
     m_getFenOption{"getfen", QCoreApplication::translate("main", "Get FEN record for current board state.")},
     m_sendFenOption{"sendfen",
@@ -45,17 +49,88 @@ CliApplicationFactory::CliApplicationFactory() :
                     QCoreApplication::translate("main", "FEN")},
     m_addressOption{"address",
                     QCoreApplication::translate("main", "Address of remote board to connect to."),
-                    QCoreApplication::translate("main", "ADDRESS")}
+                    QCoreApplication::translate("main", "ADDRESS")},
+    m_analyzeOption{"analyze",
+                    QCoreApplication::translate("main", "Analyse every move of the games in a PGN file."),
+                    QCoreApplication::translate("main", "FILE")},
+    m_outputOption{"output",
+                   QCoreApplication::translate("main", "Write the analysis to a file, resuming it if it exists."),
+                   QCoreApplication::translate("main", "FILE")},
+    m_formatOption{"format",
+                   QCoreApplication::translate("main", "Analysis output format: json or csv."),
+                   QCoreApplication::translate("main", "FORMAT"),
+                   QLatin1String("json")},
+    m_moveTimeOption{"movetime",
+                     QCoreApplication::translate("main", "Time to analyse each position, in milliseconds."),
+                     QCoreApplication::translate("main", "MS"),
+                     QLatin1String("1000")},
+    m_enginesOption{"engines",
+                    QCoreApplication::translate("main", "Number of engines to analyse with, or match games to play at once. Defaults to one per core."),
+                    QCoreApplication::translate("main", "N")},
+    m_levelOption{"level",
+                  QCoreApplication::translate("main", "Assistance level (2-6) used to classify moves."),
+                  QCoreApplication::translate("main", "N"),
+                  QLatin1String("3")},
+    m_matchOption{"match",
+                  QCoreApplication::translate("main", "Play a match of N games between two engines."),
+                  QCoreApplication::translate("main", "N")},
+    m_engineAOption{"engine-a",
+                    QCoreApplication::translate("main", "Stockfish path for the first engine, or \"native\"."),
+                    QCoreApplication::translate("main", "PATH")},
+    m_engineBOption{"engine-b",
+                    QCoreApplication::translate("main", "Stockfish path for the second engine, or \"native\"."),
+                    QCoreApplication::translate("main", "PATH")},
+    m_eloAOption{"elo-a",
+                 QCoreApplication::translate("main", "Strength of the first engine."),
+                 QCoreApplication::translate("main", "ELO"),
+                 QLatin1String("2000")},
+    m_eloBOption{"elo-b",
+                 QCoreApplication::translate("main", "Strength of the second engine."),
+                 QCoreApplication::translate("main", "ELO"),
+                 QLatin1String("2000")},
+    m_openingsOption{"openings",
+                     QCoreApplication::translate("main", "PGN or EPD file of match openings."),
+                     QCoreApplication::translate("main", "FILE")},
+    m_timeControlOption{"tc",
+                        QCoreApplication::translate("main", "Match time control in seconds, e.g. 10+0.1."),
+                        QCoreApplication::translate("main", "BASE+INC")},
+    m_maximumPliesOption{"maxplies",
+                         QCoreApplication::translate("main", "Adjudicate match games as drawn after N plies."),
+                         QCoreApplication::translate("main", "N"),
+                         QLatin1String("400")},
+    m_evalOption{"eval", QCoreApplication::translate("main", "With --listen, stream live engine analysis of the board as JSON lines.")},
+    m_rateOption{"rate",
+                 QCoreApplication::translate("main", "Maximum live analysis updates per second; 0 for every update."),
+                 QCoreApplication::translate("main", "N")},
+    m_roomOption{"room", QCoreApplication::translate("main", "Follow the games on every board given with --address at once.")}
 {
 }
 
 void CliApplicationFactory::addCommandLineOptions(QCommandLineParser *parser)
 {
     parser->addOption(m_quietOption);
+    parser->addOption(m_listenOption);
     parser->addOption(m_discoverOption);
     parser->addOption(m_getFenOption);
     parser->addOption(m_sendFenOption);
     parser->addOption(m_addressOption);
+    parser->addOption(m_analyzeOption);
+    parser->addOption(m_outputOption);
+    parser->addOption(m_formatOption);
+    parser->addOption(m_moveTimeOption);
+    parser->addOption(m_enginesOption);
+    parser->addOption(m_levelOption);
+    parser->addOption(m_matchOption);
+    parser->addOption(m_engineAOption);
+    parser->addOption(m_engineBOption);
+    parser->addOption(m_eloAOption);
+    parser->addOption(m_eloBOption);
+    parser->addOption(m_openingsOption);
+    parser->addOption(m_timeControlOption);
+    parser->addOption(m_maximumPliesOption);
+    parser->addOption(m_evalOption);
+    parser->addOption(m_rateOption);
+    parser->addOption(m_roomOption);
 }
 
 Options *CliApplicationFactory::createOptions()
@@ -69,21 +144,34 @@ bool CliApplicationFactory::processOptions(QCommandLineParser *parser, Options&
     if (!success)
         return false;
     CliOptions& cliOptions = static_cast<CliOptions&>(options);
-    if (parser->isSet(m_discoverOption))
+    if (parser->isSet(m_listenOption))
+        cliOptions.action = CliOptions::Action::Listen;
+    else if (parser->isSet(m_discoverOption))
         cliOptions.action = CliOptions::Action::Discover;
     else if (parser->isSet(m_getFenOption))
         cliOptions.action = CliOptions::Action::GetFen;
     else if (!parser->value(m_sendFenOption).isNull())
         cliOptions.action = CliOptions::Action::SendFen;
+    else if (!parser->value(m_analyzeOption).isNull())
+        cliOptions.action = CliOptions::Action::Analyze;
+    else if (!parser->value(m_matchOption).isNull())
+        cliOptions.action = CliOptions::Action::Match;
+    else if (parser->isSet(m_roomOption))
+        cliOptions.action = CliOptions::Action::Room;
     cliOptions.quiet = parser->isSet(m_quietOption);
-    QString address = parser->value(m_addressOption);
-    if (!address.isNull()) {
+    const QStringList addresses = parser->values(m_addressOption);
+    for (const QString& address : addresses) {
         BoardAddress parsedAddress = BoardAddress::fromString(address);
         if (!parsedAddress.isValid()) {
             *errorMessage = QCoreApplication::translate("main", "%1: unable to parse address").arg(address);
             return false;
         }
         cliOptions.address = parsedAddress;
+        cliOptions.addresses.append(parsedAddress);
+    }
+    if (cliOptions.action == CliOptions::Action::Room && cliOptions.addresses.isEmpty()) {
+        *errorMessage = QCoreApplication::translate("main", "--room needs at least one --address");
+        return false;
     }
     QString fen = parser->value(m_sendFenOption);
     if (!fen.isNull()) {
@@ -94,6 +182,81 @@ bool CliApplicationFactory::processOptions(QCommandLineParser *parser, Options&
         }
         cliOptions.fenToSend = state;
     }
+    cliOptions.analyzeFile = parser->value(m_analyzeOption);
+    cliOptions.outputFile = parser->value(m_outputOption);
+    const QString format = parser->value(m_formatOption);
+    if (format == QLatin1String("json")) {
+        cliOptions.format = CliOptions::Format::Json;
+    } else if (format == QLatin1String("csv")) {
+        cliOptions.format = CliOptions::Format::Csv;
+    } else {
+        *errorMessage = QCoreApplication::translate("main", "%1: unknown output format").arg(format);
+        return false;
+    }
+    bool ok = false;
+    cliOptions.moveTime = parser->value(m_moveTimeOption).toInt(&ok);
+    if (!ok || cliOptions.moveTime <= 0) {
+        *errorMessage = QCoreApplication::translate("main", "%1: invalid move time").arg(parser->value(m_moveTimeOption));
+        return false;
+    }
+    if (parser->isSet(m_enginesOption)) {
+        cliOptions.engines = parser->value(m_enginesOption).toInt(&ok);
+        if (!ok || cliOptions.engines <= 0) {
+            *errorMessage = QCoreApplication::translate("main", "%1: invalid number of engines").arg(parser->value(m_enginesOption));
+            return false;
+        }
+    }
+    cliOptions.assistanceLevel = parser->value(m_levelOption).toInt(&ok);
+    if (!ok || cliOptions.assistanceLevel < 2 || cliOptions.assistanceLevel > 6) {
+        *errorMessage = QCoreApplication::translate("main", "%1: assistance level must be between 2 and 6").arg(parser->value(m_levelOption));
+        return false;
+    }
+    if (cliOptions.action == CliOptions::Action::Match) {
+        cliOptions.matchGames = parser->value(m_matchOption).toInt(&ok);
+        if (!ok || cliOptions.matchGames <= 0) {
+            *errorMessage = QCoreApplication::translate("main", "%1: invalid number of games").arg(parser->value(m_matchOption));
+            return false;
+        }
+    }
+    cliOptions.engineA = parser->value(m_engineAOption);
+    cliOptions.engineB = parser->value(m_engineBOption);
+    cliOptions.eloA = parser->value(m_eloAOption).toInt(&ok);
+    if (!ok) {
+        *errorMessage = QCoreApplication::translate("main", "%1: invalid strength").arg(parser->value(m_eloAOption));
+        return false;
+    }
+    cliOptions.eloB = parser->value(m_eloBOption).toInt(&ok);
+    if (!ok) {
+        *errorMessage = QCoreApplication::translate("main", "%1: invalid strength").arg(parser->value(m_eloBOption));
+        return false;
+    }
+    cliOptions.openingsFile = parser->value(m_openingsOption);
+    const QString timeControl = parser->value(m_timeControlOption);
+    if (!timeControl.isNull()) {
+        const QStringList parts = timeControl.split(QLatin1Char('+'));
+        bool baseOk = false, incrementOk = true;
+        const double base = parts.value(0).toDouble(&baseOk);
+        const double increment = (parts.size() > 1) ? parts.value(1).toDouble(&incrementOk) : 0.0;
+        if (parts.size() > 2 || !baseOk || !incrementOk || base <= 0.0 || increment < 0.0) {
+            *errorMessage = QCoreApplication::translate("main", "%1: invalid time control").arg(timeControl);
+            return false;
+        }
+        cliOptions.timeControl.baseTime = qRound(base * 1000.0);
+        cliOptions.timeControl.increment = qRound(increment * 1000.0);
+    }
+    cliOptions.maximumPlies = parser->value(m_maximumPliesOption).toInt(&ok);
+    if (!ok || cliOptions.maximumPlies < 0) {
+        *errorMessage = QCoreApplication::translate("main", "%1: invalid number of plies").arg(parser->value(m_maximumPliesOption));
+        return false;
+    }
+    cliOptions.liveAnalysis = parser->isSet(m_evalOption);
+    if (parser->isSet(m_rateOption)) {
+        cliOptions.analysisRate = parser->value(m_rateOption).toInt(&ok);
+        if (!ok || cliOptions.analysisRate < 0) {
+            *errorMessage = QCoreApplication::translate("main", "%1: invalid analysis rate").arg(parser->value(m_rateOption));
+            return false;
+        }
+    }
     return true;
 }
 
@@ -114,6 +277,15 @@ ApplicationBase *CliApplicationFactory::create(const Options& options)
     case CliOptions::Action::Listen:
         app.reset(new ListenApplication(cliOptions));
         break;
+    case CliOptions::Action::Analyze:
+        app.reset(new AnalyzeApplication(cliOptions));
+        break;
+    case CliOptions::Action::Match:
+        app.reset(new MatchApplication(cliOptions));
+        break;
+    case CliOptions::Action::Room:
+        app.reset(new RoomApplication(cliOptions));
+        break;
     }
     return app.release();
 }
@@ -34,10 +34,28 @@ public:
     bool processOptions(QCommandLineParser *parser, Options& options, QString *errorMessage) override;
 private:
     QCommandLineOption m_quietOption;
+    QCommandLineOption m_listenOption;
     QCommandLineOption m_discoverOption;
     QCommandLineOption m_addressOption;
     QCommandLineOption m_getFenOption;
     QCommandLineOption m_sendFenOption;
+    QCommandLineOption m_analyzeOption;
+    QCommandLineOption m_outputOption;
+    QCommandLineOption m_formatOption;
+    QCommandLineOption m_moveTimeOption;
+    QCommandLineOption m_enginesOption;
+    QCommandLineOption m_levelOption;
+    QCommandLineOption m_matchOption;
+    QCommandLineOption m_engineAOption;
+    QCommandLineOption m_engineBOption;
+    QCommandLineOption m_eloAOption;
+    QCommandLineOption m_eloBOption;
+    QCommandLineOption m_openingsOption;
+    QCommandLineOption m_timeControlOption;
+    QCommandLineOption m_maximumPliesOption;
+    QCommandLineOption m_evalOption;
+    QCommandLineOption m_rateOption;
+    QCommandLineOption m_roomOption;
 };
 
 #endif // CLIAPPLICATIONFACTORY_H
@@ -27,13 +27,45 @@ struct CliOptions : public Options {
         Listen,
         Discover,
         GetFen,
-        SendFen
+        SendFen,
+        Analyze,
+        Match,
+        Room
+    };
+    enum class Format {
+        Json,
+        Csv
     };
 
     bool quiet {false};
     Action action {Action::Listen};
     Chessboard::BoardAddress address;
+    // Every --address given, for --room.
+    QList<Chessboard::BoardAddress> addresses;
     Chessboard::BoardState fenToSend;
+    QString analyzeFile;
+    // Standard output if empty. An existing analysis file is resumed; match
+    // games are appended.
+    QString outputFile;
+    Format format {Format::Json};
+    int moveTime {1000};
+    // Zero means one engine per core.
+    int engines {0};
+    int assistanceLevel {3};
+    int matchGames {0};
+    // A Stockfish path, or "native" for the built-in engine. Empty means
+    // the configured engine.
+    QString engineA;
+    QString engineB;
+    int eloA {2000};
+    int eloB {2000};
+    QString openingsFile;
+    Chessboard::TimeControl timeControl;
+    int maximumPlies {400};
+    // Stream live analysis while listening.
+    bool liveAnalysis {false};
+    // Analysis updates per second; negative keeps the configured rate.
+    int analysisRate {-1};
 };
 
 #endif // CLIOPTIONS_H
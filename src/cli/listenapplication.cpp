@@ -16,18 +16,30 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QTextStream>
 
+#include "aiplayer.h"
 #include "applicationfacade.h"
+#include "clioptions.h"
 #include "connectedcliapplicationbase.h"
 #include "listenapplication.h"
 
 using namespace Chessboard;
 
 ListenApplication::ListenApplication(const CliOptions& options, QObject *parent)
-    : ConnectedCliApplicationBase(options, parent)
+    : ConnectedCliApplicationBase(options, parent),
+      m_liveAnalysis(options.liveAnalysis)
 {
     connect(facade(), &ApplicationFacade::remoteBoardState, this, &ListenApplication::onRemoteBoardState);
+    if (m_liveAnalysis) {
+        if (options.analysisRate >= 0)
+            facade()->setAnalysisRate(options.analysisRate);
+        connect(facade(), &ApplicationFacade::analysis, this, &ListenApplication::onAnalysis);
+        facade()->setAnalysisEnabled(true);
+    }
     connect(facade(), &ApplicationFacade::connected, this, [this]() {
         Chessboard::GameOptions gameOptions;
         gameOptions.white.playerType = Chessboard::PlayerType::Human;
@@ -41,5 +53,37 @@ ListenApplication::ListenApplication(const CliOptions& options, QObject *parent)
 void ListenApplication::onRemoteBoardState(const BoardState& newState)
 {
     QTextStream ts(stdout);
-    ts << newState.toFenString() << "\n";
+    if (!m_liveAnalysis) {
+        ts << newState.toFenString() << "\n";
+        return;
+    }
+    // One JSON object per line, so that consumers can follow the stream.
+    QJsonObject record;
+    record.insert(QLatin1String("type"), QLatin1String("position"));
+    record.insert(QLatin1String("fen"), newState.toFenString());
+    ts << QJsonDocument(record).toJson(QJsonDocument::Compact) << "\n";
+}
+
+void ListenApplication::onAnalysis(const BoardState& state, const PositionAnalysis& analysis)
+{
+    QJsonObject record;
+    record.insert(QLatin1String("type"), QLatin1String("analysis"));
+    record.insert(QLatin1String("fen"), state.toFenString());
+    record.insert(QLatin1String("depth"), analysis.depth);
+    // From White's point of view, as in the batch analysis output.
+    const int sign = (state.activeColour == Colour::White) ? 1 : -1;
+    QJsonValue eval, mate;
+    if (analysis.mate != 0)
+        mate = sign * analysis.mate;
+    else
+        eval = sign * analysis.score;
+    record.insert(QLatin1String("eval"), eval);
+    record.insert(QLatin1String("mate"), mate);
+    record.insert(QLatin1String("nodes"), analysis.nodes);
+    record.insert(QLatin1String("nps"), analysis.nps);
+    const QStringList pv = analysis.sanPv(state);
+    record.insert(QLatin1String("best"), pv.value(0));
+    record.insert(QLatin1String("pv"), QJsonArray::fromStringList(pv));
+    QTextStream ts(stdout);
+    ts << QJsonDocument(record).toJson(QJsonDocument::Compact) << "\n";
 }
@@ -21,12 +21,17 @@
 
 #include "connectedcliapplicationbase.h"
 
+struct PositionAnalysis;
+
 class ListenApplication : public ConnectedCliApplicationBase
 {
 public:
     explicit ListenApplication(const CliOptions& options, QObject *parent = nullptr);
 private slots:
     void onRemoteBoardState(const Chessboard::BoardState& newState);
+    void onAnalysis(const Chessboard::BoardState& state, const PositionAnalysis& analysis);
+private:
+    bool m_liveAnalysis;
 };
 
 #endif // LISTENAPPLICATION_H
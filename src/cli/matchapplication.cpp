@@ -0,0 +1,137 @@
+/*
+ * bluecheese
+ * Copyright (C) 2022-2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QTextStream>
+#include "aiplayerfactory.h"
+#include "applicationfacade.h"
+#include "clioptions.h"
+#include "matchapplication.h"
+#include "matchrunner.h"
+#include "nativeaiplayer.h"
+#include "stockfishaiplayer.h"
+
+using namespace Chessboard;
+
+MatchApplication::MatchApplication(const CliOptions &options, QObject *parent)
+    : CliApplicationBase{options, parent}
+{
+    QMetaObject::invokeMethod(this, &MatchApplication::start, Qt::QueuedConnection);
+}
+
+MatchApplication::~MatchApplication()
+{
+    // The runner's engines are created by the factories.
+    delete m_runner;
+}
+
+AiPlayerFactory *MatchApplication::createFactory(const QString& engine, QString *name)
+{
+    const QString path = engine.isEmpty() ? facade()->stockfishPath() : engine;
+    if (path.isEmpty() || path == QLatin1String("native")) {
+        *name = tr("Native");
+        return new NativeAiPlayerFactory;
+    }
+    *name = QFileInfo(path).baseName();
+    return new StockfishAiPlayerFactory(path);
+}
+
+void MatchApplication::start()
+{
+    const CliOptions& cliOptions = options<CliOptions>();
+    QList<Pgn> openings;
+    if (!cliOptions.openingsFile.isEmpty()) {
+        QFile file(cliOptions.openingsFile);
+        if (!file.open(QIODevice::ReadOnly)) {
+            onMatchError(tr("%1: %2").arg(cliOptions.openingsFile, file.errorString()));
+            return;
+        }
+        QString errorMessage;
+        openings = MatchRunner::readOpenings(&file, &errorMessage);
+        if (openings.isEmpty()) {
+            onMatchError(tr("%1: %2").arg(cliOptions.openingsFile, errorMessage.isEmpty() ? tr("no openings") : errorMessage));
+            return;
+        }
+    }
+    if (cliOptions.outputFile.isEmpty()) {
+        m_output.open(stdout, QIODevice::WriteOnly);
+    } else {
+        m_output.setFileName(cliOptions.outputFile);
+        if (!m_output.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            onMatchError(tr("%1: %2").arg(cliOptions.outputFile, m_output.errorString()));
+            return;
+        }
+    }
+
+    MatchRunner::Player players[2];
+    const QString engines[2] = { cliOptions.engineA, cliOptions.engineB };
+    const int elos[2] = { cliOptions.eloA, cliOptions.eloB };
+    for (int i=0;i<2;++i) {
+        QString name;
+        m_factories[i].reset(createFactory(engines[i], &name));
+        players[i].factory = m_factories[i].get();
+        players[i].elo = elos[i];
+        players[i].name = tr("%1 %2").arg(name).arg(elos[i]);
+    }
+    m_runner = new MatchRunner(players[0], players[1], cliOptions.engines);
+    m_runner->setResources(facade()->engineResources());
+    m_runner->setOpenings(openings);
+    m_runner->setTimeControl(cliOptions.timeControl);
+    m_runner->setMaximumPlies(cliOptions.maximumPlies);
+    m_runner->setOutput(&m_output);
+    connect(m_runner, &MatchRunner::gameFinished, this, &MatchApplication::onGameFinished);
+    connect(m_runner, &MatchRunner::error, this, &MatchApplication::onMatchError);
+    connect(m_runner, &MatchRunner::finished, this, &MatchApplication::onFinished);
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Playing %1 games between %2 and %3, %4 at a time.")
+              .arg(cliOptions.matchGames).arg(players[0].name, players[1].name).arg(m_runner->concurrency()) << "\n";
+    }
+    m_runner->start(cliOptions.matchGames);
+}
+
+void MatchApplication::onGameFinished(int game, const QString& result, const QString& termination)
+{
+    if (!isQuiet()) {
+        const MatchRunner::Statistics statistics = m_runner->statistics();
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Game %1: %2 (%3). Score %4-%5-%6.")
+              .arg(game).arg(result, termination)
+              .arg(statistics.wins).arg(statistics.losses).arg(statistics.draws) << "\n";
+    }
+}
+
+void MatchApplication::onMatchError(const QString& message)
+{
+    QTextStream ts(stderr, QIODevice::WriteOnly);
+    ts << tr("Error: %1").arg(message) << "\n";
+    QCoreApplication::exit(1);
+}
+
+void MatchApplication::onFinished()
+{
+    const MatchRunner::Statistics statistics = m_runner->statistics();
+    QTextStream ts(stderr, QIODevice::WriteOnly);
+    ts << tr("Wins %1, losses %2, draws %3: score %4%, Elo difference %5.")
+          .arg(statistics.wins).arg(statistics.losses).arg(statistics.draws)
+          .arg(statistics.score() * 100.0, 0, 'f', 1)
+          .arg(statistics.eloDifference(), 0, 'f', 0) << "\n";
+    m_output.flush();
+    QCoreApplication::exit(0);
+}
@@ -0,0 +1,48 @@
+/*
+ * bluecheese
+ * Copyright (C) 2022-2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATCHAPPLICATION_H
+#define MATCHAPPLICATION_H
+
+#include <QFile>
+#include <memory>
+#include "cliapplicationbase.h"
+
+class AiPlayerFactory;
+class MatchRunner;
+
+class MatchApplication : public CliApplicationBase
+{
+    Q_OBJECT
+public:
+    explicit MatchApplication(const CliOptions &options, QObject *parent = nullptr);
+    ~MatchApplication();
+private slots:
+    void start();
+    void onGameFinished(int game, const QString& result, const QString& termination);
+    void onMatchError(const QString& message);
+    void onFinished();
+private:
+    AiPlayerFactory *createFactory(const QString& engine, QString *name);
+
+    QFile m_output;
+    std::unique_ptr<AiPlayerFactory> m_factories[2];
+    MatchRunner *m_runner {};
+};
+
+#endif // MATCHAPPLICATION_H
@@ -0,0 +1,90 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QIODevice>
+#include <QTextStream>
+
+#include "boardroom.h"
+#include "clioptions.h"
+#include "compositeboard.h"
+#include "roomapplication.h"
+
+using namespace Chessboard;
+
+RoomApplication::RoomApplication(const CliOptions& options, QObject *parent)
+    : CliApplicationBase{options, parent},
+      m_room(new BoardRoom(this))
+{
+    connect(m_room, &BoardRoom::boardConnected, this, &RoomApplication::onBoardConnected);
+    connect(m_room, &BoardRoom::boardDisconnected, this, &RoomApplication::onBoardDisconnected);
+    connect(m_room->connectionManager(), &MultiConnectionManager::reconnecting, this, &RoomApplication::onReconnecting);
+    connect(m_room->connectionManager(), &MultiConnectionManager::reconnected, this, &RoomApplication::onReconnected);
+    QMetaObject::invokeMethod(this, &RoomApplication::start, Qt::QueuedConnection);
+}
+
+void RoomApplication::start()
+{
+    for (const BoardAddress& address : options<CliOptions>().addresses)
+        m_room->addBoard(address);
+}
+
+void RoomApplication::onBoardConnected(const BoardAddress& address, CompositeBoard *game)
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Connected to %1.").arg(address.toString()) << "\n";
+    }
+    connect(game, &CompositeBoard::boardStateChanged, this, [address](const BoardState& state) {
+        QTextStream ts(stdout);
+        ts << address.toString() << " " << state.toFenString() << "\n";
+    });
+    GameOptions gameOptions;
+    gameOptions.white.playerType = PlayerType::Human;
+    gameOptions.white.playerLocation = PlayerLocation::LocalBoard;
+    gameOptions.black.playerType = PlayerType::Human;
+    gameOptions.black.playerLocation = PlayerLocation::LocalBoard;
+    game->setGameOptions(gameOptions);
+}
+
+void RoomApplication::onBoardDisconnected(const BoardAddress& address)
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Disconnected from %1.").arg(address.toString()) << "\n";
+    }
+    // Boards that failed to connect are gone too.
+    if (m_room->boards().isEmpty())
+        QCoreApplication::exit(1);
+}
+
+void RoomApplication::onReconnecting(const BoardAddress& address, int attempt)
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Connection to %1 lost, reconnecting (attempt %2).").arg(address.toString()).arg(attempt) << "\n";
+    }
+}
+
+void RoomApplication::onReconnected(const BoardAddress& address)
+{
+    if (!isQuiet()) {
+        QTextStream ts(stderr, QIODevice::WriteOnly);
+        ts << tr("Reconnected to %1.").arg(address.toString()) << "\n";
+    }
+}
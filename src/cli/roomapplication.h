@@ -0,0 +1,44 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROOMAPPLICATION_H
+#define ROOMAPPLICATION_H
+
+#include "cliapplicationbase.h"
+
+class BoardRoom;
+class CompositeBoard;
+
+// Follows the games on several boards at once, printing each board's
+// address and FEN record after every move.
+class RoomApplication : public CliApplicationBase
+{
+    Q_OBJECT
+public:
+    explicit RoomApplication(const CliOptions& options, QObject *parent = nullptr);
+private slots:
+    void start();
+    void onBoardConnected(const Chessboard::BoardAddress& address, CompositeBoard *game);
+    void onBoardDisconnected(const Chessboard::BoardAddress& address);
+    void onReconnecting(const Chessboard::BoardAddress& address, int attempt);
+    void onReconnected(const Chessboard::BoardAddress& address);
+private:
+    BoardRoom *m_room;
+};
+
+#endif // ROOMAPPLICATION_H
@@ -20,6 +20,8 @@
 #include "aicontroller.h"
 #include "aiplayer.h"
 #include "aiplayerfactory.h"
+#include "analysisthrottle.h"
+#include "commandchannel.h"
 
 class AiPlayerWorkerProxy : public QObject
 {
@@ -27,7 +29,9 @@ class AiPlayerWorkerProxy : public QObject
 public:
     explicit AiPlayerWorkerProxy(AiPlayer *aiPlayer, QObject *parent = nullptr) :
         QObject(parent),
-        m_aiPlayer(aiPlayer)
+        m_aiPlayer(aiPlayer),
+        m_requests(new CommandReceiver(this)),
+        m_analysisThrottle(new AnalysisThrottle(this))
     {
         aiPlayer->setParent(this);
         connect(m_aiPlayer, &AiPlayer::requestMove, this, &AiPlayerWorkerProxy::requestMove);
@@ -37,6 +41,24 @@ public:
         connect(m_aiPlayer, &AiPlayer::requestPromotion, this, &AiPlayerWorkerProxy::requestPromotion);
         connect(m_aiPlayer, &AiPlayer::assistance, this, &AiPlayerWorkerProxy::assistance);
         connect(m_aiPlayer, &AiPlayer::error, this, &AiPlayerWorkerProxy::error);
+        // Interim results are throttled here, before they cross to the
+        // other thread, so a fast engine cannot flood its event loop.
+        connect(m_aiPlayer, &AiPlayer::analysisProgress, m_analysisThrottle, &AnalysisThrottle::post);
+        connect(m_aiPlayer, &AiPlayer::analysis, this, [this](const PositionAnalysis& analysis) {
+            if (analysis.isValid()) {
+                m_analysisThrottle->post(analysis);
+                m_analysisThrottle->flush();
+            } else {
+                m_analysisThrottle->clear();
+            }
+        });
+        connect(m_analysisThrottle, &AnalysisThrottle::analysis, this, [this](const PositionAnalysis& analysis) {
+            emit analysisSerial(m_serial, analysis);
+        });
+    }
+    CommandSender requests() const
+    {
+        return m_requests->sender();
     }
 signals:
     void requestMoveSerial(long serial, int fromRow, int fromCol, int toRow, int toCol);
@@ -45,26 +67,42 @@ signals:
     void requestResignationSerial(long serial);
     void requestPromotionSerial(long serial, Chessboard::Piece piece);
     void assistanceSerial(long serial, QList<Chessboard::AssistanceColour> colours);
+    void analysisSerial(long serial, const PositionAnalysis& analysis);
     void error(AiPlayer::Error error);
 public slots:
-    void startSerial(long serial, const Chessboard::BoardState& state)
+    void startSerial(long serial, const CancellationToken& token, const Chessboard::BoardState& state)
     {
         m_serial = serial;
+        m_aiPlayer->setCancellationToken(token);
+        if (m_openingBook) {
+            const Chessboard::BookMove move = m_openingBook->selectMove(state, m_bookSelection);
+            if (move.isValid()) {
+                qDebug("AiPlayerWorkerProxy::startSerial: book move %s%s",
+                       qPrintable(move.from.toAlgebraicString()), qPrintable(move.to.toAlgebraicString()));
+                emit requestMoveSerial(serial, move.from.row, move.from.col, move.to.row, move.to.col);
+                if (move.promotion)
+                    emit requestPromotionSerial(serial, move.promotionPiece);
+                return;
+            }
+        }
         m_aiPlayer->start(state);
     }
-    void promotionRequiredSerial(long serial)
+    void promotionRequiredSerial(long serial, const CancellationToken& token)
     {
         m_serial = serial;
+        m_aiPlayer->setCancellationToken(token);
         m_aiPlayer->promotionRequired();
     }
-    void drawRequestedSerial(long serial)
+    void drawRequestedSerial(long serial, const CancellationToken& token)
     {
         m_serial = serial;
+        m_aiPlayer->setCancellationToken(token);
         m_aiPlayer->drawRequested();
     }
-    void drawDeclinedSerial(long serial)
+    void drawDeclinedSerial(long serial, const CancellationToken& token)
     {
         m_serial = serial;
+        m_aiPlayer->setCancellationToken(token);
         m_aiPlayer->drawDeclined();
     }
     void setStrength(int elo)
@@ -75,11 +113,45 @@ public slots:
     {
         m_aiPlayer->setAssistanceLevel(level);
     }
-    void startAssistanceSerial(long serial, const Chessboard::BoardState& state)
+    void startAssistanceSerial(long serial, const CancellationToken& token, const Chessboard::BoardState& state)
     {
         m_serial = serial;
+        m_aiPlayer->setCancellationToken(token);
         m_aiPlayer->startAssistance(state);
     }
+    void prioritiseAssistance(const Chessboard::Square& square)
+    {
+        m_aiPlayer->prioritiseAssistance(square);
+    }
+    void startAnalysisSerial(long serial, const CancellationToken& token, const Chessboard::BoardState& state, int moveTime)
+    {
+        m_serial = serial;
+        m_aiPlayer->setCancellationToken(token);
+        m_analysisThrottle->clear();
+        m_aiPlayer->startAnalysis(state, moveTime);
+    }
+    void setAnalysisRate(int rate)
+    {
+        m_analysisThrottle->setMaximumRate(rate);
+    }
+    void setOpeningBook(const QSharedPointer<const Chessboard::OpeningBook>& openingBook,
+                        Chessboard::OpeningBook::Selection selection)
+    {
+        m_openingBook = openingBook;
+        m_bookSelection = selection;
+    }
+    void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+    {
+        m_aiPlayer->setTablebases(tablebases);
+    }
+    void setClock(const GameClock& clock)
+    {
+        m_aiPlayer->setClock(clock);
+    }
+    void setResources(const EngineResources& resources)
+    {
+        m_aiPlayer->setResources(resources);
+    }
     void cancel()
     {
         m_aiPlayer->cancel();
@@ -111,7 +183,11 @@ private slots:
     }
 private:
     AiPlayer *m_aiPlayer;
+    CommandReceiver *m_requests;
+    AnalysisThrottle *m_analysisThrottle;
     long m_serial {};
+    QSharedPointer<const Chessboard::OpeningBook> m_openingBook;
+    Chessboard::OpeningBook::Selection m_bookSelection {Chessboard::OpeningBook::WeightedRandom};
 };
 
 class AiPlayerControllerProxy : public QObject
@@ -120,15 +196,53 @@ class AiPlayerControllerProxy : public QObject
 public:
     AiPlayerControllerProxy(AiPlayerWorkerProxy *worker, QObject *parent = nullptr) :
         QObject(parent),
-        m_worker(worker)
-    {
-        connect(m_worker, &AiPlayerWorkerProxy::requestMoveSerial, this, &AiPlayerControllerProxy::requestMoveSerial, Qt::QueuedConnection);
-        connect(m_worker, &AiPlayerWorkerProxy::requestDrawSerial, this, &AiPlayerControllerProxy::requestDrawSerial, Qt::QueuedConnection);
-        connect(m_worker, &AiPlayerWorkerProxy::declineDrawSerial, this, &AiPlayerControllerProxy::declineDrawSerial, Qt::QueuedConnection);
-        connect(m_worker, &AiPlayerWorkerProxy::requestResignationSerial, this, &AiPlayerControllerProxy::requestResignationSerial, Qt::QueuedConnection);
-        connect(m_worker, &AiPlayerWorkerProxy::requestPromotionSerial, this, &AiPlayerControllerProxy::requestPromotionSerial, Qt::QueuedConnection);
-        connect(m_worker, &AiPlayerWorkerProxy::assistanceSerial, this, &AiPlayerControllerProxy::assistanceSerial, Qt::QueuedConnection);
-        connect(m_worker, &AiPlayerWorkerProxy::error, this, &AiPlayerControllerProxy::error, Qt::QueuedConnection);
+        m_worker(worker),
+        m_requests(worker->requests()),
+        m_responses(new CommandReceiver(this))
+    {
+        // Results are emitted on the AI thread and handed back to this
+        // thread through the response channel.
+        const CommandSender responses = m_responses->sender();
+        connect(m_worker, &AiPlayerWorkerProxy::requestMoveSerial, m_worker, [this, responses](long serial, int fromRow, int fromCol, int toRow, int toCol) {
+            responses.post([this, serial, fromRow, fromCol, toRow, toCol]() {
+                requestMoveSerial(serial, fromRow, fromCol, toRow, toCol);
+            });
+        }, Qt::DirectConnection);
+        connect(m_worker, &AiPlayerWorkerProxy::requestDrawSerial, m_worker, [this, responses](long serial) {
+            responses.post([this, serial]() {
+                requestDrawSerial(serial);
+            });
+        }, Qt::DirectConnection);
+        connect(m_worker, &AiPlayerWorkerProxy::declineDrawSerial, m_worker, [this, responses](long serial) {
+            responses.post([this, serial]() {
+                declineDrawSerial(serial);
+            });
+        }, Qt::DirectConnection);
+        connect(m_worker, &AiPlayerWorkerProxy::requestResignationSerial, m_worker, [this, responses](long serial) {
+            responses.post([this, serial]() {
+                requestResignationSerial(serial);
+            });
+        }, Qt::DirectConnection);
+        connect(m_worker, &AiPlayerWorkerProxy::requestPromotionSerial, m_worker, [this, responses](long serial, Chessboard::Piece piece) {
+            responses.post([this, serial, piece]() {
+                requestPromotionSerial(serial, piece);
+            });
+        }, Qt::DirectConnection);
+        connect(m_worker, &AiPlayerWorkerProxy::assistanceSerial, m_worker, [this, responses](long serial, const QList<Chessboard::AssistanceColour>& colours) {
+            responses.post([this, serial, colours]() {
+                assistanceSerial(serial, colours);
+            });
+        }, Qt::DirectConnection);
+        connect(m_worker, &AiPlayerWorkerProxy::analysisSerial, m_worker, [this, responses](long serial, const PositionAnalysis& analysis) {
+            responses.post([this, serial, analysis]() {
+                analysisSerial(serial, analysis);
+            });
+        }, Qt::DirectConnection);
+        connect(m_worker, &AiPlayerWorkerProxy::error, m_worker, [this, responses](AiPlayer::Error error) {
+            responses.post([this, error]() {
+                emit this->error(error);
+            });
+        }, Qt::DirectConnection);
         connect(this, &QObject::destroyed, m_worker, &QObject::deleteLater);
     }
 
@@ -139,66 +253,131 @@ signals:
     void requestResignation();
     void requestPromotion(Chessboard::Piece piece);
     void assistance(QList<Chessboard::AssistanceColour> colours);
+    void analysis(const PositionAnalysis& analysis);
     void error(AiPlayer::Error error);
 
 public slots:
-    void start(const Chessboard::BoardState& state)
+    void start(const Chessboard::BoardState& state, const QDeadlineTimer& deadline)
     {
         long serial = ++m_serial;
+        CancellationToken token = newCancellationToken(deadline);
         AiPlayerWorkerProxy *worker = m_worker;
-        QMetaObject::invokeMethod(worker, [worker, serial, state]() {
-                worker->startSerial(serial, state);
-            }, Qt::QueuedConnection);
+        m_requests.post([worker, serial, token, state]() {
+                worker->startSerial(serial, token, state);
+            });
     }
     void promotionRequired()
     {
         long serial = ++m_serial;
+        CancellationToken token = newCancellationToken();
         AiPlayerWorkerProxy *worker = m_worker;
-        QMetaObject::invokeMethod(worker, [worker, serial]() {
-                worker->promotionRequiredSerial(serial);
-            }, Qt::QueuedConnection);
+        m_requests.post([worker, serial, token]() {
+                worker->promotionRequiredSerial(serial, token);
+            });
     }
     void drawRequested()
     {
         long serial = ++m_serial;
+        CancellationToken token = newCancellationToken();
         AiPlayerWorkerProxy *worker = m_worker;
-        QMetaObject::invokeMethod(worker, [worker, serial]() {
-                worker->drawRequestedSerial(serial);
-            }, Qt::QueuedConnection);
+        m_requests.post([worker, serial, token]() {
+                worker->drawRequestedSerial(serial, token);
+            });
     }
     void drawDeclined()
     {
         long serial = ++m_serial;
+        CancellationToken token = newCancellationToken();
         AiPlayerWorkerProxy *worker = m_worker;
-        QMetaObject::invokeMethod(worker, [worker, serial]() {
-                worker->drawDeclinedSerial(serial);
-            }, Qt::QueuedConnection);
+        m_requests.post([worker, serial, token]() {
+                worker->drawDeclinedSerial(serial, token);
+            });
     }
     void setStrength(int elo)
     {
         AiPlayerWorkerProxy *worker = m_worker;
-        QMetaObject::invokeMethod(worker, [worker, elo]() {
+        m_requests.post([worker, elo]() {
                 worker->setStrength(elo);
-            }, Qt::QueuedConnection);
+            });
     }
     void setAssistanceLevel(int level)
     {
         AiPlayerWorkerProxy *worker = m_worker;
-        QMetaObject::invokeMethod(worker, [worker, level]() {
+        m_requests.post([worker, level]() {
                 worker->setAssistanceLevel(level);
-            }, Qt::QueuedConnection);
+            });
     }
     void startAssistance(const Chessboard::BoardState& state)
     {
         long serial = ++m_serial;
+        CancellationToken token = newCancellationToken();
         AiPlayerWorkerProxy *worker = m_worker;
-        QMetaObject::invokeMethod(worker, [worker, serial, state]() {
-                worker->startAssistanceSerial(serial, state);
-            }, Qt::QueuedConnection);
+        m_requests.post([worker, serial, token, state]() {
+                worker->startAssistanceSerial(serial, token, state);
+            });
+    }
+    void startAnalysis(const Chessboard::BoardState& state, int moveTime)
+    {
+        long serial = ++m_serial;
+        CancellationToken token = newCancellationToken();
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker, serial, token, state, moveTime]() {
+                worker->startAnalysisSerial(serial, token, state, moveTime);
+            });
+    }
+    void setAnalysisRate(int rate)
+    {
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker, rate]() {
+                worker->setAnalysisRate(rate);
+            });
+    }
+    void setOpeningBook(const QSharedPointer<const Chessboard::OpeningBook>& openingBook,
+                        Chessboard::OpeningBook::Selection selection)
+    {
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker, openingBook, selection]() {
+                worker->setOpeningBook(openingBook, selection);
+            });
+    }
+    void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+    {
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker, tablebases]() {
+                worker->setTablebases(tablebases);
+            });
+    }
+    void setClock(const GameClock& clock)
+    {
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker, clock]() {
+                worker->setClock(clock);
+            });
+    }
+    void setResources(const EngineResources& resources)
+    {
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker, resources]() {
+                worker->setResources(resources);
+            });
+    }
+    void prioritiseAssistance(const Chessboard::Square& square)
+    {
+        // Not serialized: this refines the request already in progress.
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker, square]() {
+                worker->prioritiseAssistance(square);
+            });
     }
     void cancel()
     {
-        m_worker->cancel();
+        // Flag the request straight away so that a busy player notices
+        // without waiting for the AI thread's event loop.
+        m_cancellationToken.cancel();
+        AiPlayerWorkerProxy *worker = m_worker;
+        m_requests.post([worker]() {
+                worker->cancel();
+            });
     }
 
 private slots:
@@ -232,18 +411,53 @@ private slots:
         if (serial == m_serial)
             emit assistance(colours);
     }
+    void analysisSerial(long serial, const PositionAnalysis& analysis)
+    {
+        if (serial == m_serial)
+            emit this->analysis(analysis);
+    }
 
 private:
+    // Each serialized request supersedes the previous one, so its token
+    // is cancelled as soon as the next request is made.
+    CancellationToken newCancellationToken(const QDeadlineTimer& deadline = QDeadlineTimer(QDeadlineTimer::Forever))
+    {
+        m_cancellationToken.cancel();
+        m_cancellationToken = CancellationToken(deadline);
+        return m_cancellationToken;
+    }
+
     AiPlayerWorkerProxy *m_worker;
+    CommandSender m_requests;
+    CommandReceiver *m_responses;
     long m_serial {};
+    CancellationToken m_cancellationToken;
 };
 
+namespace {
+    // Quits the thread once the events already queued for it, such as the
+    // deletion of worker proxies, have been processed.
+    void quitThreadWhenIdle(QThread *thread)
+    {
+        QObject *threadKiller = new QObject;
+        threadKiller->moveToThread(thread);
+        QObject::connect(threadKiller, &QObject::destroyed, thread, &QThread::quit);
+        QMetaObject::invokeMethod(threadKiller, [threadKiller]() {
+                threadKiller->deleteLater();
+            }, Qt::QueuedConnection);
+    }
+}
+
 AiController::AiController(AiPlayerFactory *factory, QObject *parent)
     : QObject{parent},
-      m_thread(new QThread)
+      m_thread(new QThread),
+      m_analysisThread(new QThread),
+      m_analysisRate(AnalysisThrottle::defaultMaximumRate)
 {
     connect(m_thread, &QThread::finished, m_thread, &QThread::deleteLater);
+    connect(m_analysisThread, &QThread::finished, m_analysisThread, &QThread::deleteLater);
     m_thread->start();
+    m_analysisThread->start();
     createAiPlayers(factory);
 }
 
@@ -255,20 +469,33 @@ AiController::~AiController()
     // before the thread is destroyed.
     delete m_whiteAiPlayer;
     delete m_blackAiPlayer;
-    QObject *threadKiller = new QObject;
-    threadKiller->moveToThread(m_thread);
-    connect(threadKiller, &QObject::destroyed, m_thread, &QThread::quit);
-    QMetaObject::invokeMethod(threadKiller, [threadKiller]() {
-            threadKiller->deleteLater();
-        }, Qt::QueuedConnection);
+    delete m_analysisPlayer;
+    quitThreadWhenIdle(m_thread);
+    quitThreadWhenIdle(m_analysisThread);
 }
 
 void AiController::createAiPlayers(AiPlayerFactory *factory)
 {
+    createAnalysisPlayer(factory);
     createAiPlayer(Chessboard::Colour::White, factory, &m_whiteAiPlayer);
     createAiPlayer(Chessboard::Colour::Black, factory, &m_blackAiPlayer);
 }
 
+void AiController::createAnalysisPlayer(AiPlayerFactory *factory)
+{
+    // Live analysis runs alongside the game, so it has a player and a
+    // thread of its own. The player is only configured, which starts an
+    // external engine, once analysis is first requested.
+    AiPlayer *aiPlayer = factory->createAiPlayer(Chessboard::Colour::White);
+    AiPlayerWorkerProxy *workerProxy = new AiPlayerWorkerProxy(aiPlayer);
+    m_analysisPlayer = new AiPlayerControllerProxy(workerProxy, this);
+    m_analysisPlayerConfigured = false;
+    connect(m_analysisPlayer, &AiPlayerControllerProxy::analysis, this, &AiController::analysis);
+    connect(m_analysisPlayer, &AiPlayerControllerProxy::error, this, &AiController::error);
+    workerProxy->moveToThread(m_analysisThread);
+    m_analysisPlayer->setAnalysisRate(m_analysisRate);
+}
+
 void AiController::createAiPlayer(Chessboard::Colour colour, AiPlayerFactory *factory, AiPlayerControllerProxy **controllerProxy)
 {
     AiPlayer *aiPlayer = factory->createAiPlayer(colour);
@@ -288,6 +515,11 @@ void AiController::createAiPlayer(Chessboard::Colour colour, AiPlayerFactory *fa
     connect(*controllerProxy, &AiPlayerControllerProxy::assistance, this, &AiController::assistance);
     connect(*controllerProxy, &AiPlayerControllerProxy::error, this, &AiController::error);
     workerProxy->moveToThread(m_thread);
+    if (m_openingBook)
+        (*controllerProxy)->setOpeningBook(m_openingBook, m_bookSelection);
+    if (m_tablebases)
+        (*controllerProxy)->setTablebases(m_tablebases);
+    (*controllerProxy)->setResources(resources(colour));
 }
 
 void AiController::cancel()
@@ -301,9 +533,14 @@ void AiController::cancel(Chessboard::Colour colour)
     aiPlayer(colour)->cancel();
 }
 
-void AiController::start(Chessboard::Colour colour, const Chessboard::BoardState& state)
+void AiController::start(Chessboard::Colour colour, const Chessboard::BoardState& state, const QDeadlineTimer& deadline)
+{
+    aiPlayer(colour)->start(state, deadline);
+}
+
+void AiController::setClock(Chessboard::Colour colour, const GameClock& clock)
 {
-    aiPlayer(colour)->start(state);
+    aiPlayer(colour)->setClock(clock);
 }
 
 void AiController::drawRequested(Chessboard::Colour colour)
@@ -336,6 +573,72 @@ void AiController::startAssistance(Chessboard::Colour colour, const Chessboard::
     aiPlayer(colour)->startAssistance(state);
 }
 
+void AiController::prioritiseAssistance(Chessboard::Colour colour, const Chessboard::Square& square)
+{
+    aiPlayer(colour)->prioritiseAssistance(square);
+}
+
+void AiController::startAnalysis(const Chessboard::BoardState& state, int moveTime)
+{
+    if (!m_analysisPlayerConfigured) {
+        m_analysisPlayerConfigured = true;
+        if (m_tablebases)
+            m_analysisPlayer->setTablebases(m_tablebases);
+        m_analysisPlayer->setResources(m_analysisResources);
+    }
+    m_analysisPlayer->startAnalysis(state, moveTime);
+}
+
+void AiController::stopAnalysis()
+{
+    m_analysisPlayer->cancel();
+}
+
+void AiController::setAnalysisRate(int rate)
+{
+    m_analysisRate = rate;
+    m_analysisPlayer->setAnalysisRate(rate);
+}
+
+void AiController::setAnalysisResources(const EngineResources& resources)
+{
+    m_analysisResources = resources;
+    if (m_analysisPlayerConfigured)
+        m_analysisPlayer->setResources(resources);
+}
+
+void AiController::setOpeningBook(const QSharedPointer<const Chessboard::OpeningBook>& openingBook,
+                                  Chessboard::OpeningBook::Selection selection)
+{
+    m_openingBook = openingBook;
+    m_bookSelection = selection;
+    m_whiteAiPlayer->setOpeningBook(openingBook, selection);
+    m_blackAiPlayer->setOpeningBook(openingBook, selection);
+}
+
+void AiController::setResources(Chessboard::Colour colour, const EngineResources& resources)
+{
+    if (colour == Chessboard::Colour::White)
+        m_whiteResources = resources;
+    else
+        m_blackResources = resources;
+    aiPlayer(colour)->setResources(resources);
+}
+
+EngineResources AiController::resources(Chessboard::Colour colour) const
+{
+    return (colour == Chessboard::Colour::White) ? m_whiteResources : m_blackResources;
+}
+
+void AiController::setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+{
+    m_tablebases = tablebases;
+    m_whiteAiPlayer->setTablebases(tablebases);
+    m_blackAiPlayer->setTablebases(tablebases);
+    if (m_analysisPlayerConfigured)
+        m_analysisPlayer->setTablebases(tablebases);
+}
+
 AiPlayerControllerProxy *AiController::aiPlayer(Chessboard::Colour colour)
 {
     switch (colour) {
@@ -351,6 +654,7 @@ void AiController::setFactory(AiPlayerFactory *factory)
 {
     delete m_whiteAiPlayer;
     delete m_blackAiPlayer;
+    delete m_analysisPlayer;
     createAiPlayers(factory);
 }
 
@@ -19,9 +19,12 @@
 #ifndef AICONTROLLER_H
 #define AICONTROLLER_H
 
+#include <QDeadlineTimer>
 #include <QObject>
+#include <QSharedPointer>
 #include "aiplayer.h"
 #include "chessboard.h"
+#include "engineresources.h"
 
 class AiPlayerControllerProxy;
 class AiPlayerFactory;
@@ -33,6 +36,14 @@ public:
     explicit AiController(AiPlayerFactory *factory, QObject *parent = nullptr);
     ~AiController();
     void setFactory(AiPlayerFactory *factory);
+    void setOpeningBook(const QSharedPointer<const Chessboard::OpeningBook>& openingBook,
+                        Chessboard::OpeningBook::Selection selection = Chessboard::OpeningBook::WeightedRandom);
+    void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases);
+    void setResources(Chessboard::Colour colour, const EngineResources& resources);
+    EngineResources resources(Chessboard::Colour colour) const;
+    // Maximum analysis updates per second; zero passes on every update.
+    void setAnalysisRate(int rate);
+    void setAnalysisResources(const EngineResources& resources);
 
 signals:
     void requestMove(int fromRow, int fromCol, int toRow, int toCol);
@@ -41,10 +52,13 @@ signals:
     void requestResignation(Chessboard::Colour requestor);
     void requestPromotion(Chessboard::Piece piece);
     void assistance(QList<Chessboard::AssistanceColour> colours);
+    void analysis(const PositionAnalysis& analysis);
     void error(AiPlayer::Error error);
 
 public slots:
-    void start(Chessboard::Colour colour, const Chessboard::BoardState& state);
+    void start(Chessboard::Colour colour, const Chessboard::BoardState& state,
+               const QDeadlineTimer& deadline = QDeadlineTimer(QDeadlineTimer::Forever));
+    void setClock(Chessboard::Colour colour, const GameClock& clock);
     void cancel();
     void cancel(Chessboard::Colour colour);
     void drawRequested(Chessboard::Colour requestor);
@@ -53,15 +67,31 @@ public slots:
     void setStrength(Chessboard::Colour colour, int elo);
     void setAssistanceLevel(Chessboard::Colour colour, int level);
     void startAssistance(Chessboard::Colour colour, const Chessboard::BoardState& state);
+    void prioritiseAssistance(Chessboard::Colour colour, const Chessboard::Square& square);
+    // Analyses state independently of either player. Each call supersedes
+    // the last; cancel() leaves the analysis running.
+    void startAnalysis(const Chessboard::BoardState& state, int moveTime);
+    void stopAnalysis();
 
 private:
     AiPlayerControllerProxy *aiPlayer(Chessboard::Colour);
     void createAiPlayers(AiPlayerFactory *factory);
     void createAiPlayer(Chessboard::Colour colour, AiPlayerFactory *factory, AiPlayerControllerProxy **controllerProxy);
+    void createAnalysisPlayer(AiPlayerFactory *factory);
 
     QThread *m_thread;
+    QThread *m_analysisThread;
     AiPlayerControllerProxy *m_whiteAiPlayer;
     AiPlayerControllerProxy *m_blackAiPlayer;
+    AiPlayerControllerProxy *m_analysisPlayer;
+    bool m_analysisPlayerConfigured {};
+    int m_analysisRate;
+    EngineResources m_analysisResources;
+    QSharedPointer<const Chessboard::OpeningBook> m_openingBook;
+    Chessboard::OpeningBook::Selection m_bookSelection {Chessboard::OpeningBook::WeightedRandom};
+    QSharedPointer<const Chessboard::SyzygyTablebases> m_tablebases;
+    EngineResources m_whiteResources;
+    EngineResources m_blackResources;
 };
 
 #endif // AICONTROLLER_H
@@ -1,4 +1,22 @@
 #include "aiplayer.h"
+#include "assistance.h"
+
+QStringList PositionAnalysis::sanPv(const Chessboard::BoardState& state) const
+{
+    QStringList ret;
+    Chessboard::BoardState board = state;
+    for (const QString& move : pv) {
+        const Chessboard::AlgebraicNotation an = Chessboard::AlgebraicNotation::fromString(move);
+        const QString san = an.toString(board);
+        if (san.isEmpty())
+            break;
+        ret.append(san);
+        board.move(an.fromRow, an.fromCol, an.toRow, an.toCol);
+        if (an.promotion)
+            board.promote(an.promotionPiece);
+    }
+    return ret;
+}
 
 AiPlayer::AiPlayer(Chessboard::Colour colour, QObject *parent) :
     QObject(parent),
@@ -13,15 +31,17 @@ Chessboard::Colour AiPlayer::colour() const
 
 bool AiPlayer::isCancelled() const
 {
-    return m_cancelled;
+    return m_cancellationToken.isCancelled();
 }
 
 void AiPlayer::cancel()
 {
-    m_cancelled = true;
-    QMetaObject::invokeMethod(this, [this]() {
-            m_cancelled = false;
-        }, Qt::QueuedConnection);
+    m_cancellationToken.cancel();
+}
+
+void AiPlayer::setCancellationToken(const CancellationToken& token)
+{
+    m_cancellationToken = token;
 }
 
 void AiPlayer::drawRequested()
@@ -43,4 +63,65 @@ void AiPlayer::setAssistanceLevel(int)
 
 void AiPlayer::startAssistance(const Chessboard::BoardState&)
 {
+    emit assistanceComplete();
+}
+
+void AiPlayer::startAnalysis(const Chessboard::BoardState&, int)
+{
+    emit analysis(PositionAnalysis());
+}
+
+void AiPlayer::prioritiseAssistance(const Chessboard::Square&)
+{
+}
+
+void AiPlayer::setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+{
+    m_tablebases = tablebases;
+}
+
+void AiPlayer::setClock(const GameClock& clock)
+{
+    m_clock = clock;
+}
+
+void AiPlayer::setResources(const EngineResources&)
+{
+}
+
+bool AiPlayer::playTablebaseMove(const Chessboard::BoardState& state)
+{
+    if (!m_tablebases || isCancelled())
+        return false;
+    const Chessboard::TablebaseMove move = m_tablebases->selectMove(state);
+    if (!move.isValid())
+        return false;
+    qDebug("AiPlayer::playTablebaseMove: %s%s dtz %d", qPrintable(move.from.toAlgebraicString()),
+           qPrintable(move.to.toAlgebraicString()), move.dtz);
+    emit requestMove(move.from.row, move.from.col, move.to.row, move.to.col);
+    if (move.promotion)
+        emit requestPromotion(move.promotionPiece);
+    return true;
+}
+
+bool AiPlayer::tablebaseAssistance(const Chessboard::BoardState& state, int assistanceLevel,
+                                   QList<Chessboard::AssistanceColour> *colours) const
+{
+    if (!m_tablebases)
+        return false;
+    const QList<Chessboard::TablebaseMove> moves = m_tablebases->moves(state);
+    if (moves.isEmpty())
+        return false;
+    colours->clear();
+    for (const QPair<Chessboard::Square, Chessboard::Square>& sortedMove : state.sortedLegalMoves()) {
+        // Moves are best first, so this finds the best promotion.
+        for (const Chessboard::TablebaseMove& move : moves) {
+            if (move.from == sortedMove.first && move.to == sortedMove.second) {
+                const bool best = move.from == moves.first().from && move.to == moves.first().to;
+                colours->append(classifyAssistance(assistanceLevel, tablebaseScore(move.result), best));
+                break;
+            }
+        }
+    }
+    return true;
 }
@@ -20,7 +20,43 @@
 #define AIPLAYER_H
 
 #include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include "cancellationtoken.h"
 #include "chessboard.h"
+#include "engineresources.h"
+#include "timemanager.h"
+
+// Evaluation of a position from the point of view of the side to move.
+struct PositionAnalysis {
+    static const int mateScore = 100000;
+
+    // Long algebraic notation, as used by UCI.
+    QString bestMove;
+    // Centipawns; not meaningful when there is a forced mate.
+    int score {};
+    // Moves to mate, negative when the side to move is being mated.
+    int mate {};
+    int depth {};
+    QStringList pv;
+    qint64 nodes {};
+    // Nodes searched per second.
+    qint64 nps {};
+
+    bool isValid() const { return !bestMove.isEmpty(); }
+    // Centipawns, with any forced mate worth more than every material advantage.
+    int effectiveScore() const
+    {
+        if (mate > 0)
+            return mateScore - mate;
+        if (mate < 0)
+            return -mateScore - mate;
+        return score;
+    }
+    // The principal variation in standard algebraic notation, played out
+    // from state. It stops at the first move that is not legal there.
+    QStringList sanPv(const Chessboard::BoardState& state) const;
+};
 
 class AiPlayer : public QObject {
     Q_OBJECT
@@ -32,6 +68,7 @@ public:
         EngineNoStart,
         EngineNoBoot,
         EngineTimedOut,
+        EngineCrashed,
         UnknownError
     };
 
@@ -41,6 +78,9 @@ public:
     Chessboard::Colour colour() const;
     bool isCancelled() const;
     virtual void cancel();
+    CancellationToken cancellationToken() const { return m_cancellationToken; }
+    void setCancellationToken(const CancellationToken& token);
+    GameClock clock() const { return m_clock; }
 
 signals:
     void requestMove(int fromRow, int fromCol, int toRow, int toCol);
@@ -49,6 +89,12 @@ signals:
     void requestResignation();
     void requestPromotion(Chessboard::Piece piece);
     void assistance(QList<Chessboard::AssistanceColour>& colours);
+    // No further assistance will follow for the current position.
+    void assistanceComplete();
+    void analysis(const PositionAnalysis& analysis);
+    // Interim results of startAnalysis as the search deepens. analysis()
+    // still follows with the final result.
+    void analysisProgress(const PositionAnalysis& analysis);
     void error(Error error);
 
 public slots:
@@ -59,10 +105,26 @@ public slots:
     virtual void setStrength(int elo);
     virtual void setAssistanceLevel(int level);
     virtual void startAssistance(const Chessboard::BoardState& state);
+    virtual void startAnalysis(const Chessboard::BoardState& state, int moveTime);
+    virtual void prioritiseAssistance(const Chessboard::Square& square);
+    virtual void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases);
+    virtual void setClock(const GameClock& clock);
+    virtual void setResources(const EngineResources& resources);
+
+protected:
+    QSharedPointer<const Chessboard::SyzygyTablebases> tablebases() const { return m_tablebases; }
+    // Plays the best tablebase move, if the position is in the tablebases.
+    bool playTablebaseMove(const Chessboard::BoardState& state);
+    // Classifies every legal move, in sortedLegalMoves() order, from the
+    // tablebases, if the position is in them.
+    bool tablebaseAssistance(const Chessboard::BoardState& state, int assistanceLevel,
+                             QList<Chessboard::AssistanceColour> *colours) const;
 
 private:
     Chessboard::Colour m_colour;
-    bool m_cancelled {};
+    CancellationToken m_cancellationToken;
+    GameClock m_clock;
+    QSharedPointer<const Chessboard::SyzygyTablebases> m_tablebases;
 };
 
 #endif // AIPLAYER_H
@@ -0,0 +1,66 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "analysiscache.h"
+
+AnalysisCache::AnalysisCache(int maxEntries) :
+    m_cache(maxEntries)
+{
+}
+
+QByteArray AnalysisCache::cacheKey(const QByteArray& positionKey, int assistanceLevel)
+{
+    QByteArray key = positionKey;
+    key.append(static_cast<char>(assistanceLevel));
+    return key;
+}
+
+bool AnalysisCache::lookup(const QByteArray& positionKey, int assistanceLevel, int budget, Entry *entry)
+{
+    // QCache::object() marks the entry as most recently used.
+    Entry *cached = m_cache.object(cacheKey(positionKey, assistanceLevel));
+    if (!cached || cached->budget < budget)
+        return false;
+    if (entry)
+        *entry = *cached;
+    return true;
+}
+
+bool AnalysisCache::insert(const QByteArray& positionKey, int assistanceLevel, const Entry& entry)
+{
+    const QByteArray key = cacheKey(positionKey, assistanceLevel);
+    Entry *cached = m_cache.object(key);
+    if (cached && cached->budget > entry.budget)
+        return false;
+    return m_cache.insert(key, new Entry(entry));
+}
+
+void AnalysisCache::clear()
+{
+    m_cache.clear();
+}
+
+int AnalysisCache::size() const
+{
+    return m_cache.size();
+}
+
+int AnalysisCache::maxEntries() const
+{
+    return m_cache.maxCost();
+}
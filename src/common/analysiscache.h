@@ -0,0 +1,54 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QList>
+#include "chessboard.h"
+
+// Least-recently-used cache of assistance results keyed by position and
+// assistance level. Each entry records the per-move search budget it was
+// computed with so that a lookup with a larger budget misses and the
+// deeper result replaces the shallower one when it is inserted.
+class AnalysisCache
+{
+public:
+    struct Entry {
+        int budget {};
+        QList<Chessboard::AssistanceColour> colours;
+        QList<int> scores;
+    };
+
+    explicit AnalysisCache(int maxEntries = 256);
+
+    bool lookup(const QByteArray& positionKey, int assistanceLevel, int budget, Entry *entry);
+    bool insert(const QByteArray& positionKey, int assistanceLevel, const Entry& entry);
+    void clear();
+    int size() const;
+    int maxEntries() const;
+
+private:
+    static QByteArray cacheKey(const QByteArray& positionKey, int assistanceLevel);
+
+    QCache<QByteArray, Entry> m_cache;
+};
+
+#endif // ANALYSISCACHE_H
@@ -0,0 +1,72 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTimer>
+#include "analysisthrottle.h"
+
+AnalysisThrottle::AnalysisThrottle(QObject *parent) :
+    QObject(parent),
+    m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &AnalysisThrottle::flush);
+}
+
+void AnalysisThrottle::setMaximumRate(int rate)
+{
+    m_maximumRate = qMax(0, rate);
+    if (m_maximumRate == 0)
+        flush();
+}
+
+void AnalysisThrottle::post(const PositionAnalysis& analysis)
+{
+    m_pending = analysis;
+    m_hasPending = true;
+    if (m_maximumRate == 0 || !m_lastDelivery.isValid()) {
+        deliver();
+        return;
+    }
+    const qint64 interval = 1000 / m_maximumRate;
+    const qint64 elapsed = m_lastDelivery.elapsed();
+    if (elapsed >= interval)
+        deliver();
+    else if (!m_timer->isActive())
+        m_timer->start(static_cast<int>(interval - elapsed));
+}
+
+void AnalysisThrottle::flush()
+{
+    if (m_hasPending)
+        deliver();
+}
+
+void AnalysisThrottle::clear()
+{
+    m_timer->stop();
+    m_hasPending = false;
+    m_pending = PositionAnalysis();
+}
+
+void AnalysisThrottle::deliver()
+{
+    m_timer->stop();
+    m_hasPending = false;
+    m_lastDelivery.start();
+    emit analysis(m_pending);
+}
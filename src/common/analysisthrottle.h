@@ -0,0 +1,62 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANALYSISTHROTTLE_H
+#define ANALYSISTHROTTLE_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include "aiplayer.h"
+
+class QTimer;
+
+// Coalesces a stream of analysis updates so that no more than the maximum
+// rate are delivered each second. Only the latest update is kept while the
+// stream is held back, and it is delivered once the interval is up, so the
+// last update of a burst is never lost.
+class AnalysisThrottle : public QObject
+{
+    Q_OBJECT
+public:
+    static const int defaultMaximumRate = 4;
+
+    explicit AnalysisThrottle(QObject *parent = nullptr);
+
+    int maximumRate() const { return m_maximumRate; }
+    // Updates per second; zero delivers every update.
+    void setMaximumRate(int rate);
+    void post(const PositionAnalysis& analysis);
+    // Delivers the held back update now, if there is one.
+    void flush();
+    // Drops the held back update, for example because the position changed.
+    void clear();
+
+signals:
+    void analysis(const PositionAnalysis& analysis);
+
+private:
+    void deliver();
+
+    QTimer *m_timer;
+    QElapsedTimer m_lastDelivery;
+    PositionAnalysis m_pending;
+    bool m_hasPending {};
+    int m_maximumRate {defaultMaximumRate};
+};
+
+#endif // ANALYSISTHROTTLE_H
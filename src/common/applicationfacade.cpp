@@ -26,6 +26,7 @@
 #include "applicationfacade.h"
 #include "commontranslations.h"
 #include "compositeboard.h"
+#include "nativeaiplayer.h"
 #include "stockfishaiplayer.h"
 #include "config.h"
 
@@ -38,6 +39,18 @@ namespace {
     const QLatin1String ADDRESS("address");
     const QLatin1String STOCKFISH_GROUP("stockfish");
     const QLatin1String PATH("path");
+    const QLatin1String THREADS("threads");
+    const QLatin1String HASH("hash");
+    const QLatin1String BOOK_GROUP("book");
+    const QLatin1String TABLEBASES_GROUP("tablebases");
+    const QLatin1String ANALYSIS_GROUP("analysis");
+    const QLatin1String RATE("rate");
+    // Live analysis carries on until the position changes; this only stops
+    // an engine left on a position that never does.
+    const int analysisMoveTime = 5 * 60 * 1000;
+    // Boards near each other advertise at about the same time, so discovery
+    // lingers briefly after the first one rather than for the full timeout.
+    const int discoveryGrace = 1000;
 }
 
 ApplicationFacade::ApplicationFacade(AiPlayerFactory *aiPlayerFactory, QObject *parent)
@@ -46,21 +59,6 @@ ApplicationFacade::ApplicationFacade(AiPlayerFactory *aiPlayerFactory, QObject *
     construct(aiPlayerFactory);
 }
 
-class StockfishAiPlayerFactory : public AiPlayerFactory
-{
-public:
-    StockfishAiPlayerFactory(const QString& stockfishPath) :
-        m_stockfishPath(stockfishPath)
-    {
-    }
-    AiPlayer *createAiPlayer(Chessboard::Colour colour, QObject *parent = nullptr)
-    {
-        return new StockfishAiPlayer(colour, m_stockfishPath, parent);
-    }
-private:
-    QString m_stockfishPath;
-};
-
 ApplicationFacade::ApplicationFacade(QObject *parent)
     : QObject{parent}
 {
@@ -72,14 +70,36 @@ ApplicationFacade::ApplicationFacade(QObject *parent)
         m_stockfishPath.clear();
     else if (QFileInfo(m_stockfishPath).isRelative())
         m_stockfishPath = QFileInfo(QDir(QCoreApplication::applicationDirPath()), m_stockfishPath).filePath();
+    const int threads = m_settings.value(THREADS, 0).toInt();
+    const int hash = m_settings.value(HASH, 0).toInt();
     m_settings.endGroup();
+    // Without Stockfish fall back to the built-in engine.
     StockfishAiPlayerFactory stockfishAiPlayerFactory(m_stockfishPath);
-    construct(&stockfishAiPlayerFactory);
+    NativeAiPlayerFactory nativeAiPlayerFactory;
+    if (m_stockfishPath.isEmpty())
+        construct(&nativeAiPlayerFactory);
+    else
+        construct(&stockfishAiPlayerFactory);
+    m_settings.beginGroup(BOOK_GROUP);
+    const QString bookPath = m_settings.value(PATH, QString()).toString();
+    m_settings.endGroup();
+    loadOpeningBook(bookPath);
+    m_settings.beginGroup(TABLEBASES_GROUP);
+    const QString tablebasePath = m_settings.value(PATH, QString()).toString();
+    m_settings.endGroup();
+    loadTablebases(tablebasePath);
+    loadEngineResources(threads, hash);
+    m_settings.beginGroup(ANALYSIS_GROUP);
+    const int analysisRate = m_settings.value(RATE, AnalysisThrottle::defaultMaximumRate).toInt();
+    m_settings.endGroup();
+    setAnalysisRate(analysisRate);
 }
 
 void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
 {
     m_boardDiscovery = new BoardDiscovery(this);
+    m_boardDiscovery->setBoardsOnly(true);
+    m_boardDiscovery->setStopAfterFirst(discoveryGrace);
     connect(m_boardDiscovery, &BoardDiscovery::finished, this, &ApplicationFacade::discoveryFinished);
     connect(m_boardDiscovery, &BoardDiscovery::error, this, &ApplicationFacade::onDiscoveryError);
     connect(m_boardDiscovery, &BoardDiscovery::boardDiscovered, this, &ApplicationFacade::boardDiscovered);
@@ -88,6 +108,7 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
     connect(m_boardDiscovery, &BoardDiscovery::started, this, &ApplicationFacade::discoveryStarted);
 
     m_connectionManager = new ConnectionManager(this);
+    m_connectionManager->setAutoReconnect(true);
     connect(m_connectionManager, &ConnectionManager::connected, this, [this](RemoteBoard *board) {
         m_board->setRemoteBoard(board);
         emit connected(board);
@@ -97,6 +118,16 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
         emit disconnected();
         m_board->setRemoteBoard(nullptr);
     });
+    connect(m_connectionManager, &ConnectionManager::reconnecting, this, [this](int attempt, int delay) {
+        qDebug("ApplicationFacade::reconnecting(%d) in %d ms", attempt, delay);
+        if (attempt == 1)
+            m_board->setRemoteBoard(nullptr);
+        emit reconnecting(attempt);
+    });
+    connect(m_connectionManager, &ConnectionManager::reconnected, this, [this](RemoteBoard *board) {
+        m_board->resyncRemoteBoard(board);
+        emit reconnected(board);
+    });
     connect(m_connectionManager, &ConnectionManager::error, this, &ApplicationFacade::onConnectionError);
     connect(m_connectionManager, &ConnectionManager::connectionFailed, this, &ApplicationFacade::connectionFailed);
     connect(m_connectionManager, &ConnectionManager::connecting, this, &ApplicationFacade::connecting);
@@ -112,6 +143,7 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
     connect(m_board, &CompositeBoard::boardStateChanged, this, [this](const BoardState& state) {
         m_aiController->cancel();
         emit boardStateChanged(state);
+        maybeStartAnalysis();
         if (m_gameProgress.state != GameProgress::InProgress)
             emit gameProgressChanged(GameProgress(GameProgress::InProgress));
         if (!m_board->isPromotionRequired())
@@ -138,6 +170,13 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
             m_aiController->drawDeclined(declinor);
         }
     });
+    connect(m_board, &CompositeBoard::pieceLifted, this, [this](const Square& square) {
+        // Speculatively refine the hints for the lifted piece first.
+        const BoardState state = m_board->boardState();
+        const ColouredPiece piece = state[square];
+        if (piece.isValid() && piece.colour() == state.activeColour && !isPlayerAppAi(state.activeColour))
+            m_aiController->prioritiseAssistance(state.activeColour, square);
+    });
     connect(m_board, &CompositeBoard::resignation, this, [this](Colour colour) {
         emit gameProgressChanged(GameProgress(GameProgress::Resignation,
                                               (colour == Colour::White) ? Colour::Black : Colour::White));
@@ -149,6 +188,16 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
         emit gameOver();
         emit checkmate(colour);
     });
+    connect(m_board, &CompositeBoard::adjudicated, this, [this](Colour colour) {
+        emit gameProgressChanged(GameProgress(GameProgress::Adjudication, colour));
+        emit gameOver();
+        emit adjudicated(colour);
+    });
+    connect(m_board, &CompositeBoard::timeExpired, this, [this](Colour colour) {
+        emit gameProgressChanged(GameProgress(GameProgress::Timeout, invertColour(colour)));
+        emit gameOver();
+        emit timeExpired(colour);
+    });
     connect(m_board, &CompositeBoard::draw, this, [this](DrawReason reason) {
         emit gameProgressChanged(GameProgress(GameProgress::Draw, reason));
         emit gameOver();
@@ -165,6 +214,7 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
     });
     connect(this, &ApplicationFacade::gameOver, this, [this]() {
         m_aiController->cancel();
+        m_board->stopClock();
     });
     connect(m_aiController, &AiController::requestMove, this, &ApplicationFacade::requestMove);
     connect(m_aiController, &AiController::requestDraw, this, &ApplicationFacade::requestDraw);
@@ -176,6 +226,10 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
         m_board->sendAssistance(colours);
         emit assistance(colours);
     });
+    connect(m_aiController, &AiController::analysis, this, [this](const PositionAnalysis& analysis) {
+        if (m_analysisRunning)
+            emit this->analysis(m_analysedState, analysis);
+    });
     connect(m_aiController, &AiController::error, this, &ApplicationFacade::aiError);
 
     connect(this, &ApplicationFacade::gameProgressChanged, this, [this](GameProgress gameProgress) {
@@ -190,6 +244,7 @@ void ApplicationFacade::construct(AiPlayerFactory *aiPlayerFactory)
             m_aiController->setStrength(Colour::Black, gameOptions.black.aiNominalElo);
         else
             m_aiController->setAssistanceLevel(Colour::Black, gameOptions.black.assistanceLevel);
+        applyEngineResources(gameOptions);
     });
 
     m_settings.beginGroup(CONNECTION_GROUP);
@@ -451,6 +506,9 @@ void ApplicationFacade::aiError(AiPlayer::Error error)
     case AiPlayer::EngineTimedOut:
         errorMessage = tr("engine timed out");
         break;
+    case AiPlayer::EngineCrashed:
+        errorMessage = tr("engine stopped unexpectedly");
+        break;
     case AiPlayer::UnknownError:
     default:
         errorMessage = tr("unknown engine error");
@@ -476,7 +534,12 @@ void ApplicationFacade::maybeStartAi(Chessboard::Colour colour)
         m_aiController->cancel();
         if (isPlayerAppAi(colour)) {
             qDebug("ApplicationFacade::maybeStartAi: start AI");
-            m_aiController->start(colour, m_board->boardState());
+            const GameClock clock = m_board->clock();
+            m_aiController->setClock(colour, clock);
+            // There is no point thinking once the flag has fallen.
+            const QDeadlineTimer deadline = clock.isTimed() ? QDeadlineTimer(clock.remaining(colour))
+                                                            : QDeadlineTimer(QDeadlineTimer::Forever);
+            m_aiController->start(colour, m_board->boardState(), deadline);
         } else {
             qDebug("ApplicationFacade::maybeStartAi: start assistance");
             m_aiController->startAssistance(colour, m_board->boardState());
@@ -486,6 +549,49 @@ void ApplicationFacade::maybeStartAi(Chessboard::Colour colour)
     }
 }
 
+void ApplicationFacade::setAnalysisEnabled(bool enabled)
+{
+    qDebug("ApplicationFacade::setAnalysisEnabled(%d)", enabled);
+    if (enabled == m_analysisEnabled)
+        return;
+    m_analysisEnabled = enabled;
+    maybeStartAnalysis();
+    emit analysisEnabledChanged(enabled);
+}
+
+void ApplicationFacade::setAnalysisRate(int rate)
+{
+    m_analysisRate = qMax(0, rate);
+    m_aiController->setAnalysisRate(m_analysisRate);
+}
+
+void ApplicationFacade::configureAnalysisRate(int rate)
+{
+    m_settings.beginGroup(ANALYSIS_GROUP);
+    m_settings.setValue(RATE, rate);
+    m_settings.endGroup();
+    setAnalysisRate(rate);
+}
+
+void ApplicationFacade::maybeStartAnalysis()
+{
+    const BoardState state = m_board->boardState();
+    // There is nothing to analyse once the game is over, nor until a
+    // pending promotion has been chosen.
+    if (!m_analysisEnabled || m_board->isPromotionRequired() || !state.hasLegalMove()) {
+        if (m_analysisRunning) {
+            qDebug("ApplicationFacade::maybeStartAnalysis: stop analysis");
+            m_analysisRunning = false;
+            m_aiController->stopAnalysis();
+        }
+        return;
+    }
+    qDebug("ApplicationFacade::maybeStartAnalysis: start analysis");
+    m_analysisRunning = true;
+    m_analysedState = state;
+    m_aiController->startAnalysis(state, analysisMoveTime);
+}
+
 void ApplicationFacade::configureEngine(const QString& stockfishPath)
 {
     m_stockfishPath = stockfishPath;
@@ -493,6 +599,98 @@ void ApplicationFacade::configureEngine(const QString& stockfishPath)
     m_settings.setValue(PATH, stockfishPath);
     m_settings.endGroup();
     StockfishAiPlayerFactory stockfishAiPlayerFactory(stockfishPath);
-    m_aiController->setFactory(&stockfishAiPlayerFactory);
+    NativeAiPlayerFactory nativeAiPlayerFactory;
+    if (stockfishPath.isEmpty())
+        m_aiController->setFactory(&nativeAiPlayerFactory);
+    else
+        m_aiController->setFactory(&stockfishAiPlayerFactory);
     maybeStartAi(m_board->activeColour());
+    maybeStartAnalysis();
+}
+
+void ApplicationFacade::configureOpeningBook(const QString& bookPath)
+{
+    m_settings.beginGroup(BOOK_GROUP);
+    m_settings.setValue(PATH, bookPath);
+    m_settings.endGroup();
+    loadOpeningBook(bookPath);
+}
+
+void ApplicationFacade::loadOpeningBook(const QString& bookPath)
+{
+    if (bookPath.isEmpty()) {
+        m_aiController->setOpeningBook(nullptr);
+        return;
+    }
+    QSharedPointer<OpeningBook> openingBook(new OpeningBook);
+    QString errorMessage;
+    if (!openingBook->open(bookPath, &errorMessage)) {
+        qWarning("ApplicationFacade::loadOpeningBook: %s", qPrintable(errorMessage));
+        m_aiController->setOpeningBook(nullptr);
+        return;
+    }
+    m_aiController->setOpeningBook(openingBook);
+}
+
+void ApplicationFacade::configureTablebases(const QString& tablebasePath)
+{
+    m_settings.beginGroup(TABLEBASES_GROUP);
+    m_settings.setValue(PATH, tablebasePath);
+    m_settings.endGroup();
+    loadTablebases(tablebasePath);
+}
+
+void ApplicationFacade::loadTablebases(const QString& tablebasePath)
+{
+    if (tablebasePath.isEmpty()) {
+        m_aiController->setTablebases(nullptr);
+        m_board->setTablebases(nullptr);
+        return;
+    }
+    QSharedPointer<SyzygyTablebases> tablebases(new SyzygyTablebases);
+    QString errorMessage;
+    if (tablebases->load(tablebasePath, &errorMessage) == 0) {
+        qWarning("ApplicationFacade::loadTablebases: no tablebases found in %s: %s",
+                 qPrintable(tablebasePath), qPrintable(errorMessage));
+        m_aiController->setTablebases(nullptr);
+        m_board->setTablebases(nullptr);
+        return;
+    }
+    m_aiController->setTablebases(tablebases);
+    m_board->setTablebases(tablebases);
+}
+
+void ApplicationFacade::configureEngineResources(int threads, int hash)
+{
+    m_settings.beginGroup(STOCKFISH_GROUP);
+    m_settings.setValue(THREADS, threads);
+    m_settings.setValue(HASH, hash);
+    m_settings.endGroup();
+    loadEngineResources(threads, hash);
+}
+
+void ApplicationFacade::loadEngineResources(int threads, int hash)
+{
+    m_engineResources = EngineResources::defaults();
+    if (threads > 0)
+        m_engineResources.threads = threads;
+    if (hash > 0)
+        m_engineResources.hash = hash;
+    qDebug("ApplicationFacade::loadEngineResources: %d threads, %d MiB hash",
+           m_engineResources.threads, m_engineResources.hash);
+    applyEngineResources(m_gameOptions);
+}
+
+void ApplicationFacade::applyEngineResources(const GameOptions& gameOptions)
+{
+    // Each colour has its own engine session. The sessions take turns to
+    // search, since the AI and assistance are both cancelled whenever the
+    // turn passes, so they share the threads but not the hash.
+    const EngineResources session = m_engineResources.sharedBy(2);
+    m_aiController->setResources(Colour::White, gameOptions.white.playerType == Chessboard::PlayerType::Ai
+                                                ? session : session.forAssistance());
+    m_aiController->setResources(Colour::Black, gameOptions.black.playerType == Chessboard::PlayerType::Ai
+                                                ? session : session.forAssistance());
+    // Live analysis searches at the same time as the sessions.
+    m_aiController->setAnalysisResources(m_engineResources.partitionedBetween(2));
 }
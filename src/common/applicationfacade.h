@@ -23,7 +23,9 @@
 #include <QSettings>
 
 #include "aiplayer.h"
+#include "analysisthrottle.h"
 #include "chessboard.h"
+#include "engineresources.h"
 #include "gameprogress.h"
 
 class AiController;
@@ -38,10 +40,20 @@ public:
     explicit ApplicationFacade(AiPlayerFactory *aiPlayerFactory, QObject *parent = nullptr);
     QSettings *settings() { return &m_settings; }
     Chessboard::GameOptions gameOptions() { return m_gameOptions; }
+    EngineResources engineResources() const { return m_engineResources; }
+    // Empty when the built-in engine is used instead of Stockfish.
+    QString stockfishPath() const { return m_stockfishPath; }
+    bool isAnalysisEnabled() const { return m_analysisEnabled; }
+    // Maximum analysis updates per second.
+    int analysisRate() const { return m_analysisRate; }
 
 signals:
     void connected(Chessboard::RemoteBoard *board);
     void disconnected();
+    // The link dropped and is being brought back; the game carries on
+    // locally in the meantime.
+    void reconnecting(int attempt);
+    void reconnected(Chessboard::RemoteBoard *board);
     void error(const QString& errorMessage);
     void remoteMove(int fromRow, int fromCol, int toRow, int toCol);
     void remoteBoardState(const Chessboard::BoardState& newState);
@@ -65,6 +77,8 @@ signals:
     void draw(Chessboard::DrawReason reason);
     void resignation(Chessboard::Colour colour);
     void checkmate(Chessboard::Colour winner);
+    void adjudicated(Chessboard::Colour winner);
+    void timeExpired(Chessboard::Colour colour);
     void gameProgressChanged(const GameProgress& progress);
     void activeColourChanged(Chessboard::Colour colour);
     void gameOver();
@@ -72,6 +86,9 @@ signals:
     void assistance(QList<Chessboard::AssistanceColour> colours);
     void canUndoChanged(bool canUndo);
     void engineNeedsConfigure(const QString& errorMessage, const QString& stockfishPath);
+    // Live analysis of state, the current position, while analysis is enabled.
+    void analysis(const Chessboard::BoardState& state, const PositionAnalysis& analysis);
+    void analysisEnabledChanged(bool enabled);
 
 public slots:
     virtual void connectToLast();
@@ -92,6 +109,15 @@ public slots:
     virtual void requestPromotion(Chessboard::Piece piece);
     virtual void setGameOptions(const Chessboard::GameOptions& gameOptions);
     virtual void configureEngine(const QString& stockfishPath);
+    virtual void configureOpeningBook(const QString& bookPath);
+    virtual void configureTablebases(const QString& tablebasePath);
+    // Zero selects the default for the machine.
+    virtual void configureEngineResources(int threads, int hash);
+    virtual void setAnalysisEnabled(bool enabled);
+    // Zero passes on every update. Only configureAnalysisRate() saves the
+    // rate in the settings.
+    virtual void setAnalysisRate(int rate);
+    virtual void configureAnalysisRate(int rate);
 
 protected slots:
     virtual void onConnectionError(Chessboard::ConnectionManager::Error error);
@@ -101,6 +127,7 @@ protected slots:
 private slots:
     virtual void setLastConnectedAddress(const Chessboard::BoardAddress& address);
     virtual void maybeStartAi(Chessboard::Colour colour);
+    virtual void maybeStartAnalysis();
 
 private:
     QSettings m_settings;
@@ -112,12 +139,22 @@ private:
     Chessboard::GameOptions m_gameOptions;
     GameProgress m_gameProgress;
     QString m_stockfishPath;
+    EngineResources m_engineResources {EngineResources::defaults()};
+    bool m_analysisEnabled {};
+    // Cleared when analysis stops, so that a result still on its way is dropped.
+    bool m_analysisRunning {};
+    int m_analysisRate {AnalysisThrottle::defaultMaximumRate};
+    Chessboard::BoardState m_analysedState;
 
     bool isCurrentPlayerAppAi() const;
     bool isPlayerAppAi(Chessboard::Colour colour) const;
     bool isCurrentPlayerAppHuman() const;
     bool isPlayerAppHuman(Chessboard::Colour colour) const;
     void construct(AiPlayerFactory *aiPlayerFactory);
+    void loadOpeningBook(const QString& bookPath);
+    void loadTablebases(const QString& tablebasePath);
+    void loadEngineResources(int threads, int hash);
+    void applyEngineResources(const Chessboard::GameOptions& gameOptions);
 friend class MockApplicationFacade;
 };
 
@@ -0,0 +1,56 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "assistance.h"
+
+// Assistance thresholds in centipawns relative to initial position.
+// 2: red = <= -300 cp; green >= -299 cp
+// 3: red = <= -300 cp; green >= -100 cp
+// 4: red = <= -300 cp; green >= 0 cp
+// 5: red = <= -100 cp; green >= 300 cp
+// 6: red = <=  -1 cp;  green = best move only
+namespace {
+    int redThreshold[] =   { 0, -300, -300, -300, -100, -1 };
+    int greenThreshold[] = { 0, -299, -100, 0,    300,  0 };
+    // Outweighs any material, as the tablebases see to the end of the game.
+    const int tablebaseWinScore = 20000;
+}
+
+Chessboard::AssistanceColour classifyAssistance(int assistanceLevel, int score, bool bestMove)
+{
+    if (bestMove)
+        return Chessboard::AssistanceColour::Green;
+    else if (assistanceLevel != 6 && score >= greenThreshold[assistanceLevel - 1])
+        return Chessboard::AssistanceColour::Green;
+    else if (score <= redThreshold[assistanceLevel - 1])
+        return Chessboard::AssistanceColour::Red;
+    else
+        return Chessboard::AssistanceColour::Blue;
+}
+
+int tablebaseScore(Chessboard::TablebaseResult result)
+{
+    switch (result) {
+    case Chessboard::TablebaseResult::Win:
+        return tablebaseWinScore;
+    case Chessboard::TablebaseResult::Loss:
+        return -tablebaseWinScore;
+    default:
+        return 0;
+    }
+}
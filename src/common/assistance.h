@@ -0,0 +1,31 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASSISTANCE_H
+#define ASSISTANCE_H
+
+#include "chessboard.h"
+
+// Classifies a move for the given assistance level (2-6) from its score in
+// centipawns relative to the initial position, from the mover's point of view.
+Chessboard::AssistanceColour classifyAssistance(int assistanceLevel, int score, bool bestMove);
+// Score for a move with the given tablebase result, for classifyAssistance().
+// Cursed wins and blessed losses are drawn under the fifty-move rule.
+int tablebaseScore(Chessboard::TablebaseResult result);
+
+#endif // ASSISTANCE_H
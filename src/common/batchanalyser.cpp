@@ -0,0 +1,374 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QFileDevice>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include "assistance.h"
+#include "batchanalyser.h"
+#include "enginepool.h"
+
+using namespace Chessboard;
+
+namespace {
+    // Requests kept queued in the pool for each engine, so that an engine
+    // never waits for the next position.
+    const int requestsPerEngine = 2;
+    // Scores are clamped before working out the loss, so that a missed
+    // mate doesn't swamp every other mistake in the game.
+    const int maximumLoss = 1000;
+    const QLatin1String csvHeader("game,ply,fen,move,best,eval,mate,loss,classification,depth\n");
+
+    QString classificationName(AssistanceColour colour)
+    {
+        switch (colour) {
+        case AssistanceColour::Green:
+            return QLatin1String("good");
+        case AssistanceColour::Blue:
+            return QLatin1String("inaccuracy");
+        case AssistanceColour::Red:
+            return QLatin1String("blunder");
+        }
+        return QString();
+    }
+
+    QString csvValue(const QJsonValue& value)
+    {
+        if (value.isString())
+            return value.toString();
+        if (value.isDouble())
+            return QString::number(value.toInt());
+        return QString();
+    }
+}
+
+PgnGameReader::PgnGameReader(QIODevice *device) :
+    m_device(device)
+{
+}
+
+bool PgnGameReader::atEnd() const
+{
+    return m_pendingLine.isEmpty() && m_device->atEnd();
+}
+
+QString PgnGameReader::readGame()
+{
+    QString game = m_pendingLine;
+    m_pendingLine.clear();
+    bool inMoveText = false;
+    while (!m_device->atEnd()) {
+        const QString line = QString::fromLatin1(m_device->readLine());
+        const QString trimmed = line.trimmed();
+        if (trimmed.startsWith(QLatin1Char('['))) {
+            // A tag after the moves starts the next game.
+            if (inMoveText) {
+                m_pendingLine = line;
+                break;
+            }
+        } else if (!trimmed.isEmpty() && !trimmed.startsWith(QLatin1Char('%'))) {
+            inMoveText = true;
+        }
+        game += line;
+    }
+    return game;
+}
+
+BatchAnalyser::BatchAnalyser(EnginePool *pool, QIODevice *output, Format format, QObject *parent) :
+    QObject(parent),
+    m_pool(pool),
+    m_output(output),
+    m_format(format)
+{
+    connect(m_pool, &EnginePool::positionAnalysed, this, &BatchAnalyser::positionAnalysed);
+    connect(m_pool, &EnginePool::error, this, &BatchAnalyser::poolError);
+}
+
+BatchAnalyser::~BatchAnalyser()
+{
+    for (auto it = m_requests.cbegin(); it != m_requests.cend(); ++it)
+        m_pool->cancel(it.key());
+    delete m_reader;
+}
+
+void BatchAnalyser::setMoveTime(int moveTime)
+{
+    m_moveTime = moveTime;
+}
+
+void BatchAnalyser::setAssistanceLevel(int level)
+{
+    m_assistanceLevel = level;
+}
+
+void BatchAnalyser::setCompleted(const QSet<MoveKey>& completed)
+{
+    m_completed = completed;
+}
+
+void BatchAnalyser::analyse(QIODevice *pgn)
+{
+    delete m_reader;
+    m_reader = new PgnGameReader(pgn);
+    if (m_format == Csv && m_output->size() == 0)
+        m_output->write(csvHeader.data(), csvHeader.size());
+    fillPool();
+}
+
+bool BatchAnalyser::readCompleted(QIODevice *device, Format format, QSet<MoveKey> *completed,
+                                  qint64 *validSize, QString *errorMessage)
+{
+    completed->clear();
+    qint64 size = 0;
+    int lineNumber = 0;
+    while (!device->atEnd()) {
+        const QByteArray line = device->readLine();
+        ++lineNumber;
+        // Anything after the last newline was cut short.
+        if (!line.endsWith('\n'))
+            break;
+        bool ok = false;
+        if (format == Json) {
+            const QJsonObject record = QJsonDocument::fromJson(line).object();
+            ok = record.contains(QLatin1String("game")) && record.contains(QLatin1String("ply"));
+            if (ok)
+                completed->insert(MoveKey(record.value(QLatin1String("game")).toInt(),
+                                          record.value(QLatin1String("ply")).toInt()));
+        } else if (size == 0 && line == QByteArray(csvHeader.data(), csvHeader.size())) {
+            ok = true;
+        } else {
+            const QList<QByteArray> fields = line.split(',');
+            bool plyOk = false;
+            const int game = fields.value(0).toInt(&ok);
+            const int ply = fields.value(1).toInt(&plyOk);
+            ok = ok && plyOk;
+            if (ok)
+                completed->insert(MoveKey(game, ply));
+        }
+        if (!ok) {
+            // Not an earlier output in this format: leave it to the user.
+            if (errorMessage)
+                *errorMessage = tr("line %1: not an analysis record").arg(lineNumber);
+            completed->clear();
+            return false;
+        }
+        size += line.size();
+    }
+    if (validSize)
+        *validSize = size;
+    return true;
+}
+
+void BatchAnalyser::fillPool()
+{
+    const int limit = m_pool->engineCount() * requestsPerEngine;
+    while (!m_failed && m_requests.size() < limit) {
+        if (m_backlog.isEmpty() && !loadNextGame())
+            break;
+        if (m_backlog.isEmpty())
+            continue;
+        const MoveKey key = m_backlog.takeFirst();
+        const int request = m_pool->requestAnalysis(m_games[key.first].positions[key.second], m_moveTime);
+        m_requests.insert(request, key);
+    }
+    maybeFinish();
+}
+
+bool BatchAnalyser::loadNextGame()
+{
+    while (m_reader && !m_reader->atEnd()) {
+        const QString text = m_reader->readGame();
+        if (text.trimmed().isEmpty())
+            continue;
+        const int number = ++m_gameNumber;
+        QString errorMessage;
+        const Pgn pgn = PgnParser().parse(text, &errorMessage);
+        if (!pgn.isValid()) {
+            emit warning(tr("Game %1: %2").arg(number).arg(errorMessage.isEmpty() ? tr("no moves") : errorMessage));
+            return true;
+        }
+        Game game;
+        game.number = number;
+        BoardState state = pgn.tags.contains(QLatin1String("FEN")) ?
+            BoardState::fromFenString(pgn.tags.value(QLatin1String("FEN"))) : BoardState::newGame();
+        game.positions.append(state);
+        for (const AlgebraicNotation& move : pgn.moves) {
+            const AlgebraicNotation resolved = move.resolve(state);
+            bool promotionRequired = false;
+            if (!resolved.isValid() ||
+                !state.move(resolved.fromRow, resolved.fromCol, resolved.toRow, resolved.toCol, &promotionRequired)) {
+                emit warning(tr("Game %1: illegal move at ply %2; only the moves before it will be analysed.")
+                                 .arg(number).arg(game.moves.size() + 1));
+                break;
+            }
+            QString uci = Square(resolved.fromRow, resolved.fromCol).toString() +
+                          Square(resolved.toRow, resolved.toCol).toString();
+            if (promotionRequired) {
+                const Piece piece = move.promotion ? move.promotionPiece : Piece::Queen;
+                state.promote(piece);
+                uci += ColouredPiece(Colour::Black, piece).toFenString();
+            }
+            game.moves.append(uci);
+            game.positions.append(state);
+        }
+        game.analyses.resize(game.positions.size());
+        game.analysed.fill(false, game.positions.size());
+        for (int ply=1;ply<=game.moves.size();++ply) {
+            if (m_completed.contains(MoveKey(number, ply)))
+                continue;
+            game.plies.append(ply);
+        }
+        if (game.plies.isEmpty())
+            return true;
+        // Each move needs the positions either side of it.
+        QList<bool> needed(game.positions.size(), false);
+        for (int ply : game.plies)
+            needed[ply - 1] = needed[ply] = true;
+        for (int i=0;i<game.positions.size();++i) {
+            if (!needed[i])
+                continue;
+            if (!game.positions[i].hasLegalMove()) {
+                // Nothing to search; the analysis stays invalid.
+                game.analysed[i] = true;
+                continue;
+            }
+            m_backlog.append(MoveKey(number, i));
+            ++game.remaining;
+        }
+        m_games.insert(number, game);
+        return true;
+    }
+    return false;
+}
+
+void BatchAnalyser::positionAnalysed(int request, const PositionAnalysis& analysis)
+{
+    const auto it = m_requests.constFind(request);
+    if (it == m_requests.cend())
+        return;
+    const MoveKey key = it.value();
+    m_requests.erase(it);
+    Game& game = m_games[key.first];
+    game.analyses[key.second] = analysis;
+    game.analysed[key.second] = true;
+    --game.remaining;
+    // Games are written in order, so a game that finishes early waits for
+    // the ones before it.
+    while (!m_games.isEmpty() && m_games.first().remaining == 0) {
+        finishGame(m_games.first());
+        m_games.erase(m_games.begin());
+    }
+    fillPool();
+}
+
+void BatchAnalyser::poolError(int request, AiPlayer::Error)
+{
+    if (!m_requests.contains(request))
+        return;
+    m_requests.remove(request);
+    m_failed = true;
+    for (auto it = m_requests.cbegin(); it != m_requests.cend(); ++it)
+        m_pool->cancel(it.key());
+    m_requests.clear();
+    emit error(tr("The engine failed while analysing game %1.").arg(m_games.isEmpty() ? m_gameNumber : m_games.firstKey()));
+}
+
+void BatchAnalyser::finishGame(const Game& game)
+{
+    for (int ply : game.plies)
+        writeRecord(game, ply);
+    if (QFileDevice *file = qobject_cast<QFileDevice *>(m_output))
+        file->flush();
+    ++m_gamesAnalysed;
+    m_movesAnalysed += game.plies.size();
+    emit gameFinished(game.number);
+}
+
+void BatchAnalyser::writeRecord(const Game& game, int ply)
+{
+    const BoardState& before = game.positions[ply - 1];
+    const BoardState& after = game.positions[ply];
+    const PositionAnalysis& bestAnalysis = game.analyses[ply - 1];
+    const PositionAnalysis& playedAnalysis = game.analyses[ply];
+    const QString& move = game.moves[ply - 1];
+
+    // Scores from the point of view of the player who moved.
+    const bool isBest = move == bestAnalysis.bestMove;
+    const int bestScore = bestAnalysis.effectiveScore();
+    int playedScore;
+    if (isBest)
+        playedScore = bestScore;
+    else if (playedAnalysis.isValid())
+        playedScore = -playedAnalysis.effectiveScore();
+    else
+        playedScore = after.isCheckmate() ? PositionAnalysis::mateScore : 0;
+    const int loss = qMax(0, qBound(-maximumLoss, bestScore, maximumLoss) -
+                             qBound(-maximumLoss, playedScore, maximumLoss));
+    // The assistance thresholds are applied to the score lost against the
+    // best move, not to the absolute evaluation: a move that throws away a
+    // winning position is still a blunder.
+    const AssistanceColour colour = classifyAssistance(m_assistanceLevel, -loss, isBest);
+
+    QJsonObject record;
+    record.insert(QLatin1String("game"), game.number);
+    record.insert(QLatin1String("ply"), ply);
+    record.insert(QLatin1String("fen"), before.toFenString());
+    record.insert(QLatin1String("move"), move);
+    record.insert(QLatin1String("best"), bestAnalysis.bestMove);
+    // The evaluation after the move, from White's point of view.
+    QJsonValue eval, mate;
+    if (playedAnalysis.isValid()) {
+        const int sign = (after.activeColour == Colour::White) ? 1 : -1;
+        if (playedAnalysis.mate != 0)
+            mate = sign * playedAnalysis.mate;
+        else
+            eval = sign * playedAnalysis.score;
+    }
+    record.insert(QLatin1String("eval"), eval);
+    record.insert(QLatin1String("mate"), mate);
+    record.insert(QLatin1String("loss"), loss);
+    record.insert(QLatin1String("classification"), classificationName(colour));
+    record.insert(QLatin1String("depth"), bestAnalysis.depth);
+
+    QByteArray line;
+    if (m_format == Json) {
+        line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    } else {
+        QStringList fields;
+        for (const QLatin1String& field : { QLatin1String("game"), QLatin1String("ply"), QLatin1String("fen"),
+                                            QLatin1String("move"), QLatin1String("best"), QLatin1String("eval"),
+                                            QLatin1String("mate"), QLatin1String("loss"),
+                                            QLatin1String("classification"), QLatin1String("depth") })
+            fields.append(csvValue(record.value(field)));
+        line = fields.join(QLatin1Char(',')).toLatin1();
+    }
+    line.append('\n');
+    m_output->write(line);
+}
+
+void BatchAnalyser::maybeFinish()
+{
+    if (m_failed || !m_reader || !m_reader->atEnd() || !m_requests.isEmpty() ||
+        !m_backlog.isEmpty() || !m_games.isEmpty())
+        return;
+    delete m_reader;
+    m_reader = nullptr;
+    emit finished();
+}
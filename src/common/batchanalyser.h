@@ -0,0 +1,127 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCHANALYSER_H
+#define BATCHANALYSER_H
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include "aiplayer.h"
+#include "chessboard.h"
+
+class EnginePool;
+class QIODevice;
+
+// Reads one game at a time from a PGN file that may hold many games.
+class PgnGameReader
+{
+public:
+    explicit PgnGameReader(QIODevice *device);
+    bool atEnd() const;
+    // The text of the next game, including its tags.
+    QString readGame();
+
+private:
+    QIODevice *m_device;
+    QString m_pendingLine;
+};
+
+// Analyses every move of every game in a PGN file with an engine pool and
+// writes one record per move: the evaluation after the move, the engine's
+// best move and a classification of the score lost against that best move,
+// using the assistance thresholds. Records are written a game at a time, so
+// an interrupted run can be resumed by passing the moves already in the
+// output to setCompleted().
+class BatchAnalyser : public QObject
+{
+    Q_OBJECT
+public:
+    enum Format {
+        Json,
+        Csv
+    };
+    typedef QPair<int, int> MoveKey;
+
+    BatchAnalyser(EnginePool *pool, QIODevice *output, Format format, QObject *parent = nullptr);
+    ~BatchAnalyser();
+
+    void setMoveTime(int moveTime);
+    void setAssistanceLevel(int level);
+    void setCompleted(const QSet<MoveKey>& completed);
+    // Starts analysing the games in pgn, which must stay open until finished().
+    void analyse(QIODevice *pgn);
+    int gamesAnalysed() const { return m_gamesAnalysed; }
+    int movesAnalysed() const { return m_movesAnalysed; }
+
+    // Reads the (game, ply) keys of the records in an earlier output. Both
+    // are numbered from one. validSize is set to the length of the complete
+    // lines, so that a record cut short by an interruption can be dropped.
+    // Fails if a complete line is not a record in format.
+    static bool readCompleted(QIODevice *device, Format format, QSet<MoveKey> *completed,
+                              qint64 *validSize = nullptr, QString *errorMessage = nullptr);
+
+signals:
+    void gameFinished(int game);
+    void warning(const QString& message);
+    void error(const QString& message);
+    void finished();
+
+private:
+    struct Game {
+        int number {};
+        QList<Chessboard::BoardState> positions;
+        QStringList moves;
+        QList<PositionAnalysis> analyses;
+        QList<bool> analysed;
+        // The plies to write, numbered from one.
+        QList<int> plies;
+        // Positions still waiting for their analysis.
+        int remaining {};
+    };
+
+    void fillPool();
+    bool loadNextGame();
+    void positionAnalysed(int request, const PositionAnalysis& analysis);
+    void poolError(int request, AiPlayer::Error error);
+    void finishGame(const Game& game);
+    void writeRecord(const Game& game, int ply);
+    void maybeFinish();
+
+    EnginePool *m_pool;
+    QIODevice *m_output;
+    Format m_format;
+    PgnGameReader *m_reader {};
+    int m_moveTime {1000};
+    int m_assistanceLevel {3};
+    QSet<MoveKey> m_completed;
+    int m_gameNumber {};
+    QMap<int, Game> m_games;
+    // Positions waiting to be submitted, as (game, position index).
+    QList<MoveKey> m_backlog;
+    QHash<int, MoveKey> m_requests;
+    int m_gamesAnalysed {};
+    int m_movesAnalysed {};
+    bool m_failed {};
+};
+
+#endif // BATCHANALYSER_H
@@ -0,0 +1,91 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "boardroom.h"
+#include "compositeboard.h"
+
+using namespace Chessboard;
+
+BoardRoom::BoardRoom(QObject *parent) :
+    QObject(parent),
+    m_connectionManager(new MultiConnectionManager(this))
+{
+    m_connectionManager->setAutoReconnect(true);
+    connect(m_connectionManager, &MultiConnectionManager::connected, this, &BoardRoom::onConnected);
+    connect(m_connectionManager, &MultiConnectionManager::reconnecting, this, [this](const BoardAddress& address) {
+        // The game stays here while the link is down.
+        if (CompositeBoard *board = game(address))
+            board->setRemoteBoard(nullptr);
+    });
+    connect(m_connectionManager, &MultiConnectionManager::reconnected, this, [this](const BoardAddress& address, RemoteBoard *remoteBoard) {
+        if (CompositeBoard *board = game(address))
+            board->resyncRemoteBoard(remoteBoard);
+    });
+    connect(m_connectionManager, &MultiConnectionManager::connectionFailed, this, &BoardRoom::onDisconnected);
+    connect(m_connectionManager, &MultiConnectionManager::disconnected, this, &BoardRoom::onDisconnected);
+}
+
+BoardRoom::~BoardRoom()
+{
+    // The games may still refer to remote boards owned by the connections.
+    for (CompositeBoard *board : std::as_const(m_games))
+        board->setRemoteBoard(nullptr);
+}
+
+void BoardRoom::addBoard(const BoardAddress& address)
+{
+    const QString key = address.toString();
+    if (m_games.contains(key))
+        return;
+    m_games.insert(key, new CompositeBoard(this));
+    m_connectionManager->connectToBoard(address, this);
+}
+
+void BoardRoom::removeBoard(const BoardAddress& address)
+{
+    m_connectionManager->disconnectFromBoard(address);
+}
+
+QList<BoardAddress> BoardRoom::boards() const
+{
+    return m_connectionManager->addresses();
+}
+
+CompositeBoard *BoardRoom::game(const BoardAddress& address) const
+{
+    return m_games.value(address.toString());
+}
+
+void BoardRoom::onConnected(const BoardAddress& address, RemoteBoard *remoteBoard)
+{
+    CompositeBoard *board = game(address);
+    if (!board)
+        return;
+    board->setRemoteBoard(remoteBoard);
+    emit boardConnected(address, board);
+}
+
+void BoardRoom::onDisconnected(const BoardAddress& address)
+{
+    CompositeBoard *board = m_games.take(address.toString());
+    if (!board)
+        return;
+    board->setRemoteBoard(nullptr);
+    board->deleteLater();
+    emit boardDisconnected(address);
+}
@@ -0,0 +1,58 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOARDROOM_H
+#define BOARDROOM_H
+
+#include <QHash>
+#include <QObject>
+#include "chessboard.h"
+
+class CompositeBoard;
+
+// Runs a game on each of several boards at once, for example at a club
+// or a simultaneous exhibition. Every board has its own CompositeBoard,
+// which outlives dropped links so that the game carries on when the board
+// reconnects.
+class BoardRoom : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BoardRoom(QObject *parent = nullptr);
+    ~BoardRoom();
+
+    Chessboard::MultiConnectionManager *connectionManager() const { return m_connectionManager; }
+    void addBoard(const Chessboard::BoardAddress& address);
+    void removeBoard(const Chessboard::BoardAddress& address);
+    QList<Chessboard::BoardAddress> boards() const;
+    // Null for boards that were never added.
+    CompositeBoard *game(const Chessboard::BoardAddress& address) const;
+
+signals:
+    void boardConnected(const Chessboard::BoardAddress& address, CompositeBoard *game);
+    void boardDisconnected(const Chessboard::BoardAddress& address);
+
+private:
+    void onConnected(const Chessboard::BoardAddress& address, Chessboard::RemoteBoard *board);
+    void onDisconnected(const Chessboard::BoardAddress& address);
+
+    Chessboard::MultiConnectionManager *m_connectionManager;
+    QHash<QString, CompositeBoard*> m_games;
+};
+
+#endif // BOARDROOM_H
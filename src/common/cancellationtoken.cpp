@@ -0,0 +1,56 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include "cancellationtoken.h"
+
+struct CancellationToken::State {
+    std::atomic<bool> cancelled {false};
+    QDeadlineTimer deadline;
+};
+
+CancellationToken::CancellationToken(QDeadlineTimer deadline) :
+    d(new State)
+{
+    d->deadline = deadline;
+}
+
+void CancellationToken::cancel()
+{
+    d->cancelled.store(true, std::memory_order_release);
+}
+
+bool CancellationToken::isCancelled() const
+{
+    return d->cancelled.load(std::memory_order_acquire);
+}
+
+QDeadlineTimer CancellationToken::deadline() const
+{
+    return d->deadline;
+}
+
+bool CancellationToken::hasExpired() const
+{
+    return d->deadline.hasExpired();
+}
+
+qint64 CancellationToken::remainingTime() const
+{
+    return d->deadline.remainingTime();
+}
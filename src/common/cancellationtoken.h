@@ -0,0 +1,48 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QDeadlineTimer>
+#include <QSharedPointer>
+
+// Handle on the cancellation state of a single AI request. Copies share
+// the same state, so the GUI thread can cancel a request while the AI
+// thread is still busy with it. The deadline is fixed when the token is
+// created; reaching it is not a cancellation, it only tells the player to
+// finish with the best result it has.
+class CancellationToken
+{
+public:
+    explicit CancellationToken(QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever));
+
+    void cancel();
+    bool isCancelled() const;
+    QDeadlineTimer deadline() const;
+    bool hasExpired() const;
+    bool isStopRequested() const { return isCancelled() || hasExpired(); }
+    // Milliseconds left before the deadline, or -1 if there is none.
+    qint64 remainingTime() const;
+
+private:
+    struct State;
+    QSharedPointer<State> d;
+};
+
+#endif // CANCELLATIONTOKEN_H
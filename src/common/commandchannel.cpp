@@ -0,0 +1,134 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QMutex>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <atomic>
+#include "commandchannel.h"
+#include "spscqueue.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    QEvent::Type wakeupEventType()
+    {
+        static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+        return type;
+    }
+}
+
+struct CommandChannelState {
+    ~CommandChannelState()
+    {
+#ifdef Q_OS_LINUX
+        if (eventFd != -1)
+            ::close(eventFd);
+#endif
+    }
+
+    SpscQueue<CommandSender::Command> queue;
+    // Set by the producer when it wakes the receiver and cleared by the
+    // receiver before it drains, so each batch costs a single wake-up.
+    std::atomic<bool> wakeupPending {false};
+    int eventFd {-1};
+    // Only used for the posted event fallback.
+    QMutex receiverMutex;
+    CommandReceiver *receiver {};
+};
+
+void CommandSender::post(Command command) const
+{
+    if (!d)
+        return;
+    d->queue.push(std::move(command));
+    if (d->wakeupPending.exchange(true))
+        return;
+#ifdef Q_OS_LINUX
+    if (d->eventFd != -1) {
+        const quint64 one = 1;
+        if (::write(d->eventFd, &one, sizeof(one)) == sizeof(one))
+            return;
+    }
+#endif
+    QMutexLocker locker(&d->receiverMutex);
+    if (d->receiver)
+        QCoreApplication::postEvent(d->receiver, new QEvent(wakeupEventType()));
+}
+
+CommandReceiver::CommandReceiver(QObject *parent) :
+    QObject(parent),
+    d(new CommandChannelState)
+{
+    d->receiver = this;
+#ifdef Q_OS_LINUX
+    d->eventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (d->eventFd != -1) {
+        m_notifier = new QSocketNotifier(d->eventFd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, [this]() {
+            quint64 count;
+            while (::read(d->eventFd, &count, sizeof(count)) == sizeof(count)) {}
+            drain();
+        });
+    }
+#endif
+}
+
+CommandReceiver::~CommandReceiver()
+{
+    QMutexLocker locker(&d->receiverMutex);
+    d->receiver = nullptr;
+}
+
+CommandSender CommandReceiver::sender() const
+{
+    return CommandSender(d);
+}
+
+bool CommandReceiver::usesEventFd() const
+{
+    return m_notifier != nullptr;
+}
+
+bool CommandReceiver::event(QEvent *event)
+{
+    if (event->type() == wakeupEventType()) {
+        drain();
+        return true;
+    }
+    return QObject::event(event);
+}
+
+void CommandReceiver::drain()
+{
+    d->wakeupPending.store(false);
+    // A command may delete the receiver, e.g. by destroying its parent.
+    QPointer<CommandReceiver> guard(this);
+    QSharedPointer<CommandChannelState> state = d;
+    CommandSender::Command command;
+    while (state->queue.pop(&command)) {
+        command();
+        if (!guard)
+            return;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMANDCHANNEL_H
+#define COMMANDCHANNEL_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <functional>
+
+class QSocketNotifier;
+struct CommandChannelState;
+
+// Producer end of a command channel. Commands are pushed on to a
+// single-producer single-consumer lock-free queue and run, in order, by
+// the CommandReceiver on its own thread. All posts through a channel must
+// come from the same thread. Commands still queued when the receiver is
+// destroyed are dropped without being run.
+class CommandSender
+{
+public:
+    using Command = std::function<void()>;
+
+    CommandSender() {}
+    bool isValid() const { return !d.isNull(); }
+    void post(Command command) const;
+
+private:
+    friend class CommandReceiver;
+    explicit CommandSender(const QSharedPointer<CommandChannelState>& state) : d(state) {}
+
+    QSharedPointer<CommandChannelState> d;
+};
+
+// Consumer end of a command channel. The receiver's thread is woken once
+// per batch of commands: through an eventfd watched by the thread's event
+// loop where the platform has one, otherwise by posting an event.
+class CommandReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CommandReceiver(QObject *parent = nullptr);
+    ~CommandReceiver();
+    CommandSender sender() const;
+    bool usesEventFd() const;
+
+protected:
+    bool event(QEvent *event) override;
+
+private:
+    void drain();
+
+    QSharedPointer<CommandChannelState> d;
+    QSocketNotifier *m_notifier {};
+};
+
+#endif // COMMANDCHANNEL_H
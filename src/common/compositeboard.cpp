@@ -16,14 +16,18 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <QTimer>
 #include "compositeboard.h"
 
 using namespace Chessboard;
 
 CompositeBoard::CompositeBoard(QObject *parent)
     : QObject{parent},
-      m_local(BoardState::newGame())
+      m_local(BoardState::newGame()),
+      m_flagTimer(new QTimer(this))
 {
+    m_flagTimer->setSingleShot(true);
+    connect(m_flagTimer, &QTimer::timeout, this, &CompositeBoard::flagFall);
 }
 
 void CompositeBoard::setRemoteBoard(Chessboard::RemoteBoard *board)
@@ -37,9 +41,12 @@ void CompositeBoard::setRemoteBoard(Chessboard::RemoteBoard *board)
         disconnect(m_remote, &RemoteBoard::remoteResignation, this, nullptr);
         disconnect(m_remote, &RemoteBoard::remoteDrawDeclined, this, nullptr);
         disconnect(m_remote, &RemoteBoard::remoteDrawRequested, this, nullptr);
+        disconnect(m_remote, &RemoteBoard::remotePieceLifted, this, nullptr);
     }
     auto oldBoard = m_remote;
     m_remote = board;
+    if (!board)
+        m_resyncPending = false;
     if (oldBoard != board)
         delete oldBoard;
     if (board) {
@@ -55,6 +62,7 @@ void CompositeBoard::setRemoteBoard(Chessboard::RemoteBoard *board)
                 if (promotion)
                     m_promotionRequired = true;
                 m_prevLocal = prevLocal;
+                switchClock(true);
                 emit boardStateChanged(m_local);
                 emit canUndoChanged(true);
             } else if (!legal) {
@@ -74,6 +82,7 @@ void CompositeBoard::setRemoteBoard(Chessboard::RemoteBoard *board)
             }
             emit remoteUndo();
             if (!m_hasLocalMoves && ok) {
+                switchClock(false);
                 emit boardStateChanged(m_local);
                 emit canUndoChanged(false);
             } else if (!ok) {
@@ -81,12 +90,22 @@ void CompositeBoard::setRemoteBoard(Chessboard::RemoteBoard *board)
             }
         });
         connect(board, &RemoteBoard::remoteBoardState, this, [this](const BoardState& state) {
+            if (m_resyncPending) {
+                m_resyncPending = false;
+                m_hasLocalMoves = false;
+                if (state.toFenString() != m_local.toFenString()) {
+                    qDebug("CompositeBoard: board changed while disconnected, sending position");
+                    m_remote->setBoardState(m_local);
+                }
+                return;
+            }
             if (!m_hasLocalMoves) {
                 m_prevLocal = BoardState();
                 m_local = state;
             }
             emit remoteBoardState(state);
             if (!m_hasLocalMoves) {
+                switchClock(false);
                 emit boardStateChanged(state);
                 emit canUndoChanged(false);
             }
@@ -96,10 +115,12 @@ void CompositeBoard::setRemoteBoard(Chessboard::RemoteBoard *board)
                 m_promotionRequired = false;
                 bool ok = m_local.promote(piece);
                 emit remotePromotion(piece);
-                if (ok)
+                if (ok) {
+                    switchClock(true);
                     emit boardStateChanged(m_local);
-                else
+                } else {
                     emit localOutOfSyncWithRemote();
+                }
                 checkGameOver();
             }
         });
@@ -108,12 +129,20 @@ void CompositeBoard::setRemoteBoard(Chessboard::RemoteBoard *board)
         connect(board, &RemoteBoard::remoteResignation, this, &CompositeBoard::resignation);
         connect(board, &RemoteBoard::remoteDrawRequested, this, &CompositeBoard::requestDraw);
         connect(board, &RemoteBoard::remoteDrawDeclined, this, &CompositeBoard::declineDraw);
+        connect(board, &RemoteBoard::remotePieceLifted, this, &CompositeBoard::pieceLifted);
         board->setGameOptions(m_gameOptions);
-        if (m_hasLocalMoves)
+        if (m_hasLocalMoves && !m_resyncPending)
             emit remoteOutOfSyncWithLocal();
     }
 }
 
+void CompositeBoard::resyncRemoteBoard(Chessboard::RemoteBoard *board)
+{
+    // The board reports its position when it connects.
+    m_resyncPending = true;
+    setRemoteBoard(board);
+}
+
 void CompositeBoard::requestMove(int fromRow, int fromCol, int toRow, int toCol)
 {
     qDebug("CompositeBoard::requestMove(%d, %d, %d, %d)", fromRow, fromCol, toRow, toCol);
@@ -133,6 +162,7 @@ void CompositeBoard::requestMove(int fromRow, int fromCol, int toRow, int toCol)
                 if (promotion)
                     m_promotionRequired = true;
                 m_prevLocal = prevLocal;
+                switchClock(true);
                 emit boardStateChanged(m_local);
                 emit canUndoChanged(true);
                 if (promotion)
@@ -156,6 +186,7 @@ void CompositeBoard::requestUndo()
             m_remote->setBoardState(m_local);
         else
             m_hasLocalMoves = true;
+        switchClock(false);
         emit boardStateChanged(m_local);
         emit canUndoChanged(false);
     }
@@ -172,6 +203,19 @@ void CompositeBoard::checkGameOver()
         m_drawRequested = false;
         m_promotionRequired = false;
         emit draw(reason);
+    } else if (m_tablebases) {
+        TablebaseResult result;
+        if (!m_tablebases->probeWdl(m_local, &result))
+            return;
+        m_drawRequested = false;
+        m_promotionRequired = false;
+        // Cursed wins and blessed losses are drawn by the fifty-move rule.
+        if (result == TablebaseResult::Win)
+            emit adjudicated(m_local.activeColour);
+        else if (result == TablebaseResult::Loss)
+            emit adjudicated(invertColour(m_local.activeColour));
+        else
+            emit draw(DrawReason::Tablebase);
     }
 }
 
@@ -185,6 +229,7 @@ void CompositeBoard::setBoardState(const Chessboard::BoardState& boardState)
         m_remote->setBoardState(boardState);
     else
         m_hasLocalMoves = true;
+    switchClock(false);
     emit boardStateChanged(m_local);
     emit canUndoChanged(false);
     checkGameOver();
@@ -213,6 +258,7 @@ void CompositeBoard::requestNewGame(const Chessboard::GameOptions& gameOptions)
     m_local = BoardState::newGame();
     m_prevLocal = BoardState();
     m_gameOptions = gameOptions;
+    resetClock();
     if (m_remote)
         m_remote->requestNewGame(gameOptions);
     emit boardStateChanged(m_local);
@@ -228,8 +274,10 @@ void CompositeBoard::requestPromotion(Piece piece)
         m_remote->requestPromotion(piece);
     else
         m_hasLocalMoves = true;
-    if (ok)
+    if (ok) {
+        switchClock(true);
         emit boardStateChanged(m_local);
+    }
     checkGameOver();
 }
 
@@ -279,7 +327,11 @@ void CompositeBoard::requestResignation(Colour requestor)
 
 void CompositeBoard::setGameOptions(const Chessboard::GameOptions& gameOptions)
 {
+    const bool timeControlChanged = gameOptions.timeControl.baseTime != m_gameOptions.timeControl.baseTime ||
+                                    gameOptions.timeControl.increment != m_gameOptions.timeControl.increment;
     m_gameOptions = gameOptions;
+    if (timeControlChanged)
+        resetClock();
     if (m_remote)
         m_remote->setGameOptions(gameOptions);
 }
@@ -290,7 +342,77 @@ void CompositeBoard::sendAssistance(const QList<Chessboard::AssistanceColour>& c
         m_remote->sendAssistance(colours);
 }
 
+void CompositeBoard::setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+{
+    m_tablebases = tablebases;
+}
+
 bool CompositeBoard::canUndo() const
 {
     return m_prevLocal.isValid();
 }
+
+int CompositeBoard::remainingTime(Chessboard::Colour colour) const
+{
+    const int time = (colour == Colour::White) ? m_whiteTime : m_blackTime;
+    if (time < 0 || !m_clockRunning || colour != m_clockColour)
+        return time;
+    return qMax(0, time - static_cast<int>(m_clockTimer.elapsed()));
+}
+
+GameClock CompositeBoard::clock() const
+{
+    GameClock ret;
+    if (m_gameOptions.timeControl.isTimed()) {
+        ret.whiteTime = remainingTime(Colour::White);
+        ret.blackTime = remainingTime(Colour::Black);
+        ret.increment = m_gameOptions.timeControl.increment;
+    }
+    return ret;
+}
+
+void CompositeBoard::resetClock()
+{
+    m_flagTimer->stop();
+    m_clockRunning = false;
+    if (!m_gameOptions.timeControl.isTimed()) {
+        m_whiteTime = m_blackTime = -1;
+        return;
+    }
+    m_whiteTime = m_blackTime = m_gameOptions.timeControl.baseTime;
+    m_clockColour = m_local.activeColour;
+    m_clockRunning = true;
+    m_clockTimer.start();
+    m_flagTimer->start(remainingTime(m_clockColour));
+}
+
+void CompositeBoard::switchClock(bool moved)
+{
+    // The clock keeps running until a promotion has been completed.
+    if (!m_clockRunning || m_promotionRequired || m_local.activeColour == m_clockColour)
+        return;
+    int& time = (m_clockColour == Colour::White) ? m_whiteTime : m_blackTime;
+    time = remainingTime(m_clockColour) + (moved ? m_gameOptions.timeControl.increment : 0);
+    m_clockColour = m_local.activeColour;
+    m_clockTimer.restart();
+    m_flagTimer->start(remainingTime(m_clockColour));
+}
+
+void CompositeBoard::stopClock()
+{
+    if (!m_clockRunning)
+        return;
+    int& time = (m_clockColour == Colour::White) ? m_whiteTime : m_blackTime;
+    time = remainingTime(m_clockColour);
+    m_clockRunning = false;
+    m_flagTimer->stop();
+}
+
+void CompositeBoard::flagFall()
+{
+    qDebug("CompositeBoard::flagFall");
+    stopClock();
+    m_drawRequested = false;
+    m_promotionRequired = false;
+    emit timeExpired(m_clockColour);
+}
@@ -19,7 +19,12 @@
 #ifndef COMPOSITEBOARD_H
 #define COMPOSITEBOARD_H
 
+#include <QElapsedTimer>
+#include <QSharedPointer>
 #include "chessboard.h"
+#include "timemanager.h"
+
+class QTimer;
 
 class CompositeBoard : public QObject
 {
@@ -31,8 +36,16 @@ public:
     bool isDrawRequested() const { return m_drawRequested; }
     Chessboard::Colour activeColour() const { return m_local.activeColour; }
     bool canUndo() const;
+    int remainingTime(Chessboard::Colour colour) const;
+    GameClock clock() const;
+    // With tablebases, games are adjudicated as soon as they reach a
+    // position in them.
+    void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases);
 public slots:
     void setRemoteBoard(Chessboard::RemoteBoard *board);
+    // Takes over from a board that lost its link, keeping the game here.
+    // The board is only sent the position if it differs from this one.
+    void resyncRemoteBoard(Chessboard::RemoteBoard *board);
     void requestMove(int fromRow, int fromCol, int toRow, int toCol);
     void requestMove(const Chessboard::Square& from, const Chessboard::Square& to) {
         requestMove(from.row, from.col, to.row, to.col);
@@ -48,33 +61,52 @@ public slots:
     void requestResignation(Chessboard::Colour requestor);
     void setGameOptions(const Chessboard::GameOptions& gameOptions);
     void sendAssistance(const QList<Chessboard::AssistanceColour>& colours);
+    void stopClock();
 signals:
     void remoteMove(int fromRow, int fromCol, int toRow, int toCol);
     void remotePromotion(Chessboard::Piece piece);
     void remoteBoardState(const Chessboard::BoardState& boardState);
     void remoteUndo();
+    void pieceLifted(const Chessboard::Square& square);
     void promotionRequired();
     void drawRequested(Chessboard::Colour requestor);
     void drawDeclined(Chessboard::Colour declinor);
     void draw(Chessboard::DrawReason reason);
     void resignation(Chessboard::Colour colour);
     void checkmate(Chessboard::Colour winner);
+    // The tablebases show a forced win.
+    void adjudicated(Chessboard::Colour winner);
     void boardStateChanged(const Chessboard::BoardState& boardState);
     void illegalMove(int fromRow, int fromCol, int toRow, int toCol);
     void localOutOfSyncWithRemote();
     void remoteOutOfSyncWithLocal();
     void canUndoChanged(bool canUndo);
+    void timeExpired(Chessboard::Colour colour);
 private slots:
     void checkGameOver();
+    void flagFall();
 private:
+    void resetClock();
+    // Hands the clock to the side to move. Only a move earns the increment;
+    // undos and positions set up or read back do not.
+    void switchClock(bool moved);
+
     Chessboard::BoardState m_local;
     Chessboard::BoardState m_prevLocal;
     Chessboard::RemoteBoard *m_remote {};
     bool m_hasLocalMoves {};
+    bool m_resyncPending {};
     bool m_drawRequested { false };
     bool m_promotionRequired { false };
     Chessboard::Colour m_drawRequestor;
     Chessboard::GameOptions m_gameOptions;
+    int m_whiteTime {-1};
+    int m_blackTime {-1};
+    Chessboard::Colour m_clockColour {Chessboard::Colour::White};
+    bool m_clockRunning {};
+    QElapsedTimer m_clockTimer;
+    QTimer *m_flagTimer;
+    QSharedPointer<const Chessboard::SyzygyTablebases> m_tablebases;
 };
 
 #endif // COMPOSITEBOARD_H
@@ -28,10 +28,13 @@ QString connectionStateToString(ConnectionState state)
         return QCoreApplication::translate("ConnectionState", "connecting");
     case ConnectionState::Connected:
         return QCoreApplication::translate("ConnectionState", "connected");
+    case ConnectionState::Reconnecting:
+        return QCoreApplication::translate("ConnectionState", "reconnecting");
     default:
         Q_ASSERT(state == ConnectionState::Disconnected ||
                  state == ConnectionState::Connecting ||
-                 state == ConnectionState::Connected);
+                 state == ConnectionState::Connected ||
+                 state == ConnectionState::Reconnecting);
         return QString();
     }
 }
@@ -45,10 +48,13 @@ QString connectionStateToStringTitle(ConnectionState state)
         return QCoreApplication::translate("ConnectionState", "Connecting");
     case ConnectionState::Connected:
         return QCoreApplication::translate("ConnectionState", "Connected");
+    case ConnectionState::Reconnecting:
+        return QCoreApplication::translate("ConnectionState", "Reconnecting");
     default:
         Q_ASSERT(state == ConnectionState::Disconnected ||
                  state == ConnectionState::Connecting ||
-                 state == ConnectionState::Connected);
+                 state == ConnectionState::Connected ||
+                 state == ConnectionState::Reconnecting);
         return QString();
     }
 }
@@ -24,7 +24,8 @@
 enum class ConnectionState {
     Disconnected,
     Connecting,
-    Connected
+    Connected,
+    Reconnecting
 };
 
 QString connectionStateToString(ConnectionState state);
@@ -0,0 +1,492 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QThread>
+#include "aiplayerfactory.h"
+#include "enginepool.h"
+
+// Runs one request at a time on an engine's thread and reports the
+// results back through the pool's response channel for that engine.
+class EngineWorker : public QObject
+{
+public:
+    EngineWorker(EnginePool *pool, int engine, AiPlayer *aiPlayer, const CommandSender& responses) :
+        m_pool(pool),
+        m_engine(engine),
+        m_aiPlayer(aiPlayer),
+        m_requests(new CommandReceiver(this)),
+        m_responses(responses)
+    {
+        aiPlayer->setParent(this);
+        connect(m_aiPlayer, &AiPlayer::requestMove, this, &EngineWorker::requestMove);
+        connect(m_aiPlayer, &AiPlayer::requestPromotion, this, &EngineWorker::requestPromotion);
+        connect(m_aiPlayer, &AiPlayer::assistance, this, &EngineWorker::assistance);
+        connect(m_aiPlayer, &AiPlayer::assistanceComplete, this, &EngineWorker::assistanceComplete);
+        connect(m_aiPlayer, &AiPlayer::analysis, this, &EngineWorker::analysis);
+        connect(m_aiPlayer, &AiPlayer::error, this, &EngineWorker::error);
+    }
+    CommandSender requests() const
+    {
+        return m_requests->sender();
+    }
+    void run(const EnginePool::Request& request)
+    {
+        m_request = request.id;
+        m_type = request.type;
+        m_state = request.state;
+        m_awaitingPromotion = false;
+        m_aiPlayer->setCancellationToken(request.token);
+        if (m_state.legalMoves().isEmpty()) {
+            // Players have nothing to report for a finished game.
+            if (m_type == EnginePool::Request::Move)
+                error(AiPlayer::UnknownError);
+            else if (m_type == EnginePool::Request::Analysis)
+                analysis(PositionAnalysis());
+            else
+                finish();
+            return;
+        }
+        if (m_type == EnginePool::Request::Analysis) {
+            m_aiPlayer->startAnalysis(m_state, request.moveTime);
+        } else if (m_type == EnginePool::Request::Move) {
+            if (request.strength != m_strength) {
+                m_strength = request.strength;
+                m_aiPlayer->setStrength(m_strength);
+            }
+            m_aiPlayer->setClock(request.clock);
+            m_aiPlayer->start(m_state);
+        } else {
+            if (request.strength != m_assistanceLevel) {
+                m_assistanceLevel = request.strength;
+                m_aiPlayer->setAssistanceLevel(m_assistanceLevel);
+            }
+            m_aiPlayer->startAssistance(m_state);
+        }
+    }
+    void release(int request)
+    {
+        // The request may already have finished on this thread, but the
+        // pool is waiting for this reply before it reuses the engine.
+        if (m_request == request) {
+            m_aiPlayer->cancel();
+            m_request = 0;
+        }
+        EnginePool *pool = m_pool;
+        const int engine = m_engine;
+        m_responses.post([pool, engine, request]() {
+            pool->engineReleased(engine, request);
+        });
+    }
+    void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+    {
+        m_aiPlayer->setTablebases(tablebases);
+    }
+    void setResources(const EngineResources& resources)
+    {
+        m_aiPlayer->setResources(resources);
+    }
+private:
+    void requestMove(int fromRow, int fromCol, int toRow, int toCol)
+    {
+        if (m_request == 0 || m_type != EnginePool::Request::Move)
+            return;
+        const Chessboard::ColouredPiece piece = m_state[fromRow][fromCol];
+        m_move = Chessboard::AlgebraicNotation();
+        m_move.fromRow = fromRow;
+        m_move.fromCol = fromCol;
+        m_move.toRow = toRow;
+        m_move.toCol = toCol;
+        m_move.piece = piece.piece();
+        if (piece.piece() != Chessboard::Piece::Pawn || (toRow != 0 && toRow != 7)) {
+            reportMove();
+            return;
+        }
+        // Most players follow a promotion with the piece straight away;
+        // ask the others once they have returned to the event loop.
+        m_awaitingPromotion = true;
+        const int request = m_request;
+        QMetaObject::invokeMethod(this, [this, request]() {
+            if (m_request == request && m_awaitingPromotion)
+                m_aiPlayer->promotionRequired();
+        }, Qt::QueuedConnection);
+    }
+    void requestPromotion(Chessboard::Piece piece)
+    {
+        if (m_request == 0 || !m_awaitingPromotion)
+            return;
+        m_awaitingPromotion = false;
+        m_move.promotion = true;
+        m_move.promotionPiece = piece;
+        reportMove();
+    }
+    void reportMove()
+    {
+        EnginePool *pool = m_pool;
+        const int engine = m_engine;
+        const int request = m_request;
+        const Chessboard::AlgebraicNotation move = m_move;
+        m_responses.post([pool, engine, request, move]() {
+            pool->engineMoveFound(engine, request, move);
+        });
+        finish();
+    }
+    void assistance(const QList<Chessboard::AssistanceColour>& colours)
+    {
+        if (m_request == 0 || m_type != EnginePool::Request::Assistance)
+            return;
+        EnginePool *pool = m_pool;
+        const int request = m_request;
+        m_responses.post([pool, request, colours]() {
+            pool->engineAssistance(request, colours);
+        });
+    }
+    void analysis(const PositionAnalysis& analysis)
+    {
+        if (m_request == 0 || m_type != EnginePool::Request::Analysis)
+            return;
+        EnginePool *pool = m_pool;
+        const int engine = m_engine;
+        const int request = m_request;
+        m_responses.post([pool, engine, request, analysis]() {
+            pool->engineAnalysed(engine, request, analysis);
+        });
+        finish();
+    }
+    void assistanceComplete()
+    {
+        if (m_request != 0 && m_type == EnginePool::Request::Assistance)
+            finish();
+    }
+    void error(AiPlayer::Error error)
+    {
+        if (m_request == 0)
+            return;
+        EnginePool *pool = m_pool;
+        const int engine = m_engine;
+        const int request = m_request;
+        m_responses.post([pool, engine, request, error]() {
+            pool->engineError(engine, request, error);
+        });
+        finish();
+    }
+    void finish()
+    {
+        EnginePool *pool = m_pool;
+        const int engine = m_engine;
+        const int request = m_request;
+        m_request = 0;
+        m_responses.post([pool, engine, request]() {
+            pool->engineFinished(engine, request);
+        });
+    }
+
+    EnginePool *m_pool;
+    int m_engine;
+    AiPlayer *m_aiPlayer;
+    CommandReceiver *m_requests;
+    CommandSender m_responses;
+    int m_request {};
+    EnginePool::Request::Type m_type {EnginePool::Request::Move};
+    Chessboard::BoardState m_state;
+    Chessboard::AlgebraicNotation m_move;
+    bool m_awaitingPromotion {};
+    int m_strength {-1};
+    int m_assistanceLevel {-1};
+};
+
+double EnginePool::Statistics::utilisation() const
+{
+    if (engineCount == 0 || elapsedTime == 0)
+        return 0.0;
+    return static_cast<double>(busyTime) / (static_cast<double>(elapsedTime) * engineCount);
+}
+
+double EnginePool::Statistics::averageWaitTime(Priority priority) const
+{
+    if (started[priority] == 0)
+        return 0.0;
+    return static_cast<double>(totalWaitTime[priority]) / started[priority];
+}
+
+EnginePool::EnginePool(AiPlayerFactory *factory, int engineCount, QObject *parent) :
+    QObject(parent)
+{
+    if (engineCount <= 0)
+        engineCount = qMax(1, QThread::idealThreadCount());
+    qDebug("EnginePool::EnginePool: %d engines", engineCount);
+    m_elapsed.start();
+    for (int i=0;i<engineCount;++i) {
+        Engine engine;
+        engine.thread = new QThread;
+        connect(engine.thread, &QThread::finished, engine.thread, &QThread::deleteLater);
+        engine.thread->start();
+        engine.responses = new CommandReceiver(this);
+        AiPlayer *aiPlayer = factory->createAiPlayer(Chessboard::Colour::White);
+        engine.worker = new EngineWorker(this, i, aiPlayer, engine.responses->sender());
+        engine.requests = engine.worker->requests();
+        engine.worker->moveToThread(engine.thread);
+        m_engines.append(engine);
+    }
+}
+
+EnginePool::~EnginePool()
+{
+    for (Engine& engine : m_engines) {
+        if (engine.request && m_requests.contains(engine.request))
+            m_requests[engine.request].token.cancel();
+        // As in AiController, the worker must be deleted on its own thread
+        // before the thread is told to quit.
+        engine.worker->deleteLater();
+        QObject *threadKiller = new QObject;
+        threadKiller->moveToThread(engine.thread);
+        connect(threadKiller, &QObject::destroyed, engine.thread, &QThread::quit);
+        QMetaObject::invokeMethod(threadKiller, [threadKiller]() {
+                threadKiller->deleteLater();
+            }, Qt::QueuedConnection);
+    }
+}
+
+int EnginePool::engineCount() const
+{
+    return static_cast<int>(m_engines.size());
+}
+
+int EnginePool::requestMove(const Chessboard::BoardState& state, int elo, Priority priority,
+                            const GameClock& clock, const QDeadlineTimer& deadline)
+{
+    Request request;
+    request.type = Request::Move;
+    request.priority = priority;
+    request.state = state;
+    request.strength = elo;
+    request.clock = clock;
+    request.deadline = deadline;
+    return submit(request);
+}
+
+int EnginePool::requestAssistance(const Chessboard::BoardState& state, int level, Priority priority)
+{
+    Request request;
+    request.type = Request::Assistance;
+    request.priority = priority;
+    request.state = state;
+    request.strength = level;
+    return submit(request);
+}
+
+int EnginePool::requestAnalysis(const Chessboard::BoardState& state, int moveTime, Priority priority)
+{
+    Request request;
+    request.type = Request::Analysis;
+    request.priority = priority;
+    request.state = state;
+    request.moveTime = moveTime;
+    return submit(request);
+}
+
+int EnginePool::submit(Request request)
+{
+    request.id = m_nextRequest++;
+    request.token = CancellationToken(request.deadline);
+    request.queued.start();
+    m_requests.insert(request.id, request);
+    m_queues[request.priority].append(request.id);
+    qDebug("EnginePool::submit: request %d priority %d", request.id, request.priority);
+    preemptFor(request.priority);
+    schedule();
+    return request.id;
+}
+
+void EnginePool::cancel(int request)
+{
+    if (!m_requests.contains(request))
+        return;
+    const Priority priority = m_requests[request].priority;
+    m_requests[request].token.cancel();
+    m_requests.remove(request);
+    ++m_statistics.cancelled;
+    if (m_queues[priority].removeOne(request))
+        return;
+    for (int i=0;i<m_engines.size();++i) {
+        if (m_engines[i].request == request && !m_engines[i].releasing)
+            releaseEngine(i, true);
+    }
+}
+
+void EnginePool::setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+{
+    for (const Engine& engine : m_engines) {
+        EngineWorker *worker = engine.worker;
+        engine.requests.post([worker, tablebases]() {
+            worker->setTablebases(tablebases);
+        });
+    }
+}
+
+void EnginePool::setResources(const EngineResources& resources)
+{
+    const EngineResources engineResources = resources.partitionedBetween(engineCount());
+    for (const Engine& engine : m_engines) {
+        EngineWorker *worker = engine.worker;
+        engine.requests.post([worker, engineResources]() {
+            worker->setResources(engineResources);
+        });
+    }
+}
+
+EnginePool::Statistics EnginePool::statistics() const
+{
+    Statistics statistics = m_statistics;
+    statistics.engineCount = engineCount();
+    statistics.elapsedTime = m_elapsed.elapsed();
+    for (const Engine& engine : m_engines) {
+        if (engine.request) {
+            ++statistics.busyEngines;
+            statistics.busyTime += engine.busy.elapsed();
+        }
+    }
+    for (int i=0;i<priorityCount;++i)
+        statistics.queued[i] = static_cast<int>(m_queues[i].size());
+    return statistics;
+}
+
+void EnginePool::schedule()
+{
+    for (int i=0;i<m_engines.size();++i) {
+        if (m_engines[i].request)
+            continue;
+        int request = 0;
+        for (QList<int>& queue : m_queues) {
+            if (!queue.isEmpty()) {
+                request = queue.takeFirst();
+                break;
+            }
+        }
+        if (!request)
+            return;
+        dispatch(i, request);
+    }
+}
+
+void EnginePool::preemptFor(Priority priority)
+{
+    int victim = -1;
+    for (int i=0;i<m_engines.size();++i) {
+        const Engine& engine = m_engines[i];
+        if (!engine.request)
+            return;
+        if (engine.releasing)
+            continue;
+        const Priority running = m_requests[engine.request].priority;
+        if (running > priority && (victim == -1 || running > m_requests[m_engines[victim].request].priority))
+            victim = i;
+    }
+    if (victim == -1)
+        return;
+    const int id = m_engines[victim].request;
+    qDebug("EnginePool::preemptFor: request %d preempted on engine %d", id, victim);
+    Request& request = m_requests[id];
+    request.token.cancel();
+    // The request starts again from scratch on the next free engine.
+    request.token = CancellationToken(request.deadline);
+    request.queued.start();
+    m_queues[request.priority].prepend(id);
+    ++m_statistics.preempted;
+    releaseEngine(victim, true);
+}
+
+void EnginePool::dispatch(int engine, int id)
+{
+    const Request& request = m_requests[id];
+    m_statistics.totalWaitTime[request.priority] += request.queued.elapsed();
+    ++m_statistics.started[request.priority];
+    m_engines[engine].request = id;
+    m_engines[engine].busy.start();
+    EngineWorker *worker = m_engines[engine].worker;
+    m_engines[engine].requests.post([worker, request]() {
+        worker->run(request);
+    });
+}
+
+void EnginePool::releaseEngine(int engine, bool notifyWorker)
+{
+    Engine& e = m_engines[engine];
+    if (notifyWorker) {
+        // Keep the engine until the worker confirms it has let go.
+        e.releasing = true;
+        EngineWorker *worker = e.worker;
+        const int request = e.request;
+        e.requests.post([worker, request]() {
+            worker->release(request);
+        });
+        return;
+    }
+    m_statistics.busyTime += e.busy.elapsed();
+    e.request = 0;
+    e.releasing = false;
+    schedule();
+}
+
+void EnginePool::engineMoveFound(int engine, int request, const Chessboard::AlgebraicNotation& move)
+{
+    if (m_engines[engine].request != request || m_engines[engine].releasing)
+        return;
+    emit moveFound(request, move);
+}
+
+void EnginePool::engineAssistance(int request, const QList<Chessboard::AssistanceColour>& colours)
+{
+    // Late results from a preempted run are dropped with the run.
+    for (const Engine& engine : m_engines) {
+        if (engine.request == request && !engine.releasing) {
+            emit assistance(request, colours);
+            return;
+        }
+    }
+}
+
+void EnginePool::engineAnalysed(int engine, int request, const PositionAnalysis& analysis)
+{
+    if (m_engines[engine].request != request || m_engines[engine].releasing)
+        return;
+    emit positionAnalysed(request, analysis);
+}
+
+void EnginePool::engineError(int engine, int request, AiPlayer::Error error)
+{
+    if (m_engines[engine].request != request || m_engines[engine].releasing)
+        return;
+    emit this->error(request, error);
+}
+
+void EnginePool::engineFinished(int engine, int request)
+{
+    if (m_engines[engine].request != request || m_engines[engine].releasing)
+        return;
+    m_requests.remove(request);
+    ++m_statistics.completed;
+    releaseEngine(engine, false);
+    emit finished(request);
+}
+
+void EnginePool::engineReleased(int engine, int request)
+{
+    if (m_engines[engine].request != request || !m_engines[engine].releasing)
+        return;
+    releaseEngine(engine, false);
+}
@@ -0,0 +1,152 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include "aiplayer.h"
+#include "cancellationtoken.h"
+#include "chessboard.h"
+#include "commandchannel.h"
+#include "engineresources.h"
+#include "timemanager.h"
+
+class AiPlayerFactory;
+class EngineWorker;
+class QThread;
+
+// Shares a fixed set of engines, each on its own thread, between any
+// number of games. Requests are queued by priority and handed to the
+// first idle engine; when every engine is busy a new request preempts
+// the lowest priority request in progress, which goes back to the front
+// of its queue. Results are reported against the id returned when the
+// request was made.
+class EnginePool : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority {
+        LiveMove,
+        Assistance,
+        Background
+    };
+    Q_ENUM(Priority)
+    static const int priorityCount = Background + 1;
+
+    struct Statistics {
+        int engineCount {};
+        int busyEngines {};
+        int queued[priorityCount] {};
+        int completed {};
+        int preempted {};
+        int cancelled {};
+        // Summed over all engines, including requests still in progress.
+        qint64 busyTime {};
+        qint64 elapsedTime {};
+        qint64 totalWaitTime[priorityCount] {};
+        int started[priorityCount] {};
+        // Fraction of the available engine time spent on requests.
+        double utilisation() const;
+        double averageWaitTime(Priority priority) const;
+    };
+
+    // An engine count of zero means one engine per core.
+    explicit EnginePool(AiPlayerFactory *factory, int engineCount = 0, QObject *parent = nullptr);
+    ~EnginePool();
+
+    int engineCount() const;
+    int requestMove(const Chessboard::BoardState& state, int elo, Priority priority = LiveMove,
+                    const GameClock& clock = GameClock(),
+                    const QDeadlineTimer& deadline = QDeadlineTimer(QDeadlineTimer::Forever));
+    int requestAssistance(const Chessboard::BoardState& state, int level, Priority priority = Assistance);
+    int requestAnalysis(const Chessboard::BoardState& state, int moveTime, Priority priority = Background);
+    void cancel(int request);
+    void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases);
+    // The engines search at the same time, so they split the resources.
+    void setResources(const EngineResources& resources);
+    Statistics statistics() const;
+
+signals:
+    void moveFound(int request, const Chessboard::AlgebraicNotation& move);
+    void assistance(int request, const QList<Chessboard::AssistanceColour>& colours);
+    // The analysis is invalid if the position has no legal moves.
+    void positionAnalysed(int request, const PositionAnalysis& analysis);
+    // Emitted once for every request that was not cancelled, after its
+    // last result.
+    void finished(int request);
+    void error(int request, AiPlayer::Error error);
+
+private:
+    friend class EngineWorker;
+
+    struct Request {
+        enum Type {
+            Move,
+            Assistance,
+            Analysis
+        };
+        int id {};
+        Type type {Move};
+        Priority priority {LiveMove};
+        Chessboard::BoardState state;
+        int strength {};
+        int moveTime {};
+        GameClock clock;
+        QDeadlineTimer deadline;
+        CancellationToken token;
+        QElapsedTimer queued;
+    };
+
+    struct Engine {
+        QThread *thread {};
+        EngineWorker *worker {};
+        CommandSender requests;
+        CommandReceiver *responses {};
+        int request {};
+        // Set once the engine has been told to drop its request.
+        bool releasing {};
+        QElapsedTimer busy;
+    };
+
+    int submit(Request request);
+    void schedule();
+    void preemptFor(Priority priority);
+    void dispatch(int engine, int request);
+    void releaseEngine(int engine, bool notifyWorker);
+    void engineMoveFound(int engine, int request, const Chessboard::AlgebraicNotation& move);
+    void engineAssistance(int request, const QList<Chessboard::AssistanceColour>& colours);
+    void engineAnalysed(int engine, int request, const PositionAnalysis& analysis);
+    void engineError(int engine, int request, AiPlayer::Error error);
+    void engineFinished(int engine, int request);
+    void engineReleased(int engine, int request);
+
+    QList<Engine> m_engines;
+    QHash<int, Request> m_requests;
+    QList<int> m_queues[priorityCount];
+    int m_nextRequest {1};
+    Statistics m_statistics;
+    QElapsedTimer m_elapsed;
+};
+
+#endif // ENGINEPOOL_H
@@ -0,0 +1,103 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QThread>
+#include "engineresources.h"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_MACOS)
+#include <sys/sysctl.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+namespace {
+    // Fraction of the installed memory given to engine hash tables.
+    const int memoryShare = 16;
+    // Used when the installed memory is unknown.
+    const int fallbackHash = 64;
+
+    int roundDownToPowerOfTwo(int value)
+    {
+        int ret = 1;
+        while (ret * 2 <= value)
+            ret *= 2;
+        return ret;
+    }
+}
+
+EngineResources EngineResources::sharedBy(int sessions) const
+{
+    EngineResources ret = *this;
+    ret.hash = qMax(1, hash / qMax(1, sessions));
+    return ret;
+}
+
+EngineResources EngineResources::partitionedBetween(int sessions) const
+{
+    EngineResources ret = sharedBy(sessions);
+    ret.threads = qMax(1, threads / qMax(1, sessions));
+    return ret;
+}
+
+EngineResources EngineResources::forAssistance() const
+{
+    EngineResources ret = *this;
+    ret.threads = qMin(threads, maximumAssistanceThreads);
+    return ret;
+}
+
+EngineResources EngineResources::defaults()
+{
+    EngineResources ret;
+    ret.threads = qMax(1, QThread::idealThreadCount());
+    const qint64 memory = physicalMemory();
+    if (memory > 0) {
+        const qint64 share = memory / memoryShare / (1024 * 1024);
+        ret.hash = roundDownToPowerOfTwo(static_cast<int>(qBound<qint64>(minimumHash, share, maximumHash)));
+    } else {
+        ret.hash = fallbackHash;
+    }
+    return ret;
+}
+
+qint64 EngineResources::physicalMemory()
+{
+#if defined(Q_OS_WIN)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        return static_cast<qint64>(status.ullTotalPhys);
+    return 0;
+#elif defined(Q_OS_MACOS)
+    int64_t memory = 0;
+    size_t size = sizeof(memory);
+    if (sysctlbyname("hw.memsize", &memory, &size, nullptr, 0) == 0)
+        return memory;
+    return 0;
+#elif defined(Q_OS_UNIX)
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0)
+        return static_cast<qint64>(pages) * pageSize;
+    return 0;
+#else
+    return 0;
+#endif
+}
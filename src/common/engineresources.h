@@ -0,0 +1,51 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINERESOURCES_H
+#define ENGINERESOURCES_H
+
+#include <QtGlobal>
+
+// Search threads and hash table size (in MiB) for an engine session.
+struct EngineResources {
+    int threads {1};
+    int hash {16};
+
+    bool operator==(const EngineResources& other) const { return threads == other.threads && hash == other.hash; }
+    bool operator!=(const EngineResources& other) const { return !(*this == other); }
+
+    // Sessions that take turns to search can all use every thread, but
+    // each engine process allocates its own hash table.
+    EngineResources sharedBy(int sessions) const;
+    // Sessions that search at the same time split the threads as well.
+    EngineResources partitionedBetween(int sessions) const;
+    // Assistance searches each move for a few milliseconds, which is
+    // too short for more than a couple of threads to pay off.
+    EngineResources forAssistance() const;
+
+    // One thread per core and a hash table sized to the installed memory.
+    static EngineResources defaults();
+    // Installed memory in bytes, or 0 if it cannot be determined.
+    static qint64 physicalMemory();
+
+    static const int maximumAssistanceThreads = 2;
+    static const int minimumHash = 16;
+    static const int maximumHash = 2048;
+};
+
+#endif // ENGINERESOURCES_H
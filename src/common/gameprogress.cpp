@@ -34,6 +34,13 @@ QString GameProgress::toString() const
         return QCoreApplication::translate("GameProgress", "%1 resigns -- %1 wins").arg(
             colourToString(invertColour(winner)),
             colourToString(winner));
+    case GameProgress::Timeout:
+        return QCoreApplication::translate("GameProgress", "%1 ran out of time -- %2 wins").arg(
+            colourToString(invertColour(winner)),
+            colourToString(winner));
+    case GameProgress::Adjudication:
+        return QCoreApplication::translate("GameProgress", "Tablebase win -- %1 wins").arg(
+            colourToString(winner));
     case GameProgress::Draw:
         switch (reason) {
         case DrawReason::DeadPosition:
@@ -48,6 +55,8 @@ QString GameProgress::toString() const
             return QCoreApplication::translate("GameProgress", "Draw -- Fivefold Reptition Rule");
         case DrawReason::SeventyFiveMoveRule:
             return QCoreApplication::translate("GameProgress", "Draw -- 75 Move Rule");
+        case DrawReason::Tablebase:
+            return QCoreApplication::translate("GameProgress", "Draw -- Tablebase");
         case DrawReason::None:
         case DrawReason::MutualAgreement:
             return QCoreApplication::translate("GameProgress", "Draw");
@@ -58,6 +67,7 @@ QString GameProgress::toString() const
                      reason == DrawReason::FiftyMoveRule ||
                      reason == DrawReason::FivefoldRepetitionRule ||
                      reason == DrawReason::SeventyFiveMoveRule ||
+                     reason == DrawReason::Tablebase ||
                      reason == DrawReason::None ||
                      reason == DrawReason::MutualAgreement);
             return QString();
@@ -66,6 +76,8 @@ QString GameProgress::toString() const
         Q_ASSERT(state == GameProgress::InProgress ||
                  state == GameProgress::Checkmate ||
                  state == GameProgress::Resignation ||
+                 state == GameProgress::Timeout ||
+                 state == GameProgress::Adjudication ||
                  state == GameProgress::Draw);
         return QString();
     }
@@ -26,7 +26,9 @@ public:
     enum State { InProgress,
                  Checkmate,
                  Draw,
-                 Resignation
+                 Resignation,
+                 Timeout,
+                 Adjudication
                };
     GameProgress() : state(InProgress) {}
     GameProgress(State state_) : state(state_) {}
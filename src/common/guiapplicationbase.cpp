@@ -31,6 +31,8 @@ GuiApplicationBase::GuiApplicationBase(GuiFacade *guiFacade_, const Options &opt
 {
     connect(facade(), &ApplicationFacade::connected, this, &GuiApplicationBase::onConnected);
     connect(facade(), &ApplicationFacade::disconnected, this, &GuiApplicationBase::onDisconnected);
+    connect(facade(), &ApplicationFacade::reconnecting, this, &GuiApplicationBase::onReconnecting);
+    connect(facade(), &ApplicationFacade::reconnected, this, &GuiApplicationBase::onReconnected);
     connect(facade(), &ApplicationFacade::error, this, &GuiApplicationBase::onError);
     connect(facade(), &ApplicationFacade::discoveryFinished, this, &GuiApplicationBase::onDiscoveryFinished);
     connect(facade(), &ApplicationFacade::discoveryStarted, this, &GuiApplicationBase::onDiscoveryStarted);
@@ -48,6 +50,8 @@ GuiApplicationBase::GuiApplicationBase(GuiFacade *guiFacade_, const Options &opt
     connect(facade(), &ApplicationFacade::assistance, guiFacade(), &GuiFacade::assistance);
     connect(facade(), &ApplicationFacade::canUndoChanged, guiFacade(), &GuiFacade::setCanUndo);
     connect(facade(), &ApplicationFacade::engineNeedsConfigure, guiFacade(), &GuiFacade::showConfigureEngineDialog);
+    connect(facade(), &ApplicationFacade::analysisEnabledChanged, guiFacade(), &GuiFacade::setAnalysisEnabled);
+    connect(facade(), &ApplicationFacade::analysis, guiFacade(), &GuiFacade::analysis);
     connect(guiFacade(), &GuiFacade::connectRequested, this, &GuiApplicationBase::onConnectRequested);
     connect(guiFacade(), &GuiFacade::disconnectRequested, this, &GuiApplicationBase::onDisconnectRequested);
     connect(guiFacade(), &GuiFacade::cancelConnect, this, &GuiApplicationBase::onCancelConnect);
@@ -65,9 +69,11 @@ GuiApplicationBase::GuiApplicationBase(GuiFacade *guiFacade_, const Options &opt
     connect(guiFacade(), &GuiFacade::requestEdit, this, &GuiApplicationBase::onRequestEdit);
     connect(guiFacade(), &GuiFacade::requestUndo, facade(), &ApplicationFacade::requestUndo);
     connect(guiFacade(), &GuiFacade::configureEngine, facade(), &ApplicationFacade::configureEngine);
+    connect(guiFacade(), &GuiFacade::requestAnalysis, facade(), &ApplicationFacade::setAnalysisEnabled);
     guiFacade()->setConnectionState(ConnectionState::Disconnected);
     guiFacade()->setBoardState(BoardState::newGame());
     guiFacade()->gameOptionsChanged(facade()->gameOptions());
+    guiFacade()->setAnalysisEnabled(facade()->isAnalysisEnabled());
     QMetaObject::invokeMethod(this, &GuiApplicationBase::autoConnect, Qt::QueuedConnection);
 }
 
@@ -92,6 +98,18 @@ void GuiApplicationBase::onDisconnected()
     guiFacade()->hideConnectingPopup();
 }
 
+void GuiApplicationBase::onReconnecting(int attempt)
+{
+    qDebug("GuiApplicationBase::onReconnecting(%d)", attempt);
+    guiFacade()->setConnectionState(ConnectionState::Reconnecting);
+}
+
+void GuiApplicationBase::onReconnected(Chessboard::RemoteBoard *board)
+{
+    qDebug("GuiApplicationBase::onReconnected(%s)", qPrintable(board->address().toString()));
+    guiFacade()->setConnectionState(ConnectionState::Connected);
+}
+
 void GuiApplicationBase::onError(const QString& errorMessage)
 {
     qDebug("GuiApplicationBase::onError(%s)", qPrintable(errorMessage));
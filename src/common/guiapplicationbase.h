@@ -36,6 +36,8 @@ public:
 protected slots:
     virtual void onConnected(Chessboard::RemoteBoard *board);
     virtual void onDisconnected();
+    virtual void onReconnecting(int attempt);
+    virtual void onReconnected(Chessboard::RemoteBoard *board);
     virtual void onError(const QString& errorMessage);
     virtual void onDiscoveryFinished();
     virtual void onDiscoveryStarted();
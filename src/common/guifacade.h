@@ -20,6 +20,7 @@
 #define GUIFACADE_H
 
 #include <QObject>
+#include "aiplayer.h"
 #include "chessboard.h"
 #include "connectionstate.h"
 #include "gameprogress.h"
@@ -49,6 +50,7 @@ signals:
     void requestEdit(const Chessboard::BoardState& state);
     void requestUndo();
     void configureEngine(const QString& stockfishPath);
+    void requestAnalysis(bool enabled);
 
 public slots:
     virtual void showConnectingPopup(const QString& address) = 0;
@@ -77,6 +79,8 @@ public slots:
     virtual void assistance(const QList<Chessboard::AssistanceColour>& colours) = 0;
     virtual void setCanUndo(bool canUndo) = 0;
     virtual void showConfigureEngineDialog(const QString& errorMessage, const QString& stockfishPath) = 0;
+    virtual void setAnalysisEnabled(bool enabled) = 0;
+    virtual void analysis(const Chessboard::BoardState& state, const PositionAnalysis& analysis) = 0;
 };
 
 #endif // GUIFACADE_H
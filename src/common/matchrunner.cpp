@@ -0,0 +1,372 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDate>
+#include <QFileDevice>
+#include <QIODevice>
+#include <QThread>
+#include <cmath>
+#include "batchanalyser.h"
+#include "compositeboard.h"
+#include "enginepool.h"
+#include "matchrunner.h"
+
+using namespace Chessboard;
+
+namespace {
+    const QLatin1String whiteWins("1-0");
+    const QLatin1String blackWins("0-1");
+    const QLatin1String drawn("1/2-1/2");
+
+    // Plays move, filling in its squares and piece so that it can be
+    // replayed without resolving it again.
+    bool playMove(BoardState& state, AlgebraicNotation& move)
+    {
+        if (move.fromRow >= 0 && move.fromRow < 8 && move.fromCol >= 0 && move.fromCol < 8 &&
+            state[move.fromRow][move.fromCol].isValid())
+            move.piece = state[move.fromRow][move.fromCol].piece();
+        const AlgebraicNotation resolved = move.resolve(state);
+        bool promotionRequired = false;
+        if (!resolved.isValid() ||
+            !state.move(resolved.fromRow, resolved.fromCol, resolved.toRow, resolved.toCol, &promotionRequired))
+            return false;
+        move = resolved;
+        if (promotionRequired) {
+            if (!move.promotion) {
+                move.promotion = true;
+                move.promotionPiece = Piece::Queen;
+            }
+            state.promote(move.promotionPiece);
+        }
+        return true;
+    }
+
+    bool isEpd(QIODevice *device)
+    {
+        const QList<QByteArray> lines = device->peek(4096).split('\n');
+        for (const QByteArray& line : lines) {
+            const QByteArray trimmed = line.trimmed();
+            if (trimmed.isEmpty())
+                continue;
+            // The first field of a position has a slash between each rank.
+            return !trimmed.startsWith('[') && trimmed.split(' ').first().count('/') == 7;
+        }
+        return false;
+    }
+}
+
+double MatchRunner::Statistics::score() const
+{
+    if (games() == 0)
+        return 0.5;
+    return (wins + draws * 0.5) / games();
+}
+
+double MatchRunner::Statistics::eloDifference() const
+{
+    const double s = score();
+    if (s <= 0.0 || s >= 1.0)
+        return 0.0;
+    return -400.0 * std::log10(1.0 / s - 1.0);
+}
+
+MatchRunner::MatchRunner(const Player& first, const Player& second, int concurrency, QObject *parent) :
+    QObject(parent),
+    m_players{first, second},
+    m_concurrency(concurrency > 0 ? concurrency : qMax(1, QThread::idealThreadCount()))
+{
+    for (int i=0;i<2;++i) {
+        EnginePool *pool = new EnginePool(m_players[i].factory, m_concurrency, this);
+        connect(pool, &EnginePool::moveFound, this, [this, pool](int request, const AlgebraicNotation& move) {
+            moveFound(pool, request, move);
+        });
+        connect(pool, &EnginePool::error, this, [this, pool](int request, AiPlayer::Error error) {
+            engineError(pool, request, error);
+        });
+        m_pools[i] = pool;
+    }
+}
+
+MatchRunner::~MatchRunner()
+{
+    for (const Game& game : m_games) {
+        if (game.request)
+            game.pool->cancel(game.request);
+    }
+}
+
+void MatchRunner::setOpenings(const QList<Pgn>& openings)
+{
+    m_openings = openings;
+}
+
+void MatchRunner::setTimeControl(const TimeControl& timeControl)
+{
+    m_timeControl = timeControl;
+}
+
+void MatchRunner::setMaximumPlies(int plies)
+{
+    m_maximumPlies = plies;
+}
+
+void MatchRunner::setResources(const EngineResources& resources)
+{
+    for (EnginePool *pool : m_pools)
+        pool->setResources(resources);
+}
+
+void MatchRunner::setOutput(QIODevice *output)
+{
+    m_output = output;
+}
+
+void MatchRunner::start(int games)
+{
+    m_gamesToPlay = games;
+    m_gamesStarted = 0;
+    m_statistics = Statistics();
+    while (m_gamesStarted < m_gamesToPlay && m_games.size() < m_concurrency)
+        startGame();
+    if (m_games.isEmpty())
+        emit finished();
+}
+
+QList<Pgn> MatchRunner::readOpenings(QIODevice *device, QString *errorMessage)
+{
+    QList<Pgn> ret;
+    if (isEpd(device)) {
+        int lineNumber = 0;
+        while (!device->atEnd()) {
+            const QString line = QString::fromLatin1(device->readLine()).trimmed();
+            ++lineNumber;
+            if (line.isEmpty())
+                continue;
+            // EPD has no move counters, so supply them.
+            const QStringList fields = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+            const BoardState state = (fields.size() >= 4) ?
+                BoardState::fromFenString(fields.mid(0, 4).join(QLatin1Char(' ')) + QLatin1String(" 0 1")) : BoardState();
+            if (!state.isValid()) {
+                if (errorMessage)
+                    *errorMessage = tr("line %1: invalid EPD record").arg(lineNumber);
+                return QList<Pgn>();
+            }
+            Pgn opening;
+            opening.tags[QLatin1String("FEN")] = state.toFenString();
+            opening.tags[QLatin1String("SetUp")] = QLatin1String("1");
+            ret.append(opening);
+        }
+        return ret;
+    }
+    PgnGameReader reader(device);
+    while (!reader.atEnd()) {
+        const QString text = reader.readGame();
+        if (text.trimmed().isEmpty())
+            continue;
+        QString parseError;
+        const Pgn pgn = PgnParser().parse(text, &parseError);
+        if (!pgn.isValid()) {
+            if (errorMessage)
+                *errorMessage = tr("opening %1: %2").arg(ret.size() + 1).arg(parseError.isEmpty() ? tr("no moves") : parseError);
+            return QList<Pgn>();
+        }
+        Pgn opening;
+        const QString fen = pgn.tags.value(QLatin1String("FEN"));
+        BoardState state = fen.isEmpty() ? BoardState::newGame() : BoardState::fromFenString(fen);
+        if (!fen.isEmpty()) {
+            opening.tags[QLatin1String("FEN")] = fen;
+            opening.tags[QLatin1String("SetUp")] = QLatin1String("1");
+        }
+        for (AlgebraicNotation move : pgn.moves) {
+            if (!playMove(state, move)) {
+                if (errorMessage)
+                    *errorMessage = tr("opening %1: illegal move at ply %2").arg(ret.size() + 1).arg(opening.moves.size() + 1);
+                return QList<Pgn>();
+            }
+            opening.moves.append(move);
+        }
+        ret.append(opening);
+    }
+    return ret;
+}
+
+void MatchRunner::startGame()
+{
+    Game game;
+    game.number = ++m_gamesStarted;
+    // Each opening is played twice, with the colours reversed.
+    game.firstIsWhite = (game.number % 2) == 1;
+    const Player& white = m_players[game.firstIsWhite ? 0 : 1];
+    const Player& black = m_players[game.firstIsWhite ? 1 : 0];
+    game.record.tags[QLatin1String("Event")] = tr("Engine match");
+    game.record.tags[QLatin1String("Date")] = QDate::currentDate().toString(QLatin1String("yyyy.MM.dd"));
+    game.record.tags[QLatin1String("Round")] = QString::number(game.number);
+    game.record.tags[QLatin1String("White")] = white.name;
+    game.record.tags[QLatin1String("Black")] = black.name;
+    game.record.tags[QLatin1String("TimeControl")] = m_timeControl.isTimed() ?
+        QString::number(m_timeControl.baseTime / 1000.0) + QLatin1Char('+') + QString::number(m_timeControl.increment / 1000.0) :
+        QLatin1String("-");
+
+    BoardState state = BoardState::newGame();
+    if (!m_openings.isEmpty()) {
+        const Pgn& opening = m_openings[((game.number - 1) / 2) % m_openings.size()];
+        if (opening.tags.contains(QLatin1String("FEN"))) {
+            game.record.tags[QLatin1String("FEN")] = opening.tags.value(QLatin1String("FEN"));
+            game.record.tags[QLatin1String("SetUp")] = QLatin1String("1");
+            state = BoardState::fromFenString(opening.tags.value(QLatin1String("FEN")));
+        }
+        for (AlgebraicNotation move : opening.moves) {
+            playMove(state, move);
+            game.record.moves.append(move);
+        }
+    }
+
+    const int number = game.number;
+    game.board = new CompositeBoard(this);
+    connect(game.board, &CompositeBoard::checkmate, this, [this, number](Colour winner) {
+        endGame(number, (winner == Colour::White) ? whiteWins : blackWins, QLatin1String("normal"));
+    });
+    connect(game.board, &CompositeBoard::draw, this, [this, number](DrawReason) {
+        endGame(number, drawn, QLatin1String("normal"));
+    });
+    connect(game.board, &CompositeBoard::timeExpired, this, [this, number](Colour colour) {
+        endGame(number, (colour == Colour::White) ? blackWins : whiteWins, QLatin1String("time forfeit"));
+    });
+    CompositeBoard *board = game.board;
+    m_games.insert(number, game);
+    GameOptions options;
+    options.white.playerType = options.black.playerType = PlayerType::Ai;
+    options.white.aiNominalElo = white.elo;
+    options.black.aiNominalElo = black.elo;
+    options.timeControl = m_timeControl;
+    board->requestNewGame(options);
+    if (!game.record.moves.isEmpty() || game.record.tags.contains(QLatin1String("FEN")))
+        board->setBoardState(state);
+    // The opening may already be over.
+    if (m_games.contains(number))
+        adjudicate(m_games[number]);
+}
+
+void MatchRunner::requestMove(Game& game)
+{
+    const BoardState state = game.board->boardState();
+    const bool whiteToMove = state.activeColour == Colour::White;
+    const int side = (whiteToMove == game.firstIsWhite) ? 0 : 1;
+    game.pool = m_pools[side];
+    game.request = game.pool->requestMove(state, m_players[side].elo, EnginePool::LiveMove, game.board->clock());
+}
+
+MatchRunner::Game *MatchRunner::findGame(EnginePool *pool, int request)
+{
+    for (Game& game : m_games) {
+        if (game.pool == pool && game.request == request)
+            return &game;
+    }
+    return nullptr;
+}
+
+void MatchRunner::moveFound(EnginePool *pool, int request, const AlgebraicNotation& move)
+{
+    Game *game = findGame(pool, request);
+    if (!game)
+        return;
+    game->request = 0;
+    const int number = game->number;
+    const BoardState before = game->board->boardState();
+    BoardState after = before;
+    AlgebraicNotation played = move;
+    if (!Square(move.fromRow, move.fromCol).isValid() || !Square(move.toRow, move.toCol).isValid() ||
+        !playMove(after, played)) {
+        const bool whiteToMove = before.activeColour == Colour::White;
+        endGame(number, whiteToMove ? blackWins : whiteWins, QLatin1String("rules infraction"));
+        return;
+    }
+    game->record.moves.append(played);
+    // The board reports the end of the game itself, which removes it.
+    game->board->requestMove(played.fromRow, played.fromCol, played.toRow, played.toCol);
+    if (!m_games.contains(number))
+        return;
+    if (game->board->isPromotionRequired()) {
+        game->board->requestPromotion(played.promotionPiece);
+        if (!m_games.contains(number))
+            return;
+    }
+    adjudicate(*game);
+}
+
+void MatchRunner::engineError(EnginePool *pool, int request, AiPlayer::Error)
+{
+    Game *game = findGame(pool, request);
+    if (!game)
+        return;
+    game->request = 0;
+    const bool whiteToMove = game->board->activeColour() == Colour::White;
+    endGame(game->number, whiteToMove ? blackWins : whiteWins, QLatin1String("abandoned"));
+}
+
+void MatchRunner::adjudicate(Game& game)
+{
+    const BoardState state = game.board->boardState();
+    // Engines never claim draws, so claim them on their behalf.
+    if (state.isClaimableDraw()) {
+        endGame(game.number, drawn, QLatin1String("normal"));
+        return;
+    }
+    if (m_maximumPlies > 0 && game.record.moves.size() >= m_maximumPlies) {
+        endGame(game.number, drawn, QLatin1String("adjudication"));
+        return;
+    }
+    requestMove(game);
+}
+
+void MatchRunner::endGame(int number, const QString& result, const QString& termination)
+{
+    const auto it = m_games.find(number);
+    if (it == m_games.end())
+        return;
+    Game game = it.value();
+    m_games.erase(it);
+    if (game.request)
+        game.pool->cancel(game.request);
+    // This may be called from one of the board's own signals.
+    game.board->stopClock();
+    game.board->deleteLater();
+
+    if (result == drawn)
+        ++m_statistics.draws;
+    else if ((result == whiteWins) == game.firstIsWhite)
+        ++m_statistics.wins;
+    else
+        ++m_statistics.losses;
+
+    if (m_output) {
+        game.record.tags[QLatin1String("Result")] = result;
+        game.record.tags[QLatin1String("Termination")] = termination;
+        QString errorMessage;
+        if (!PgnWriter().write(m_output, game.record, &errorMessage))
+            emit error(tr("Game %1: %2").arg(number).arg(errorMessage));
+        if (QFileDevice *file = qobject_cast<QFileDevice *>(m_output))
+            file->flush();
+    }
+    emit gameFinished(number, result, termination);
+
+    if (m_gamesStarted < m_gamesToPlay)
+        startGame();
+    else if (m_games.isEmpty())
+        emit finished();
+}
@@ -0,0 +1,118 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATCHRUNNER_H
+#define MATCHRUNNER_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include "aiplayer.h"
+#include "chessboard.h"
+#include "engineresources.h"
+
+class AiPlayerFactory;
+class CompositeBoard;
+class EnginePool;
+class QIODevice;
+
+// Plays games between two engine configurations without a board. Each
+// configuration gets its own engine pool with one engine per concurrent
+// game, so every core is searching while games are in progress. Openings
+// are played twice, once with each side as White.
+class MatchRunner : public QObject
+{
+    Q_OBJECT
+public:
+    struct Player {
+        QString name;
+        AiPlayerFactory *factory {};
+        int elo {2000};
+    };
+
+    // Results from the point of view of the first player.
+    struct Statistics {
+        int wins {};
+        int draws {};
+        int losses {};
+        int games() const { return wins + draws + losses; }
+        double score() const;
+        // Logistic estimate; zero until both players have scored.
+        double eloDifference() const;
+    };
+
+    // A concurrency of zero means one game per core.
+    MatchRunner(const Player& first, const Player& second, int concurrency = 0, QObject *parent = nullptr);
+    ~MatchRunner();
+
+    int concurrency() const { return m_concurrency; }
+    // Each opening is a game whose moves are played before the engines take
+    // over. It may start from a FEN tag.
+    void setOpenings(const QList<Chessboard::Pgn>& openings);
+    void setTimeControl(const Chessboard::TimeControl& timeControl);
+    // Games still going after this many plies are adjudicated drawn. Zero
+    // means no limit.
+    void setMaximumPlies(int plies);
+    void setResources(const EngineResources& resources);
+    // Finished games are written here as PGN.
+    void setOutput(QIODevice *output);
+    void start(int games);
+    Statistics statistics() const { return m_statistics; }
+
+    // Reads openings from PGN games or EPD positions, one per line.
+    static QList<Chessboard::Pgn> readOpenings(QIODevice *device, QString *errorMessage = nullptr);
+
+signals:
+    void gameFinished(int game, const QString& result, const QString& termination);
+    void error(const QString& message);
+    void finished();
+
+private:
+    struct Game {
+        int number {};
+        bool firstIsWhite {true};
+        CompositeBoard *board {};
+        EnginePool *pool {};
+        int request {};
+        Chessboard::Pgn record;
+        QString result;
+        QString termination;
+    };
+
+    void startGame();
+    void requestMove(Game& game);
+    void moveFound(EnginePool *pool, int request, const Chessboard::AlgebraicNotation& move);
+    void engineError(EnginePool *pool, int request, AiPlayer::Error error);
+    void endGame(int number, const QString& result, const QString& termination);
+    void adjudicate(Game& game);
+    Game *findGame(EnginePool *pool, int request);
+
+    Player m_players[2];
+    EnginePool *m_pools[2] {};
+    int m_concurrency {};
+    QList<Chessboard::Pgn> m_openings;
+    Chessboard::TimeControl m_timeControl;
+    int m_maximumPlies {};
+    QIODevice *m_output {};
+    int m_gamesToPlay {};
+    int m_gamesStarted {};
+    QHash<int, Game> m_games;
+    Statistics m_statistics;
+};
+
+#endif // MATCHRUNNER_H
@@ -0,0 +1,307 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include "assistance.h"
+#include "nativeaiplayer.h"
+#include "timemanager.h"
+
+using namespace Chessboard;
+
+namespace {
+    // Strength is limited by capping the search depth and adding noise to
+    // the evaluation. The first profile with an Elo at least as high as the
+    // requested one is used.
+    struct StrengthProfile {
+        int elo;
+        int maxDepth;
+        int noise;
+    };
+
+    const StrengthProfile strengthProfiles[] = {
+        {  600,  1, 300 },
+        {  800,  1, 150 },
+        { 1000,  2, 100 },
+        { 1200,  3,  60 },
+        { 1400,  4,  40 },
+        { 1600,  5,  25 },
+        { 1800,  6,  15 },
+        { 2000,  7,   8 },
+        { 2200,  9,   4 },
+        { 2400, 64,   0 }
+    };
+
+    // Total time in milliseconds for classifying all legal moves.
+    const int assistanceBudget = 400;
+
+    int toNativePiece(const ColouredPiece& piece)
+    {
+        if (!piece.isValid())
+            return NativeEngine::Empty;
+        int type;
+        switch (piece.piece()) {
+        case Piece::Pawn:
+            type = NativeEngine::Pawn;
+            break;
+        case Piece::Knight:
+            type = NativeEngine::Knight;
+            break;
+        case Piece::Bishop:
+            type = NativeEngine::Bishop;
+            break;
+        case Piece::Rook:
+            type = NativeEngine::Rook;
+            break;
+        case Piece::Queen:
+            type = NativeEngine::Queen;
+            break;
+        case Piece::King:
+        default:
+            type = NativeEngine::King;
+            break;
+        }
+        return piece.colour() == Colour::White ? type : -type;
+    }
+
+    Piece fromNativePiece(int type)
+    {
+        switch (type) {
+        case NativeEngine::Rook:
+            return Piece::Rook;
+        case NativeEngine::Knight:
+            return Piece::Knight;
+        case NativeEngine::Bishop:
+            return Piece::Bishop;
+        case NativeEngine::Queen:
+        default:
+            return Piece::Queen;
+        }
+    }
+
+    // Recreates the hash of a position recorded in BoardState::history
+    // from its BoardState::key().
+    uint64_t hashFromKey(const QByteArray& key)
+    {
+        if (key.size() < 66)
+            return 0;
+        NativeEngine::Board board;
+        for (int i=0;i<64;++i) {
+            const uint8_t value = static_cast<uint8_t>(key[i]);
+            ColouredPiece piece;
+            if (value != 0)
+                piece = ColouredPiece(static_cast<Colour>(value & 0x30), static_cast<Piece>(value & 0xf));
+            board.setPiece((7 - i / 8) * 8 + i % 8, toNativePiece(piece));
+        }
+        const uint8_t flags = static_cast<uint8_t>(key[64]);
+        board.setSideToMove((flags & 1) ? NativeEngine::Black : NativeEngine::White);
+        board.setCastlingRights(((flags & 2) ? NativeEngine::WhiteKingside : 0) |
+                                ((flags & 4) ? NativeEngine::BlackKingside : 0) |
+                                ((flags & 8) ? NativeEngine::WhiteQueenside : 0) |
+                                ((flags & 16) ? NativeEngine::BlackQueenside : 0));
+        const int enPassant = static_cast<signed char>(key[65]);
+        board.setEnPassantSquare(enPassant >= 0 ? enPassant : -1);
+        board.refresh();
+        return board.hash();
+    }
+
+    PositionAnalysis toPositionAnalysis(const NativeEngine::SearchResult& result, qint64 elapsed)
+    {
+        PositionAnalysis ret;
+        ret.bestMove = QString::fromStdString(result.bestMove.toUci());
+        ret.depth = result.depth;
+        if (qAbs(result.score) >= NativeEngine::MateThreshold) {
+            // Mate scores count down by one for every ply to the mate.
+            const int moves = (NativeEngine::MateScore - qAbs(result.score) + 1) / 2;
+            ret.mate = (result.score > 0) ? moves : -moves;
+        } else {
+            ret.score = result.score;
+        }
+        for (const NativeEngine::Move& move : result.pv)
+            ret.pv.append(QString::fromStdString(move.toUci()));
+        ret.nodes = result.nodes;
+        ret.nps = result.nodes * 1000 / qMax<qint64>(1, elapsed);
+        return ret;
+    }
+}
+
+NativeAiPlayer::NativeAiPlayer(Chessboard::Colour colour, QObject *parent, int hashSizeMb) :
+    AiPlayer(colour, parent),
+    m_search(new NativeEngine::Search(hashSizeMb))
+{
+}
+
+NativeAiPlayer::~NativeAiPlayer()
+{
+}
+
+NativeEngine::Board NativeAiPlayer::toNativeBoard(const Chessboard::BoardState& state)
+{
+    NativeEngine::Board board;
+    for (int row=0;row<8;++row) {
+        for (int col=0;col<8;++col)
+            board.setPiece(row * 8 + col, toNativePiece(state[row][col]));
+    }
+    board.setSideToMove(state.activeColour == Colour::White ? NativeEngine::White : NativeEngine::Black);
+    board.setCastlingRights((state.whiteKingsideCastlingAvailable ? NativeEngine::WhiteKingside : 0) |
+                            (state.whiteQueensideCastlingAvailable ? NativeEngine::WhiteQueenside : 0) |
+                            (state.blackKingsideCastlingAvailable ? NativeEngine::BlackKingside : 0) |
+                            (state.blackQueensideCastlingAvailable ? NativeEngine::BlackQueenside : 0));
+    board.setEnPassantSquare(state.enpassantTarget.isValid() ?
+                             state.enpassantTarget.row * 8 + state.enpassantTarget.col : -1);
+    board.setHalfMoveClock(state.halfMoveClock);
+    for (const QByteArray& key : state.history)
+        board.addHistory(hashFromKey(key));
+    board.refresh();
+    return board;
+}
+
+NativeEngine::SearchLimits NativeAiPlayer::searchLimits(int moveTime) const
+{
+    NativeEngine::SearchLimits limits;
+    limits.moveTime = moveTime;
+    const CancellationToken token = cancellationToken();
+    limits.stopRequested = [token]() { return token.isStopRequested(); };
+    return limits;
+}
+
+void NativeAiPlayer::start(const Chessboard::BoardState& state)
+{
+    qDebug("NativeAiPlayer::start");
+    if (playTablebaseMove(state))
+        return;
+    NativeEngine::Board board = toNativeBoard(state);
+    NativeEngine::SearchLimits limits = searchLimits(TimeManager::moveTime(state, clock(), m_elo * m_elo / 2000));
+    const StrengthProfile *profile = &strengthProfiles[0];
+    for (const StrengthProfile& p : strengthProfiles) {
+        profile = &p;
+        if (p.elo >= m_elo)
+            break;
+    }
+    limits.maxDepth = profile->maxDepth;
+    limits.noise = profile->noise;
+    limits.noiseSeed = QRandomGenerator::global()->generate64();
+    NativeEngine::SearchResult result = m_search->search(board, limits);
+    if (isCancelled() || result.bestMove.isNull())
+        return;
+    qDebug("NativeAiPlayer::start: %s depth %d score %d nodes %lld",
+           result.bestMove.toUci().c_str(), result.depth, result.score, static_cast<long long>(result.nodes));
+    const NativeEngine::Move move = result.bestMove;
+    emit requestMove(move.from() / 8, move.from() % 8, move.to() / 8, move.to() % 8);
+    if (move.promotion() != NativeEngine::Empty)
+        emit requestPromotion(fromNativePiece(move.promotion()));
+}
+
+void NativeAiPlayer::promotionRequired()
+{
+    emit requestPromotion(Chessboard::Piece::Queen);
+}
+
+void NativeAiPlayer::setStrength(int elo)
+{
+    m_elo = elo;
+}
+
+void NativeAiPlayer::setAssistanceLevel(int level)
+{
+    m_assistanceLevel = level;
+}
+
+void NativeAiPlayer::startAssistance(const Chessboard::BoardState& state)
+{
+    qDebug("NativeAiPlayer::startAssistance -- level = %d", m_assistanceLevel);
+    if (m_assistanceLevel == 1) {
+        emit assistanceComplete();
+        return;
+    }
+    const QList<QPair<Square, Square> > sortedMoves = state.sortedLegalMoves();
+    if (sortedMoves.isEmpty()) {
+        emit assistanceComplete();
+        return;
+    }
+    QList<AssistanceColour> colours;
+    if (tablebaseAssistance(state, m_assistanceLevel, &colours)) {
+        emit assistance(colours);
+        emit assistanceComplete();
+        return;
+    }
+    const QByteArray key = state.key();
+    AnalysisCache::Entry entry;
+    int cachedDepth = 0;
+    if (m_analysisCache.lookup(key, m_assistanceLevel, 0, &entry)) {
+        qDebug("NativeAiPlayer::startAssistance: cache hit (depth = %d)", entry.budget);
+        cachedDepth = entry.budget;
+        emit assistance(entry.colours);
+    }
+
+    NativeEngine::Board board = toNativeBoard(state);
+    const std::vector<NativeEngine::Move> rootMoves = board.legalMoves();
+    // Map each of the board's moves on to the engine's moves; promotions
+    // appear once per piece in the engine but only once on the board.
+    QList<QList<int> > moveIndices(sortedMoves.size());
+    for (size_t i=0;i<rootMoves.size();++i) {
+        const NativeEngine::Move& move = rootMoves[i];
+        for (int j=0;j<sortedMoves.size();++j) {
+            const QPair<Square, Square>& m = sortedMoves[j];
+            if (m.first.row * 8 + m.first.col == move.from() && m.second.row * 8 + m.second.col == move.to()) {
+                moveIndices[j].append(static_cast<int>(i));
+                break;
+            }
+        }
+    }
+
+    const int level = m_assistanceLevel;
+    m_search->scoreMoves(board, rootMoves, searchLimits(assistanceBudget),
+                         [&](int depth, const std::vector<int>& scores) {
+        if (depth <= cachedDepth || isCancelled())
+            return;
+        AnalysisCache::Entry entry;
+        entry.budget = depth;
+        int best = 0;
+        for (int j=0;j<sortedMoves.size();++j) {
+            int score = -NativeEngine::InfiniteScore;
+            for (int i : moveIndices[j])
+                score = qMax(score, scores[i]);
+            entry.scores.append(score);
+            if (score > entry.scores[best])
+                best = j;
+        }
+        for (int j=0;j<sortedMoves.size();++j)
+            entry.colours.append(classifyAssistance(level, entry.scores[j], j == best));
+        m_analysisCache.insert(key, level, entry);
+        emit assistance(entry.colours);
+    });
+    emit assistanceComplete();
+}
+
+void NativeAiPlayer::startAnalysis(const Chessboard::BoardState& state, int moveTime)
+{
+    qDebug("NativeAiPlayer::startAnalysis -- move time = %d", moveTime);
+    NativeEngine::Board board = toNativeBoard(state);
+    QElapsedTimer timer;
+    timer.start();
+    const NativeEngine::SearchResult result = m_search->search(board, searchLimits(moveTime),
+                                                               [&](const NativeEngine::SearchResult& iteration) {
+        if (!isCancelled() && !iteration.bestMove.isNull())
+            emit analysisProgress(toPositionAnalysis(iteration, timer.elapsed()));
+    });
+    PositionAnalysis ret;
+    if (!isCancelled() && !result.bestMove.isNull())
+        ret = toPositionAnalysis(result, timer.elapsed());
+    emit analysis(ret);
+}
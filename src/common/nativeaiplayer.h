@@ -0,0 +1,63 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef NATIVEAIPLAYER_H
+#define NATIVEAIPLAYER_H
+
+#include <QScopedPointer>
+#include "aiplayer.h"
+#include "aiplayerfactory.h"
+#include "analysiscache.h"
+#include "nativeengine.h"
+
+// AI player using the built-in alpha-beta engine. It runs in-process on
+// the AI thread, so needs no external executable and starts instantly.
+class NativeAiPlayer : public AiPlayer
+{
+    Q_OBJECT
+public:
+    NativeAiPlayer(Chessboard::Colour colour, QObject *parent, int hashSizeMb = 16);
+    ~NativeAiPlayer();
+    void start(const Chessboard::BoardState& state) override;
+    void promotionRequired() override;
+    void setStrength(int elo) override;
+    void setAssistanceLevel(int level) override;
+    void startAssistance(const Chessboard::BoardState& state) override;
+    void startAnalysis(const Chessboard::BoardState& state, int moveTime) override;
+
+    static NativeEngine::Board toNativeBoard(const Chessboard::BoardState& state);
+
+private:
+    NativeEngine::SearchLimits searchLimits(int moveTime) const;
+
+    QScopedPointer<NativeEngine::Search> m_search;
+    AnalysisCache m_analysisCache;
+    int m_elo {1000};
+    int m_assistanceLevel {1};
+};
+
+class NativeAiPlayerFactory : public AiPlayerFactory
+{
+public:
+    AiPlayer *createAiPlayer(Chessboard::Colour colour, QObject *parent = nullptr) override
+    {
+        return new NativeAiPlayer(colour, parent);
+    }
+};
+
+#endif // NATIVEAIPLAYER_H
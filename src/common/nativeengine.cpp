@@ -0,0 +1,1038 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "nativeengine.h"
+
+namespace NativeEngine {
+
+namespace {
+    uint64_t splitMix64(uint64_t& state)
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    struct Tables {
+        uint64_t pieceKeys[13][64];
+        uint64_t castlingKeys[16];
+        uint64_t enPassantKeys[8];
+        uint64_t sideKey;
+        std::vector<int> knightTargets[64];
+        std::vector<int> kingTargets[64];
+        int castlingMask[64];
+
+        Tables()
+        {
+            uint64_t state = 0x2545f4914f6cdd1dULL;
+            for (int p=0;p<13;++p)
+                for (int sq=0;sq<64;++sq)
+                    pieceKeys[p][sq] = splitMix64(state);
+            for (int i=0;i<16;++i)
+                castlingKeys[i] = splitMix64(state);
+            for (int i=0;i<8;++i)
+                enPassantKeys[i] = splitMix64(state);
+            sideKey = splitMix64(state);
+            static const int knightDeltas[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2},
+                                                    {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+            static const int kingDeltas[8][2] = { {1, 0}, {1, 1}, {0, 1}, {-1, 1},
+                                                  {-1, 0}, {-1, -1}, {0, -1}, {1, -1} };
+            for (int sq=0;sq<64;++sq) {
+                int row = sq / 8, col = sq % 8;
+                for (int i=0;i<8;++i) {
+                    int r = row + knightDeltas[i][0], c = col + knightDeltas[i][1];
+                    if (r >= 0 && r < 8 && c >= 0 && c < 8)
+                        knightTargets[sq].push_back(r * 8 + c);
+                    r = row + kingDeltas[i][0];
+                    c = col + kingDeltas[i][1];
+                    if (r >= 0 && r < 8 && c >= 0 && c < 8)
+                        kingTargets[sq].push_back(r * 8 + c);
+                }
+                castlingMask[sq] = 15;
+            }
+            castlingMask[0] &= ~WhiteQueenside;
+            castlingMask[7] &= ~WhiteKingside;
+            castlingMask[4] &= ~(WhiteKingside | WhiteQueenside);
+            castlingMask[56] &= ~BlackQueenside;
+            castlingMask[63] &= ~BlackKingside;
+            castlingMask[60] &= ~(BlackKingside | BlackQueenside);
+        }
+    };
+
+    const Tables& tables()
+    {
+        static const Tables t;
+        return t;
+    }
+
+    inline int pieceIndex(int piece)
+    {
+        // 1..6 for white, 7..12 for black.
+        return piece > 0 ? piece : 6 - piece;
+    }
+
+    const int rookDirections[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+    const int bishopDirections[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+
+    const int pieceValues[7] = { 0, 100, 320, 330, 500, 900, 0 };
+
+    // Piece-square tables from white's point of view with rank 8 first,
+    // as in the Simplified Evaluation Function.
+    const int pawnTable[64] = {
+         0,  0,  0,  0,  0,  0,  0,  0,
+        50, 50, 50, 50, 50, 50, 50, 50,
+        10, 10, 20, 30, 30, 20, 10, 10,
+         5,  5, 10, 25, 25, 10,  5,  5,
+         0,  0,  0, 20, 20,  0,  0,  0,
+         5, -5,-10,  0,  0,-10, -5,  5,
+         5, 10, 10,-20,-20, 10, 10,  5,
+         0,  0,  0,  0,  0,  0,  0,  0
+    };
+    const int knightTable[64] = {
+        -50,-40,-30,-30,-30,-30,-40,-50,
+        -40,-20,  0,  0,  0,  0,-20,-40,
+        -30,  0, 10, 15, 15, 10,  0,-30,
+        -30,  5, 15, 20, 20, 15,  5,-30,
+        -30,  0, 15, 20, 20, 15,  0,-30,
+        -30,  5, 10, 15, 15, 10,  5,-30,
+        -40,-20,  0,  5,  5,  0,-20,-40,
+        -50,-40,-30,-30,-30,-30,-40,-50
+    };
+    const int bishopTable[64] = {
+        -20,-10,-10,-10,-10,-10,-10,-20,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -10,  0,  5, 10, 10,  5,  0,-10,
+        -10,  5,  5, 10, 10,  5,  5,-10,
+        -10,  0, 10, 10, 10, 10,  0,-10,
+        -10, 10, 10, 10, 10, 10, 10,-10,
+        -10,  5,  0,  0,  0,  0,  5,-10,
+        -20,-10,-10,-10,-10,-10,-10,-20
+    };
+    const int rookTable[64] = {
+         0,  0,  0,  0,  0,  0,  0,  0,
+         5, 10, 10, 10, 10, 10, 10,  5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+        -5,  0,  0,  0,  0,  0,  0, -5,
+         0,  0,  0,  5,  5,  0,  0,  0
+    };
+    const int queenTable[64] = {
+        -20,-10,-10, -5, -5,-10,-10,-20,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -10,  0,  5,  5,  5,  5,  0,-10,
+         -5,  0,  5,  5,  5,  5,  0, -5,
+          0,  0,  5,  5,  5,  5,  0, -5,
+        -10,  5,  5,  5,  5,  5,  0,-10,
+        -10,  0,  5,  0,  0,  0,  0,-10,
+        -20,-10,-10, -5, -5,-10,-10,-20
+    };
+    const int kingMiddleGameTable[64] = {
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -20,-30,-30,-40,-40,-30,-30,-20,
+        -10,-20,-20,-20,-20,-20,-20,-10,
+         20, 20,  0,  0,  0,  0, 20, 20,
+         20, 30, 10,  0,  0, 10, 30, 20
+    };
+    const int kingEndGameTable[64] = {
+        -50,-40,-30,-20,-20,-30,-40,-50,
+        -30,-20,-10,  0,  0,-10,-20,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 30, 40, 40, 30,-10,-30,
+        -30,-10, 20, 30, 30, 20,-10,-30,
+        -30,-30,  0,  0,  0,  0,-30,-30,
+        -50,-30,-30,-30,-30,-30,-30,-50
+    };
+    const int *pieceTables[7] = { nullptr, pawnTable, knightTable, bishopTable, rookTable, queenTable, nullptr };
+    const int phaseWeights[7] = { 0, 0, 1, 1, 2, 4, 0 };
+}
+
+std::string Move::toUci() const
+{
+    std::string ret;
+    ret += static_cast<char>('a' + from() % 8);
+    ret += static_cast<char>('1' + from() / 8);
+    ret += static_cast<char>('a' + to() % 8);
+    ret += static_cast<char>('1' + to() / 8);
+    static const char promotionChars[] = " pnbrqk";
+    if (promotion() != Empty)
+        ret += promotionChars[promotion()];
+    return ret;
+}
+
+Board::Board()
+{
+    clear();
+}
+
+void Board::clear()
+{
+    std::fill(std::begin(m_squares), std::end(m_squares), static_cast<int>(Empty));
+    m_side = White;
+    m_castling = 0;
+    m_enPassant = -1;
+    m_halfMoveClock = 0;
+    m_kingSquare[White] = m_kingSquare[Black] = -1;
+    m_hash = 0;
+    m_undo.clear();
+    m_history.clear();
+}
+
+bool Board::setFen(const std::string& fen)
+{
+    clear();
+    std::istringstream stream(fen);
+    std::string placement, side, castling, enPassant;
+    int halfMoveClock = 0;
+    stream >> placement >> side >> castling >> enPassant;
+    if (!(stream >> halfMoveClock))
+        halfMoveClock = 0;
+    int row = 7, col = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            --row;
+            col = 0;
+        } else if (c >= '1' && c <= '8') {
+            col += c - '0';
+        } else {
+            static const std::string pieceChars("pnbrqk");
+            size_t index = pieceChars.find(static_cast<char>(c | 0x20));
+            if (index == std::string::npos || row < 0 || col > 7)
+                return false;
+            int piece = static_cast<int>(index) + 1;
+            m_squares[row * 8 + col] = (c >= 'a') ? -piece : piece;
+            ++col;
+        }
+    }
+    m_side = (side == "b") ? Black : White;
+    for (char c : castling) {
+        switch (c) {
+        case 'K': m_castling |= WhiteKingside; break;
+        case 'Q': m_castling |= WhiteQueenside; break;
+        case 'k': m_castling |= BlackKingside; break;
+        case 'q': m_castling |= BlackQueenside; break;
+        default: break;
+        }
+    }
+    if (enPassant.size() == 2)
+        m_enPassant = (enPassant[1] - '1') * 8 + (enPassant[0] - 'a');
+    m_halfMoveClock = halfMoveClock;
+    refresh();
+    return m_kingSquare[White] != -1 && m_kingSquare[Black] != -1;
+}
+
+void Board::setPiece(int square, int piece)
+{
+    m_squares[square] = piece;
+}
+
+void Board::setSideToMove(int side)
+{
+    m_side = side;
+}
+
+void Board::setCastlingRights(int rights)
+{
+    m_castling = rights;
+}
+
+void Board::setEnPassantSquare(int square)
+{
+    m_enPassant = square;
+}
+
+void Board::setHalfMoveClock(int halfMoveClock)
+{
+    m_halfMoveClock = halfMoveClock;
+}
+
+void Board::refresh()
+{
+    m_kingSquare[White] = m_kingSquare[Black] = -1;
+    for (int sq=0;sq<64;++sq) {
+        if (m_squares[sq] == King)
+            m_kingSquare[White] = sq;
+        else if (m_squares[sq] == -King)
+            m_kingSquare[Black] = sq;
+    }
+    computeHash();
+}
+
+void Board::addHistory(uint64_t hash)
+{
+    m_history.push_back(hash);
+}
+
+void Board::computeHash()
+{
+    const Tables& t = tables();
+    m_hash = 0;
+    for (int sq=0;sq<64;++sq) {
+        if (m_squares[sq] != Empty)
+            m_hash ^= t.pieceKeys[pieceIndex(m_squares[sq])][sq];
+    }
+    m_hash ^= t.castlingKeys[m_castling];
+    if (m_enPassant != -1)
+        m_hash ^= t.enPassantKeys[m_enPassant % 8];
+    if (m_side == Black)
+        m_hash ^= t.sideKey;
+}
+
+uint64_t Board::zobristPiece(int piece, int square)
+{
+    return tables().pieceKeys[pieceIndex(piece)][square];
+}
+
+uint64_t Board::zobristCastling(int rights)
+{
+    return tables().castlingKeys[rights];
+}
+
+uint64_t Board::zobristEnPassant(int col)
+{
+    return tables().enPassantKeys[col];
+}
+
+uint64_t Board::zobristSide()
+{
+    return tables().sideKey;
+}
+
+int Board::pieceCount() const
+{
+    int count = 0;
+    for (int sq=0;sq<64;++sq) {
+        if (m_squares[sq] != Empty)
+            ++count;
+    }
+    return count;
+}
+
+bool Board::hasNonPawnMaterial(int side) const
+{
+    for (int sq=0;sq<64;++sq) {
+        int p = m_squares[sq];
+        if (p == Empty)
+            continue;
+        if ((p > 0) != (side == White))
+            continue;
+        int type = std::abs(p);
+        if (type != Pawn && type != King)
+            return true;
+    }
+    return false;
+}
+
+bool Board::isRepetition() const
+{
+    // Only positions since the last irreversible move can repeat.
+    int count = 0;
+    for (int i=static_cast<int>(m_history.size()) - 2;i>=0 && count < m_halfMoveClock;i-=2, count+=2) {
+        if (m_history[i] == m_hash)
+            return true;
+    }
+    return false;
+}
+
+bool Board::isAttacked(int square, int bySide) const
+{
+    const Tables& t = tables();
+    const int sign = (bySide == White) ? 1 : -1;
+    const int row = square / 8, col = square % 8;
+    // Pawns attack diagonally forwards, so look backwards from the square.
+    const int pawnRow = row - sign;
+    if (pawnRow >= 0 && pawnRow < 8) {
+        if (col > 0 && m_squares[pawnRow * 8 + col - 1] == sign * Pawn)
+            return true;
+        if (col < 7 && m_squares[pawnRow * 8 + col + 1] == sign * Pawn)
+            return true;
+    }
+    for (int target : t.knightTargets[square]) {
+        if (m_squares[target] == sign * Knight)
+            return true;
+    }
+    for (int target : t.kingTargets[square]) {
+        if (m_squares[target] == sign * King)
+            return true;
+    }
+    for (const auto& d : rookDirections) {
+        int r = row + d[0], c = col + d[1];
+        while (r >= 0 && r < 8 && c >= 0 && c < 8) {
+            int p = m_squares[r * 8 + c];
+            if (p != Empty) {
+                if (p == sign * Rook || p == sign * Queen)
+                    return true;
+                break;
+            }
+            r += d[0];
+            c += d[1];
+        }
+    }
+    for (const auto& d : bishopDirections) {
+        int r = row + d[0], c = col + d[1];
+        while (r >= 0 && r < 8 && c >= 0 && c < 8) {
+            int p = m_squares[r * 8 + c];
+            if (p != Empty) {
+                if (p == sign * Bishop || p == sign * Queen)
+                    return true;
+                break;
+            }
+            r += d[0];
+            c += d[1];
+        }
+    }
+    return false;
+}
+
+void Board::addPawnMoves(std::vector<Move>& moves, int from, int to, int flags) const
+{
+    const int row = to / 8;
+    if (row == 0 || row == 7) {
+        moves.emplace_back(from, to, Queen, flags);
+        moves.emplace_back(from, to, Rook, flags);
+        moves.emplace_back(from, to, Bishop, flags);
+        moves.emplace_back(from, to, Knight, flags);
+    } else {
+        moves.emplace_back(from, to, Empty, flags);
+    }
+}
+
+void Board::generateMoves(std::vector<Move>& moves, bool capturesOnly) const
+{
+    const Tables& t = tables();
+    const int sign = (m_side == White) ? 1 : -1;
+    for (int from=0;from<64;++from) {
+        const int p = m_squares[from] * sign;
+        if (p <= 0)
+            continue;
+        const int row = from / 8, col = from % 8;
+        switch (p) {
+        case Pawn: {
+            const int forward = row + sign;
+            if (forward < 0 || forward > 7)
+                break;
+            const int to = forward * 8 + col;
+            const bool promotion = forward == 0 || forward == 7;
+            if (m_squares[to] == Empty && (!capturesOnly || promotion)) {
+                addPawnMoves(moves, from, to, 0);
+                const int startRow = (m_side == White) ? 1 : 6;
+                const int to2 = to + 8 * sign;
+                if (row == startRow && !capturesOnly && m_squares[to2] == Empty)
+                    moves.emplace_back(from, to2, Empty, Move::DoublePush);
+            }
+            for (int dc = -1; dc <= 1; dc += 2) {
+                const int c = col + dc;
+                if (c < 0 || c > 7)
+                    continue;
+                const int target = forward * 8 + c;
+                if (m_squares[target] * sign < 0)
+                    addPawnMoves(moves, from, target, Move::Capture);
+                else if (target == m_enPassant)
+                    moves.emplace_back(from, target, Empty, Move::Capture | Move::EnPassant);
+            }
+            break;
+        }
+        case Knight:
+        case King: {
+            const std::vector<int>& targets = (p == Knight) ? t.knightTargets[from] : t.kingTargets[from];
+            for (int to : targets) {
+                const int target = m_squares[to] * sign;
+                if (target > 0)
+                    continue;
+                if (target < 0)
+                    moves.emplace_back(from, to, Empty, Move::Capture);
+                else if (!capturesOnly)
+                    moves.emplace_back(from, to, Empty, 0);
+            }
+            if (p == King && !capturesOnly) {
+                const int base = (m_side == White) ? 0 : 56;
+                const int kingside = (m_side == White) ? WhiteKingside : BlackKingside;
+                const int queenside = (m_side == White) ? WhiteQueenside : BlackQueenside;
+                const int them = m_side ^ 1;
+                if (from == base + 4) {
+                    if ((m_castling & kingside) &&
+                        m_squares[base + 7] == sign * Rook &&
+                        m_squares[base + 5] == Empty && m_squares[base + 6] == Empty &&
+                        !isAttacked(base + 4, them) && !isAttacked(base + 5, them) && !isAttacked(base + 6, them))
+                        moves.emplace_back(from, base + 6, Empty, Move::Castle);
+                    if ((m_castling & queenside) &&
+                        m_squares[base] == sign * Rook &&
+                        m_squares[base + 3] == Empty && m_squares[base + 2] == Empty && m_squares[base + 1] == Empty &&
+                        !isAttacked(base + 4, them) && !isAttacked(base + 3, them) && !isAttacked(base + 2, them))
+                        moves.emplace_back(from, base + 2, Empty, Move::Castle);
+                }
+            }
+            break;
+        }
+        default: {
+            const bool diagonal = p == Bishop || p == Queen;
+            const bool straight = p == Rook || p == Queen;
+            for (int dir=0;dir<8;++dir) {
+                const int *d = (dir < 4) ? rookDirections[dir] : bishopDirections[dir - 4];
+                if ((dir < 4 && !straight) || (dir >= 4 && !diagonal))
+                    continue;
+                int r = row + d[0], c = col + d[1];
+                while (r >= 0 && r < 8 && c >= 0 && c < 8) {
+                    const int to = r * 8 + c;
+                    const int target = m_squares[to] * sign;
+                    if (target > 0)
+                        break;
+                    if (target < 0) {
+                        moves.emplace_back(from, to, Empty, Move::Capture);
+                        break;
+                    }
+                    if (!capturesOnly)
+                        moves.emplace_back(from, to, Empty, 0);
+                    r += d[0];
+                    c += d[1];
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+std::vector<Move> Board::legalMoves()
+{
+    std::vector<Move> pseudoLegal, ret;
+    pseudoLegal.reserve(64);
+    generateMoves(pseudoLegal);
+    for (const Move& move : pseudoLegal) {
+        if (makeMove(move)) {
+            unmakeMove();
+            ret.push_back(move);
+        }
+    }
+    return ret;
+}
+
+bool Board::makeMove(const Move& move)
+{
+    const Tables& t = tables();
+    const int from = move.from(), to = move.to();
+    const int piece = m_squares[from];
+    const int sign = (m_side == White) ? 1 : -1;
+    Undo undo;
+    undo.move = move;
+    undo.captured = m_squares[to];
+    undo.castling = m_castling;
+    undo.enPassant = m_enPassant;
+    undo.halfMoveClock = m_halfMoveClock;
+    undo.hash = m_hash;
+    m_history.push_back(m_hash);
+
+    if (m_enPassant != -1)
+        m_hash ^= t.enPassantKeys[m_enPassant % 8];
+    m_enPassant = -1;
+
+    if (move.flags() & Move::EnPassant) {
+        const int capturedSquare = to - 8 * sign;
+        undo.captured = m_squares[capturedSquare];
+        m_hash ^= t.pieceKeys[pieceIndex(m_squares[capturedSquare])][capturedSquare];
+        m_squares[capturedSquare] = Empty;
+    } else if (undo.captured != Empty) {
+        m_hash ^= t.pieceKeys[pieceIndex(undo.captured)][to];
+    }
+
+    m_hash ^= t.pieceKeys[pieceIndex(piece)][from];
+    m_squares[from] = Empty;
+    const int placed = (move.promotion() != Empty) ? sign * move.promotion() : piece;
+    m_squares[to] = placed;
+    m_hash ^= t.pieceKeys[pieceIndex(placed)][to];
+
+    if (move.flags() & Move::Castle) {
+        const int rookFrom = (to % 8 == 6) ? to + 1 : to - 2;
+        const int rookTo = (to % 8 == 6) ? to - 1 : to + 1;
+        const int rook = m_squares[rookFrom];
+        m_squares[rookFrom] = Empty;
+        m_squares[rookTo] = rook;
+        m_hash ^= t.pieceKeys[pieceIndex(rook)][rookFrom] ^ t.pieceKeys[pieceIndex(rook)][rookTo];
+    }
+    if (std::abs(piece) == King)
+        m_kingSquare[m_side] = to;
+
+    m_hash ^= t.castlingKeys[m_castling];
+    m_castling &= t.castlingMask[from] & t.castlingMask[to];
+    m_hash ^= t.castlingKeys[m_castling];
+
+    if (move.flags() & Move::DoublePush) {
+        m_enPassant = from + 8 * sign;
+        m_hash ^= t.enPassantKeys[m_enPassant % 8];
+    }
+
+    if (std::abs(piece) == Pawn || undo.captured != Empty)
+        m_halfMoveClock = 0;
+    else
+        ++m_halfMoveClock;
+
+    m_side ^= 1;
+    m_hash ^= t.sideKey;
+    m_undo.push_back(undo);
+
+    if (isAttacked(m_kingSquare[m_side ^ 1], m_side)) {
+        unmakeMove();
+        return false;
+    }
+    return true;
+}
+
+void Board::unmakeMove()
+{
+    const Undo undo = m_undo.back();
+    m_undo.pop_back();
+    m_history.pop_back();
+    m_side ^= 1;
+    const Move& move = undo.move;
+    const int from = move.from(), to = move.to();
+    const int sign = (m_side == White) ? 1 : -1;
+    const int piece = (move.promotion() != Empty) ? sign * Pawn : m_squares[to];
+    m_squares[from] = piece;
+    if (move.flags() & Move::EnPassant) {
+        m_squares[to] = Empty;
+        m_squares[to - 8 * sign] = undo.captured;
+    } else {
+        m_squares[to] = undo.captured;
+    }
+    if (move.flags() & Move::Castle) {
+        const int rookFrom = (to % 8 == 6) ? to + 1 : to - 2;
+        const int rookTo = (to % 8 == 6) ? to - 1 : to + 1;
+        m_squares[rookFrom] = m_squares[rookTo];
+        m_squares[rookTo] = Empty;
+    }
+    if (std::abs(piece) == King)
+        m_kingSquare[m_side] = from;
+    m_castling = undo.castling;
+    m_enPassant = undo.enPassant;
+    m_halfMoveClock = undo.halfMoveClock;
+    m_hash = undo.hash;
+}
+
+void Board::makeNullMove()
+{
+    const Tables& t = tables();
+    Undo undo;
+    undo.captured = Empty;
+    undo.castling = m_castling;
+    undo.enPassant = m_enPassant;
+    undo.halfMoveClock = m_halfMoveClock;
+    undo.hash = m_hash;
+    m_undo.push_back(undo);
+    m_history.push_back(m_hash);
+    if (m_enPassant != -1)
+        m_hash ^= t.enPassantKeys[m_enPassant % 8];
+    m_enPassant = -1;
+    ++m_halfMoveClock;
+    m_side ^= 1;
+    m_hash ^= t.sideKey;
+}
+
+void Board::unmakeNullMove()
+{
+    const Undo undo = m_undo.back();
+    m_undo.pop_back();
+    m_history.pop_back();
+    m_side ^= 1;
+    m_enPassant = undo.enPassant;
+    m_halfMoveClock = undo.halfMoveClock;
+    m_hash = undo.hash;
+}
+
+int Board::evaluate() const
+{
+    int score = 0;
+    int phase = 0;
+    int bishops[2] = { 0, 0 };
+    for (int sq=0;sq<64;++sq) {
+        const int p = m_squares[sq];
+        if (p == Empty)
+            continue;
+        const int type = std::abs(p);
+        phase += phaseWeights[type];
+        if (type == Bishop)
+            bishops[p > 0 ? White : Black]++;
+        if (type == King)
+            continue;
+        const int index = (p > 0) ? (7 - sq / 8) * 8 + sq % 8 : sq;
+        const int value = pieceValues[type] + pieceTables[type][index];
+        score += (p > 0) ? value : -value;
+    }
+    phase = std::min(phase, 24);
+    for (int side=White;side<=Black;++side) {
+        const int sq = m_kingSquare[side];
+        if (sq == -1)
+            continue;
+        const int index = (side == White) ? (7 - sq / 8) * 8 + sq % 8 : sq;
+        const int value = (kingMiddleGameTable[index] * phase + kingEndGameTable[index] * (24 - phase)) / 24;
+        score += (side == White) ? value : -value;
+    }
+    if (bishops[White] >= 2)
+        score += 30;
+    if (bishops[Black] >= 2)
+        score -= 30;
+    return (m_side == White) ? score : -score;
+}
+
+uint64_t perft(Board& board, int depth)
+{
+    if (depth == 0)
+        return 1;
+    std::vector<Move> moves;
+    moves.reserve(64);
+    board.generateMoves(moves);
+    uint64_t nodes = 0;
+    for (const Move& move : moves) {
+        if (!board.makeMove(move))
+            continue;
+        nodes += perft(board, depth - 1);
+        board.unmakeMove();
+    }
+    return nodes;
+}
+
+Search::Search(int hashSizeMb)
+{
+    resize(hashSizeMb);
+}
+
+void Search::resize(int hashSizeMb)
+{
+    size_t entries = static_cast<size_t>(std::max(1, hashSizeMb)) * 1024 * 1024 / sizeof(TtEntry);
+    size_t size = 1;
+    while (size * 2 <= entries)
+        size *= 2;
+    m_table.assign(size, TtEntry());
+    clear();
+}
+
+void Search::clear()
+{
+    std::fill(m_table.begin(), m_table.end(), TtEntry { 0, 0, 0, 0, NoBound });
+    for (auto& killers : m_killers)
+        killers[0] = killers[1] = Move();
+    std::memset(m_historyTable, 0, sizeof(m_historyTable));
+}
+
+Search::TtEntry *Search::probe(uint64_t key)
+{
+    TtEntry *entry = &m_table[key & (m_table.size() - 1)];
+    return (entry->key == key && entry->bound != NoBound) ? entry : nullptr;
+}
+
+void Search::store(uint64_t key, int depth, int score, int bound, const Move& move, int ply)
+{
+    TtEntry *entry = &m_table[key & (m_table.size() - 1)];
+    if (entry->key == key && entry->depth > depth && bound != ExactBound)
+        return;
+    // Mate scores are stored relative to the node, not the root.
+    if (score > MateThreshold)
+        score += ply;
+    else if (score < -MateThreshold)
+        score -= ply;
+    entry->key = key;
+    entry->move = move.value();
+    entry->score = static_cast<int16_t>(score);
+    entry->depth = static_cast<int8_t>(std::min(depth, 127));
+    entry->bound = static_cast<uint8_t>(bound);
+}
+
+void Search::startClock(const SearchLimits& limits)
+{
+    m_limits = limits;
+    m_startTime = std::chrono::steady_clock::now();
+    m_nodes = 0;
+    m_stopped = false;
+}
+
+bool Search::checkStop()
+{
+    if (m_stopped)
+        return true;
+    if ((m_nodes & 1023) != 0)
+        return false;
+    if (m_limits.maxNodes > 0 && m_nodes >= m_limits.maxNodes)
+        m_stopped = true;
+    else if (m_limits.moveTime > 0 &&
+             std::chrono::steady_clock::now() - m_startTime >= std::chrono::milliseconds(m_limits.moveTime))
+        m_stopped = true;
+    else if (m_limits.stopRequested && m_limits.stopRequested())
+        m_stopped = true;
+    return m_stopped;
+}
+
+int Search::evaluate(const Board& board) const
+{
+    int score = board.evaluate();
+    if (m_limits.noise > 0) {
+        // Deterministic per position so that transpositions agree.
+        uint64_t state = board.hash() ^ m_limits.noiseSeed;
+        const uint64_t r = splitMix64(state);
+        score += static_cast<int>(r % static_cast<uint64_t>(2 * m_limits.noise + 1)) - m_limits.noise;
+    }
+    return score;
+}
+
+void Search::orderMoves(const Board& board, std::vector<Move>& moves, std::vector<int>& scores, const Move& ttMove, int ply) const
+{
+    scores.resize(moves.size());
+    const int side = board.sideToMove();
+    for (size_t i=0;i<moves.size();++i) {
+        const Move& move = moves[i];
+        int score;
+        if (move == ttMove) {
+            score = 10000000;
+        } else if (move.isCapture()) {
+            // Most valuable victim, least valuable attacker.
+            const int victim = (move.flags() & Move::EnPassant) ? Pawn : std::abs(board.piece(move.to()));
+            const int attacker = std::abs(board.piece(move.from()));
+            score = 1000000 + victim * 100 - attacker;
+        } else if (move.promotion() == Queen) {
+            score = 900000;
+        } else if (ply < MaxPly && move == m_killers[ply][0]) {
+            score = 800000;
+        } else if (ply < MaxPly && move == m_killers[ply][1]) {
+            score = 700000;
+        } else {
+            score = std::min(m_historyTable[side][move.from()][move.to()], 600000);
+        }
+        scores[i] = score;
+    }
+}
+
+namespace {
+    void pickMove(std::vector<Move>& moves, std::vector<int>& scores, size_t index)
+    {
+        size_t best = index;
+        for (size_t i=index + 1;i<moves.size();++i) {
+            if (scores[i] > scores[best])
+                best = i;
+        }
+        if (best != index) {
+            std::swap(moves[index], moves[best]);
+            std::swap(scores[index], scores[best]);
+        }
+    }
+}
+
+int Search::quiescence(Board& board, int alpha, int beta, int ply)
+{
+    ++m_nodes;
+    if (checkStop())
+        return 0;
+    if (ply >= MaxPly - 1)
+        return evaluate(board);
+    const int standPat = evaluate(board);
+    if (standPat >= beta)
+        return standPat;
+    if (standPat > alpha)
+        alpha = standPat;
+    std::vector<Move> moves;
+    std::vector<int> scores;
+    moves.reserve(32);
+    board.generateMoves(moves, true);
+    orderMoves(board, moves, scores, Move(), MaxPly);
+    for (size_t i=0;i<moves.size();++i) {
+        pickMove(moves, scores, i);
+        if (!board.makeMove(moves[i]))
+            continue;
+        const int score = -quiescence(board, -beta, -alpha, ply + 1);
+        board.unmakeMove();
+        if (m_stopped)
+            return 0;
+        if (score >= beta)
+            return score;
+        if (score > alpha)
+            alpha = score;
+    }
+    return alpha;
+}
+
+int Search::negamax(Board& board, int depth, int alpha, int beta, int ply, bool allowNull)
+{
+    m_pvLength[ply] = ply;
+    if (ply > 0 && (board.halfMoveClock() >= 100 || board.isRepetition()))
+        return 0;
+    const bool inCheck = board.inCheck();
+    if (inCheck)
+        ++depth;
+    if (depth <= 0 || ply >= MaxPly - 1)
+        return quiescence(board, alpha, beta, ply);
+    ++m_nodes;
+    if (checkStop())
+        return 0;
+
+    const bool pvNode = beta - alpha > 1;
+    Move ttMove;
+    if (TtEntry *entry = probe(board.hash())) {
+        ttMove = Move::fromValue(entry->move);
+        if (!pvNode && ply > 0 && entry->depth >= depth) {
+            int score = entry->score;
+            if (score > MateThreshold)
+                score -= ply;
+            else if (score < -MateThreshold)
+                score += ply;
+            if (entry->bound == ExactBound ||
+                (entry->bound == LowerBound && score >= beta) ||
+                (entry->bound == UpperBound && score <= alpha))
+                return score;
+        }
+    }
+
+    if (allowNull && !pvNode && !inCheck && depth >= 3 && ply > 0 &&
+        board.hasNonPawnMaterial(board.sideToMove()) && evaluate(board) >= beta) {
+        board.makeNullMove();
+        const int score = -negamax(board, depth - 3, -beta, -beta + 1, ply + 1, false);
+        board.unmakeNullMove();
+        if (m_stopped)
+            return 0;
+        if (score >= beta && score < MateThreshold)
+            return beta;
+    }
+
+    std::vector<Move> moves;
+    std::vector<int> scores;
+    moves.reserve(64);
+    board.generateMoves(moves);
+    orderMoves(board, moves, scores, ttMove, ply);
+
+    const int originalAlpha = alpha;
+    int bestScore = -InfiniteScore;
+    Move bestMove;
+    int legalMoves = 0;
+    for (size_t i=0;i<moves.size();++i) {
+        pickMove(moves, scores, i);
+        const Move move = moves[i];
+        if (!board.makeMove(move))
+            continue;
+        ++legalMoves;
+        int score;
+        if (legalMoves == 1) {
+            score = -negamax(board, depth - 1, -beta, -alpha, ply + 1, true);
+        } else {
+            // Late move reductions for quiet moves that do not give check.
+            int reduction = 0;
+            if (depth >= 3 && legalMoves > 4 && !inCheck && !move.isCapture() &&
+                move.promotion() == Empty && !board.inCheck())
+                reduction = 1;
+            score = -negamax(board, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, true);
+            if (score > alpha && (reduction > 0 || score < beta))
+                score = -negamax(board, depth - 1, -beta, -alpha, ply + 1, true);
+        }
+        board.unmakeMove();
+        if (m_stopped)
+            return 0;
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = move;
+            if (score > alpha) {
+                alpha = score;
+                m_pv[ply][ply] = move;
+                for (int j=ply + 1;j<m_pvLength[ply + 1];++j)
+                    m_pv[ply][j] = m_pv[ply + 1][j];
+                m_pvLength[ply] = m_pvLength[ply + 1];
+                if (score >= beta) {
+                    if (!move.isCapture() && move.promotion() == Empty) {
+                        if (m_killers[ply][0] != move) {
+                            m_killers[ply][1] = m_killers[ply][0];
+                            m_killers[ply][0] = move;
+                        }
+                        m_historyTable[board.sideToMove()][move.from()][move.to()] += depth * depth;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    if (legalMoves == 0)
+        return inCheck ? -MateScore + ply : 0;
+    const int bound = (bestScore >= beta) ? LowerBound :
+                      (bestScore > originalAlpha) ? ExactBound : UpperBound;
+    store(board.hash(), depth, bestScore, bound, bestMove, ply);
+    return bestScore;
+}
+
+SearchResult Search::search(Board& board, const SearchLimits& limits,
+                            const std::function<void(const SearchResult&)>& iterationFinished)
+{
+    startClock(limits);
+    SearchResult result;
+    const std::vector<Move> rootMoves = board.legalMoves();
+    if (rootMoves.empty())
+        return result;
+    result.bestMove = rootMoves.front();
+    for (int depth=1;depth<=std::min(limits.maxDepth, MaxPly - 1);++depth) {
+        const int score = negamax(board, depth, -InfiniteScore, InfiniteScore, 0, false);
+        if (m_stopped)
+            break;
+        result.score = score;
+        result.depth = depth;
+        result.nodes = m_nodes;
+        result.pv.assign(m_pv[0], m_pv[0] + m_pvLength[0]);
+        if (!result.pv.empty())
+            result.bestMove = result.pv.front();
+        if (iterationFinished)
+            iterationFinished(result);
+        if (rootMoves.size() == 1 || std::abs(score) > MateThreshold)
+            break;
+        // The next iteration is unlikely to finish in the remaining time.
+        if (limits.moveTime > 0 &&
+            std::chrono::steady_clock::now() - m_startTime >= std::chrono::milliseconds(limits.moveTime / 2))
+            break;
+    }
+    result.nodes = m_nodes;
+    return result;
+}
+
+std::vector<int> Search::scoreMoves(Board& board, const std::vector<Move>& rootMoves, const SearchLimits& limits,
+                                    const std::function<void(int depth, const std::vector<int>& scores)>& iterationFinished)
+{
+    startClock(limits);
+    std::vector<int> result(rootMoves.size(), 0);
+    std::vector<int> scores(rootMoves.size(), 0);
+    for (int depth=1;depth<=std::min(limits.maxDepth, MaxPly - 1);++depth) {
+        for (size_t i=0;i<rootMoves.size();++i) {
+            if (!board.makeMove(rootMoves[i])) {
+                scores[i] = -InfiniteScore;
+                continue;
+            }
+            scores[i] = -negamax(board, depth - 1, -InfiniteScore, InfiniteScore, 1, true);
+            board.unmakeMove();
+            if (m_stopped)
+                break;
+        }
+        if (m_stopped)
+            break;
+        result = scores;
+        if (iterationFinished)
+            iterationFinished(depth, result);
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,235 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef NATIVEENGINE_H
+#define NATIVEENGINE_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Compact board representation and alpha-beta search used by
+// NativeAiPlayer. Squares are numbered row * 8 + col with row 0 being
+// rank 1 and col 0 being file a, the same as Chessboard::Square.
+// Pieces are stored as signed piece types: positive for white and
+// negative for black.
+
+namespace NativeEngine {
+
+enum PieceType {
+    Empty = 0,
+    Pawn = 1,
+    Knight = 2,
+    Bishop = 3,
+    Rook = 4,
+    Queen = 5,
+    King = 6
+};
+
+enum Side {
+    White = 0,
+    Black = 1
+};
+
+enum CastlingRights {
+    WhiteKingside = 1,
+    WhiteQueenside = 2,
+    BlackKingside = 4,
+    BlackQueenside = 8
+};
+
+const int MateScore = 32000;
+const int MateThreshold = MateScore - 1000;
+const int InfiniteScore = 32767;
+
+class Move
+{
+public:
+    enum Flags {
+        Capture = 1,
+        EnPassant = 2,
+        Castle = 4,
+        DoublePush = 8
+    };
+
+    Move() : m_value(0) {}
+    Move(int from, int to, int promotion = Empty, int flags = 0) :
+        m_value(static_cast<uint32_t>(from | (to << 6) | (promotion << 12) | (flags << 15))) {}
+
+    int from() const { return m_value & 0x3f; }
+    int to() const { return (m_value >> 6) & 0x3f; }
+    int promotion() const { return (m_value >> 12) & 0x7; }
+    int flags() const { return (m_value >> 15) & 0xf; }
+    bool isCapture() const { return flags() & Capture; }
+    bool isNull() const { return m_value == 0; }
+    uint32_t value() const { return m_value; }
+    static Move fromValue(uint32_t value) { Move m; m.m_value = value; return m; }
+    bool operator==(const Move& other) const { return m_value == other.m_value; }
+    bool operator!=(const Move& other) const { return m_value != other.m_value; }
+    std::string toUci() const;
+
+private:
+    uint32_t m_value;
+};
+
+class Board
+{
+public:
+    Board();
+
+    void clear();
+    bool setFen(const std::string& fen);
+    void setPiece(int square, int piece);
+    void setSideToMove(int side);
+    void setCastlingRights(int rights);
+    void setEnPassantSquare(int square);
+    void setHalfMoveClock(int halfMoveClock);
+    // Must be called after the position has been set up piece by piece.
+    void refresh();
+    void addHistory(uint64_t hash);
+
+    int piece(int square) const { return m_squares[square]; }
+    int sideToMove() const { return m_side; }
+    int castlingRights() const { return m_castling; }
+    int enPassantSquare() const { return m_enPassant; }
+    int halfMoveClock() const { return m_halfMoveClock; }
+    uint64_t hash() const { return m_hash; }
+    int pieceCount() const;
+
+    bool isAttacked(int square, int bySide) const;
+    bool inCheck() const { return isAttacked(m_kingSquare[m_side], m_side ^ 1); }
+    bool hasNonPawnMaterial(int side) const;
+    bool isRepetition() const;
+
+    // Pseudo-legal moves; makeMove() rejects those leaving the king in check.
+    void generateMoves(std::vector<Move>& moves, bool capturesOnly = false) const;
+    std::vector<Move> legalMoves();
+    bool makeMove(const Move& move);
+    void unmakeMove();
+    void makeNullMove();
+    void unmakeNullMove();
+
+    int evaluate() const;
+
+    static uint64_t zobristPiece(int piece, int square);
+    static uint64_t zobristCastling(int rights);
+    static uint64_t zobristEnPassant(int col);
+    static uint64_t zobristSide();
+
+private:
+    struct Undo {
+        Move move;
+        int captured;
+        int castling;
+        int enPassant;
+        int halfMoveClock;
+        uint64_t hash;
+    };
+
+    void addPawnMoves(std::vector<Move>& moves, int from, int to, int flags) const;
+    void computeHash();
+
+    int m_squares[64];
+    int m_side;
+    int m_castling;
+    int m_enPassant;
+    int m_halfMoveClock;
+    int m_kingSquare[2];
+    uint64_t m_hash;
+    std::vector<Undo> m_undo;
+    std::vector<uint64_t> m_history;
+};
+
+uint64_t perft(Board& board, int depth);
+
+struct SearchLimits {
+    int maxDepth {64};
+    int64_t maxNodes {0};
+    int moveTime {0};
+    // Evaluation noise in centipawns used to weaken the engine.
+    int noise {0};
+    uint64_t noiseSeed {0};
+    std::function<bool()> stopRequested;
+};
+
+struct SearchResult {
+    Move bestMove;
+    int score {0};
+    int depth {0};
+    int64_t nodes {0};
+    std::vector<Move> pv;
+};
+
+class Search
+{
+public:
+    explicit Search(int hashSizeMb = 16);
+
+    SearchResult search(Board& board, const SearchLimits& limits,
+                        const std::function<void(const SearchResult&)>& iterationFinished = {});
+    // Scores every move in rootMoves from the point of view of the side to
+    // move, deepening until the limits are reached. iterationFinished is
+    // called with the scores for every completed depth.
+    std::vector<int> scoreMoves(Board& board, const std::vector<Move>& rootMoves, const SearchLimits& limits,
+                                const std::function<void(int depth, const std::vector<int>& scores)>& iterationFinished = {});
+    void clear();
+    void resize(int hashSizeMb);
+
+private:
+    struct TtEntry {
+        uint64_t key;
+        uint32_t move;
+        int16_t score;
+        int8_t depth;
+        uint8_t bound;
+    };
+
+    enum Bound {
+        NoBound,
+        UpperBound,
+        LowerBound,
+        ExactBound
+    };
+
+    static const int MaxPly = 128;
+
+    int negamax(Board& board, int depth, int alpha, int beta, int ply, bool allowNull);
+    int quiescence(Board& board, int alpha, int beta, int ply);
+    int evaluate(const Board& board) const;
+    void orderMoves(const Board& board, std::vector<Move>& moves, std::vector<int>& scores, const Move& ttMove, int ply) const;
+    bool checkStop();
+    void startClock(const SearchLimits& limits);
+    TtEntry *probe(uint64_t key);
+    void store(uint64_t key, int depth, int score, int bound, const Move& move, int ply);
+
+    std::vector<TtEntry> m_table;
+    Move m_killers[MaxPly][2];
+    int m_historyTable[2][64][64];
+    Move m_pv[MaxPly][MaxPly];
+    int m_pvLength[MaxPly];
+    SearchLimits m_limits;
+    std::chrono::steady_clock::time_point m_startTime;
+    int64_t m_nodes {0};
+    bool m_stopped {false};
+};
+
+}
+
+#endif // NATIVEENGINE_H
@@ -0,0 +1,115 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free queue for exactly one producer thread and one
+// consumer thread. The consumer always owns a dummy head node; the
+// producer only ever touches the tail, so the two threads never write to
+// the same node. Consumed nodes are kept on a free list that the producer
+// reuses, which avoids an allocation per item once the queue has warmed up.
+template<typename T>
+class SpscQueue
+{
+public:
+    SpscQueue()
+    {
+        Node *node = new Node;
+        m_head = m_tail = m_first = m_headCopy = node;
+    }
+
+    ~SpscQueue()
+    {
+        Node *node = m_first;
+        while (node) {
+            Node *next = node->next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only.
+    void push(T value)
+    {
+        Node *node = allocateNode();
+        node->value = std::move(value);
+        node->next.store(nullptr, std::memory_order_relaxed);
+        m_tail->next.store(node, std::memory_order_release);
+        m_tail = node;
+    }
+
+    // Consumer only.
+    bool pop(T *value)
+    {
+        Node *head = m_head.load(std::memory_order_relaxed);
+        Node *next = head->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+        *value = std::move(next->value);
+        next->value = T();
+        m_head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.
+    bool isEmpty() const
+    {
+        return m_head.load(std::memory_order_relaxed)->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node *> next {nullptr};
+        T value {};
+    };
+
+    Node *allocateNode()
+    {
+        // Nodes before the consumer's head have been consumed and can be
+        // recycled. m_headCopy caches the head to avoid touching the
+        // consumer's cache line on every push.
+        if (m_first != m_headCopy) {
+            Node *node = m_first;
+            m_first = m_first->next.load(std::memory_order_relaxed);
+            return node;
+        }
+        m_headCopy = m_head.load(std::memory_order_acquire);
+        if (m_first != m_headCopy) {
+            Node *node = m_first;
+            m_first = m_first->next.load(std::memory_order_relaxed);
+            return node;
+        }
+        return new Node;
+    }
+
+    // Consumer side.
+    alignas(64) std::atomic<Node *> m_head;
+    // Producer side.
+    alignas(64) Node *m_tail;
+    Node *m_first;
+    Node *m_headCopy;
+};
+
+#endif // SPSCQUEUE_H
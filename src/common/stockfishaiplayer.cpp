@@ -16,9 +16,13 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <QDeadlineTimer>
 #include <QFile>
 #include <QThread>
+#include <algorithm>
+#include "assistance.h"
 #include "stockfishaiplayer.h"
+#include "timemanager.h"
 
 namespace {
     QByteArray section(const QByteArray& line, int index)
@@ -39,6 +43,29 @@ namespace {
         }
         return line.mid(start, end - start);
     }
+
+    QByteArray moveString(const QPair<Chessboard::Square, Chessboard::Square>& move)
+    {
+        return move.first.toString().toLatin1() + move.second.toString().toLatin1();
+    }
+
+    // Total time in milliseconds shared between all the legal moves in each
+    // assistance pass. The first pass is a very shallow search so that the
+    // board can light up almost immediately; later passes refine the hints.
+    const int assistancePassBudgets[] = { 0, 100, 400 };
+    const int assistancePassCount = sizeof(assistancePassBudgets) / sizeof(assistancePassBudgets[0]);
+
+    int assistanceTimePerMove(int pass, int moveCount)
+    {
+        return qMax(1, assistancePassBudgets[pass] / moveCount);
+    }
+
+    // Once the root is in the tablebases the engine ranks the moves by
+    // probing, so a longer search cannot find a better one.
+    const int tablebaseMoveTime = 50;
+
+    const int engineResponseTimeout = 30000;
+    const int cancellationPollInterval = 5;
 }
 
 StockfishAiPlayer::StockfishAiPlayer(Chessboard::Colour colour, const QString& stockfishPath, QObject *parent) :
@@ -50,6 +77,7 @@ StockfishAiPlayer::StockfishAiPlayer(Chessboard::Colour colour, const QString& s
 StockfishAiPlayer::~StockfishAiPlayer()
 {
     if (m_process && m_process->processId() != 0) {
+        disconnect(m_process, &QProcess::finished, this, &StockfishAiPlayer::engineFinished);
         QThread *processKillerThread = new QThread;
         m_process->setParent(nullptr);
         m_process->moveToThread(processKillerThread);
@@ -74,6 +102,10 @@ bool StockfishAiPlayer::initialize()
         emit error(EngineNotFound);
         return false;
     }
+    // A previous engine that crashed.
+    const bool restart = m_process != nullptr;
+    if (m_process)
+        m_process->deleteLater();
     m_process = new QProcess(this);
     connect(m_process, &QProcess::readyRead, this, &StockfishAiPlayer::readyReadFromEngine);
     m_process->start(m_stockfishPath);
@@ -86,7 +118,22 @@ bool StockfishAiPlayer::initialize()
         emit error(EngineNoBoot);
         return false;
     }
-    sendCommand("setoption name OwnBook value true");
+    // An engine that never booted is not started again.
+    connect(m_process, &QProcess::finished, this, &StockfishAiPlayer::engineFinished);
+    // A new engine starts from its defaults, so give it back the options
+    // the old one was set up with.
+    if (restart) {
+        if (m_limitStrength) {
+            sendCommand("setoption name UCI_LimitStrength value true");
+            sendCommand("setoption name UCI_Elo value " + QByteArray::number(m_elo));
+        }
+        if (m_resources != EngineResources()) {
+            sendCommand("setoption name Threads value " + QByteArray::number(m_resources.threads));
+            sendCommand("setoption name Hash value " + QByteArray::number(m_resources.hash));
+        }
+        if (tablebases() && !tablebases()->path().isEmpty())
+            sendCommand("setoption name SyzygyPath value " + QFile::encodeName(tablebases()->path()));
+    }
     return true;
 }
 
@@ -113,15 +160,43 @@ void StockfishAiPlayer::readyReadFromEngine()
     }
 }
 
+// The engine only exits of its own accord if it crashes. The next command
+// starts a new one.
+void StockfishAiPlayer::engineFinished()
+{
+    qWarning("StockfishAiPlayer::engineFinished: engine exited with code %d", m_process->exitCode());
+    m_initialized = false;
+    // Searches in progress will never be answered.
+    m_outstandingSearches = 0;
+    m_staleSearches = 0;
+    // A request waiting on the engine reports the failure itself.
+    if (!m_waitingForResponse)
+        emit error(EngineCrashed);
+}
+
 QByteArray StockfishAiPlayer::waitForResponse(const QByteArray& response)
 {
     m_waitingForResponse = true;
-    while (!isCancelled()) {
-        if (!m_process->waitForReadyRead()) {
-            qDebug("StockfishAiPlayer::waitForResponse: waitForReadyRead timed out");
+    const CancellationToken token = cancellationToken();
+    QDeadlineTimer responseTimer(engineResponseTimeout);
+    while (!token.isStopRequested()) {
+        // engineFinished() leaves a crash while waiting to be reported here.
+        if (m_process->state() == QProcess::NotRunning) {
+            qDebug("StockfishAiPlayer::waitForResponse: engine exited");
+            m_waitingForResponse = false;
+            emit error(EngineCrashed);
+            return QByteArray();
+        }
+        if (responseTimer.hasExpired()) {
+            qDebug("StockfishAiPlayer::waitForResponse: timed out");
+            m_waitingForResponse = false;
             emit error(EngineTimedOut);
             return QByteArray();
         }
+        // Wake up regularly so that a cancelled or expired request does
+        // not have to wait for the engine to answer.
+        if (!m_process->waitForReadyRead(cancellationPollInterval))
+            continue;
         while (m_process->canReadLine()) {
             QByteArray line = m_process->readLine();
             line = line.simplified();
@@ -141,10 +216,23 @@ void StockfishAiPlayer::processResponse(const QByteArray& response)
     qDebug("processResponse: %s", response.constData());
     QByteArray command = section(response, 0);
     if (command == "bestmove") {
+        if (m_outstandingSearches > 0)
+            --m_outstandingSearches;
+        if (m_staleSearches > 0) {
+            // Result of a search that was stopped or superseded.
+            --m_staleSearches;
+            return;
+        }
         QByteArray move = section(response, 1);
-        if (m_assistanceMode) {
-            if (m_currentMove.isEmpty())
+        if (m_analysisMode) {
+            m_analysisMode = false;
+            m_analysis.bestMove = QString::fromLatin1(move);
+            emit analysis(m_analysis);
+        } else if (m_assistanceMode) {
+            if (m_currentIndex == -1) {
                 m_bestMove = move.left(4);
+                m_bestScore = m_currentScore;
+            }
             nextAssistance();
         } else {
             Chessboard::AlgebraicNotation an = Chessboard::AlgebraicNotation::fromString(QString::fromLatin1(move));
@@ -152,7 +240,9 @@ void StockfishAiPlayer::processResponse(const QByteArray& response)
             if (an.promotion)
                 emit requestPromotion(an.promotionPiece);
         }
-    } else if (command == "info" && m_assistanceMode) {
+    } else if (command == "info" && m_analysisMode && m_staleSearches == 0) {
+        processAnalysisInfo(response);
+    } else if (command == "info" && m_assistanceMode && m_staleSearches == 0) {
         QList<QByteArray> infos = response.split(' ');
         int index = infos.indexOf("score");
         if (index != -1) {
@@ -165,11 +255,52 @@ void StockfishAiPlayer::processResponse(const QByteArray& response)
     }
 }
 
+void StockfishAiPlayer::processAnalysisInfo(const QByteArray& response)
+{
+    const QList<QByteArray> infos = response.split(' ');
+    // Bounds from aspiration windows and lines without a score (such as
+    // currmove updates) say nothing about the final evaluation.
+    if (!infos.contains("score") || infos.contains("lowerbound") || infos.contains("upperbound"))
+        return;
+    for (int i=1;i<infos.size()-1;++i) {
+        if (infos[i] == "depth") {
+            m_analysis.depth = infos[i + 1].toInt();
+        } else if (infos[i] == "score" && i + 2 < infos.size()) {
+            if (infos[i + 1] == "mate") {
+                m_analysis.mate = infos[i + 2].toInt();
+                m_analysis.score = 0;
+            } else {
+                m_analysis.mate = 0;
+                m_analysis.score = infos[i + 2].toInt();
+            }
+        } else if (infos[i] == "nodes") {
+            m_analysis.nodes = infos[i + 1].toLongLong();
+        } else if (infos[i] == "nps") {
+            m_analysis.nps = infos[i + 1].toLongLong();
+        } else if (infos[i] == "pv") {
+            m_analysis.pv.clear();
+            for (int j=i+1;j<infos.size();++j)
+                m_analysis.pv.append(QString::fromLatin1(infos[j]));
+            break;
+        }
+    }
+    if (m_analysis.pv.isEmpty())
+        return;
+    PositionAnalysis progress = m_analysis;
+    progress.bestMove = progress.pv.first();
+    emit analysisProgress(progress);
+}
+
 void StockfishAiPlayer::start(const Chessboard::BoardState& state)
 {
     qDebug("StockfishAiPlayer::start");
+    if (isCancelled())
+        return;
     m_assistanceMode = false;
-    sendCommand("stop");
+    m_analysisMode = false;
+    stopSearch();
+    if (playTablebaseMove(state))
+        return;
     sendCommand("isready");
     if (waitForResponse("readyok").isNull())
         return;
@@ -177,15 +308,48 @@ void StockfishAiPlayer::start(const Chessboard::BoardState& state)
     sendCommand("isready");
     if (waitForResponse("readyok").isNull())
         return;
-    sendCommand("go movetime " + QByteArray::number(m_elo * m_elo / 2000));
+    const GameClock gameClock = clock();
+    int moveTime = TimeManager::moveTime(state, gameClock, m_elo * m_elo / 2000);
+    if (tablebases() && tablebases()->contains(state))
+        moveTime = qMin(moveTime, tablebaseMoveTime);
+    const qint64 remaining = cancellationToken().remainingTime();
+    if (remaining >= 0)
+        moveTime = static_cast<int>(qBound<qint64>(1, remaining, moveTime));
+    if (!gameClock.isTimed()) {
+        go("movetime " + QByteArray::number(moveTime));
+        return;
+    }
+    QByteArray arguments = "wtime " + QByteArray::number(gameClock.whiteTime) +
+                           " btime " + QByteArray::number(gameClock.blackTime) +
+                           " winc " + QByteArray::number(gameClock.increment) +
+                           " binc " + QByteArray::number(gameClock.increment);
+    // The engine manages its own clock unless we want it to move early.
+    if (moveTime < TimeManager::clockBudget(state, gameClock))
+        arguments += " movetime " + QByteArray::number(moveTime);
+    go(arguments);
+}
+
+void StockfishAiPlayer::go(const QByteArray& arguments)
+{
+    // The engine answers every go with exactly one bestmove, so any
+    // search still running at this point can only produce a stale result.
+    m_staleSearches = m_outstandingSearches;
+    sendCommand("go " + arguments);
+    if (m_process)
+        ++m_outstandingSearches;
+}
+
+void StockfishAiPlayer::stopSearch()
+{
+    sendCommand("stop");
+    m_staleSearches = m_outstandingSearches;
 }
 
 void StockfishAiPlayer::cancel()
 {
-    QMetaObject::invokeMethod(this, [this]() {
-            if (m_process)
-                sendCommand("stop");
-        }, Qt::QueuedConnection);
+    AiPlayer::cancel();
+    if (m_process)
+        stopSearch();
 }
 
 void StockfishAiPlayer::promotionRequired()
@@ -198,6 +362,7 @@ void StockfishAiPlayer::setStrength(int elo)
     sendCommand("setoption name UCI_LimitStrength value true");
     sendCommand("setoption name UCI_Elo value " + QByteArray::number(elo));
     m_elo = elo;
+    m_limitStrength = true;
 }
 
 void StockfishAiPlayer::setAssistanceLevel(int level)
@@ -208,54 +373,159 @@ void StockfishAiPlayer::setAssistanceLevel(int level)
 void StockfishAiPlayer::startAssistance(const Chessboard::BoardState& state)
 {
     qDebug("StockfishAiPlayer::startAssistance -- level = %d", m_assistanceLevel);
-    if (m_assistanceLevel == 1)
+    if (m_assistanceLevel == 1 || isCancelled()) {
+        emit assistanceComplete();
         return;
-    sendCommand("stop");
+    }
+    stopSearch();
     m_assistanceMode = true;
+    m_analysisMode = false;
     m_board = state;
     m_sortedMoves = state.sortedLegalMoves();
-    m_timePerMove = 400 / m_sortedMoves.size();
-    m_currentMove.clear();
-    sendCommand("position fen " + m_board.toFenString().toLatin1());
-    sendCommand("go movetime " + QByteArray::number(m_timePerMove));
+    m_pendingMoves.clear();
+    m_assistanceColours.clear();
+    m_prioritySquare = Chessboard::Square();
+    m_timePerMove = 0;
+    m_tablebasePosition = tablebases() && tablebases()->contains(state);
+    if (m_sortedMoves.isEmpty()) {
+        emit assistanceComplete();
+        return;
+    }
+    if (tablebaseAssistance(state, m_assistanceLevel, &m_assistanceColours)) {
+        emit assistance(m_assistanceColours);
+        emit assistanceComplete();
+        return;
+    }
+    AnalysisCache::Entry entry;
+    if (m_analysisCache.lookup(state.key(), m_assistanceLevel, 0, &entry)) {
+        qDebug("StockfishAiPlayer::startAssistance: cache hit (budget = %d)", entry.budget);
+        m_timePerMove = entry.budget;
+        m_assistanceColours = entry.colours;
+        emit assistance(entry.colours);
+    }
+    startAssistancePass(0);
 }
 
-// Assistance thresholds in centipawns relative to initial position.
-// 2: red = <= -300 cp; green >= -299 cp
-// 3: red = <= -300 cp; green >= -100 cp
-// 4: red = <= -300 cp; green >= 0 cp
-// 5: red = <= -100 cp; green >= 300 cp
-// 6: red = <=  -1 cp;  green = best move only
-namespace {
-    int redThreshold[] =   { 0, -300, -300, -300, -100, -1 };
-    int greenThreshold[] = { 0, -299, -100, 0,    300,  0 };
+void StockfishAiPlayer::startAnalysis(const Chessboard::BoardState& state, int moveTime)
+{
+    qDebug("StockfishAiPlayer::startAnalysis -- move time = %d", moveTime);
+    if (isCancelled())
+        return;
+    stopSearch();
+    m_assistanceMode = false;
+    m_analysisMode = true;
+    m_analysis = PositionAnalysis();
+    sendCommand("position fen " + state.toFenString().toLatin1());
+    go("movetime " + QByteArray::number(moveTime));
+}
+
+void StockfishAiPlayer::startAssistancePass(int pass)
+{
+    const int moveCount = m_sortedMoves.size();
+    // Skip passes that would not search deeper than the results we already have.
+    while (pass < assistancePassCount && assistanceTimePerMove(pass, moveCount) <= m_timePerMove)
+        ++pass;
+    // The first pass already gives exact results for tablebase positions.
+    if (pass == assistancePassCount || (m_tablebasePosition && pass > 0)) {
+        emit assistanceComplete();
+        return;
+    }
+    qDebug("StockfishAiPlayer::startAssistancePass(%d)", pass);
+    m_assistancePass = pass;
+    m_timePerMove = assistanceTimePerMove(pass, moveCount);
+    // Moves not yet searched in this pass keep the colour from the previous
+    // pass so that interim lists never regress.
+    if (m_assistanceColours.size() != moveCount)
+        m_assistanceColours = QList<Chessboard::AssistanceColour>(moveCount, Chessboard::AssistanceColour::Blue);
+    m_assistanceScores = QList<int>(moveCount, 0);
+    m_pendingMoves.clear();
+    for (int i=0;i<moveCount;++i)
+        m_pendingMoves.append(i);
+    prioritisePendingMoves();
+    m_currentIndex = -1;
+    m_bestMove.clear();
+    sendCommand("position fen " + m_board.toFenString().toLatin1());
+    go("movetime " + QByteArray::number(m_timePerMove));
 }
 
 void StockfishAiPlayer::nextAssistance()
 {
-    if (!m_currentMove.isEmpty()) {
-        if (m_currentMove == m_bestMove) {
-            m_assistanceColours.append(Chessboard::AssistanceColour::Green);
-        } else if (m_assistanceLevel != 6 && m_currentScore >= greenThreshold[m_assistanceLevel - 1]) {
-            m_assistanceColours.append(Chessboard::AssistanceColour::Green);
-        } else if (m_currentScore <= redThreshold[m_assistanceLevel - 1]) {
-            m_assistanceColours.append(Chessboard::AssistanceColour::Red);
-        } else {
-            m_assistanceColours.append(Chessboard::AssistanceColour::Blue);
+    if (m_currentIndex != -1) {
+        const bool bestMove = moveString(m_sortedMoves[m_currentIndex]) == m_bestMove;
+        const int score = bestMove ? m_bestScore : m_currentScore;
+        m_assistanceColours[m_currentIndex] = classifyAssistance(m_assistanceLevel, score, bestMove);
+        m_assistanceScores[m_currentIndex] = score;
+        if (m_prioritySquare.isValid() && m_sortedMoves[m_currentIndex].first == m_prioritySquare &&
+            !m_pendingMoves.isEmpty() && !isPendingFrom(m_prioritySquare)) {
+            // Every move of the lifted piece has been searched: show its
+            // hints now and carry on with the rest of the board.
+            qDebug("StockfishAiPlayer::nextAssistance: lifted piece classified");
+            emit assistance(m_assistanceColours);
         }
     }
-    if (m_sortedMoves.isEmpty()) {
-        if (!m_assistanceColours.isEmpty())
-            emit assistance(m_assistanceColours);
-        m_assistanceColours.clear();
+    if (m_pendingMoves.isEmpty()) {
+        AnalysisCache::Entry entry;
+        entry.budget = m_timePerMove;
+        entry.colours = m_assistanceColours;
+        entry.scores = m_assistanceScores;
+        m_analysisCache.insert(m_board.key(), m_assistanceLevel, entry);
+        emit assistance(m_assistanceColours);
+        startAssistancePass(m_assistancePass + 1);
         return;
     }
-    QPair<Chessboard::Square, Chessboard::Square> move = m_sortedMoves.takeFirst();
-    m_currentMove = move.first.toString().toLatin1() + move.second.toString().toLatin1();
-    if (m_currentMove == m_bestMove) {
+    m_currentIndex = m_pendingMoves.takeFirst();
+    const QByteArray move = moveString(m_sortedMoves[m_currentIndex]);
+    if (move == m_bestMove) {
         nextAssistance();
     } else {
         sendCommand("position fen " + m_board.toFenString().toLatin1());
-        sendCommand("go movetime " + QByteArray::number(m_timePerMove) + " searchmoves " + m_currentMove);
+        go("movetime " + QByteArray::number(m_timePerMove) + " searchmoves " + move);
+    }
+}
+
+void StockfishAiPlayer::prioritiseAssistance(const Chessboard::Square& square)
+{
+    qDebug("StockfishAiPlayer::prioritiseAssistance(%s)", qPrintable(square.toString()));
+    if (!m_assistanceMode || m_sortedMoves.isEmpty())
+        return;
+    m_prioritySquare = square;
+    prioritisePendingMoves();
+}
+
+void StockfishAiPlayer::setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases)
+{
+    if (!tablebases && !this->tablebases())
+        return;
+    AiPlayer::setTablebases(tablebases);
+    const QString path = tablebases ? tablebases->path() : QString();
+    sendCommand("setoption name SyzygyPath value " + (path.isEmpty() ? QByteArray("<empty>") : QFile::encodeName(path)));
+}
+
+void StockfishAiPlayer::setResources(const EngineResources& resources)
+{
+    // Changing either option makes the engine reallocate its hash table.
+    if (resources == m_resources)
+        return;
+    qDebug("StockfishAiPlayer::setResources: %d threads, %d MiB hash", resources.threads, resources.hash);
+    m_resources = resources;
+    sendCommand("setoption name Threads value " + QByteArray::number(resources.threads));
+    sendCommand("setoption name Hash value " + QByteArray::number(resources.hash));
+}
+
+void StockfishAiPlayer::prioritisePendingMoves()
+{
+    if (!m_prioritySquare.isValid())
+        return;
+    std::stable_partition(m_pendingMoves.begin(), m_pendingMoves.end(), [this](int index) {
+        return m_sortedMoves[index].first == m_prioritySquare;
+    });
+}
+
+bool StockfishAiPlayer::isPendingFrom(const Chessboard::Square& square) const
+{
+    for (int index : m_pendingMoves) {
+        if (m_sortedMoves[index].first == square)
+            return true;
     }
+    return false;
 }
@@ -4,6 +4,8 @@
 #include <QProcess>
 #include <QString>
 #include "aiplayer.h"
+#include "aiplayerfactory.h"
+#include "analysiscache.h"
 
 class StockfishAiPlayer : public AiPlayer
 {
@@ -16,30 +18,70 @@ public:
     void cancel() override;
     void setStrength(int elo) override;
     void startAssistance(const Chessboard::BoardState& state) override;
+    void startAnalysis(const Chessboard::BoardState& state, int moveTime) override;
     void setAssistanceLevel(int level) override;
+    void prioritiseAssistance(const Chessboard::Square& square) override;
+    void setTablebases(const QSharedPointer<const Chessboard::SyzygyTablebases>& tablebases) override;
+    void setResources(const EngineResources& resources) override;
 private slots:
     void readyReadFromEngine();
+    void engineFinished();
 private:
     bool initialize();
     void sendCommand(const QByteArray& command);
     QByteArray waitForResponse(const QByteArray& response);
     void processResponse(const QByteArray& response);
+    void processAnalysisInfo(const QByteArray& response);
+    void go(const QByteArray& arguments);
+    void stopSearch();
+    void startAssistancePass(int pass);
     void nextAssistance();
+    void prioritisePendingMoves();
+    bool isPendingFrom(const Chessboard::Square& square) const;
 
     QProcess *m_process {};
     QString m_stockfishPath;
     Chessboard::BoardState m_board;
     QList<QPair<Chessboard::Square, Chessboard::Square> > m_sortedMoves;
+    QList<int> m_pendingMoves;
+    Chessboard::Square m_prioritySquare;
     QList<Chessboard::AssistanceColour> m_assistanceColours;
-    QByteArray m_currentMove;
+    QList<int> m_assistanceScores;
+    AnalysisCache m_analysisCache;
+    // Starts out as the engine's own defaults.
+    EngineResources m_resources;
     QByteArray m_bestMove;
+    PositionAnalysis m_analysis;
     int m_elo { 1000 };
     int m_assistanceLevel {1};
-    int m_timePerMove;
-    int m_currentScore;
+    int m_assistancePass {};
+    int m_currentIndex {-1};
+    int m_timePerMove {};
+    int m_currentScore {};
+    int m_bestScore {};
+    int m_outstandingSearches {};
+    int m_staleSearches {};
     bool m_initialized {};
+    bool m_limitStrength {};
     bool m_waitingForResponse {};
     bool m_assistanceMode {};
+    bool m_analysisMode {};
+    bool m_tablebasePosition {};
+};
+
+class StockfishAiPlayerFactory : public AiPlayerFactory
+{
+public:
+    StockfishAiPlayerFactory(const QString& stockfishPath) :
+        m_stockfishPath(stockfishPath)
+    {
+    }
+    AiPlayer *createAiPlayer(Chessboard::Colour colour, QObject *parent = nullptr) override
+    {
+        return new StockfishAiPlayer(colour, m_stockfishPath, parent);
+    }
+private:
+    QString m_stockfishPath;
 };
 
 #endif // STOCKFISHAIPLAYER_H
@@ -0,0 +1,84 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "timemanager.h"
+
+using namespace Chessboard;
+
+namespace {
+    // Time kept back on every move for board and engine round trips.
+    const int moveOverhead = 50;
+    // Assume at least this many moves remain, however far into the game.
+    const int minimumMovesToGo = 20;
+    const int expectedGameLength = 50;
+    // Fraction of the remaining time a single move may never exceed.
+    const int maximumShare = 4;
+    const int recaptureDivisor = 3;
+}
+
+int TimeManager::moveTime(const BoardState& state, const GameClock& clock, int untimedMoveTime)
+{
+    const int budget = clock.isTimed() ? clockBudget(state, clock) : untimedMoveTime;
+    if (isForced(state))
+        return qMin(budget, forcedMoveTime);
+    if (isRecapture(state))
+        return qMax(minimumMoveTime, budget / recaptureDivisor);
+    return budget;
+}
+
+int TimeManager::clockBudget(const BoardState& state, const GameClock& clock)
+{
+    const int remaining = clock.remaining(state.activeColour);
+    const int movesToGo = qMax(minimumMovesToGo, expectedGameLength - state.fullMoveCount);
+    const int budget = qMax(0, remaining - moveOverhead) / movesToGo + clock.increment * 3 / 4;
+    return qMax(minimumMoveTime, qMin(budget, remaining / maximumShare));
+}
+
+bool TimeManager::isForced(const BoardState& state)
+{
+    return state.legalMoves().size() == 1;
+}
+
+bool TimeManager::isRecapture(const BoardState& state)
+{
+    // A capture always resets the half move clock.
+    if (state.halfMoveClock != 0 || state.history.isEmpty())
+        return false;
+    const QByteArray previous = state.history.last();
+    if (previous.size() < 64)
+        return false;
+    const int active = static_cast<int>(state.activeColour);
+    Square captureSquare;
+    for (int row=0;row<8 && !captureSquare.isValid();++row) {
+        for (int col=0;col<8;++col) {
+            const int before = static_cast<uchar>(previous[(7 - row) * 8 + col]);
+            const ColouredPiece& after = state[row][col];
+            if ((before & 0x30) == active && after.isValid() && after.colour() != state.activeColour) {
+                captureSquare = Square(row, col);
+                break;
+            }
+        }
+    }
+    if (!captureSquare.isValid())
+        return false;
+    for (const QPair<Square, Square>& move : state.legalMoves()) {
+        if (move.second == captureSquare)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMEMANAGER_H
+#define TIMEMANAGER_H
+
+#include "chessboard.h"
+
+// Snapshot of the game clocks taken when the AI is asked to move.
+// Times are in milliseconds; a negative time means the game is untimed.
+struct GameClock {
+    int whiteTime {-1};
+    int blackTime {-1};
+    int increment {};
+    bool isTimed() const { return whiteTime >= 0 && blackTime >= 0; }
+    int remaining(Chessboard::Colour colour) const {
+        return colour == Chessboard::Colour::White ? whiteTime : blackTime;
+    }
+};
+
+// Decides how long the AI may think about a move. In a timed game the
+// budget is a share of the remaining clock; otherwise the caller's
+// default is used. Either way forced moves and recaptures get much less
+// than a normal move since searching them longer rarely changes the choice.
+class TimeManager
+{
+public:
+    static const int forcedMoveTime = 10;
+    static const int minimumMoveTime = 10;
+
+    static int moveTime(const Chessboard::BoardState& state, const GameClock& clock, int untimedMoveTime);
+    static int clockBudget(const Chessboard::BoardState& state, const GameClock& clock);
+    static bool isForced(const Chessboard::BoardState& state);
+    static bool isRecapture(const Chessboard::BoardState& state);
+};
+
+#endif // TIMEMANAGER_H
@@ -47,6 +47,7 @@ DesktopGuiFacade::DesktopGuiFacade(const Options& options, QObject *parent)
         emit requestDraw(m_activeColour);
     });
     connect(m_mainWindow, &MainWindow::requestUndo, this, &GuiFacade::requestUndo);
+    connect(m_mainWindow, &MainWindow::requestAnalysis, this, &GuiFacade::requestAnalysis);
     QMetaObject::invokeMethod(this, [this]() {
         setConnectionState(ConnectionState::Disconnected);
         setGameProgress(GameProgress(GameProgress::InProgress));
@@ -322,3 +323,13 @@ void DesktopGuiFacade::showConfigureEngineDialog(const QString& errorMessage, co
     configureEngineDialog->show();
     connect(configureEngineDialog, &ConfigureEngineDialog::configureEngine, this, &GuiFacade::configureEngine);
 }
+
+void DesktopGuiFacade::setAnalysisEnabled(bool enabled)
+{
+    m_mainWindow->setAnalysisEnabled(enabled);
+}
+
+void DesktopGuiFacade::analysis(const Chessboard::BoardState& state, const PositionAnalysis& analysis)
+{
+    m_mainWindow->setAnalysis(state, analysis);
+}
@@ -60,6 +60,8 @@ public slots:
     void assistance(const QList<Chessboard::AssistanceColour>& colours) override;
     void setCanUndo(bool canUndo) override;
     void showConfigureEngineDialog(const QString& errorMessage, const QString& stockfishPath) override;
+    void setAnalysisEnabled(bool enabled) override;
+    void analysis(const Chessboard::BoardState& state, const PositionAnalysis& analysis) override;
 
 private slots:
     void updateStatusMessage();
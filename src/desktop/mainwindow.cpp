@@ -21,6 +21,11 @@
 #include "chessboardscene.h"
 #include "ui_mainwindow.h"
 
+namespace {
+    // Centipawns at which the evaluation bar is full.
+    const int evalBarLimit = 1000;
+}
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
@@ -33,9 +38,13 @@ MainWindow::MainWindow(QWidget *parent) :
     font.setPointSizeF(font.pointSizeF() * 2.0);
     ui->editToolBar->setFont(font);
     ui->editToolBar->hide();
+    ui->evalBar->setRange(-evalBarLimit, evalBarLimit);
+    ui->evalBar->hide();
+    ui->pvLabel->hide();
     connect(m_scene, &ChessboardScene::requestMove, this, &MainWindow::requestMove);
     connect(m_scene, &ChessboardScene::squareSelected, this, &MainWindow::squareSelected);
     connect(ui->action_Undo, &QAction::triggered, this, &MainWindow::requestUndo);
+    connect(ui->action_Analysis, &QAction::triggered, this, &MainWindow::requestAnalysis);
 }
 
 MainWindow::~MainWindow()
@@ -51,7 +60,8 @@ void MainWindow::on_action_Connect_triggered()
 void MainWindow::setConnectionState(ConnectionState state)
 {
     ui->action_Connect->setEnabled(state == ConnectionState::Disconnected);
-    ui->action_Disconnect->setEnabled(state == ConnectionState::Connected);
+    ui->action_Disconnect->setEnabled(state == ConnectionState::Connected ||
+                                      state == ConnectionState::Reconnecting);
 }
 
 void MainWindow::on_action_Disconnect_triggered()
@@ -280,3 +290,42 @@ void MainWindow::setCanUndo(bool enabled)
 {
     ui->action_Undo->setEnabled(enabled);
 }
+
+void MainWindow::setAnalysisEnabled(bool enabled)
+{
+    ui->action_Analysis->setChecked(enabled);
+    ui->evalBar->setVisible(enabled);
+    ui->evalBar->setValue(0);
+    ui->evalBar->setToolTip(QString());
+    ui->pvLabel->setVisible(enabled);
+    ui->pvLabel->clear();
+}
+
+void MainWindow::setAnalysis(const Chessboard::BoardState& state, const PositionAnalysis& analysis)
+{
+    // Both the bar and the text show the evaluation from White's point of view.
+    const int sign = (state.activeColour == Chessboard::Colour::White) ? 1 : -1;
+    ui->evalBar->setValue(sign * qBound(-evalBarLimit, analysis.effectiveScore(), evalBarLimit));
+    const QString evaluation = (analysis.mate != 0) ? QStringLiteral("#%1").arg(sign * analysis.mate)
+                                                    : QString::asprintf("%+.2f", sign * analysis.score / 100.0);
+    ui->evalBar->setToolTip(evaluation);
+    QString line;
+    int moveNumber = state.fullMoveCount;
+    bool whiteToMove = state.activeColour == Chessboard::Colour::White;
+    const QStringList pv = analysis.sanPv(state);
+    for (int i=0;i<pv.size();++i) {
+        if (whiteToMove)
+            line += QStringLiteral("%1. ").arg(moveNumber);
+        else if (i == 0)
+            line += QStringLiteral("%1... ").arg(moveNumber);
+        line += pv[i] + QLatin1Char(' ');
+        if (!whiteToMove)
+            ++moveNumber;
+        whiteToMove = !whiteToMove;
+    }
+    ui->pvLabel->setText(tr("%1  depth %2  %3 kN/s  %4")
+                         .arg(evaluation)
+                         .arg(analysis.depth)
+                         .arg(analysis.nps / 1000)
+                         .arg(line.trimmed()));
+}
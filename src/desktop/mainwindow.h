@@ -20,6 +20,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include "aiplayer.h"
 #include "chessboard.h"
 #include "connectionstate.h"
 
@@ -47,6 +48,8 @@ public slots:
     void setLocalPlayer(Chessboard::Colour color, bool localPlayer);
     void setAssistance(const QList<Chessboard::AssistanceColour>& colours);
     void setCanUndo(bool enabled);
+    void setAnalysisEnabled(bool enabled);
+    void setAnalysis(const Chessboard::BoardState& state, const PositionAnalysis& analysis);
 
 signals:
     void connectRequested();
@@ -58,6 +61,7 @@ signals:
     void requestResignation();
     void requestEdit(const Chessboard::BoardState& state);
     void requestUndo();
+    void requestAnalysis(bool enabled);
 
 protected:
     void resizeEvent(QResizeEvent *) override;
@@ -19,11 +19,33 @@
 #include "newgamedialog.h"
 #include "ui_newgamedialog.h"
 
+namespace {
+    struct TimeControlPreset {
+        int minutes;
+        int incrementSeconds;
+    };
+
+    const TimeControlPreset timeControlPresets[] = {
+        {  0,  0 },
+        {  3,  2 },
+        {  5,  3 },
+        { 10,  5 },
+        { 15, 10 },
+        { 30,  0 }
+    };
+}
+
 NewGameDialog::NewGameDialog(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::NewGameDialog)
 {
     ui->setupUi(this);
+    for (const TimeControlPreset& preset : timeControlPresets) {
+        if (preset.minutes == 0)
+            ui->timeControlComboBox->addItem(tr("Untimed"));
+        else
+            ui->timeControlComboBox->addItem(tr("%1 min + %2 s").arg(preset.minutes).arg(preset.incrementSeconds));
+    }
     connect(this, &QDialog::accepted, this, [this]() {
         Chessboard::GameOptions gameOptions;
         gameOptions.white.playerType =
@@ -44,6 +66,9 @@ NewGameDialog::NewGameDialog(QWidget *parent)
         gameOptions.black.aiNominalElo = ui->blackAiDifficultySlider->value();
         gameOptions.white.assistanceLevel = ui->whiteAssistanceLevelSlider->value();
         gameOptions.black.assistanceLevel = ui->blackAssistanceLevelSlider->value();
+        const TimeControlPreset& preset = timeControlPresets[qMax(0, ui->timeControlComboBox->currentIndex())];
+        gameOptions.timeControl.baseTime = preset.minutes * 60000;
+        gameOptions.timeControl.increment = preset.incrementSeconds * 1000;
         emit newGameRequested(gameOptions);
     });
 }
@@ -67,4 +92,11 @@ void NewGameDialog::setGameOptions(const Chessboard::GameOptions& gameOptions)
     ui->blackAiDifficultySlider->setValue(gameOptions.black.aiNominalElo);
     ui->whiteAssistanceLevelSlider->setValue(gameOptions.white.assistanceLevel);
     ui->blackAssistanceLevelSlider->setValue(gameOptions.black.assistanceLevel);
+    ui->timeControlComboBox->setCurrentIndex(0);
+    for (int i=0;i<ui->timeControlComboBox->count();++i) {
+        const TimeControlPreset& preset = timeControlPresets[i];
+        if (preset.minutes * 60000 == gameOptions.timeControl.baseTime &&
+            preset.incrementSeconds * 1000 == gameOptions.timeControl.increment)
+            ui->timeControlComboBox->setCurrentIndex(i);
+    }
 }
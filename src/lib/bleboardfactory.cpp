@@ -17,10 +17,12 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#include <QBluetoothDeviceInfo>
 #include <QBluetoothUuid>
 #include <QLatin1String>
 
 #include "bleboardfactory.h"
+#include "blechessuptransport.h"
 #include "bleconnection.h"
 #include "chessupboard.h"
 
@@ -28,10 +30,16 @@ namespace Chessboard {
 
 RemoteBoard *BleBoardFactory::create(const BoardAddress& address, BleConnection *connection, QObject *parent)
 {
-    if (connection->name().startsWith("ChessUp"))
-        return new ChessUpBoard(address, connection, parent);
+    if (isSupported(connection->deviceInfo()))
+        return new ChessUpBoard(address, connection, new BleChessUpTransport(connection), parent);
     else
         return nullptr;
 }
 
+bool BleBoardFactory::isSupported(const QBluetoothDeviceInfo& info)
+{
+    return info.name().startsWith("ChessUp") ||
+           info.serviceUuids().contains(QBluetoothUuid(CHESSUP_SERVICE));
+}
+
 }
@@ -20,6 +20,7 @@
 #ifndef BLEBOARDFACTORY_H
 #define BLEBOARDFACTORY_H
 
+class QBluetoothDeviceInfo;
 class QObject;
 
 namespace Chessboard {
@@ -32,6 +33,8 @@ class BleBoardFactory
 {
 public:
     RemoteBoard *create(const BoardAddress& address, BleConnection *connection, QObject *parent = nullptr);
+    // Whether the device advertises itself as a board this factory knows.
+    static bool isSupported(const QBluetoothDeviceInfo& info);
 };
 
 }
@@ -0,0 +1,150 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "bleconnection.h"
+#include "blechessuptransport.h"
+#include "gattcache.h"
+
+namespace {
+    // https://developer.nordicsemi.com/nRF_Connect_SDK/doc/2.2.0/nrf/libraries/bluetooth_services/services/nus.html#nordic-uart-service-nus
+    const QLatin1String RX_CHARACTERISTIC_UUID("{6E400002-B5A3-F393-E0A9-E50E24DCCA9E}");
+    const QLatin1String TX_CHARACTERISTIC_UUID("{6E400003-B5A3-F393-E0A9-E50E24DCCA9E}");
+
+    // Each write and notification waits for the next connection event, so
+    // the interval bounds how quickly moves and hints get across. During
+    // play the shortest interval allowed is asked for; otherwise a longer
+    // one, with events the board may skip, saves its battery. The
+    // supervision timeouts leave room for several missed events.
+    QLowEnergyConnectionParameters connectionParameters(bool lowLatency)
+    {
+        QLowEnergyConnectionParameters parameters;
+        if (lowLatency) {
+            parameters.setIntervalRange(7.5, 15);
+            parameters.setLatency(0);
+            parameters.setSupervisionTimeout(2000);
+        } else {
+            parameters.setIntervalRange(100, 200);
+            parameters.setLatency(4);
+            parameters.setSupervisionTimeout(6000);
+        }
+        return parameters;
+    }
+}
+
+namespace Chessboard {
+
+BleChessUpTransport::BleChessUpTransport(BleConnection *connection, QObject *parent) :
+    ChessUpTransport(parent),
+    m_connection(connection)
+{
+    connect(connection, &BleConnection::connectionUpdated, this, [this](const QLowEnergyConnectionParameters& parameters) {
+        // The interval range collapses to the one in use.
+        emit connectionParametersChanged(parameters.maximumInterval(), parameters.latency(), parameters.supervisionTimeout());
+    });
+    m_uartService = connection->createServiceObject(QBluetoothUuid(CHESSUP_SERVICE), this);
+    connect(m_uartService, &QLowEnergyService::stateChanged, this, &BleChessUpTransport::discoveryFinished);
+    connect(m_uartService, &QLowEnergyService::characteristicChanged, this, [this](const QLowEnergyCharacteristic &characteristic, const QByteArray &value) {
+        if (characteristic == m_rxCharacteristic)
+            emit received(value);
+    });
+    connect(m_uartService, &QLowEnergyService::characteristicWritten, this, [this](const QLowEnergyCharacteristic &characteristic, const QByteArray &value) {
+        if (characteristic == m_txCharacteristic)
+            emit written(value);
+    });
+    connect(m_uartService, &QLowEnergyService::errorOccurred, this, [this](QLowEnergyService::ServiceError error) {
+        if (error == QLowEnergyService::CharacteristicWriteError)
+            emit writeFailed();
+    });
+    m_batteryService = connection->createServiceObject(QBluetoothUuid::ServiceClassUuid::BatteryService, this);
+    connect(m_batteryService, &QLowEnergyService::stateChanged, this, &BleChessUpTransport::discoveryFinished);
+    // The values read during discovery are never used (the battery level
+    // is read once ready), so a board seen before skips reading them.
+    const QLowEnergyService::DiscoveryMode mode = connection->usingCachedLayout() ?
+        QLowEnergyService::SkipValueDiscovery : QLowEnergyService::FullDiscovery;
+    m_batteryService->discoverDetails(mode);
+    m_uartService->discoverDetails(mode);
+}
+
+bool BleChessUpTransport::findCharacteristics()
+{
+    m_txCharacteristic = m_uartService->characteristic(QBluetoothUuid(RX_CHARACTERISTIC_UUID));
+    m_rxCharacteristic = m_uartService->characteristic(QBluetoothUuid(TX_CHARACTERISTIC_UUID));
+    m_batteryCharacteristic = m_batteryService->characteristic(QBluetoothUuid::CharacteristicType::BatteryLevel);
+    if (!m_txCharacteristic.isValid() || !m_rxCharacteristic.isValid() || !m_batteryCharacteristic.isValid() ||
+        !(m_rxCharacteristic.properties() & QLowEnergyCharacteristic::Notify))
+        return false;
+    m_rxClientCharacteristicConfiguration = m_rxCharacteristic.clientCharacteristicConfiguration();
+    m_batteryClientCharacteristicConfiguration = m_batteryCharacteristic.clientCharacteristicConfiguration();
+    return m_rxClientCharacteristicConfiguration.isValid() && m_batteryClientCharacteristicConfiguration.isValid();
+}
+
+void BleChessUpTransport::discoveryFinished()
+{
+    if (m_ready ||
+        m_uartService->state() != QLowEnergyService::RemoteServiceDiscovered ||
+        m_batteryService->state() != QLowEnergyService::RemoteServiceDiscovered)
+        return;
+    qDebug("BleChessUpTransport::discoveryFinished");
+    if (!findCharacteristics()) {
+        // The connection after this one discovers everything again.
+        qWarning("BleChessUpTransport::discoveryFinished: characteristics missing%s",
+                 m_connection->usingCachedLayout() ? " from cached layout" : "");
+        GattCache::remove(m_connection->deviceInfo());
+        m_connection->disconnectFromBoard();
+        return;
+    }
+    GattLayout layout;
+    layout.services = m_connection->services();
+    for (QLowEnergyService *service : { m_uartService, m_batteryService }) {
+        QList<QBluetoothUuid> characteristics;
+        for (const QLowEnergyCharacteristic& characteristic : service->characteristics())
+            characteristics.append(characteristic.uuid());
+        layout.characteristics.insert(service->serviceUuid(), characteristics);
+    }
+    GattLayout cachedLayout;
+    if (m_connection->usingCachedLayout() && GattCache::find(m_connection->deviceInfo(), &cachedLayout) &&
+        cachedLayout.characteristics != layout.characteristics)
+        qDebug("BleChessUpTransport::discoveryFinished: characteristics changed since the last connection");
+    GattCache::insert(m_connection->deviceInfo(), layout);
+    m_batteryService->readCharacteristic(m_batteryCharacteristic);
+    // Enable notifications.
+#ifdef __linux__
+    m_uartService->writeDescriptor(m_rxClientCharacteristicConfiguration, QByteArray::fromHex("0100"));
+    m_batteryService->writeDescriptor(m_batteryClientCharacteristicConfiguration, QByteArray::fromHex("0100"));
+#else
+    uint8_t buf[] = {0x01, 0x00};
+    m_uartService->writeDescriptor(m_rxClientCharacteristicConfiguration, QByteArray::fromRawData(reinterpret_cast<const char *>(buf), sizeof(buf)));
+    m_batteryService->writeDescriptor(m_batteryClientCharacteristicConfiguration, QByteArray::fromRawData(reinterpret_cast<const char *>(buf), sizeof(buf)));
+#endif
+    m_ready = true;
+    emit ready();
+}
+
+void BleChessUpTransport::write(const QByteArray& data)
+{
+    m_uartService->writeCharacteristic(m_txCharacteristic, data, QLowEnergyService::WriteWithResponse);
+}
+
+void BleChessUpTransport::setLowLatency(bool lowLatency)
+{
+    if (m_connection)
+        m_connection->requestConnectionUpdate(connectionParameters(lowLatency));
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLECHESSUPTRANSPORT_H
+#define BLECHESSUPTRANSPORT_H
+
+#include <QLowEnergyCharacteristic>
+#include <QLowEnergyDescriptor>
+#include <QLowEnergyService>
+#include <QPointer>
+
+#include "bleconnection.h"
+#include "chessuptransport.h"
+
+namespace Chessboard {
+
+const QLatin1String CHESSUP_SERVICE("{6E400001-B5A3-F393-E0A9-E50E24DCCA9E}"); // Nordic UART Service
+
+// Talks to a ChessUp board over the Nordic UART Service. The transport is
+// ready once the services have been discovered and notifications enabled.
+class BleChessUpTransport : public ChessUpTransport
+{
+    Q_OBJECT
+public:
+    explicit BleChessUpTransport(BleConnection *connection, QObject *parent = nullptr);
+    bool isReady() const override { return m_ready; }
+    void write(const QByteArray& data) override;
+    void setLowLatency(bool lowLatency) override;
+private slots:
+    void discoveryFinished();
+private:
+    bool findCharacteristics();
+
+    // Gone once the link drops, while the board may live on.
+    QPointer<BleConnection> m_connection;
+    QLowEnergyService *m_uartService;
+    QLowEnergyService *m_batteryService;
+    QLowEnergyCharacteristic m_rxCharacteristic;
+    QLowEnergyCharacteristic m_txCharacteristic;
+    QLowEnergyCharacteristic m_batteryCharacteristic;
+    QLowEnergyDescriptor m_rxClientCharacteristicConfiguration;
+    QLowEnergyDescriptor m_batteryClientCharacteristicConfiguration;
+    bool m_ready {false};
+};
+
+}
+
+#endif // BLECHESSUPTRANSPORT_H
@@ -23,6 +23,7 @@
 #include <QLowEnergyController>
 #include <QtGlobal>
 #include <QTimer>
+#include <algorithm>
 
 #include "bleconnection.h"
 #include "chessboard.h"
@@ -36,16 +37,25 @@ BleConnection::BleConnection(const BoardAddress& address, const QBluetoothDevice
     m_central = QLowEnergyController::createCentral(info, this);
     connect(m_central, &QLowEnergyController::serviceDiscovered, this, [this](const QBluetoothUuid& newService) {
         m_services.append(newService);
+        // Start on a board seen before as soon as its services are back,
+        // rather than waiting for the rest of discovery.
+        if (m_state == ConnectedToDeviceDiscoveryInProgress && !m_cachedLayout.services.isEmpty() &&
+            std::all_of(m_cachedLayout.services.cbegin(), m_cachedLayout.services.cend(), [this](const QBluetoothUuid& service) {
+                return m_services.contains(service);
+            })) {
+            m_usingCachedLayout = true;
+            createBoard();
+        }
     });
     connect(m_central, &QLowEnergyController::discoveryFinished, this, [this]() {
-        m_state = DiscoveryFinished;
-        RemoteBoard *board = m_factory.create(this->address(), this, this);
-        if (board) {
-            connect(this, &BleConnection::connectionFailed, board, &RemoteBoard::deleteLater);
-        } else {
-            emit error(ConnectionManager::NotSupported);
-            disconnectFromBoard();
+        if (m_state != ConnectedToDeviceDiscoveryInProgress)
+            return;
+        if (!m_cachedLayout.services.isEmpty()) {
+            qDebug("BleConnection::discoveryFinished: cached layout no longer matches");
+            GattCache::remove(m_info);
+            m_cachedLayout = GattLayout();
         }
+        createBoard();
     });
     connect(m_central, &QLowEnergyController::connected, this, [this]() {
         qDebug("BleConnection::connected");
@@ -74,7 +84,10 @@ BleConnection::BleConnection(const BoardAddress& address, const QBluetoothDevice
         }
     });
     connect(m_central, &QLowEnergyController::errorOccurred, this, &BleConnection::controllerErrorOccurred);
+    connect(m_central, &QLowEnergyController::connectionUpdated, this, &BleConnection::connectionUpdated);
     connect(this, &BleConnection::connected, this, [this]() {
+        qDebug("BleConnection::connected: ready after %lld ms%s", static_cast<long long>(m_connectTimer.elapsed()),
+               m_usingCachedLayout ? " using cached layout" : "");
         m_state = Connected;
     });
 }
@@ -83,6 +96,18 @@ BleConnection::~BleConnection()
 {
 }
 
+void BleConnection::createBoard()
+{
+    m_state = DiscoveryFinished;
+    RemoteBoard *board = m_factory.create(address(), this, this);
+    if (board) {
+        connect(this, &BleConnection::connectionFailed, board, &RemoteBoard::deleteLater);
+    } else {
+        emit error(ConnectionManager::NotSupported);
+        disconnectFromBoard();
+    }
+}
+
 void BleConnection::startDiscovery()
 {
     qDebug("BleConnection::startDiscovery");
@@ -112,7 +137,9 @@ void BleConnection::startDiscovery()
         if (!m_deviceDiscovered)
             controllerErrorOccurred(QLowEnergyController::UnknownRemoteDeviceError);
     });
-    m_discoveryAgent->start();
+    // ChessUp boards are only reachable over Bluetooth LE, so there is no
+    // need to wait for a classic inquiry as well.
+    m_discoveryAgent->start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
 }
 
 void BleConnection::controllerErrorOccurred(QLowEnergyController::Error error)
@@ -216,9 +243,23 @@ void BleConnection::connectToBoard()
     qDebug("BleConnection::connectToBoard");
     Q_ASSERT(m_state == Disconnected);
     m_state = Connecting;
+    m_connectTimer.start();
+    m_services.clear();
+    m_usingCachedLayout = false;
+    if (!GattCache::find(m_info, &m_cachedLayout))
+        m_cachedLayout = GattLayout();
     m_central->connectToDevice();
 }
 
+void BleConnection::requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters)
+{
+    if (m_central->state() != QLowEnergyController::ConnectedState &&
+        m_central->state() != QLowEnergyController::DiscoveringState &&
+        m_central->state() != QLowEnergyController::DiscoveredState)
+        return;
+    m_central->requestConnectionUpdate(parameters);
+}
+
 void BleConnection::disconnectFromBoard()
 {
     qDebug("BleConnection::disconnectFromDevice");
@@ -21,10 +21,13 @@
 #define BLUETOOTHCONNECTION_H
 
 #include <QBluetoothDeviceInfo>
+#include <QElapsedTimer>
+#include <QLowEnergyConnectionParameters>
 #include <QLowEnergyController>
 
 #include "bleboardfactory.h"
 #include "connection.h"
+#include "gattcache.h"
 
 class QBluetoothDeviceDiscoveryAgent;
 
@@ -41,11 +44,21 @@ public:
     QList<QBluetoothUuid> services() const;
     QLowEnergyService *createServiceObject(const QBluetoothUuid &serviceUuid, QObject *parent = nullptr);
     QString name() const { return m_info.name(); }
+    QBluetoothDeviceInfo deviceInfo() const { return m_info; }
+    // Whether the layout of the board was known from an earlier connection
+    // and has been found again.
+    bool usingCachedLayout() const { return m_usingCachedLayout; }
+    // Not every platform lets a central renegotiate, so connectionUpdated()
+    // may never follow.
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters& parameters);
+signals:
+    void connectionUpdated(const QLowEnergyConnectionParameters& parameters);
 private slots:
     void controllerErrorOccurred(QLowEnergyController::Error error);
     void serviceErrorOccurred(QLowEnergyService::ServiceError error);
 private:
     void startDiscovery();
+    void createBoard();
     enum State {
         Disconnected,
         Connecting,
@@ -64,6 +77,9 @@ private:
     int m_connectRetries {};
     bool m_discoveryStarted {};
     bool m_deviceDiscovered {};
+    GattLayout m_cachedLayout;
+    bool m_usingCachedLayout {};
+    QElapsedTimer m_connectTimer;
 };
 
 }
@@ -24,6 +24,13 @@
 
 #include "boardaddress_p.h"
 #include "chessboard.h"
+#include "chessupsimulator.h"
+
+namespace {
+    const QLatin1String SIMULATOR_PREFIX("simulator");
+    const QLatin1String REPLAY_PREFIX("replay:");
+    const QLatin1String SPEED_OPTION("speed=");
+}
 
 namespace Chessboard {
 
@@ -78,6 +85,10 @@ BoardAddress BoardAddress::fromByteArray(const QByteArray& in)
     ds >> method;
     if (method == CONNECTION_BLE) {
         return BoardAddress(BluetoothBoardAddressPrivate::fromByteArray(in));
+    } else if (method == CONNECTION_SIMULATED) {
+        return BoardAddress(SimulatedBoardAddressPrivate::fromByteArray(in));
+    } else if (method == CONNECTION_REPLAY) {
+        return BoardAddress(ReplayBoardAddressPrivate::fromByteArray(in));
     } else {
         return BoardAddress();
     }
@@ -94,6 +105,12 @@ BoardAddress& BoardAddress::operator=(const BoardAddress& other)
         case CONNECTION_BLE:
             d_ptr.reset(new BluetoothBoardAddressPrivate(static_cast<const BluetoothBoardAddressPrivate&>(*other.d_func())));
             break;
+        case CONNECTION_SIMULATED:
+            d_ptr.reset(new SimulatedBoardAddressPrivate(static_cast<const SimulatedBoardAddressPrivate&>(*other.d_func())));
+            break;
+        case CONNECTION_REPLAY:
+            d_ptr.reset(new ReplayBoardAddressPrivate(static_cast<const ReplayBoardAddressPrivate&>(*other.d_func())));
+            break;
         }
     }
     return *this;
@@ -105,9 +122,15 @@ bool BoardAddress::operator==(const BoardAddress& other) const
     if (!isValid()) {
         return !other.isValid();
     } else {
+        if (connectionMethod() != other.connectionMethod())
+            return false;
         switch (other.connectionMethod()) {
         case CONNECTION_BLE:
             return static_cast<const BluetoothBoardAddressPrivate&>(*d) == static_cast<const BluetoothBoardAddressPrivate&>(*other.d_func());
+        case CONNECTION_SIMULATED:
+            return static_cast<const SimulatedBoardAddressPrivate&>(*d) == static_cast<const SimulatedBoardAddressPrivate&>(*other.d_func());
+        case CONNECTION_REPLAY:
+            return static_cast<const ReplayBoardAddressPrivate&>(*d) == static_cast<const ReplayBoardAddressPrivate&>(*other.d_func());
         default:
             Q_ASSERT(other.connectionMethod() == CONNECTION_BLE);
             return false;
@@ -122,7 +145,13 @@ bool BoardAddress::operator!=(const BoardAddress& other) const
 
 BoardAddress BoardAddress::fromString(const QString& s)
 {
-    if (s.startsWith("{")) {
+    if (s.startsWith(SIMULATOR_PREFIX)) {
+        SimulatedBoardAddressPrivate *d = SimulatedBoardAddressPrivate::fromString(s);
+        return d ? BoardAddress(d) : BoardAddress();
+    } else if (s.startsWith(REPLAY_PREFIX)) {
+        ReplayBoardAddressPrivate *d = ReplayBoardAddressPrivate::fromString(s);
+        return d ? BoardAddress(d) : BoardAddress();
+    } else if (s.startsWith("{")) {
         QBluetoothUuid uuid(s);
         if (uuid.isNull())
             return BoardAddress();
@@ -220,4 +249,111 @@ BluetoothBoardAddressPrivate *BluetoothBoardAddressPrivate::fromByteArray(const
     }
 }
 
+SimulatedBoardAddressPrivate::SimulatedBoardAddressPrivate(const QString& options_) :
+    options(options_)
+{
+}
+
+QString SimulatedBoardAddressPrivate::toString() const
+{
+    if (options.isEmpty())
+        return SIMULATOR_PREFIX;
+    return QString::fromLatin1("%1:%2").arg(SIMULATOR_PREFIX, options);
+}
+
+QByteArray SimulatedBoardAddressPrivate::toByteArray() const
+{
+    QByteArray out;
+    {
+        QDataStream ds(&out, QIODevice::WriteOnly);
+        ds << CONNECTION_SIMULATED;
+        ds << options;
+    }
+    return out;
+}
+
+SimulatedBoardAddressPrivate *SimulatedBoardAddressPrivate::fromByteArray(const QByteArray& in)
+{
+    QDataStream ds(in);
+    ConnectionMethod method;
+    ds >> method;
+    assert(method == CONNECTION_SIMULATED);
+    QString options;
+    ds >> options;
+    return new SimulatedBoardAddressPrivate(options);
+}
+
+SimulatedBoardAddressPrivate *SimulatedBoardAddressPrivate::fromString(const QString& s)
+{
+    QString optionString;
+    if (s.size() > SIMULATOR_PREFIX.size()) {
+        if (s.at(SIMULATOR_PREFIX.size()) != QLatin1Char(':'))
+            return nullptr;
+        optionString = s.mid(SIMULATOR_PREFIX.size() + 1);
+    }
+    ChessUpSimulator::Options options;
+    if (!ChessUpSimulator::Options::fromString(optionString, &options))
+        return nullptr;
+    return new SimulatedBoardAddressPrivate(options.toString());
+}
+
+ReplayBoardAddressPrivate::ReplayBoardAddressPrivate(const QString& fileName_, double speed_) :
+    fileName(fileName_),
+    speed(speed_)
+{
+}
+
+QString ReplayBoardAddressPrivate::toString() const
+{
+    if (speed == 1.0)
+        return QString(REPLAY_PREFIX) + fileName;
+    return QString::fromLatin1("%1%2%3:%4").arg(REPLAY_PREFIX, SPEED_OPTION, QString::number(speed), fileName);
+}
+
+QByteArray ReplayBoardAddressPrivate::toByteArray() const
+{
+    QByteArray out;
+    {
+        QDataStream ds(&out, QIODevice::WriteOnly);
+        ds << CONNECTION_REPLAY;
+        ds << fileName;
+        ds << speed;
+    }
+    return out;
+}
+
+ReplayBoardAddressPrivate *ReplayBoardAddressPrivate::fromByteArray(const QByteArray& in)
+{
+    QDataStream ds(in);
+    ConnectionMethod method;
+    ds >> method;
+    assert(method == CONNECTION_REPLAY);
+    QString fileName;
+    ds >> fileName;
+    double speed = 1.0;
+    ds >> speed;
+    return new ReplayBoardAddressPrivate(fileName, speed);
+}
+
+ReplayBoardAddressPrivate *ReplayBoardAddressPrivate::fromString(const QString& s)
+{
+    QString fileName = s.mid(REPLAY_PREFIX.size());
+    double speed = 1.0;
+    // File names may contain colons themselves, so only a leading speed
+    // option is split off.
+    if (fileName.startsWith(SPEED_OPTION)) {
+        const qsizetype colon = fileName.indexOf(QLatin1Char(':'));
+        if (colon == -1)
+            return nullptr;
+        bool ok;
+        speed = fileName.mid(SPEED_OPTION.size(), colon - SPEED_OPTION.size()).toDouble(&ok);
+        if (!ok || speed < 0)
+            return nullptr;
+        fileName = fileName.mid(colon + 1);
+    }
+    if (fileName.isEmpty())
+        return nullptr;
+    return new ReplayBoardAddressPrivate(fileName, speed);
+}
+
 }
@@ -36,6 +36,9 @@ public:
     virtual QString toString() const = 0;
     virtual QByteArray toByteArray() const = 0;
     virtual QBluetoothDeviceInfo bluetoothDeviceInfo() const { return QBluetoothDeviceInfo(); }
+    virtual QString simulatorOptions() const { return QString(); }
+    virtual QString traceFileName() const { return QString(); }
+    virtual double replaySpeed() const { return 1.0; }
 };
 
 class BluetoothBoardAddressPrivate : public BoardAddressPrivate {
@@ -54,6 +57,43 @@ private:
     QBluetoothDeviceInfo info;
 };
 
+// "simulator", optionally followed by a colon and the simulator's options.
+class SimulatedBoardAddressPrivate : public BoardAddressPrivate {
+public:
+    SimulatedBoardAddressPrivate(const QString& options);
+    bool isValid() const override { return true; }
+    ConnectionMethod connectionMethod() const override { return CONNECTION_SIMULATED; };
+    QString toString() const override;
+    QByteArray toByteArray() const override;
+    QString simulatorOptions() const override { return options; }
+    bool operator==(const SimulatedBoardAddressPrivate& other) const { return options == other.options; }
+    bool operator!=(const SimulatedBoardAddressPrivate& other) const { return !(*this == other); }
+    static SimulatedBoardAddressPrivate *fromByteArray(const QByteArray& in);
+    static SimulatedBoardAddressPrivate *fromString(const QString& s);
+private:
+    QString options;
+};
+
+// "replay:", optionally followed by "speed=N:", and the trace to replay.
+// A speed of zero replays the trace as fast as the board consumes it.
+class ReplayBoardAddressPrivate : public BoardAddressPrivate {
+public:
+    ReplayBoardAddressPrivate(const QString& fileName, double speed);
+    bool isValid() const override { return true; }
+    ConnectionMethod connectionMethod() const override { return CONNECTION_REPLAY; };
+    QString toString() const override;
+    QByteArray toByteArray() const override;
+    QString traceFileName() const override { return fileName; }
+    double replaySpeed() const override { return speed; }
+    bool operator==(const ReplayBoardAddressPrivate& other) const { return fileName == other.fileName && speed == other.speed; }
+    bool operator!=(const ReplayBoardAddressPrivate& other) const { return !(*this == other); }
+    static ReplayBoardAddressPrivate *fromByteArray(const QByteArray& in);
+    static ReplayBoardAddressPrivate *fromString(const QString& s);
+private:
+    QString fileName;
+    double speed;
+};
+
 class InvalidBoardAddressPrivate : public BoardAddressPrivate {
 public:
     ConnectionMethod connectionMethod() const override { return static_cast<ConnectionMethod>(0); }
@@ -1076,6 +1076,67 @@ AlgebraicNotation AlgebraicNotation::fromString(const QString& s)
     return ret;
 }
 
+/**
+ * @brief Standard algebraic notation for this move.
+ * @param state the position before the move
+ * @return the move in SAN, e.g. "Nbd7", "exd6", "e8=Q+" or "O-O", or an empty
+ *         string if the move is not legal in @a state
+ * @note The source and destination squares must be set, as they are after resolve().
+ * A promotion without a piece is written as a queen promotion.
+ */
+QString AlgebraicNotation::toString(const BoardState& state) const
+{
+    const Square from(fromRow, fromCol);
+    const Square to(toRow, toCol);
+    if (!from.isValid() || !to.isValid() || !state.isLegalMove(from, to))
+        return QString();
+    const Piece movedPiece = state[from].piece();
+    BoardState after = state;
+    bool promotionRequired = false;
+    after.move(from, to, &promotionRequired);
+    QString ret;
+    if (movedPiece == Piece::King && qAbs(toCol - fromCol) == 2) {
+        ret = (toCol > fromCol) ? QLatin1String("O-O") : QLatin1String("O-O-O");
+    } else {
+        // A pawn moving diagonally always captures, even en passant.
+        const bool isCapture = state[to].isValid() || (movedPiece == Piece::Pawn && fromCol != toCol);
+        if (movedPiece == Piece::Pawn) {
+            if (isCapture)
+                ret += QLatin1Char(char('a' + fromCol));
+        } else {
+            ret += ColouredPiece(Colour::White, movedPiece).toFenString();
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for (const QPair<Square, Square>& move : state.legalMoves()) {
+                if (move.second == to && !(move.first == from) && state[move.first].piece() == movedPiece) {
+                    ambiguous = true;
+                    sameFile = sameFile || move.first.col == fromCol;
+                    sameRank = sameRank || move.first.row == fromRow;
+                }
+            }
+            if (ambiguous && !sameFile)
+                ret += QLatin1Char(char('a' + fromCol));
+            else if (ambiguous && !sameRank)
+                ret += QLatin1Char(char('1' + fromRow));
+            else if (ambiguous)
+                ret += from.toAlgebraicString();
+        }
+        if (isCapture)
+            ret += QLatin1Char('x');
+        ret += to.toAlgebraicString();
+        if (promotionRequired) {
+            const Piece piece = promotion ? promotionPiece : Piece::Queen;
+            after.promote(piece);
+            ret += QLatin1Char('=');
+            ret += ColouredPiece(Colour::White, piece).toFenString();
+        }
+    }
+    if (after.isCheckmate())
+        ret += QLatin1Char('#');
+    else if (after.isCheck())
+        ret += QLatin1Char('+');
+    return ret;
+}
+
 AlgebraicNotation AlgebraicNotation::resolve(const BoardState& state) const
 {
     AlgebraicNotation ret;
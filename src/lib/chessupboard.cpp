@@ -18,90 +18,140 @@
  */
 
 #include <QBitArray>
-#include <QCoreApplication>
-#include <QThread>
 #include <QTimer>
 
-#include "bleconnection.h"
 #include "chessupboard.h"
+#include "chessupprotocol.h"
+#include "chessuptransport.h"
+#include "connection.h"
+
+using namespace Chessboard::ChessUp;
 
 namespace {
-    // https://developer.nordicsemi.com/nRF_Connect_SDK/doc/2.2.0/nrf/libraries/bluetooth_services/services/nus.html#nordic-uart-service-nus
-    const QLatin1String RX_CHARACTERISTIC_UUID("{6E400002-B5A3-F393-E0A9-E50E24DCCA9E}");
-    const QLatin1String TX_CHARACTERISTIC_UUID("{6E400003-B5A3-F393-E0A9-E50E24DCCA9E}");
-
-    const uint8_t CMD_ASSISTANCE      = 0x10;
-    const uint8_t CMD_OK              = 0x21;
-    const uint8_t CMD_PROMOTION_OK    = 0x23;
-    const uint8_t CMD_SET_STATE       = 0x66;
-    const uint8_t CMD_GET_STATE       = 0x67;
-    const uint8_t CMD_PROMOTION       = 0x97;
-    const uint8_t CMD_SEND_MOVE       = 0x99;
-    const uint8_t CMD_WIN             = 0xb6;
-    const uint8_t CMD_SETTINGS        = 0xb9;
-    const uint8_t RESP_MOVE_OK        = 0x22;
-    const uint8_t RESP_PROMOTION_OK   = 0x23;
-    const uint8_t RESP_OK             = 0x24;
-    const uint8_t RESP_BOARD_STATE    = 0x67;
-    const uint8_t RESP_PROMOTION      = 0x97;
-    const uint8_t RESP_MOVE           = 0xa3;
-    const uint8_t RESP_SET_STATE_OK   = 0xb1;
-    const uint8_t RESP_TOUCH          = 0xb8;
-    const uint8_t RESP_UNDO           = 0xbd;
-    const uint8_t MODE_REMOTE         = 0x02;
-    const uint8_t MODE_AI             = 0x01;
-    const uint8_t MODE_LOCAL          = 0x05;
+    // How long to wait for the board to confirm a write, and then for its
+    // answer to a command that has one.
+    const int WRITE_TIMEOUT           = 1000;
+    const int RESPONSE_TIMEOUT        = 500;
+    // Requests are sent at most this many times, backing off exponentially
+    // from RETRY_BACKOFF between attempts.
+    const int MAX_ATTEMPTS            = 3;
+    const int RETRY_BACKOFF           = 100;
+    // Delay before retrying an acknowledgement the board rejected.
+    const int ACK_RETRY_INTERVAL      = 25;
+    // The link is kept fast from the last move, touch or hint until it has
+    // been quiet this long, so a player thinking for a while does not pay
+    // for a slower link on their next move.
+    const int IDLE_TIMEOUT            = 120000;
+
+    uint8_t expectedResponse(uint8_t cmd)
+    {
+        switch (cmd) {
+        case CMD_GET_STATE:
+            return RESP_BOARD_STATE;
+        case CMD_SET_STATE:
+            return RESP_SET_STATE_OK;
+        case CMD_SEND_MOVE:
+            return RESP_MOVE_OK;
+        case CMD_PROMOTION:
+            return RESP_PROMOTION_OK;
+        case CMD_SETTINGS:
+            return RESP_OK;
+        default:
+            return 0;
+        }
+    }
+
+    // Whether a command may be sent again when the board may already have
+    // acted on it. Playing a move twice is not harmless.
+    bool isIdempotent(uint8_t cmd)
+    {
+        return cmd != CMD_SEND_MOVE && cmd != CMD_PROMOTION;
+    }
+
+    // Commands that supersede an earlier one of the same kind still waiting
+    // to be sent: only the latest settings, position and hints matter.
+    bool isCoalescable(uint8_t cmd)
+    {
+        return cmd == CMD_SETTINGS || cmd == CMD_SET_STATE || cmd == CMD_GET_STATE || cmd == CMD_ASSISTANCE;
+    }
+
+    // Notifications from a player at the board, rather than answers.
+    bool isPlay(uint8_t resp)
+    {
+        return resp == RESP_MOVE || resp == RESP_PROMOTION || resp == RESP_TOUCH || resp == RESP_UNDO;
+    }
+
+    // Notifications after which the board may show a different position.
+    bool changesPosition(uint8_t resp)
+    {
+        return resp == RESP_MOVE || resp == RESP_PROMOTION || resp == RESP_UNDO || resp == RESP_BOARD_STATE;
+    }
+
+    // Commands that act on the position set up by those before them, so
+    // nothing is coalesced across them.
+    bool isOrdered(uint8_t cmd)
+    {
+        return cmd == CMD_SEND_MOVE || cmd == CMD_PROMOTION || cmd == CMD_WIN;
+    }
 }
 
 namespace Chessboard {
 
-ChessUpBoard::ChessUpBoard(const BoardAddress& address, BleConnection *connection, QObject *parent) :
+ChessUpBoard::ChessUpBoard(const BoardAddress& address, Connection *connection, ChessUpTransport *transport, QObject *parent) :
     RemoteBoard(address, parent),
-    m_connection(connection)
+    m_connection(connection),
+    m_transport(transport),
+    m_writeTimer(new QTimer(this)),
+    m_idleTimer(new QTimer(this))
 {
-    m_uartService = connection->createServiceObject(QBluetoothUuid(CHESSUP_SERVICE), this);
-    connect(m_uartService, &QLowEnergyService::stateChanged, this, &ChessUpBoard::discoveryFinished);
-    connect(m_uartService, &QLowEnergyService::characteristicChanged, this, [this](const QLowEnergyCharacteristic &characteristic, const QByteArray &value) {
-        if (characteristic == m_rxCharacteristic && !m_inAckLoop)
-            readFromBoard(value);
+    m_transport->setParent(this);
+    const QString traceFileName = qEnvironmentVariable("BLUECHEESE_TRACE");
+    if (!traceFileName.isEmpty())
+        m_trace.reset(ChessUpTraceWriter::create(traceFileName));
+    m_writeTimer->setSingleShot(true);
+    connect(m_writeTimer, &QTimer::timeout, this, &ChessUpBoard::writeTimedOut);
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(IDLE_TIMEOUT);
+    connect(m_idleTimer, &QTimer::timeout, this, [this]() {
+        qDebug("ChessUpBoard: idle, relaxing the link");
+        recordLowLatency(false);
+        m_transport->setLowLatency(false);
+    });
+    connect(m_transport, &ChessUpTransport::unexpectedWrite, this, &ChessUpBoard::recordUnexpectedWrite);
+    connect(m_transport, &ChessUpTransport::connectionParametersChanged, this, [this](double interval, int latency, int supervisionTimeout) {
+        qDebug("ChessUpBoard: connection interval %.2f ms, latency %d, supervision timeout %d ms",
+               interval, latency, supervisionTimeout);
+        recordConnectionParameters(interval, latency, supervisionTimeout);
     });
-    connect(m_uartService, &QLowEnergyService::characteristicWritten, this, [this]() {
-        m_writeAcked = true;
+    connect(m_transport, &ChessUpTransport::ready, this, &ChessUpBoard::transportReady);
+    connect(m_transport, &ChessUpTransport::received, this, [this](const QByteArray &value) {
+        if (m_trace)
+            m_trace->record(ChessUpTraceEvent::Received, value);
+        readFromBoard(value);
+    });
+    connect(m_transport, &ChessUpTransport::written, this, [this](const QByteArray &value) {
+        if (m_trace)
+            m_trace->record(ChessUpTraceEvent::Written, value);
+        // Skip confirmations of acknowledgements sent while a request
+        // awaited its response.
+        if (value == m_currentWrite.data)
+            writeFinished();
+    });
+    connect(m_transport, &ChessUpTransport::writeFailed, this, [this]() {
+        if (m_trace)
+            m_trace->record(ChessUpTraceEvent::WriteFailed);
+        if (m_writeState == WriteState::Writing)
+            writeFailed();
     });
-    m_batteryService = connection->createServiceObject(QBluetoothUuid::ServiceClassUuid::BatteryService, this);
-    connect(m_batteryService, &QLowEnergyService::stateChanged, this, &ChessUpBoard::discoveryFinished);
-    m_batteryService->discoverDetails(QLowEnergyService::FullDiscovery);
-    m_uartService->discoverDetails(QLowEnergyService::FullDiscovery);
 }
 
-void ChessUpBoard::discoveryFinished()
+void ChessUpBoard::transportReady()
 {
-    if (m_uartService->state() != QLowEnergyService::RemoteServiceDiscovered ||
-        m_batteryService->state() != QLowEnergyService::RemoteServiceDiscovered)
-        return;
-    qDebug("ChessUpBoard::discoveryFinished");
-    m_txCharacteristic = m_uartService->characteristic(QBluetoothUuid(RX_CHARACTERISTIC_UUID));
-    Q_ASSERT(m_txCharacteristic.isValid());
-    m_rxCharacteristic = m_uartService->characteristic(QBluetoothUuid(TX_CHARACTERISTIC_UUID));
-    Q_ASSERT(m_rxCharacteristic.isValid());
-    Q_ASSERT(m_rxCharacteristic.properties() & QLowEnergyCharacteristic::Notify);
-    m_batteryCharacteristic = m_batteryService->characteristic(QBluetoothUuid::CharacteristicType::BatteryLevel);
-    Q_ASSERT(m_batteryCharacteristic.isValid());
-    m_rxClientCharacteristicConfiguration = m_rxCharacteristic.clientCharacteristicConfiguration();
-    Q_ASSERT(m_rxClientCharacteristicConfiguration.isValid());
-    m_batteryClientCharacteristicConfiguration = m_batteryCharacteristic.clientCharacteristicConfiguration();
-    Q_ASSERT(m_batteryClientCharacteristicConfiguration.isValid());
-    m_batteryService->readCharacteristic(m_batteryCharacteristic);
-    // Enable notifications.
-#ifdef __linux__
-    m_uartService->writeDescriptor(m_rxClientCharacteristicConfiguration, QByteArray::fromHex("0100"));
-    m_batteryService->writeDescriptor(m_batteryClientCharacteristicConfiguration, QByteArray::fromHex("0100"));
-#else
-    uint8_t buf[] = {0x01, 0x00};
-    m_uartService->writeDescriptor(m_rxClientCharacteristicConfiguration, QByteArray::fromRawData(reinterpret_cast<const char *>(buf), sizeof(buf)));
-    m_batteryService->writeDescriptor(m_batteryClientCharacteristicConfiguration, QByteArray::fromRawData(reinterpret_cast<const char *>(buf), sizeof(buf)));
-#endif
-    emit m_connection->connected(this);
+    qDebug("ChessUpBoard::transportReady");
+    if (m_connection)
+        emit m_connection->connected(this);
+    // A game usually follows straight on from connecting.
+    markActive();
     sendInit();
 }
 
@@ -110,7 +160,25 @@ void ChessUpBoard::readFromBoard(const QByteArray& data)
     qDebug("ChessUpBoard::readFromBoard(%s)", qPrintable(data.toHex(' ')));
     if (data.isEmpty())
         return;
-    m_responseRead = true;
+    if (m_currentWrite.response != 0 && static_cast<uint8_t>(data[0]) == m_currentWrite.response) {
+        if (m_writeState == WriteState::AwaitingResponse) {
+            const qint64 latency = m_currentWrite.sent.elapsed();
+            qDebug("ChessUpBoard::readFromBoard: answered in %lld ms", latency);
+            recordNotificationLatency(m_currentWrite.confirmed.elapsed());
+            recordRequestLatency(latency);
+            m_writeTimer->stop();
+            m_writeState = WriteState::Idle;
+            m_currentWrite = PendingWrite();
+        } else if (m_writeState == WriteState::Writing) {
+            m_currentWrite.answered = true;
+        }
+    }
+    if (isPlay(static_cast<uint8_t>(data[0])))
+        markActive();
+    // A change to the position on the board invalidates the hints it
+    // shows; answers to commands leave them alone.
+    if (changesPosition(static_cast<uint8_t>(data[0])))
+        m_lastAssistance.clear();
     switch (static_cast<uint8_t>(data[0])) {
     case RESP_OK:
         break;
@@ -129,15 +197,7 @@ void ChessUpBoard::readFromBoard(const QByteArray& data)
     }
     case RESP_MOVE: {
         Q_ASSERT(data.size() == 6);
-        QByteArray cmdOk = QByteArray::fromRawData(reinterpret_cast<const char *>(&CMD_OK), 1);
-        m_writeAcked = false;
-        m_inAckLoop = true;
-        while (!m_writeAcked) {
-            m_uartService->writeCharacteristic(m_txCharacteristic, cmdOk, QLowEnergyService::WriteWithResponse);
-            QObject().thread()->usleep(25*1000);
-            qApp->processEvents();
-        }
-        m_inAckLoop = false;
+        acknowledge(CMD_OK);
         bool newMove = data != m_previousMove;
         m_previousMove = data;
         if (newMove) {
@@ -151,15 +211,7 @@ void ChessUpBoard::readFromBoard(const QByteArray& data)
     }
     case RESP_PROMOTION: {
         Q_ASSERT(data.size() == 2);
-        QByteArray cmdOk = QByteArray::fromRawData(reinterpret_cast<const char *>(&CMD_PROMOTION_OK), 1);
-        m_writeAcked = false;
-        m_inAckLoop = true;
-        while (!m_writeAcked) {
-            m_uartService->writeCharacteristic(m_txCharacteristic, cmdOk, QLowEnergyService::WriteWithResponse);
-            QObject().thread()->usleep(25*1000);
-            qApp->processEvents();
-        }
-        m_inAckLoop = false;
+        acknowledge(CMD_PROMOTION_OK);
         Piece piece = Piece::Queen;
         switch (data[1]) {
         case 1:
@@ -180,34 +232,204 @@ void ChessUpBoard::readFromBoard(const QByteArray& data)
             break;
         }
         emit remotePromotion(piece);
+        break;
     }
     case RESP_UNDO:
         emit remoteUndo();
         break;
+    case RESP_TOUCH: {
+        // The touch notification carries the column and row of the lifted
+        // piece in the same order as RESP_MOVE.
+        if (data.size() < 3)
+            break;
+        Square square(data[2], data[1]);
+        if (square.isValid())
+            emit remotePieceLifted(square);
+        break;
+    }
     }
+    scheduleWrite();
 }
 
 void ChessUpBoard::sendCommand(uint8_t cmd, const QByteArray& payload)
 {
+    if (cmd != CMD_ASSISTANCE)
+        m_lastAssistance.clear();
+    if (cmd != CMD_GET_STATE)
+        markActive();
     writeToBoard(QByteArray::fromRawData(reinterpret_cast<const char *>(&cmd), 1) + payload);
 }
 
 void ChessUpBoard::writeToBoard(const QByteArray& data)
 {
     qDebug("ChessUpBoard::writeToBoard(%s)", qPrintable(data.toHex(' ')));
-    m_responseRead = false;
-    m_uartService->writeCharacteristic(m_txCharacteristic, data, QLowEnergyService::WriteWithResponse);
-#ifndef __linux__
-    if (static_cast<uint8_t>(data.at(0)) == CMD_GET_STATE ||
-        static_cast<uint8_t>(data.at(0)) == CMD_SETTINGS ||
-        static_cast<uint8_t>(data.at(0)) == CMD_PROMOTION) {
-        qApp->processEvents();
-        while (!m_responseRead) {
-            QObject().thread()->usleep(25*1000);
-            qApp->processEvents();
+    PendingWrite write;
+    // Copy, as commands are built with QByteArray::fromRawData.
+    write.data = QByteArray(data.constData(), data.size());
+    const uint8_t cmd = static_cast<uint8_t>(data.at(0));
+    write.response = expectedResponse(cmd);
+    if (isCoalescable(cmd)) {
+        for (int i=m_writeQueue.size()-1;i>=0;--i) {
+            const uint8_t queuedCmd = static_cast<uint8_t>(m_writeQueue.at(i).data.at(0));
+            if (isOrdered(queuedCmd))
+                break;
+            if (queuedCmd == cmd) {
+                qDebug("ChessUpBoard::writeToBoard: supersedes %s", qPrintable(m_writeQueue.at(i).data.toHex(' ')));
+                m_writeQueue.removeAt(i);
+                break;
+            }
         }
     }
-#endif
+    m_writeQueue.enqueue(write);
+    scheduleWrite();
+}
+
+// Commands are written from the event loop so that those issued together,
+// such as the settings, position and options of a new game, are all queued
+// and coalesced before the first goes out.
+void ChessUpBoard::scheduleWrite()
+{
+    if (m_writeScheduled)
+        return;
+    m_writeScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        m_writeScheduled = false;
+        writeNext();
+    }, Qt::QueuedConnection);
+}
+
+void ChessUpBoard::acknowledge(uint8_t cmd)
+{
+    qDebug("ChessUpBoard::acknowledge(%02x)", cmd);
+    PendingWrite write;
+    write.data = QByteArray(1, static_cast<char>(cmd));
+    write.acknowledgement = true;
+    // Ahead of everything but earlier acknowledgements.
+    int index = 0;
+    while (index < m_writeQueue.size() && m_writeQueue.at(index).acknowledgement)
+        ++index;
+    m_writeQueue.insert(index, write);
+    writeNext();
+}
+
+void ChessUpBoard::writeNext()
+{
+    if (!m_transport->isReady())
+        return;
+    // The link is free while the board works on its answer, and the board
+    // may be waiting for an acknowledgement before it gives one. These are
+    // not tracked: the board repeats the notification if one is lost.
+    while (m_writeState == WriteState::AwaitingResponse &&
+           !m_writeQueue.isEmpty() && m_writeQueue.head().acknowledgement) {
+        const PendingWrite write = m_writeQueue.dequeue();
+        transmit(write.data);
+    }
+    if (m_writeState != WriteState::Idle || m_writeQueue.isEmpty())
+        return;
+    m_currentWrite = m_writeQueue.dequeue();
+    sendCurrentWrite();
+}
+
+void ChessUpBoard::sendCurrentWrite()
+{
+    ++m_currentWrite.attempts;
+    if (!m_currentWrite.sent.isValid())
+        m_currentWrite.sent.start();
+    m_writeState = WriteState::Writing;
+    m_writeTimer->start(WRITE_TIMEOUT);
+    transmit(m_currentWrite.data);
+}
+
+void ChessUpBoard::transmit(const QByteArray& data)
+{
+    if (m_trace)
+        m_trace->record(ChessUpTraceEvent::Write, data);
+    m_transport->write(data);
+}
+
+void ChessUpBoard::writeFinished()
+{
+    if (m_writeState != WriteState::Writing)
+        return;
+    if (m_currentWrite.response != 0 && !m_currentWrite.answered) {
+        m_currentWrite.confirmed.start();
+        m_writeState = WriteState::AwaitingResponse;
+        m_writeTimer->start(RESPONSE_TIMEOUT);
+        return;
+    }
+    recordRequestLatency(m_currentWrite.sent.elapsed());
+    finishWrite();
+}
+
+void ChessUpBoard::writeFailed()
+{
+    // The board never received the write, so it is always safe to retry.
+    if (m_writeState == WriteState::Writing)
+        retryWrite(false);
+}
+
+void ChessUpBoard::writeTimedOut()
+{
+    switch (m_writeState) {
+    case WriteState::Idle:
+        break;
+    case WriteState::Writing:
+        retryWrite(false);
+        break;
+    case WriteState::AwaitingResponse:
+        retryWrite(true);
+        break;
+    case WriteState::BackingOff:
+        sendCurrentWrite();
+        break;
+    }
+}
+
+void ChessUpBoard::retryWrite(bool delivered)
+{
+    m_writeTimer->stop();
+    const uint8_t cmd = static_cast<uint8_t>(m_currentWrite.data.at(0));
+    if (m_currentWrite.acknowledgement) {
+        qDebug("ChessUpBoard::retryWrite: retrying acknowledgement");
+        recordRequestRetry();
+        m_writeState = WriteState::BackingOff;
+        m_writeTimer->start(ACK_RETRY_INTERVAL);
+        return;
+    }
+    if (m_currentWrite.attempts < MAX_ATTEMPTS && (!delivered || isIdempotent(cmd))) {
+        const int backoff = RETRY_BACKOFF << (m_currentWrite.attempts - 1);
+        qDebug("ChessUpBoard::retryWrite: retrying %02x in %d ms", cmd, backoff);
+        recordRequestRetry();
+        m_writeState = WriteState::BackingOff;
+        m_writeTimer->start(backoff);
+        return;
+    }
+    qWarning("ChessUpBoard::retryWrite: giving up on %s", qPrintable(m_currentWrite.data.toHex(' ')));
+    recordRequestFailure();
+    // The board may or may not have acted on the command, so find out
+    // where it is rather than letting the game drift out of step.
+    const bool resynchronize = m_currentWrite.response != 0 && cmd != CMD_GET_STATE;
+    finishWrite();
+    if (resynchronize)
+        requestRemoteBoardState();
+}
+
+void ChessUpBoard::finishWrite()
+{
+    m_writeTimer->stop();
+    m_writeState = WriteState::Idle;
+    m_currentWrite = PendingWrite();
+    writeNext();
+}
+
+void ChessUpBoard::markActive()
+{
+    if (!m_idleTimer->isActive()) {
+        qDebug("ChessUpBoard: play started, asking for a low latency link");
+        recordLowLatency(true);
+        m_transport->setLowLatency(true);
+    }
+    m_idleTimer->start();
 }
 
 void ChessUpBoard::sendInit()
@@ -401,6 +623,13 @@ void ChessUpBoard::requestResignation(Colour requestor)
 
 void ChessUpBoard::sendAssistance(const QList<AssistanceColour>& colours)
 {
+    // Progressive assistance re-sends the full list each time a pass
+    // completes; only use the link when the LEDs would actually change.
+    if (colours == m_lastAssistance) {
+        qDebug("ChessUpBoard::sendAssistance: unchanged");
+        return;
+    }
+    m_lastAssistance = colours;
     QBitArray bits((2 * colours.size() + 7) / 8 * 8);
     for (int i=0;i<colours.size();++i) {
         int byte = i / 4;
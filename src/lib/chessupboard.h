@@ -20,23 +20,26 @@
 #ifndef CHESSUPBOARD_H
 #define CHESSUPBOARD_H
 
-#include <QLowEnergyCharacteristic>
-#include <QLowEnergyDescriptor>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QQueue>
+#include <QScopedPointer>
 #include "chessboard.h"
+#include "chessuptrace.h"
+#include "connection.h"
 
-class QLowEnergyService;
+class QTimer;
 
 namespace Chessboard {
 
-class BleConnection;
-
-const QLatin1String CHESSUP_SERVICE("{6E400001-B5A3-F393-E0A9-E50E24DCCA9E}"); // Nordic UART Service
+class ChessUpTransport;
 
 class ChessUpBoard : public RemoteBoard
 {
     Q_OBJECT
 public:
-    ChessUpBoard(const BoardAddress& address, BleConnection *connection, QObject *parent = nullptr);
+    // Takes ownership of the transport.
+    ChessUpBoard(const BoardAddress& address, Connection *connection, ChessUpTransport *transport, QObject *parent = nullptr);
 public slots:
     void requestMove(int fromRow, int fromCol, int toRow, int toCol) override;
     void requestRemoteBoardState() override;
@@ -51,23 +54,60 @@ private slots:
     void writeToBoard(const QByteArray& data);
     void sendCommand(uint8_t cmd, const QByteArray& payload = QByteArray());
     void sendInit();
-    void discoveryFinished();
+    void transportReady();
+    void writeNext();
+    void writeFinished();
+    void writeFailed();
+    void writeTimedOut();
 private:
+    // Requests go to the board one at a time. A request is finished when
+    // the board confirms the write or, for commands the board answers,
+    // when a notification with the expected response arrives. Requests
+    // that time out are retried with exponential backoff.
+    enum class WriteState {
+        Idle,
+        Writing,
+        AwaitingResponse,
+        BackingOff
+    };
+    struct PendingWrite {
+        QByteArray data;
+        // Acknowledgements of moves and promotions made on the board. The
+        // board repeats the notification until one gets through, so they
+        // jump the queue and are retried until they succeed.
+        bool acknowledgement {};
+        // The response that answers the command, or zero if it has none.
+        uint8_t response {};
+        // Some stacks deliver the response before confirming the write.
+        bool answered {};
+        int attempts {};
+        QElapsedTimer sent;
+        // Started when the board confirms a write it has yet to answer.
+        QElapsedTimer confirmed;
+    };
+
     BoardState boardStateFromRemote(const QByteArray& data);
+    void acknowledge(uint8_t cmd);
+    void scheduleWrite();
+    void sendCurrentWrite();
+    void transmit(const QByteArray& data);
+    void retryWrite(bool delivered);
+    void finishWrite();
+    void markActive();
 
-    BleConnection *m_connection;
-    QLowEnergyService *m_uartService;
-    QLowEnergyService *m_batteryService;
-    QLowEnergyCharacteristic m_rxCharacteristic;
-    QLowEnergyCharacteristic m_txCharacteristic;
-    QLowEnergyCharacteristic m_batteryCharacteristic;
-    QLowEnergyDescriptor m_rxClientCharacteristicConfiguration;
-    QLowEnergyDescriptor m_batteryClientCharacteristicConfiguration;
+    QPointer<Connection> m_connection;
+    ChessUpTransport *m_transport;
     QByteArray m_previousMove;
-    bool m_writeAcked {false};
-    bool m_responseRead {false};
-    bool m_sendingMove {false};
-    bool m_inAckLoop {false};
+    QList<AssistanceColour> m_lastAssistance;
+    QQueue<PendingWrite> m_writeQueue;
+    PendingWrite m_currentWrite;
+    WriteState m_writeState {WriteState::Idle};
+    QTimer *m_writeTimer;
+    bool m_writeScheduled {false};
+    // Returns the link to a relaxed connection interval once play stops.
+    QTimer *m_idleTimer;
+    // Records the session when BLUECHEESE_TRACE names a file.
+    QScopedPointer<ChessUpTraceWriter> m_trace;
 };
 
 }
@@ -0,0 +1,55 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHESSUPPROTOCOL_H
+#define CHESSUPPROTOCOL_H
+
+#include <QtGlobal>
+
+namespace Chessboard {
+
+// Opcodes of the ChessUp protocol, shared by ChessUpBoard and the
+// simulator that stands in for the board.
+namespace ChessUp {
+    const uint8_t CMD_ASSISTANCE      = 0x10;
+    const uint8_t CMD_OK              = 0x21;
+    const uint8_t CMD_PROMOTION_OK    = 0x23;
+    const uint8_t CMD_SET_STATE       = 0x66;
+    const uint8_t CMD_GET_STATE       = 0x67;
+    const uint8_t CMD_PROMOTION       = 0x97;
+    const uint8_t CMD_SEND_MOVE       = 0x99;
+    const uint8_t CMD_WIN             = 0xb6;
+    const uint8_t CMD_SETTINGS        = 0xb9;
+    const uint8_t RESP_MOVE_OK        = 0x22;
+    const uint8_t RESP_PROMOTION_OK   = 0x23;
+    const uint8_t RESP_OK             = 0x24;
+    const uint8_t RESP_BOARD_STATE    = 0x67;
+    const uint8_t RESP_PROMOTION      = 0x97;
+    const uint8_t RESP_MOVE           = 0xa3;
+    const uint8_t RESP_SET_STATE_OK   = 0xb1;
+    const uint8_t RESP_TOUCH          = 0xb8;
+    const uint8_t RESP_UNDO           = 0xbd;
+    const uint8_t MODE_REMOTE         = 0x02;
+    const uint8_t MODE_AI             = 0x01;
+    const uint8_t MODE_LOCAL          = 0x05;
+}
+
+}
+
+#endif // CHESSUPPROTOCOL_H
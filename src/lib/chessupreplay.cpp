@@ -0,0 +1,151 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTimer>
+
+#include "chessupreplay.h"
+
+namespace {
+    // How long to wait for a recorded write that the board does not make.
+    const int STALL_TIMEOUT = 2000;
+}
+
+namespace Chessboard {
+
+ChessUpReplay::ChessUpReplay(const QList<ChessUpTraceEvent>& events, double speed, QObject *parent) :
+    ChessUpTransport(parent),
+    m_events(events),
+    m_speed(speed),
+    m_deliveryTimer(new QTimer(this)),
+    m_stallTimer(new QTimer(this))
+{
+    m_deliveryTimer->setSingleShot(true);
+    m_deliveryTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_deliveryTimer, &QTimer::timeout, this, &ChessUpReplay::deliverNext);
+    m_stallTimer->setSingleShot(true);
+    m_stallTimer->setInterval(STALL_TIMEOUT);
+    connect(m_stallTimer, &QTimer::timeout, this, &ChessUpReplay::skipWrite);
+    QMetaObject::invokeMethod(this, [this]() {
+        m_ready = true;
+        emit ready();
+        scheduleNext();
+    }, Qt::QueuedConnection);
+}
+
+void ChessUpReplay::write(const QByteArray& data)
+{
+    if (m_index < m_events.size() && m_events[m_index].type == ChessUpTraceEvent::Write) {
+        const ChessUpTraceEvent& event = m_events[m_index];
+        if (event.data != data) {
+            mismatch();
+            qWarning("ChessUpReplay::write: wrote %s, recorded %s",
+                     qPrintable(data.toHex(' ')), qPrintable(event.data.toHex(' ')));
+        }
+        m_writes.enqueue(data);
+        m_time = event.time;
+        ++m_index;
+        m_stallTimer->stop();
+        scheduleNext();
+        return;
+    }
+    // Deferred writes can land either side of a notification delivered in
+    // the same pass of the event loop, so accept the next recorded write
+    // early if it matches.
+    for (qsizetype index = m_index;index<m_events.size();++index) {
+        if (m_events[index].type != ChessUpTraceEvent::Write)
+            continue;
+        if (m_events[index].data == data) {
+            m_events.removeAt(index);
+            m_writes.enqueue(data);
+            return;
+        }
+        break;
+    }
+    mismatch();
+    qWarning("ChessUpReplay::write: unexpected %s", qPrintable(data.toHex(' ')));
+    // Confirm it anyway, so that the board carries on.
+    QMetaObject::invokeMethod(this, [this, data]() {
+        emit written(data);
+    }, Qt::QueuedConnection);
+}
+
+void ChessUpReplay::scheduleNext()
+{
+    if (!m_ready || m_deliveryTimer->isActive() || m_stallTimer->isActive())
+        return;
+    if (m_index >= m_events.size()) {
+        if (!m_finished) {
+            m_finished = true;
+            qDebug("ChessUpReplay::scheduleNext: finished with %d mismatches", m_mismatches);
+            emit finished();
+        }
+        return;
+    }
+    const ChessUpTraceEvent& event = m_events[m_index];
+    if (event.type == ChessUpTraceEvent::Write) {
+        m_stallTimer->start();
+        return;
+    }
+    const qint64 delay = (m_speed > 0) ? static_cast<qint64>((event.time - m_time) / 1000 / m_speed) : 0;
+    m_deliveryTimer->start(static_cast<int>(qMax<qint64>(0, delay)));
+}
+
+void ChessUpReplay::deliverNext()
+{
+    const ChessUpTraceEvent event = m_events[m_index++];
+    m_time = event.time;
+    switch (event.type) {
+    case ChessUpTraceEvent::Written:
+        if (!m_writes.isEmpty())
+            emit written(m_writes.dequeue());
+        break;
+    case ChessUpTraceEvent::WriteFailed:
+        if (!m_writes.isEmpty())
+            m_writes.dequeue();
+        emit writeFailed();
+        break;
+    case ChessUpTraceEvent::Received:
+        emit received(event.data);
+        break;
+    case ChessUpTraceEvent::Write:
+        Q_ASSERT(event.type != ChessUpTraceEvent::Write);
+        break;
+    }
+    scheduleNext();
+}
+
+void ChessUpReplay::mismatch()
+{
+    ++m_mismatches;
+    emit unexpectedWrite();
+}
+
+void ChessUpReplay::skipWrite()
+{
+    const ChessUpTraceEvent& event = m_events[m_index];
+    mismatch();
+    qWarning("ChessUpReplay::skipWrite: %s never written", qPrintable(event.data.toHex(' ')));
+    // Keep the confirmations that follow in step.
+    m_writes.enqueue(event.data);
+    m_time = event.time;
+    ++m_index;
+    scheduleNext();
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHESSUPREPLAY_H
+#define CHESSUPREPLAY_H
+
+#include <QQueue>
+
+#include "chessuptrace.h"
+#include "chessuptransport.h"
+
+class QTimer;
+
+namespace Chessboard {
+
+// Plays a recorded trace back in place of the board. The board's side of
+// the trace is delivered at the recorded pace divided by the speed, or at
+// once if the speed is zero, but never ahead of the write that preceded
+// it in the recording. Writes that differ from the recording are logged.
+class ChessUpReplay : public ChessUpTransport
+{
+    Q_OBJECT
+public:
+    ChessUpReplay(const QList<ChessUpTraceEvent>& events, double speed, QObject *parent = nullptr);
+    bool isReady() const override { return m_ready; }
+    void write(const QByteArray& data) override;
+    int mismatches() const { return m_mismatches; }
+signals:
+    void finished();
+private:
+    void scheduleNext();
+    void deliverNext();
+    void skipWrite();
+    void mismatch();
+
+    QList<ChessUpTraceEvent> m_events;
+    qsizetype m_index {};
+    double m_speed;
+    qint64 m_time {};
+    // Writes made during the replay, waiting for their recorded
+    // confirmations.
+    QQueue<QByteArray> m_writes;
+    QTimer *m_deliveryTimer;
+    QTimer *m_stallTimer;
+    int m_mismatches {};
+    bool m_ready {false};
+    bool m_finished {false};
+};
+
+}
+
+#endif // CHESSUPREPLAY_H
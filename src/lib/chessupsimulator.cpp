@@ -0,0 +1,376 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QStringList>
+#include <QTimer>
+
+#include "chessupprotocol.h"
+#include "chessupsimulator.h"
+
+using namespace Chessboard::ChessUp;
+
+namespace {
+    // How often a move or promotion made on the board is repeated until the
+    // app acknowledges it.
+    const int REPEAT_INTERVAL = 250;
+    // How far apart the steps of a script are played.
+    const int SCRIPT_INTERVAL = 100;
+
+    QByteArray packet(uint8_t opcode)
+    {
+        return QByteArray(1, static_cast<char>(opcode));
+    }
+
+    bool isScriptStep(const QString& step)
+    {
+        using Chessboard::Square;
+        if (step == QLatin1String("undo"))
+            return true;
+        if (step.startsWith(QLatin1String("touch-")))
+            return Square::fromAlgebraicString(step.mid(6)).isValid();
+        return step.size() == 4 && Square::fromAlgebraicString(step.left(2)).isValid() &&
+               Square::fromAlgebraicString(step.mid(2)).isValid();
+    }
+}
+
+namespace Chessboard {
+
+QString ChessUpSimulator::Options::toString() const
+{
+    QStringList parts;
+    if (latency != 0)
+        parts.append(QString::fromLatin1("latency=%1").arg(latency));
+    if (loss != 0)
+        parts.append(QString::fromLatin1("loss=%1").arg(loss));
+    if (seed != 0)
+        parts.append(QString::fromLatin1("seed=%1").arg(seed));
+    if (drop != 0)
+        parts.append(QString::fromLatin1("drop=%1").arg(drop));
+    if (reply)
+        parts.append(QLatin1String("reply"));
+    if (!script.isEmpty())
+        parts.append(QString::fromLatin1("script=%1").arg(script.join('/')));
+    return parts.join(',');
+}
+
+bool ChessUpSimulator::Options::fromString(const QString& s, Options *options)
+{
+    Options result;
+    const QStringList parts = s.split(',', Qt::SkipEmptyParts);
+    for (const QString& part : parts) {
+        const QString key = part.section('=', 0, 0).trimmed();
+        const QString value = part.section('=', 1).trimmed();
+        bool ok = true;
+        if (key == QLatin1String("latency")) {
+            result.latency = value.toInt(&ok);
+            ok = ok && result.latency >= 0;
+        } else if (key == QLatin1String("loss")) {
+            result.loss = value.toDouble(&ok);
+            ok = ok && result.loss >= 0 && result.loss < 1;
+        } else if (key == QLatin1String("seed")) {
+            result.seed = value.toUInt(&ok);
+        } else if (key == QLatin1String("drop")) {
+            result.drop = value.toInt(&ok);
+            ok = ok && result.drop >= 0;
+        } else if (key == QLatin1String("reply")) {
+            ok = value.isEmpty();
+            result.reply = true;
+        } else if (key == QLatin1String("script")) {
+            result.script = value.split('/', Qt::SkipEmptyParts);
+            ok = !result.script.isEmpty();
+            for (const QString& step : std::as_const(result.script))
+                ok = ok && isScriptStep(step);
+        } else {
+            ok = false;
+        }
+        if (!ok)
+            return false;
+    }
+    *options = result;
+    return true;
+}
+
+ChessUpSimulator::ChessUpSimulator(const Options& options, QObject *parent) :
+    ChessUpTransport(parent),
+    m_options(options),
+    m_random(options.seed ? options.seed : QRandomGenerator::global()->generate()),
+    m_board(BoardState::newGame()),
+    m_repeatTimer(new QTimer(this)),
+    m_scriptTimer(new QTimer(this))
+{
+    m_repeatTimer->setInterval(REPEAT_INTERVAL);
+    connect(m_repeatTimer, &QTimer::timeout, this, [this]() {
+        notify(m_unacknowledged);
+    });
+    m_scriptTimer->setInterval(SCRIPT_INTERVAL);
+    connect(m_scriptTimer, &QTimer::timeout, this, &ChessUpSimulator::playScriptStep);
+    // As if the services had been discovered.
+    QTimer::singleShot(m_options.latency, this, [this]() {
+        m_ready = true;
+        emit ready();
+    });
+}
+
+void ChessUpSimulator::write(const QByteArray& data)
+{
+    if (isLost()) {
+        qDebug("ChessUpSimulator::write: lost %s", qPrintable(data.toHex(' ')));
+        return;
+    }
+    QTimer::singleShot(m_options.latency, this, [this, data]() {
+        // The write is confirmed ahead of any response to it.
+        QTimer::singleShot(m_options.latency, this, [this, data]() {
+            emit written(data);
+        });
+        handleCommand(data);
+    });
+}
+
+void ChessUpSimulator::handleCommand(const QByteArray& data)
+{
+    qDebug("ChessUpSimulator::handleCommand(%s)", qPrintable(data.toHex(' ')));
+    if (data.isEmpty())
+        return;
+    switch (static_cast<uint8_t>(data[0])) {
+    case CMD_GET_STATE:
+        notify(encodeBoardState());
+        if (m_scriptStep == 0 && !m_options.script.isEmpty() && !m_scriptTimer->isActive())
+            m_scriptTimer->start();
+        break;
+    case CMD_SET_STATE:
+        m_board = decodeBoardState(data);
+        m_history.clear();
+        m_unacknowledged.clear();
+        m_repeatTimer->stop();
+        notify(packet(RESP_SET_STATE_OK));
+        break;
+    case CMD_SETTINGS:
+        notify(packet(RESP_OK));
+        break;
+    case CMD_SEND_MOVE: {
+        if (data.size() < 3)
+            break;
+        const uint8_t from = static_cast<uint8_t>(data[1]);
+        const uint8_t to = static_cast<uint8_t>(data[2]);
+        const BoardState before = m_board;
+        bool promotionRequired = false;
+        if (m_board.move(from >> 3, from & 0x7, to >> 3, to & 0x7, &promotionRequired))
+            m_history.append(before);
+        else
+            qDebug("ChessUpSimulator::handleCommand: illegal move");
+        notify(packet(RESP_MOVE_OK));
+        if (m_options.reply && !promotionRequired)
+            replyToMove();
+        break;
+    }
+    case CMD_PROMOTION: {
+        if (data.size() < 2)
+            break;
+        switch (data[1]) {
+        case 1:
+            m_board.promote(Piece::Rook);
+            break;
+        case 2:
+            m_board.promote(Piece::Knight);
+            break;
+        case 3:
+            m_board.promote(Piece::Bishop);
+            break;
+        default:
+            m_board.promote(Piece::Queen);
+            break;
+        }
+        notify(packet(RESP_PROMOTION_OK));
+        if (m_options.reply)
+            replyToMove();
+        break;
+    }
+    case CMD_OK:
+    case CMD_PROMOTION_OK:
+        acknowledged();
+        break;
+    default:
+        // Settings for assistance and results change nothing the app can
+        // read back.
+        break;
+    }
+}
+
+void ChessUpSimulator::acknowledged()
+{
+    if (m_unacknowledged.isEmpty())
+        return;
+    const bool move = static_cast<uint8_t>(m_unacknowledged[0]) == RESP_MOVE;
+    m_unacknowledged.clear();
+    m_repeatTimer->stop();
+    if (move && m_options.reply && m_board.isPromotionRequired())
+        choosePromotion(Piece::Queen);
+}
+
+void ChessUpSimulator::replyToMove()
+{
+    QMetaObject::invokeMethod(this, [this]() {
+        const QList<QPair<Square, Square> > moves = m_board.legalMoves();
+        if (!moves.isEmpty())
+            playMove(moves.first().first, moves.first().second);
+    }, Qt::QueuedConnection);
+}
+
+void ChessUpSimulator::playScriptStep()
+{
+    const QString step = m_options.script.value(m_scriptStep++);
+    if (m_scriptStep >= m_options.script.size())
+        m_scriptTimer->stop();
+    qDebug("ChessUpSimulator::playScriptStep(%s)", qPrintable(step));
+    if (step == QLatin1String("undo"))
+        undo();
+    else if (step.startsWith(QLatin1String("touch-")))
+        liftPiece(Square::fromAlgebraicString(step.mid(6)));
+    else
+        playMove(Square::fromAlgebraicString(step.left(2)), Square::fromAlgebraicString(step.mid(2)));
+}
+
+void ChessUpSimulator::playMove(const Square& from, const Square& to)
+{
+    const BoardState before = m_board;
+    if (!m_board.move(from, to)) {
+        qWarning("ChessUpSimulator::playMove: illegal move");
+        return;
+    }
+    m_history.append(before);
+    QByteArray data = packet(RESP_MOVE);
+    // Counts moves so that a repeated move is not taken for a repeated
+    // notification.
+    data.append(static_cast<char>(m_history.size()));
+    data.append(static_cast<char>(from.col));
+    data.append(static_cast<char>(from.row));
+    data.append(static_cast<char>(to.col));
+    data.append(static_cast<char>(to.row));
+    notifyUntilAcknowledged(data);
+}
+
+void ChessUpSimulator::choosePromotion(Piece piece)
+{
+    uint8_t code;
+    switch (piece) {
+    case Piece::Rook:
+        code = 1;
+        break;
+    case Piece::Knight:
+        code = 2;
+        break;
+    case Piece::Bishop:
+        code = 3;
+        break;
+    default:
+        code = 4;
+        break;
+    }
+    if (!m_board.promote(piece)) {
+        qWarning("ChessUpSimulator::choosePromotion: no promotion required");
+        return;
+    }
+    QByteArray data = packet(RESP_PROMOTION);
+    data.append(static_cast<char>(code));
+    notifyUntilAcknowledged(data);
+}
+
+void ChessUpSimulator::liftPiece(const Square& square)
+{
+    QByteArray data = packet(RESP_TOUCH);
+    data.append(static_cast<char>(square.col));
+    data.append(static_cast<char>(square.row));
+    notify(data);
+}
+
+void ChessUpSimulator::undo()
+{
+    if (m_history.isEmpty())
+        return;
+    m_board = m_history.takeLast();
+    notify(packet(RESP_UNDO));
+}
+
+void ChessUpSimulator::notify(const QByteArray& data)
+{
+    if (isLost()) {
+        qDebug("ChessUpSimulator::notify: lost %s", qPrintable(data.toHex(' ')));
+        return;
+    }
+    QTimer::singleShot(m_options.latency, this, [this, data]() {
+        emit received(data);
+    });
+}
+
+void ChessUpSimulator::notifyUntilAcknowledged(const QByteArray& data)
+{
+    m_unacknowledged = data;
+    notify(data);
+    m_repeatTimer->start();
+}
+
+bool ChessUpSimulator::isLost()
+{
+    return m_options.loss > 0 && m_random.generateDouble() < m_options.loss;
+}
+
+QByteArray ChessUpSimulator::encodeBoardState() const
+{
+    QByteArray data(73, 0);
+    data[0] = static_cast<char>(RESP_BOARD_STATE);
+    for (int row=0;row<8;++row) {
+        for (int col=0;col<8;++col) {
+            const ColouredPiece piece = m_board[row][col];
+            uint8_t code = 0x40;
+            if (piece.isValid())
+                code = (static_cast<int>(piece.piece()) - 1) | ((piece.colour() == Colour::Black) ? 0x08 : 0x00);
+            data[1 + row * 8 + col] = static_cast<char>(code);
+        }
+    }
+    data[65] = (m_board.activeColour == Colour::White) ? 0 : 1;
+    data[66] = m_board.whiteKingsideCastlingAvailable ? 1 : 0;
+    data[67] = m_board.whiteQueensideCastlingAvailable ? 1 : 0;
+    data[68] = m_board.blackKingsideCastlingAvailable ? 1 : 0;
+    data[69] = m_board.blackQueensideCastlingAvailable ? 1 : 0;
+    if (m_board.enpassantTarget.isValid())
+        data[70] = static_cast<char>((m_board.enpassantTarget.row << 3) | m_board.enpassantTarget.col);
+    else
+        data[70] = static_cast<char>(0xff);
+    data[71] = static_cast<char>(m_board.halfMoveClock);
+    data[72] = static_cast<char>(m_board.fullMoveCount);
+    return data;
+}
+
+// CMD_SET_STATE carries the first four fields of a FEN record, a space and
+// then the clocks as binary.
+BoardState ChessUpSimulator::decodeBoardState(const QByteArray& data)
+{
+    const int length = (data.size() > 1) ? static_cast<uint8_t>(data[1]) : 0;
+    const QByteArray payload = data.mid(2, length);
+    if (length < 4 || payload.size() != length) {
+        qWarning("ChessUpSimulator::decodeBoardState: truncated");
+        return BoardState::newGame();
+    }
+    BoardState state = BoardState::fromFenString(QString::fromLatin1(payload.left(length - 4)) + QLatin1String(" 0 1"));
+    state.halfMoveClock = static_cast<uint8_t>(payload[length - 3]);
+    state.fullMoveCount = (static_cast<uint8_t>(payload[length - 2]) << 8) | static_cast<uint8_t>(payload[length - 1]);
+    return state;
+}
+
+}
@@ -0,0 +1,99 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHESSUPSIMULATOR_H
+#define CHESSUPSIMULATOR_H
+
+#include <QRandomGenerator>
+#include <QStringList>
+
+#include "chessboard.h"
+#include "chessuptransport.h"
+
+class QTimer;
+
+namespace Chessboard {
+
+// A ChessUp board in software. It answers the protocol as the board does
+// and can make moves, promotions, touches and undos of its own, as a player
+// at the board would. Every packet is delayed by the configured latency and
+// may be lost in either direction.
+class ChessUpSimulator : public ChessUpTransport
+{
+    Q_OBJECT
+public:
+    struct Options {
+        // One-way delay of each packet, in milliseconds.
+        int latency {};
+        // Probability that a packet is lost.
+        double loss {};
+        // Makes packet loss repeatable; zero seeds randomly.
+        quint32 seed {};
+        // Answers every move made in the app with a move on the board.
+        bool reply {};
+        // Drops the link this long after connecting, in milliseconds;
+        // zero keeps it up.
+        int drop {};
+        // Events played on the board once the app has first read the
+        // position, one every 100 ms: a move such as "e2e4", "touch-e2"
+        // to lift a piece, or "undo".
+        QStringList script;
+
+        // "latency=MS,loss=P,seed=N,drop=MS,reply,script=STEP/STEP...",
+        // each part optional.
+        QString toString() const;
+        static bool fromString(const QString& s, Options *options);
+    };
+
+    explicit ChessUpSimulator(const Options& options, QObject *parent = nullptr);
+    bool isReady() const override { return m_ready; }
+    void write(const QByteArray& data) override;
+
+    BoardState boardState() const { return m_board; }
+    void playMove(const Square& from, const Square& to);
+    void choosePromotion(Piece piece);
+    void liftPiece(const Square& square);
+    void undo();
+
+private:
+    void handleCommand(const QByteArray& data);
+    void acknowledged();
+    void notify(const QByteArray& data);
+    void notifyUntilAcknowledged(const QByteArray& data);
+    void replyToMove();
+    void playScriptStep();
+    bool isLost();
+    QByteArray encodeBoardState() const;
+    static BoardState decodeBoardState(const QByteArray& data);
+
+    Options m_options;
+    QRandomGenerator m_random;
+    BoardState m_board;
+    QList<BoardState> m_history;
+    // A move or promotion made on the board, repeated until acknowledged.
+    QByteArray m_unacknowledged;
+    QTimer *m_repeatTimer;
+    QTimer *m_scriptTimer;
+    int m_scriptStep {};
+    bool m_ready {false};
+};
+
+}
+
+#endif // CHESSUPSIMULATOR_H
@@ -0,0 +1,122 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "chessuptrace.h"
+
+namespace {
+    const QByteArray MAGIC("BCTR");
+    const char VERSION = 1;
+
+    void writeVarint(QFile *file, quint64 value)
+    {
+        char buffer[10];
+        int size = 0;
+        do {
+            char byte = static_cast<char>(value & 0x7f);
+            value >>= 7;
+            if (value)
+                byte |= static_cast<char>(0x80);
+            buffer[size++] = byte;
+        } while (value);
+        file->write(buffer, size);
+    }
+
+    bool readVarint(const QByteArray& data, qsizetype *position, quint64 *value)
+    {
+        *value = 0;
+        for (int shift=0;shift<64;shift+=7) {
+            if (*position >= data.size())
+                return false;
+            const uint8_t byte = static_cast<uint8_t>(data[(*position)++]);
+            *value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+namespace Chessboard {
+
+ChessUpTraceWriter *ChessUpTraceWriter::create(const QString& fileName)
+{
+    ChessUpTraceWriter *writer = new ChessUpTraceWriter;
+    writer->m_file.setFileName(fileName);
+    if (!writer->m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("ChessUpTraceWriter::create: cannot open %s", qPrintable(fileName));
+        delete writer;
+        return nullptr;
+    }
+    writer->m_file.write(MAGIC);
+    writer->m_file.putChar(VERSION);
+    writer->m_timer.start();
+    return writer;
+}
+
+void ChessUpTraceWriter::record(ChessUpTraceEvent::Type type, const QByteArray& data)
+{
+    const qint64 time = m_timer.nsecsElapsed() / 1000;
+    m_file.putChar(static_cast<char>(type));
+    writeVarint(&m_file, time - m_lastTime);
+    writeVarint(&m_file, data.size());
+    m_file.write(data);
+    // A trace is most wanted after a crash.
+    m_file.flush();
+    m_lastTime = time;
+}
+
+bool readChessUpTrace(const QString& fileName, QList<ChessUpTraceEvent> *events, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage)
+            *errorMessage = file.errorString();
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    if (!data.startsWith(MAGIC) || data.size() <= MAGIC.size() || data[MAGIC.size()] != VERSION) {
+        if (errorMessage)
+            *errorMessage = QLatin1String("not a board trace");
+        return false;
+    }
+    events->clear();
+    qsizetype position = MAGIC.size() + 1;
+    qint64 time = 0;
+    while (position < data.size()) {
+        ChessUpTraceEvent event;
+        const uint8_t type = static_cast<uint8_t>(data[position++]);
+        quint64 delta, size;
+        if (type < ChessUpTraceEvent::Write || type > ChessUpTraceEvent::Received ||
+            !readVarint(data, &position, &delta) || !readVarint(data, &position, &size) ||
+            size > static_cast<quint64>(data.size() - position)) {
+            // Keep what was read: the recording may have been cut short.
+            qWarning("readChessUpTrace: truncated at %lld", static_cast<long long>(position));
+            break;
+        }
+        time += delta;
+        event.type = static_cast<ChessUpTraceEvent::Type>(type);
+        event.time = time;
+        event.data = data.mid(position, size);
+        position += size;
+        events->append(event);
+    }
+    return true;
+}
+
+}
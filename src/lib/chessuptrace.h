@@ -0,0 +1,65 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHESSUPTRACE_H
+#define CHESSUPTRACE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+
+namespace Chessboard {
+
+// A trace of the packets exchanged with a ChessUp board. The file starts
+// with the magic "BCTR" and a version byte. Each record is then a type
+// byte, the microseconds since the previous record and the packet length,
+// both as unsigned LEB128, and the packet itself.
+struct ChessUpTraceEvent {
+    enum Type : uint8_t {
+        Write = 1,
+        Written = 2,
+        WriteFailed = 3,
+        Received = 4
+    };
+    Type type {Write};
+    // Microseconds since the trace started.
+    qint64 time {};
+    QByteArray data;
+};
+
+class ChessUpTraceWriter
+{
+public:
+    // Returns null if the file cannot be created.
+    static ChessUpTraceWriter *create(const QString& fileName);
+    void record(ChessUpTraceEvent::Type type, const QByteArray& data = QByteArray());
+private:
+    ChessUpTraceWriter() = default;
+
+    QFile m_file;
+    QElapsedTimer m_timer;
+    qint64 m_lastTime {};
+};
+
+bool readChessUpTrace(const QString& fileName, QList<ChessUpTraceEvent> *events, QString *errorMessage = nullptr);
+
+}
+
+#endif // CHESSUPTRACE_H
@@ -0,0 +1,57 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHESSUPTRANSPORT_H
+#define CHESSUPTRANSPORT_H
+
+#include <QByteArray>
+#include <QObject>
+
+namespace Chessboard {
+
+// Carries ChessUp protocol packets between ChessUpBoard and the board.
+// Writes are confirmed, as with a Bluetooth write with response, and the
+// board's notifications arrive through received().
+class ChessUpTransport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChessUpTransport(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~ChessUpTransport() {}
+    virtual bool isReady() const = 0;
+    virtual void write(const QByteArray& data) = 0;
+    // Asks for a link that favours latency over power, for while a game is
+    // being played. Links that cannot be tuned ignore it.
+    virtual void setLowLatency(bool lowLatency) { Q_UNUSED(lowLatency); }
+signals:
+    // The link can carry packets.
+    void ready();
+    void received(const QByteArray& data);
+    void written(const QByteArray& data);
+    void writeFailed();
+    // A write the other end did not expect, such as one that differs from
+    // the recording being replayed.
+    void unexpectedWrite();
+    // The interval and supervision timeout are in milliseconds.
+    void connectionParametersChanged(double interval, int latency, int supervisionTimeout);
+};
+
+}
+
+#endif // CHESSUPTRANSPORT_H
@@ -20,6 +20,8 @@
 #include "boardaddress_p.h"
 #include "bleconnection.h"
 #include "connectionfactory.h"
+#include "replayconnection.h"
+#include "simulatedconnection.h"
 
 namespace Chessboard {
 
@@ -29,6 +31,13 @@ Connection *ConnectionFactory::createConnection(const BoardAddress& address, QOb
     switch (address.connectionMethod()) {
     case CONNECTION_BLE:
         return new BleConnection(address, address.d_func()->bluetoothDeviceInfo(), parent);
+    case CONNECTION_SIMULATED: {
+        ChessUpSimulator::Options options;
+        ChessUpSimulator::Options::fromString(address.d_func()->simulatorOptions(), &options);
+        return new SimulatedConnection(address, options, parent);
+    }
+    case CONNECTION_REPLAY:
+        return new ReplayConnection(address, address.d_func()->traceFileName(), address.d_func()->replaySpeed(), parent);
     default:
         return nullptr;
     }
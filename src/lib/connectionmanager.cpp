@@ -17,15 +17,33 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#include <QRandomGenerator>
+#include <QTimer>
+
 #include "chessboard.h"
 #include "connection.h"
 #include "connectionmanager_p.h"
 
+namespace {
+    // Delays before reconnecting double from the first to the maximum.
+    const int RECONNECT_INITIAL_DELAY = 250;
+    const int RECONNECT_MAXIMUM_DELAY = 8000;
+    const int MAX_RECONNECT_ATTEMPTS = 10;
+}
+
 namespace Chessboard {
 
 ConnectionManagerPrivate::ConnectionManagerPrivate(ConnectionManager *q) :
-    q_ptr(q)
+    q_ptr(q),
+    m_reconnectTimer(new QTimer(q))
 {
+    m_reconnectTimer->setSingleShot(true);
+    QObject::connect(m_reconnectTimer, &QTimer::timeout, q, [this]() {
+        if (m_reconnectDue)
+            m_reconnectDue();
+        else
+            reconnect();
+    });
 }
 
 ConnectionManagerPrivate::~ConnectionManagerPrivate()
@@ -37,62 +55,151 @@ void ConnectionManagerPrivate::connectToBoard(const BoardAddress& address, QObje
 {
     Q_Q(ConnectionManager);
 
+    if (m_state == Reconnecting) {
+        m_reconnectTimer->stop();
+        m_state = Disconnected;
+    }
+    m_address = address;
+    m_parent = parent;
+    m_disconnectRequested = false;
+    m_reconnectAttempt = 0;
+    emit q->connecting(address);
+    startConnection();
+}
+
+void ConnectionManagerPrivate::startConnection()
+{
+    Q_Q(ConnectionManager);
+
     delete m_connection;
     assert(m_state == Disconnected);
-    m_connection = (m_connectionFactory.createConnection(address, q));
-    QObject::connect(m_connection, &Connection::connected, q, [this, parent](RemoteBoard *board){
+    m_connection = (m_connectionFactory.createConnection(m_address, q));
+    // Signals from a connection that has since been replaced are stale.
+    Connection *connection = m_connection;
+    QObject::connect(m_connection, &Connection::connected, q, [this, connection](RemoteBoard *board){
         Q_Q(ConnectionManager);
-        board->setParent(parent);
+        if (connection != m_connection)
+            return;
+        board->setParent(m_parent);
         m_state = Connected;
-        emit q->connected(board);
+        if (m_reconnectAttempt > 0) {
+            m_reconnectAttempt = 0;
+            emit q->reconnected(board);
+        } else {
+            emit q->connected(board);
+        }
     });
-    QObject::connect(m_connection, &Connection::disconnected, q, [this]() {
+    QObject::connect(m_connection, &Connection::disconnected, q, [this, connection]() {
         qDebug("ConnectionManager::disconnected");
-        Q_Q(ConnectionManager);
+        if (connection != m_connection)
+            return;
         State oldState = m_state;
         m_state = Disconnected;
+        // Still inside one of its signals.
+        m_connection->deleteLater();
+        m_connection = nullptr;
         if (oldState == Connected)
-            emit q->disconnected();
+            connectionLost();
         else if (oldState == Connecting)
-            emit q->connectionFailed();
-        Connection *oldConnection = m_connection;
-        m_connection = nullptr;
-        delete m_connection;
+            attemptFailed();
     });
-    QObject::connect(m_connection, &Connection::error, q, [this](ConnectionManager::Error newError) {
+    QObject::connect(m_connection, &Connection::error, q, [this, connection](ConnectionManager::Error newError) {
         qDebug("ConnectionManagerPrivate::error");
         Q_Q(ConnectionManager);
-        emit q->error(newError);
+        if (connection != m_connection)
+            return;
+        // Failed attempts to reconnect are retried quietly.
+        if (m_reconnectAttempt == 0)
+            emit q->error(newError);
         if (m_state == Connecting) {
             m_state = Disconnected;
-            emit q->connectionFailed();
-            Connection *oldConnection = m_connection;
+            m_connection->deleteLater();
             m_connection = nullptr;
-            delete m_connection;
+            attemptFailed();
         }
     });
-    QObject::connect(m_connection, &Connection::connectionFailed, q, [this]() {
+    QObject::connect(m_connection, &Connection::connectionFailed, q, [this, connection]() {
         qDebug("ConnectionManagerPrivate::connectionFailed");
-        Q_Q(ConnectionManager);
+        if (connection != m_connection)
+            return;
         State oldState = m_state;
         m_state = Disconnected;
-        if (oldState == Connected) {
-            emit q->disconnected();
-        } else if (oldState == Connecting) {
-            emit q->connectionFailed();
-        }
-        Connection *oldConnection = m_connection;
+        // Still inside one of its signals.
+        m_connection->deleteLater();
         m_connection = nullptr;
-        delete m_connection;
+        if (oldState == Connected)
+            connectionLost();
+        else if (oldState == Connecting)
+            attemptFailed();
     });
-    emit q->connecting(address);
     m_state = Connecting;
     m_connection->connectToBoard();
 }
 
+void ConnectionManagerPrivate::connectionLost()
+{
+    Q_Q(ConnectionManager);
+    // A replay that has run out is finished rather than dropped.
+    if (m_autoReconnect && !m_disconnectRequested && m_address.connectionMethod() != CONNECTION_REPLAY)
+        scheduleReconnect();
+    else
+        emit q->disconnected();
+}
+
+void ConnectionManagerPrivate::attemptFailed()
+{
+    Q_Q(ConnectionManager);
+    if (m_reconnectAttempt == 0) {
+        emit q->connectionFailed();
+    } else if (m_disconnectRequested) {
+        m_reconnectAttempt = 0;
+        emit q->disconnected();
+    } else {
+        scheduleReconnect();
+    }
+}
+
+void ConnectionManagerPrivate::scheduleReconnect()
+{
+    Q_Q(ConnectionManager);
+    if (m_reconnectAttempt == MAX_RECONNECT_ATTEMPTS) {
+        qDebug("ConnectionManagerPrivate::scheduleReconnect: giving up");
+        m_reconnectAttempt = 0;
+        emit q->disconnected();
+        return;
+    }
+    // Half the delay is random, so that boards dropped together do not
+    // all come back at once.
+    const int backoff = qMin(RECONNECT_INITIAL_DELAY << m_reconnectAttempt, RECONNECT_MAXIMUM_DELAY);
+    const int delay = backoff / 2 + QRandomGenerator::global()->bounded(backoff / 2 + 1);
+    ++m_reconnectAttempt;
+    m_state = Reconnecting;
+    emit q->reconnecting(m_reconnectAttempt, delay);
+    m_reconnectTimer->start(delay);
+}
+
+void ConnectionManagerPrivate::reconnect()
+{
+    // Dropped if the board was disconnected while the attempt was queued.
+    if (m_state != Reconnecting)
+        return;
+    qDebug("ConnectionManagerPrivate::reconnect(%d)", m_reconnectAttempt);
+    m_state = Disconnected;
+    startConnection();
+}
+
 void ConnectionManagerPrivate::disconnectFromBoard()
 {
+    Q_Q(ConnectionManager);
     assert(m_state != Disconnected);
+    m_disconnectRequested = true;
+    if (m_state == Reconnecting) {
+        m_reconnectTimer->stop();
+        m_state = Disconnected;
+        m_reconnectAttempt = 0;
+        emit q->disconnected();
+        return;
+    }
     Q_ASSERT(m_connection != nullptr);
     m_connection->disconnectFromBoard();
 }
@@ -107,6 +214,18 @@ ConnectionManager::~ConnectionManager()
 {
 }
 
+void ConnectionManager::setAutoReconnect(bool autoReconnect)
+{
+    Q_D(ConnectionManager);
+    d->m_autoReconnect = autoReconnect;
+}
+
+bool ConnectionManager::autoReconnect() const
+{
+    Q_D(const ConnectionManager);
+    return d->m_autoReconnect;
+}
+
 void ConnectionManager::connectToBoard(const BoardAddress& address, QObject *parent)
 {
     Q_D(ConnectionManager);
@@ -24,10 +24,14 @@
 #include <QBluetoothDeviceInfo>
 #include <QByteArray>
 #include <QLatin1String>
+#include <QPointer>
+#include <functional>
 
 #include "chessboard.h"
 #include "connectionfactory.h"
 
+class QTimer;
+
 namespace Chessboard {
 
 class Connection;
@@ -39,19 +43,38 @@ public:
     virtual ~ConnectionManagerPrivate();
     void connectToBoard(const BoardAddress& address, QObject *parent = nullptr);
     void disconnectFromBoard();
+    // When set, called instead of making an attempt to reconnect once it
+    // is due, so that the attempt can be queued; reconnect() makes it.
+    void setReconnectDue(const std::function<void()>& reconnectDue) { m_reconnectDue = reconnectDue; }
+    void reconnect();
 private:
     enum State {
         Disconnected,
         Connecting,
-        Connected
+        Connected,
+        // Waiting to make the next attempt to reconnect.
+        Reconnecting
     };
 
+    void startConnection();
+    void connectionLost();
+    void attemptFailed();
+    void scheduleReconnect();
+
     Q_DISABLE_COPY(ConnectionManagerPrivate)
     Q_DECLARE_PUBLIC(ConnectionManager)
     ConnectionManager *q_ptr;
     ConnectionFactory m_connectionFactory;
     Connection *m_connection {};
     State m_state {Disconnected};
+    BoardAddress m_address;
+    QPointer<QObject> m_parent;
+    bool m_autoReconnect {false};
+    bool m_disconnectRequested {false};
+    // Zero unless reconnecting.
+    int m_reconnectAttempt {};
+    QTimer *m_reconnectTimer;
+    std::function<void()> m_reconnectDue;
 };
 
 }
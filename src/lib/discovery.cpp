@@ -23,7 +23,10 @@
 #include <QIODevice>
 #include <QLowEnergyController>
 #include <QSharedData>
+#include <QTimer>
+#include <algorithm>
 
+#include "bleboardfactory.h"
 #include "boardaddress_p.h"
 #include "chessboard.h"
 
@@ -35,33 +38,60 @@ public:
     virtual ~BoardDiscoveryPrivate();
 private slots:
     void deviceDiscovered(const QBluetoothDeviceInfo& info);
+    void deviceUpdated(const QBluetoothDeviceInfo& info, QBluetoothDeviceInfo::Fields updatedFields);
     void errorOccurred(QBluetoothDeviceDiscoveryAgent::Error error);
     void start();
     void stop();
     void onFinished();
 private:
+    struct DiscoveredBoard {
+        BoardAddress address;
+        qint16 rssi {};
+    };
+
     Q_DISABLE_COPY(BoardDiscoveryPrivate)
     Q_DECLARE_PUBLIC(BoardDiscovery)
     BoardDiscovery *q_ptr;
     QScopedPointer<QBluetoothDeviceDiscoveryAgent> m_deviceDiscoveryAgent;
-    QList<BoardAddress> m_discoveredBoards;
+    QList<DiscoveredBoard> m_discoveredBoards;
+    bool m_boardsOnly {false};
+    int m_stopAfterFirst {-1};
+    // Ends discovery early once a board has been found.
+    QTimer *m_stopTimer;
+    bool m_stoppingEarly {false};
 };
 
 BoardDiscoveryPrivate::BoardDiscoveryPrivate(BoardDiscovery *q) :
     q_ptr(q),
-    m_deviceDiscoveryAgent(new QBluetoothDeviceDiscoveryAgent(q_ptr))
+    m_deviceDiscoveryAgent(new QBluetoothDeviceDiscoveryAgent(q_ptr)),
+    m_stopTimer(new QTimer(q))
 {
     m_deviceDiscoveryAgent->setLowEnergyDiscoveryTimeout(15000);
+    m_stopTimer->setSingleShot(true);
+    QObject::connect(m_stopTimer, &QTimer::timeout, q, [this]() {
+        qDebug("BoardDiscoveryPrivate: stopping early");
+        m_stoppingEarly = true;
+        m_deviceDiscoveryAgent->stop();
+    });
 
     QObject::connect(m_deviceDiscoveryAgent.get(), &QBluetoothDeviceDiscoveryAgent::deviceDiscovered,
                      q, [this](auto info) { deviceDiscovered(info); });
+    QObject::connect(m_deviceDiscoveryAgent.get(), &QBluetoothDeviceDiscoveryAgent::deviceUpdated,
+                     q, [this](auto info, auto updatedFields) { deviceUpdated(info, updatedFields); });
     QObject::connect(m_deviceDiscoveryAgent.get(), &QBluetoothDeviceDiscoveryAgent::errorOccurred,
                      q, [this](auto error) { errorOccurred(error); });
 
     QObject::connect(m_deviceDiscoveryAgent.get(), &QBluetoothDeviceDiscoveryAgent::finished,
                      q, [this]() { onFinished(); });
     QObject::connect(m_deviceDiscoveryAgent.get(), &QBluetoothDeviceDiscoveryAgent::canceled,
-                     q, &BoardDiscovery::finished);
+                     q, [this]() {
+        Q_Q(BoardDiscovery);
+        // Stopping early is finishing as far as the caller is concerned.
+        if (m_stoppingEarly)
+            onFinished();
+        else
+            emit q->finished();
+    });
 }
 
 BoardDiscoveryPrivate::~BoardDiscoveryPrivate()
@@ -71,13 +101,33 @@ BoardDiscoveryPrivate::~BoardDiscoveryPrivate()
 void BoardDiscoveryPrivate::deviceDiscovered(const QBluetoothDeviceInfo& info)
 {
     Q_Q(BoardDiscovery);
-    if (!info.name().isEmpty()) {
-        BluetoothBoardAddressPrivate *address_d = new BluetoothBoardAddressPrivate(info);
-        BoardAddress address(address_d);
-        if (!m_discoveredBoards.contains(address)) {
-            m_discoveredBoards.append(address);
-            emit q->boardDiscovered(address);
-        }
+    if (m_boardsOnly) {
+        // A board may advertise its service before its name.
+        if (!BleBoardFactory::isSupported(info))
+            return;
+    } else if (info.name().isEmpty()) {
+        return;
+    }
+    BluetoothBoardAddressPrivate *address_d = new BluetoothBoardAddressPrivate(info);
+    BoardAddress address(address_d);
+    for (const DiscoveredBoard& board : std::as_const(m_discoveredBoards)) {
+        if (board.address == address)
+            return;
+    }
+    m_discoveredBoards.append(DiscoveredBoard { address, info.rssi() });
+    emit q->boardDiscovered(address);
+    if (m_stopAfterFirst >= 0 && !m_stopTimer->isActive())
+        m_stopTimer->start(m_stopAfterFirst);
+}
+
+void BoardDiscoveryPrivate::deviceUpdated(const QBluetoothDeviceInfo& info, QBluetoothDeviceInfo::Fields updatedFields)
+{
+    if (!(updatedFields & QBluetoothDeviceInfo::Field::RSSI))
+        return;
+    const BoardAddress address(new BluetoothBoardAddressPrivate(info));
+    for (DiscoveredBoard& board : m_discoveredBoards) {
+        if (board.address == address)
+            board.rssi = info.rssi();
     }
 }
 
@@ -127,12 +177,15 @@ void BoardDiscoveryPrivate::start()
     Q_Q(BoardDiscovery);
 
     m_discoveredBoards.clear();
+    m_stopTimer->stop();
+    m_stoppingEarly = false;
     emit q->started();
     m_deviceDiscoveryAgent->start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
 }
 
 void BoardDiscoveryPrivate::stop()
 {
+    m_stopTimer->stop();
     m_deviceDiscoveryAgent->stop();
 }
 
@@ -140,10 +193,18 @@ void BoardDiscoveryPrivate::onFinished()
 {
     Q_Q(BoardDiscovery);
 
+    m_stopTimer->stop();
+    m_stoppingEarly = false;
     emit q->finished();
     if (m_discoveredBoards.isEmpty())
         emit q->noBoardsDiscovered();
-    emit q->boardsDiscovered(m_discoveredBoards);
+    std::stable_sort(m_discoveredBoards.begin(), m_discoveredBoards.end(), [](const DiscoveredBoard& a, const DiscoveredBoard& b) {
+        return a.rssi > b.rssi;
+    });
+    QList<BoardAddress> addresses;
+    for (const DiscoveredBoard& board : std::as_const(m_discoveredBoards))
+        addresses.append(board.address);
+    emit q->boardsDiscovered(addresses);
 }
 
 BoardDiscovery::BoardDiscovery(QObject *parent) :
@@ -156,6 +217,27 @@ BoardDiscovery::~BoardDiscovery()
 {
 }
 
+void BoardDiscovery::setBoardsOnly(bool boardsOnly)
+{
+    Q_D(BoardDiscovery);
+
+    d->m_boardsOnly = boardsOnly;
+}
+
+void BoardDiscovery::setStopAfterFirst(int grace)
+{
+    Q_D(BoardDiscovery);
+
+    d->m_stopAfterFirst = grace;
+}
+
+void BoardDiscovery::setTimeout(int timeout)
+{
+    Q_D(BoardDiscovery);
+
+    d->m_deviceDiscoveryAgent->setLowEnergyDiscoveryTimeout(timeout);
+}
+
 void BoardDiscovery::start()
 {
     Q_D(BoardDiscovery);
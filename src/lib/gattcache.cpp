@@ -0,0 +1,71 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QBluetoothAddress>
+#include <QMutex>
+
+#include "gattcache.h"
+
+namespace {
+    struct Cache {
+        QMutex mutex;
+        QHash<QString, Chessboard::GattLayout> layouts;
+    };
+
+    // The name of a device may change, or not be known until it is
+    // discovered, so only its address identifies it.
+    QString key(const QBluetoothDeviceInfo& device)
+    {
+        if (!device.deviceUuid().isNull())
+            return device.deviceUuid().toString();
+        return device.address().toString();
+    }
+}
+
+Q_GLOBAL_STATIC(Cache, cache)
+
+namespace Chessboard {
+
+namespace GattCache {
+
+bool find(const QBluetoothDeviceInfo& device, GattLayout *layout)
+{
+    QMutexLocker locker(&cache->mutex);
+    const auto it = cache->layouts.constFind(key(device));
+    if (it == cache->layouts.constEnd())
+        return false;
+    *layout = it.value();
+    return true;
+}
+
+void insert(const QBluetoothDeviceInfo& device, const GattLayout& layout)
+{
+    QMutexLocker locker(&cache->mutex);
+    cache->layouts.insert(key(device), layout);
+}
+
+void remove(const QBluetoothDeviceInfo& device)
+{
+    QMutexLocker locker(&cache->mutex);
+    cache->layouts.remove(key(device));
+}
+
+}
+
+}
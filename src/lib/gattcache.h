@@ -0,0 +1,49 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GATTCACHE_H
+#define GATTCACHE_H
+
+#include <QBluetoothDeviceInfo>
+#include <QBluetoothUuid>
+#include <QHash>
+#include <QList>
+
+namespace Chessboard {
+
+// The services of a board and the characteristics of the ones in use.
+struct GattLayout {
+    QList<QBluetoothUuid> services;
+    QHash<QBluetoothUuid, QList<QBluetoothUuid> > characteristics;
+};
+
+// Remembers the GATT layout of each board connected to, so that a
+// reconnect can start on the board as soon as the services it expects
+// turn up and skip reading values it does not need. A layout that no
+// longer matches is forgotten and the next connection discovers
+// everything again.
+namespace GattCache {
+    bool find(const QBluetoothDeviceInfo& device, GattLayout *layout);
+    void insert(const QBluetoothDeviceInfo& device, const GattLayout& layout);
+    void remove(const QBluetoothDeviceInfo& device);
+}
+
+}
+
+#endif // GATTCACHE_H
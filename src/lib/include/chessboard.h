@@ -40,11 +40,16 @@ class Board;
 class BoardPrivate;
 class ConnectionManager;
 class ConnectionManagerPrivate;
+class MultiConnectionManagerPrivate;
+class OpeningBookPrivate;
+class SyzygyTablebasesPrivate;
 class RemoteBoard;
 class RemoteBoardPrivate;
 
 enum ConnectionMethod {
-    CONNECTION_BLE = 1
+    CONNECTION_BLE = 1,
+    CONNECTION_SIMULATED = 2,
+    CONNECTION_REPLAY = 3
 };
 
 class LIBCHESSBOARD_EXPORT BoardAddress {
@@ -85,10 +90,19 @@ public:
     };
     BoardDiscovery(QObject *parent = nullptr);
     virtual ~BoardDiscovery();
+    // Reports only devices that advertise themselves as supported boards,
+    // rather than every named device.
+    void setBoardsOnly(bool boardsOnly);
+    // Stops this many milliseconds after the first board is reported
+    // instead of running until the timeout. Negative runs to the timeout.
+    void setStopAfterFirst(int grace);
+    void setTimeout(int timeout);
     void start();
     void stop();
 signals:
+    // Emitted in discovery order, as each board is first seen.
     void boardDiscovered(const Chessboard::BoardAddress& address);
+    // Emitted once discovery ends. Strongest signal first.
     void boardsDiscovered(const QList<Chessboard::BoardAddress>& address);
     void error(BoardDiscovery::Error error);
     void finished();
@@ -125,6 +139,12 @@ public:
 
     ConnectionManager(QObject *parent = nullptr);
     virtual ~ConnectionManager();
+    // When enabled, a link that drops is reconnected with jittered
+    // exponential backoff. The manager emits reconnecting() before each
+    // attempt and reconnected() with the new board, and only emits
+    // disconnected() once it gives up.
+    void setAutoReconnect(bool autoReconnect);
+    bool autoReconnect() const;
 public slots:
     void connectToBoard(const Chessboard::BoardAddress& address, QObject *parent = nullptr);
     void disconnectFromBoard();
@@ -134,11 +154,48 @@ signals:
     void disconnected();
     void connectionFailed();
     void connecting(const Chessboard::BoardAddress& address);
+    void reconnecting(int attempt, int delay);
+    void reconnected(Chessboard::RemoteBoard *board);
 private:
     Q_DECLARE_PRIVATE(ConnectionManager);
     QScopedPointer<ConnectionManagerPrivate> d_ptr;
 friend class BoardFactory;
 friend class BoardDiscovery;
+friend class MultiConnectionManagerPrivate;
+};
+
+// Keeps connections to several boards at once, each with a
+// ConnectionManager and board of its own. Adapters handle one connection
+// attempt at a time (BlueZ serialises them), so attempts are queued and
+// only a few are set up at once, attempts to reconnect included.
+// Established links are unaffected.
+class LIBCHESSBOARD_EXPORT MultiConnectionManager : public QObject {
+    Q_OBJECT
+public:
+    MultiConnectionManager(QObject *parent = nullptr);
+    virtual ~MultiConnectionManager();
+    void setAutoReconnect(bool autoReconnect);
+    // How many connections may be set up at the same time; one by default.
+    void setMaximumPendingConnections(int maximum);
+    // Boards connected, connecting or queued, in the order they were added.
+    QList<BoardAddress> addresses() const;
+    // Null until the board has connected.
+    RemoteBoard *board(const BoardAddress& address) const;
+public slots:
+    void connectToBoard(const Chessboard::BoardAddress& address, QObject *parent = nullptr);
+    void disconnectFromBoard(const Chessboard::BoardAddress& address);
+    void disconnectAll();
+signals:
+    void connecting(const Chessboard::BoardAddress& address);
+    void connected(const Chessboard::BoardAddress& address, Chessboard::RemoteBoard *board);
+    void error(const Chessboard::BoardAddress& address, Chessboard::ConnectionManager::Error error);
+    void connectionFailed(const Chessboard::BoardAddress& address);
+    void reconnecting(const Chessboard::BoardAddress& address, int attempt);
+    void reconnected(const Chessboard::BoardAddress& address, Chessboard::RemoteBoard *board);
+    void disconnected(const Chessboard::BoardAddress& address);
+private:
+    Q_DECLARE_PRIVATE(MultiConnectionManager);
+    QScopedPointer<MultiConnectionManagerPrivate> d_ptr;
 };
 
 enum class Piece {
@@ -261,6 +318,7 @@ struct LIBCHESSBOARD_EXPORT AlgebraicNotation {
                 (fromRow == -1 || (fromRow >= 0 && fromRow < 8)) &&
                 (fromCol == -1 || (fromCol >= 0 && fromCol < 8)); };
     AlgebraicNotation resolve(const BoardState& state) const;
+    QString toString(const BoardState& state) const;
     static AlgebraicNotation fromString(const QString& s);
 };
 
@@ -272,7 +330,9 @@ enum class DrawReason {
     FivefoldRepetitionRule,
     SeventyFiveMoveRule,
     DeadPosition,
-    MutualAgreement
+    MutualAgreement,
+    // Adjudicated from the endgame tablebases.
+    Tablebase
 };
 
 enum class IllegalBoardReason {
@@ -360,9 +420,17 @@ struct PlayerOptions {
     int assistanceLevel {1};
 };
 
+// Times are in milliseconds. A base time of zero means the game is untimed.
+struct TimeControl {
+    int baseTime {0};
+    int increment {0};
+    bool isTimed() const { return baseTime > 0; }
+};
+
 struct GameOptions {
     PlayerOptions white;
     PlayerOptions black;
+    TimeControl timeControl;
 };
 
 enum class AssistanceColour {
@@ -371,12 +439,44 @@ enum class AssistanceColour {
     Green = 2
 };
 
+// Health of the link to a remote board. Latencies are in milliseconds, from
+// first sending a request to receiving the response that answers it.
+struct LIBCHESSBOARD_EXPORT LinkStatistics {
+    int completed {};
+    int retries {};
+    int failures {};
+    // Writes a replayed recording did not expect: those that differ from
+    // the recording or that were never made. Always zero for real boards.
+    int unexpectedWrites {};
+    qint64 lastLatency {};
+    qint64 maximumLatency {};
+    qint64 totalLatency {};
+    // From the board confirming a write to the notification that answers
+    // it, which is bounded by the connection interval rather than by the
+    // queue of writes ahead.
+    int notifications {};
+    qint64 lastNotificationLatency {};
+    qint64 maximumNotificationLatency {};
+    qint64 totalNotificationLatency {};
+    // Whether the link has been asked to favour latency over power, as it
+    // is while a game is being played, and the connection parameters last
+    // reported for it. The interval and supervision timeout are zero until
+    // reported; the latency counts the connection events the board may skip.
+    bool lowLatency {};
+    double connectionInterval {};
+    int connectionLatency {};
+    int supervisionTimeout {};
+    qint64 averageLatency() const { return completed ? totalLatency / completed : 0; }
+    qint64 averageNotificationLatency() const { return notifications ? totalNotificationLatency / notifications : 0; }
+};
+
 class LIBCHESSBOARD_EXPORT RemoteBoard : public QObject {
     Q_OBJECT
 public:
     RemoteBoard(const BoardAddress& address, QObject *parent = nullptr);
     virtual ~RemoteBoard();
     BoardAddress address() const;
+    LinkStatistics linkStatistics() const;
     virtual void requestRemoteBoardState();
     virtual void requestNewGame(const GameOptions& gameOptions);
     virtual void requestMove(int fromRow, int fromCol, int toRow, int toCol);
@@ -400,7 +500,17 @@ signals:
     void remoteDraw(Chessboard::DrawReason reason);
     void remoteResignation(Chessboard::Colour colour);
     void remoteCheckmate(Chessboard::Colour winner);
+    void remotePieceLifted(const Chessboard::Square& square);
+    void linkStatisticsChanged(const Chessboard::LinkStatistics& statistics);
 protected:
+    void recordRequestLatency(qint64 latency);
+    void recordRequestRetry();
+    void recordRequestFailure();
+    void recordUnexpectedWrite();
+    void recordNotificationLatency(qint64 latency);
+    void recordLowLatency(bool lowLatency);
+    void recordConnectionParameters(double interval, int latency, int supervisionTimeout);
+
     Q_DECLARE_PRIVATE(RemoteBoard);
     QScopedPointer<RemoteBoardPrivate> d_ptr;
 };
@@ -417,6 +527,117 @@ public:
     Pgn parse(QIODevice *file, QString *errorMessage = nullptr);
 };
 
+// Writes the Seven Tag Roster first, then any other tags, then the moves in
+// standard algebraic notation. Moves are played from the position in the
+// FEN tag, or the standard starting position, and the Result tag is used as
+// the game termination marker.
+class LIBCHESSBOARD_EXPORT PgnWriter {
+public:
+    QString write(const Pgn& pgn, QString *errorMessage = nullptr);
+    bool write(QIODevice *file, const Pgn& pgn, QString *errorMessage = nullptr);
+};
+
+struct LIBCHESSBOARD_EXPORT BookMove {
+    Square from;
+    Square to;
+    bool promotion {};
+    Piece promotionPiece {Piece::Queen};
+    quint16 weight {};
+    bool isValid() const { return from.isValid() && to.isValid(); }
+};
+
+// Read-only Polyglot (.bin) opening book. The file is memory-mapped and
+// looked up with a binary search, so a book can be shared between threads
+// once opened.
+class LIBCHESSBOARD_EXPORT OpeningBook {
+public:
+    enum Selection {
+        BestMove,
+        WeightedRandom,
+        UniformRandom
+    };
+
+    OpeningBook();
+    ~OpeningBook();
+    bool open(const QString& fileName, QString *errorMessage = nullptr);
+    void close();
+    bool isOpen() const;
+    QString fileName() const;
+    qsizetype entryCount() const;
+    // Legal book moves for the position, highest weight first.
+    QList<BookMove> moves(const BoardState& state) const;
+    BookMove selectMove(const BoardState& state, Selection selection = WeightedRandom) const;
+    static quint64 polyglotKey(const BoardState& state);
+private:
+    Q_DISABLE_COPY(OpeningBook)
+    Q_DECLARE_PRIVATE(OpeningBook)
+    QScopedPointer<OpeningBookPrivate> d_ptr;
+};
+
+// Tablebase result for the side to move. A cursed win or blessed loss is
+// a draw under the fifty-move rule.
+enum class TablebaseResult {
+    Loss = -2,
+    BlessedLoss = -1,
+    Draw = 0,
+    CursedWin = 1,
+    Win = 2
+};
+
+struct LIBCHESSBOARD_EXPORT TablebaseMove {
+    Square from;
+    Square to;
+    bool promotion {};
+    Piece promotionPiece {Piece::Queen};
+    // For the side making the move.
+    TablebaseResult result {TablebaseResult::Draw};
+    // Plies from before the move to the next capture or pawn move, as
+    // returned by SyzygyTablebases::probeDtz(); zero without DTZ tables.
+    int dtz {};
+    bool isValid() const { return from.isValid() && to.isValid(); }
+};
+
+// Syzygy endgame tablebases. Files are validated when loaded and mapped
+// into memory when first probed; probing is thread-safe, so one set of
+// tables can be shared between players. path() can also be given to an
+// engine.
+class LIBCHESSBOARD_EXPORT SyzygyTablebases {
+public:
+    enum TableType {
+        WinDrawLoss,
+        DistanceToZero
+    };
+
+    SyzygyTablebases();
+    ~SyzygyTablebases();
+    // paths is a list of directories separated by QDir::listSeparator().
+    // Returns the number of valid WDL tables found.
+    int load(const QString& paths, QString *errorMessage = nullptr);
+    void clear();
+    QString path() const;
+    int tableCount(TableType type = WinDrawLoss) const;
+    int maxPieces() const;
+    bool contains(const BoardState& state, TableType type = WinDrawLoss) const;
+    // Each probe returns false if the position is not in the tables.
+    bool probeWdl(const BoardState& state, TablebaseResult *result) const;
+    // Plies to the next capture or pawn move with best play: positive when
+    // the side to move wins, negative when it loses, 100 further from zero
+    // for a cursed win or blessed loss, and zero for a draw. The value may
+    // be one too high, as the tables round some values up.
+    bool probeDtz(const BoardState& state, int *dtz) const;
+    // Legal moves for the position, best first.
+    QList<TablebaseMove> moves(const BoardState& state) const;
+    TablebaseMove selectMove(const BoardState& state) const;
+    // Material signature in Syzygy file name form, e.g. "KRPvKR", with the
+    // stronger side first. Some tables are named the other way round,
+    // which contains() allows for.
+    static QString materialKey(const BoardState& state);
+private:
+    Q_DISABLE_COPY(SyzygyTablebases)
+    Q_DECLARE_PRIVATE(SyzygyTablebases)
+    QScopedPointer<SyzygyTablebasesPrivate> d_ptr;
+};
+
 }
 
 #endif // CHESSBOARD_H
@@ -0,0 +1,293 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QPointer>
+
+#include "chessboard.h"
+#include "connectionmanager_p.h"
+
+namespace Chessboard {
+
+class MultiConnectionManagerPrivate {
+public:
+    MultiConnectionManagerPrivate(MultiConnectionManager *q);
+    void connectToBoard(const BoardAddress& address, QObject *parent);
+    void disconnectFromBoard(const BoardAddress& address);
+private:
+    enum State {
+        Queued,
+        Connecting,
+        Connected,
+        // Waiting until the next attempt to reconnect is due.
+        Reconnecting
+    };
+    struct Entry {
+        BoardAddress address;
+        ConnectionManager *manager {};
+        QPointer<QObject> parent;
+        QPointer<RemoteBoard> board;
+        State state {Queued};
+        // Queued to reconnect rather than to connect for the first time.
+        bool reconnect {};
+    };
+
+    int indexOf(const BoardAddress& address) const;
+    int indexOf(const ConnectionManager *manager) const;
+    void startNext();
+    void setupFinished(int index);
+    void remove(ConnectionManager *manager);
+
+    Q_DISABLE_COPY(MultiConnectionManagerPrivate)
+    Q_DECLARE_PUBLIC(MultiConnectionManager)
+    MultiConnectionManager *q_ptr;
+    QList<Entry> m_entries;
+    int m_pending {};
+    int m_maximumPending {1};
+    bool m_autoReconnect {false};
+};
+
+MultiConnectionManagerPrivate::MultiConnectionManagerPrivate(MultiConnectionManager *q) :
+    q_ptr(q)
+{
+}
+
+int MultiConnectionManagerPrivate::indexOf(const BoardAddress& address) const
+{
+    for (int i=0;i<m_entries.size();++i) {
+        if (m_entries[i].address == address)
+            return i;
+    }
+    return -1;
+}
+
+int MultiConnectionManagerPrivate::indexOf(const ConnectionManager *manager) const
+{
+    for (int i=0;i<m_entries.size();++i) {
+        if (m_entries[i].manager == manager)
+            return i;
+    }
+    return -1;
+}
+
+void MultiConnectionManagerPrivate::connectToBoard(const BoardAddress& address, QObject *parent)
+{
+    Q_Q(MultiConnectionManager);
+
+    if (indexOf(address) != -1) {
+        qDebug("MultiConnectionManager::connectToBoard: %s already added", qPrintable(address.toString()));
+        return;
+    }
+    Entry entry;
+    entry.address = address;
+    entry.parent = parent;
+    entry.manager = new ConnectionManager(q);
+    entry.manager->setAutoReconnect(m_autoReconnect);
+    ConnectionManager *manager = entry.manager;
+    QObject::connect(manager, &ConnectionManager::connected, q, [this, manager](RemoteBoard *board) {
+        Q_Q(MultiConnectionManager);
+        const int index = indexOf(manager);
+        if (index == -1)
+            return;
+        m_entries[index].board = board;
+        setupFinished(index);
+        m_entries[index].state = Connected;
+        const BoardAddress address = m_entries[index].address;
+        emit q->connected(address, board);
+    });
+    QObject::connect(manager, &ConnectionManager::connectionFailed, q, [this, manager]() {
+        Q_Q(MultiConnectionManager);
+        const int index = indexOf(manager);
+        if (index == -1)
+            return;
+        const BoardAddress address = m_entries[index].address;
+        setupFinished(index);
+        remove(manager);
+        emit q->connectionFailed(address);
+    });
+    QObject::connect(manager, &ConnectionManager::error, q, [this, manager](ConnectionManager::Error error) {
+        Q_Q(MultiConnectionManager);
+        const int index = indexOf(manager);
+        if (index == -1)
+            return;
+        emit q->error(m_entries[index].address, error);
+    });
+    QObject::connect(manager, &ConnectionManager::reconnecting, q, [this, manager](int attempt) {
+        Q_Q(MultiConnectionManager);
+        const int index = indexOf(manager);
+        if (index == -1)
+            return;
+        m_entries[index].board = nullptr;
+        // Also follows a failed attempt.
+        setupFinished(index);
+        m_entries[index].state = Reconnecting;
+        emit q->reconnecting(m_entries[index].address, attempt);
+    });
+    manager->d_func()->setReconnectDue([this, manager]() {
+        const int index = indexOf(manager);
+        if (index == -1 || m_entries[index].state != Reconnecting)
+            return;
+        m_entries[index].state = Queued;
+        m_entries[index].reconnect = true;
+        startNext();
+    });
+    QObject::connect(manager, &ConnectionManager::reconnected, q, [this, manager](RemoteBoard *board) {
+        Q_Q(MultiConnectionManager);
+        const int index = indexOf(manager);
+        if (index == -1)
+            return;
+        m_entries[index].board = board;
+        setupFinished(index);
+        m_entries[index].state = Connected;
+        m_entries[index].reconnect = false;
+        emit q->reconnected(m_entries[index].address, board);
+    });
+    QObject::connect(manager, &ConnectionManager::disconnected, q, [this, manager]() {
+        Q_Q(MultiConnectionManager);
+        const int index = indexOf(manager);
+        if (index == -1)
+            return;
+        const BoardAddress address = m_entries[index].address;
+        // Also covers attempts canceled part way through.
+        setupFinished(index);
+        remove(manager);
+        emit q->disconnected(address);
+    });
+    m_entries.append(entry);
+    startNext();
+}
+
+void MultiConnectionManagerPrivate::startNext()
+{
+    Q_Q(MultiConnectionManager);
+
+    for (int i=0;i<m_entries.size() && m_pending<m_maximumPending;++i) {
+        Entry& entry = m_entries[i];
+        if (entry.state != Queued)
+            continue;
+        entry.state = Connecting;
+        ++m_pending;
+        qDebug("MultiConnectionManager::startNext(%s)", qPrintable(entry.address.toString()));
+        emit q->connecting(entry.address);
+        // The entry may be gone if the attempt fails at once.
+        ConnectionManager *manager = entry.manager;
+        if (entry.reconnect)
+            manager->d_func()->reconnect();
+        else
+            manager->connectToBoard(entry.address, entry.parent);
+    }
+}
+
+void MultiConnectionManagerPrivate::setupFinished(int index)
+{
+    if (m_entries[index].state != Connecting)
+        return;
+    Q_ASSERT(m_pending > 0);
+    --m_pending;
+    // Let the caller finish with this board before the next one starts.
+    QMetaObject::invokeMethod(q_ptr, [this]() {
+        startNext();
+    }, Qt::QueuedConnection);
+}
+
+void MultiConnectionManagerPrivate::remove(ConnectionManager *manager)
+{
+    const int index = indexOf(manager);
+    if (index == -1)
+        return;
+    m_entries.removeAt(index);
+    manager->deleteLater();
+}
+
+void MultiConnectionManagerPrivate::disconnectFromBoard(const BoardAddress& address)
+{
+    Q_Q(MultiConnectionManager);
+
+    const int index = indexOf(address);
+    if (index == -1)
+        return;
+    // A queued attempt to reconnect is stopped by its manager.
+    if (m_entries[index].state == Queued && !m_entries[index].reconnect) {
+        remove(m_entries[index].manager);
+        emit q->disconnected(address);
+        return;
+    }
+    m_entries[index].manager->disconnectFromBoard();
+}
+
+MultiConnectionManager::MultiConnectionManager(QObject *parent) :
+    QObject(parent),
+    d_ptr(new MultiConnectionManagerPrivate(this))
+{
+}
+
+MultiConnectionManager::~MultiConnectionManager()
+{
+}
+
+void MultiConnectionManager::setAutoReconnect(bool autoReconnect)
+{
+    Q_D(MultiConnectionManager);
+    d->m_autoReconnect = autoReconnect;
+    for (const MultiConnectionManagerPrivate::Entry& entry : std::as_const(d->m_entries))
+        entry.manager->setAutoReconnect(autoReconnect);
+}
+
+void MultiConnectionManager::setMaximumPendingConnections(int maximum)
+{
+    Q_D(MultiConnectionManager);
+    d->m_maximumPending = qMax(1, maximum);
+    d->startNext();
+}
+
+QList<BoardAddress> MultiConnectionManager::addresses() const
+{
+    Q_D(const MultiConnectionManager);
+    QList<BoardAddress> addresses;
+    for (const MultiConnectionManagerPrivate::Entry& entry : d->m_entries)
+        addresses.append(entry.address);
+    return addresses;
+}
+
+RemoteBoard *MultiConnectionManager::board(const BoardAddress& address) const
+{
+    Q_D(const MultiConnectionManager);
+    const int index = d->indexOf(address);
+    return index == -1 ? nullptr : d->m_entries[index].board.data();
+}
+
+void MultiConnectionManager::connectToBoard(const BoardAddress& address, QObject *parent)
+{
+    Q_D(MultiConnectionManager);
+    d->connectToBoard(address, parent);
+}
+
+void MultiConnectionManager::disconnectFromBoard(const BoardAddress& address)
+{
+    Q_D(MultiConnectionManager);
+    d->disconnectFromBoard(address);
+}
+
+void MultiConnectionManager::disconnectAll()
+{
+    Q_D(MultiConnectionManager);
+    for (const BoardAddress& address : addresses())
+        d->disconnectFromBoard(address);
+}
+
+}
@@ -17,6 +17,7 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#include <QStringList>
 #include "chessboard.h"
 
 namespace Chessboard {
@@ -288,4 +289,101 @@ Pgn PgnParser::parse(QIODevice *device, QString *errorMessage)
     return parse(s, errorMessage);
 }
 
+namespace {
+    const char *const sevenTagRoster[] = {
+        "Event", "Site", "Date", "Round", "White", "Black", "Result"
+    };
+    // Export format keeps lines shorter than 80 characters.
+    const int maximumLineLength = 79;
+
+    QString escapeTagValue(QString value)
+    {
+        value.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+        value.replace(QLatin1Char('"'), QLatin1String("\\\""));
+        return value;
+    }
+
+    QString tagPair(const QString& name, const QString& value)
+    {
+        return QString(QLatin1String("[%1 \"%2\"]\n")).arg(name, escapeTagValue(value));
+    }
+}
+
+QString PgnWriter::write(const Pgn& pgn, QString *errorMessage)
+{
+    QString ret;
+    QStringList rosterTags;
+    for (const char *name : sevenTagRoster) {
+        const QString tag = QLatin1String(name);
+        const QString defaultValue = (tag == QLatin1String("Result")) ? QLatin1String("*") : QLatin1String("?");
+        ret += tagPair(tag, pgn.tags.value(tag, defaultValue));
+        rosterTags.append(tag);
+    }
+    for (auto it = pgn.tags.cbegin(); it != pgn.tags.cend(); ++it) {
+        if (!rosterTags.contains(it.key()))
+            ret += tagPair(it.key(), it.value());
+    }
+    ret += QLatin1Char('\n');
+
+    const QString fen = pgn.tags.value(QLatin1String("FEN"));
+    BoardState state = fen.isEmpty() ? BoardState::newGame() : BoardState::fromFenString(fen);
+    if (!state.isValid()) {
+        if (errorMessage)
+            *errorMessage = QString(QLatin1String("'%1': invalid FEN tag")).arg(fen);
+        return QString();
+    }
+    QStringList tokens;
+    for (int i=0;i<pgn.moves.size();++i) {
+        AlgebraicNotation move = pgn.moves[i];
+        // Moves made on a board give their squares but not always the piece.
+        if (move.fromRow >= 0 && move.fromRow < 8 && move.fromCol >= 0 && move.fromCol < 8 &&
+            state[move.fromRow][move.fromCol].isValid())
+            move.piece = state[move.fromRow][move.fromCol].piece();
+        const AlgebraicNotation resolved = move.resolve(state);
+        const QString san = resolved.isValid() ? resolved.toString(state) : QString();
+        if (san.isEmpty()) {
+            if (errorMessage)
+                *errorMessage = QString(QLatin1String("move %1: illegal move")).arg(QString::number(i + 1));
+            return QString();
+        }
+        if (state.activeColour == Colour::White)
+            tokens.append(QString::number(state.fullMoveCount) + QLatin1Char('.'));
+        else if (i == 0)
+            tokens.append(QString::number(state.fullMoveCount) + QLatin1String("..."));
+        tokens.append(san);
+        bool promotionRequired = false;
+        state.move(resolved.fromRow, resolved.fromCol, resolved.toRow, resolved.toCol, &promotionRequired);
+        if (promotionRequired)
+            state.promote(resolved.promotion ? resolved.promotionPiece : Piece::Queen);
+    }
+    tokens.append(pgn.tags.value(QLatin1String("Result"), QLatin1String("*")));
+
+    QString line;
+    for (const QString& token : tokens) {
+        if (!line.isEmpty() && line.length() + 1 + token.length() > maximumLineLength) {
+            ret += line + QLatin1Char('\n');
+            line.clear();
+        }
+        if (!line.isEmpty())
+            line += QLatin1Char(' ');
+        line += token;
+    }
+    ret += line + QLatin1String("\n\n");
+    return ret;
+}
+
+bool PgnWriter::write(QIODevice *device, const Pgn& pgn, QString *errorMessage)
+{
+    const QString s = write(pgn, errorMessage);
+    if (s.isEmpty())
+        return false;
+    const QByteArray ba = s.toLatin1();
+    if (device->write(ba) != ba.size()) {
+        if (errorMessage)
+            *errorMessage = device->errorString();
+        return false;
+    }
+    return true;
+}
+
 }
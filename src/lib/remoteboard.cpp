@@ -44,6 +44,80 @@ BoardAddress RemoteBoard::address() const
     return d->address();
 }
 
+LinkStatistics RemoteBoard::linkStatistics() const
+{
+    Q_D(const RemoteBoard);
+
+    return d->linkStatistics();
+}
+
+void RemoteBoard::recordRequestLatency(qint64 latency)
+{
+    Q_D(RemoteBoard);
+
+    LinkStatistics& statistics = d->linkStatistics();
+    ++statistics.completed;
+    statistics.lastLatency = latency;
+    statistics.maximumLatency = qMax(statistics.maximumLatency, latency);
+    statistics.totalLatency += latency;
+    emit linkStatisticsChanged(statistics);
+}
+
+void RemoteBoard::recordRequestRetry()
+{
+    Q_D(RemoteBoard);
+
+    ++d->linkStatistics().retries;
+    emit linkStatisticsChanged(d->linkStatistics());
+}
+
+void RemoteBoard::recordRequestFailure()
+{
+    Q_D(RemoteBoard);
+
+    ++d->linkStatistics().failures;
+    emit linkStatisticsChanged(d->linkStatistics());
+}
+
+void RemoteBoard::recordUnexpectedWrite()
+{
+    Q_D(RemoteBoard);
+
+    ++d->linkStatistics().unexpectedWrites;
+    emit linkStatisticsChanged(d->linkStatistics());
+}
+
+void RemoteBoard::recordNotificationLatency(qint64 latency)
+{
+    Q_D(RemoteBoard);
+
+    LinkStatistics& statistics = d->linkStatistics();
+    ++statistics.notifications;
+    statistics.lastNotificationLatency = latency;
+    statistics.maximumNotificationLatency = qMax(statistics.maximumNotificationLatency, latency);
+    statistics.totalNotificationLatency += latency;
+    emit linkStatisticsChanged(statistics);
+}
+
+void RemoteBoard::recordLowLatency(bool lowLatency)
+{
+    Q_D(RemoteBoard);
+
+    d->linkStatistics().lowLatency = lowLatency;
+    emit linkStatisticsChanged(d->linkStatistics());
+}
+
+void RemoteBoard::recordConnectionParameters(double interval, int latency, int supervisionTimeout)
+{
+    Q_D(RemoteBoard);
+
+    LinkStatistics& statistics = d->linkStatistics();
+    statistics.connectionInterval = interval;
+    statistics.connectionLatency = latency;
+    statistics.supervisionTimeout = supervisionTimeout;
+    emit linkStatisticsChanged(statistics);
+}
+
 void RemoteBoard::requestRemoteBoardState()
 {
 }
@@ -29,8 +29,11 @@ class RemoteBoardPrivate
 public:
     RemoteBoardPrivate(const BoardAddress& address);
     BoardAddress address() const { return m_address; }
+    LinkStatistics& linkStatistics() { return m_linkStatistics; }
+    const LinkStatistics& linkStatistics() const { return m_linkStatistics; }
 private:
     BoardAddress m_address;
+    LinkStatistics m_linkStatistics;
 };
 
 }
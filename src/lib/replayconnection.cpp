@@ -0,0 +1,65 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "chessupboard.h"
+#include "chessupreplay.h"
+#include "chessuptrace.h"
+#include "replayconnection.h"
+
+namespace Chessboard {
+
+ReplayConnection::ReplayConnection(const BoardAddress& address, const QString& fileName, double speed, QObject *parent) :
+    Connection(address, parent),
+    m_fileName(fileName),
+    m_speed(speed)
+{
+}
+
+void ReplayConnection::connectToBoard()
+{
+    qDebug("ReplayConnection::connectToBoard");
+    Q_ASSERT(!m_board);
+    QList<ChessUpTraceEvent> events;
+    QString errorMessage;
+    if (!readChessUpTrace(m_fileName, &events, &errorMessage)) {
+        qWarning("ReplayConnection::connectToBoard: %s", qPrintable(errorMessage));
+        QMetaObject::invokeMethod(this, [this]() {
+            emit error(ConnectionManager::UnknownRemoteDeviceError);
+            emit connectionFailed();
+        }, Qt::QueuedConnection);
+        return;
+    }
+    ChessUpReplay *replay = new ChessUpReplay(events, m_speed);
+    m_board = new ChessUpBoard(address(), this, replay, this);
+    connect(this, &ReplayConnection::connectionFailed, m_board, &RemoteBoard::deleteLater);
+    connect(replay, &ChessUpReplay::finished, this, &ReplayConnection::disconnectFromBoard, Qt::QueuedConnection);
+}
+
+void ReplayConnection::disconnectFromBoard()
+{
+    qDebug("ReplayConnection::disconnectFromBoard");
+    if (!m_board)
+        return;
+    m_board = nullptr;
+    QMetaObject::invokeMethod(this, [this]() {
+        emit disconnected();
+    }, Qt::QueuedConnection);
+}
+
+}
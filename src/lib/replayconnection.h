@@ -0,0 +1,46 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAYCONNECTION_H
+#define REPLAYCONNECTION_H
+
+#include "connection.h"
+
+namespace Chessboard {
+
+class ChessUpBoard;
+
+// Connects to a recorded ChessUp session, replaying the board's side of
+// the trace. The connection closes when the trace runs out.
+class ReplayConnection : public Connection
+{
+    Q_OBJECT
+public:
+    ReplayConnection(const BoardAddress& address, const QString& fileName, double speed, QObject *parent = nullptr);
+    void connectToBoard() override;
+    void disconnectFromBoard() override;
+private:
+    QString m_fileName;
+    double m_speed;
+    ChessUpBoard *m_board {};
+};
+
+}
+
+#endif // REPLAYCONNECTION_H
@@ -0,0 +1,63 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTimer>
+
+#include "chessupboard.h"
+#include "simulatedconnection.h"
+
+namespace Chessboard {
+
+SimulatedConnection::SimulatedConnection(const BoardAddress& address, const ChessUpSimulator::Options& options, QObject *parent) :
+    Connection(address, parent),
+    m_options(options)
+{
+}
+
+void SimulatedConnection::connectToBoard()
+{
+    qDebug("SimulatedConnection::connectToBoard");
+    Q_ASSERT(!m_board);
+    m_board = new ChessUpBoard(address(), this, new ChessUpSimulator(m_options), this);
+    connect(this, &SimulatedConnection::connectionFailed, m_board, &RemoteBoard::deleteLater);
+    if (m_options.drop > 0) {
+        connect(this, &SimulatedConnection::connected, this, [this]() {
+            QTimer::singleShot(m_options.drop, this, [this]() {
+                if (!m_board)
+                    return;
+                qDebug("SimulatedConnection: dropping the link");
+                m_board = nullptr;
+                emit disconnected();
+            });
+        });
+    }
+}
+
+void SimulatedConnection::disconnectFromBoard()
+{
+    qDebug("SimulatedConnection::disconnectFromBoard");
+    if (!m_board)
+        return;
+    m_board = nullptr;
+    QTimer::singleShot(m_options.latency, this, [this]() {
+        emit disconnected();
+    });
+}
+
+}
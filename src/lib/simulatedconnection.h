@@ -0,0 +1,46 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIMULATEDCONNECTION_H
+#define SIMULATEDCONNECTION_H
+
+#include "chessupsimulator.h"
+#include "connection.h"
+
+namespace Chessboard {
+
+class ChessUpBoard;
+
+// Connects to a simulated ChessUp board, so that the app and tests can run
+// without hardware.
+class SimulatedConnection : public Connection
+{
+    Q_OBJECT
+public:
+    SimulatedConnection(const BoardAddress& address, const ChessUpSimulator::Options& options, QObject *parent = nullptr);
+    void connectToBoard() override;
+    void disconnectFromBoard() override;
+private:
+    ChessUpSimulator::Options m_options;
+    ChessUpBoard *m_board {};
+};
+
+}
+
+#endif // SIMULATEDCONNECTION_H
@@ -0,0 +1,756 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+#include "syzygytable.h"
+
+namespace Chessboard {
+
+namespace {
+    enum Flag {
+        StmFlag = 1,
+        MappedFlag = 2,
+        WinPliesFlag = 4,
+        LossPliesFlag = 8,
+        WideFlag = 16,
+        SingleValueFlag = 128
+    };
+
+    // Syzygy piece types, as in the piece codes.
+    enum PieceType {
+        Pawn = 1,
+        Knight = 2,
+        Bishop = 3,
+        Rook = 4,
+        Queen = 5,
+        King = 6
+    };
+
+    int rankOf(int sq) { return sq >> 3; }
+    int fileOf(int sq) { return sq & 7; }
+    // Positive above the a1-h8 diagonal, negative below it.
+    int offA1H8(int sq) { return rankOf(sq) - fileOf(sq); }
+
+    uint16_t readLe16(const uint8_t *p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t readLe32(const uint8_t *p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    uint32_t readBe32(const uint8_t *p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    }
+
+    uint64_t readBe64(const uint8_t *p)
+    {
+        return (static_cast<uint64_t>(readBe32(p)) << 32) | readBe32(p + 4);
+    }
+
+    // Each node of the pairing tree is two 12-bit symbols packed in three
+    // bytes.
+    uint16_t leftSymbol(const uint8_t *btree, uint16_t sym)
+    {
+        const uint8_t *lr = btree + 3 * sym;
+        return static_cast<uint16_t>(((lr[1] & 0xf) << 8) | lr[0]);
+    }
+
+    uint16_t rightSymbol(const uint8_t *btree, uint16_t sym)
+    {
+        const uint8_t *lr = btree + 3 * sym;
+        return static_cast<uint16_t>((lr[2] << 4) | (lr[1] >> 4));
+    }
+
+    int pieceType(char letter)
+    {
+        switch (letter) {
+        case 'K':
+            return King;
+        case 'Q':
+            return Queen;
+        case 'R':
+            return Rook;
+        case 'B':
+            return Bishop;
+        case 'N':
+            return Knight;
+        case 'P':
+            return Pawn;
+        default:
+            return 0;
+        }
+    }
+
+    // Lookup tables for turning a position into an index, shared by every
+    // table.
+    struct IndexTables {
+        // Squares a2-h7 in the order pawns lead: towards the edge first,
+        // then lowest rank first, from 47 down to 0.
+        int mapPawns[64] {};
+        // Squares below the a1-h8 diagonal, 0 to 27.
+        int mapB1H1H7[64] {};
+        // The a1-d1-d4 triangle, 0 to 9 with the diagonal last.
+        int mapA1D1D4[64] {};
+        // The 462 placements of two kings with the first in the triangle.
+        int mapKK[10][64] {};
+        uint64_t binomial[SyzygyTable::maxPieces][64] {};
+        uint64_t leadPawnIdx[6][64] {};
+        uint64_t leadPawnsSize[6][4] {};
+
+        IndexTables()
+        {
+            int code = 0;
+            for (int sq=0;sq<64;++sq) {
+                if (offA1H8(sq) < 0)
+                    mapB1H1H7[sq] = code++;
+            }
+
+            std::vector<int> diagonal;
+            code = 0;
+            for (int row=0;row<4;++row) {
+                for (int col=0;col<4;++col) {
+                    const int sq = row * 8 + col;
+                    if (offA1H8(sq) < 0)
+                        mapA1D1D4[sq] = code++;
+                    else if (offA1H8(sq) == 0)
+                        diagonal.push_back(sq);
+                }
+            }
+            for (int sq : diagonal)
+                mapA1D1D4[sq] = code++;
+
+            // With the first king on the diagonal, the second is kept on
+            // or below it, and both on the diagonal come last.
+            std::vector<std::pair<int, int> > bothOnDiagonal;
+            code = 0;
+            for (int idx=0;idx<10;++idx) {
+                for (int s1=0;s1<=27;++s1) {
+                    // b1 is the only square of the triangle mapped to 0.
+                    if (mapA1D1D4[s1] != idx || (idx == 0 && s1 != 1))
+                        continue;
+                    for (int s2=0;s2<64;++s2) {
+                        if (std::abs(rankOf(s1) - rankOf(s2)) <= 1 && std::abs(fileOf(s1) - fileOf(s2)) <= 1)
+                            continue;
+                        else if (!offA1H8(s1) && offA1H8(s2) > 0)
+                            continue;
+                        else if (!offA1H8(s1) && !offA1H8(s2))
+                            bothOnDiagonal.emplace_back(idx, s2);
+                        else
+                            mapKK[idx][s2] = code++;
+                    }
+                }
+            }
+            for (const std::pair<int, int>& p : bothOnDiagonal)
+                mapKK[p.first][p.second] = code++;
+
+            binomial[0][0] = 1;
+            for (int n=1;n<64;++n) {
+                for (int k=0;k<SyzygyTable::maxPieces && k<=n;++k)
+                    binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+            }
+
+            int availableSquares = 47;
+            for (int leadPawnsCnt=1;leadPawnsCnt<=5;++leadPawnsCnt) {
+                for (int file=0;file<4;++file) {
+                    // Tables are split by the file of the leading pawn, so
+                    // the index starts again for each file.
+                    uint64_t idx = 0;
+                    for (int rank=1;rank<=6;++rank) {
+                        const int sq = rank * 8 + file;
+                        if (leadPawnsCnt == 1) {
+                            mapPawns[sq] = availableSquares--;
+                            mapPawns[sq ^ 7] = availableSquares--;
+                        }
+                        leadPawnIdx[leadPawnsCnt][sq] = idx;
+                        idx += binomial[leadPawnsCnt - 1][mapPawns[sq]];
+                    }
+                    leadPawnsSize[leadPawnsCnt][file] = idx;
+                }
+            }
+        }
+    };
+
+    const IndexTables& indexTables()
+    {
+        static const IndexTables tables;
+        return tables;
+    }
+}
+
+SyzygyTable::SyzygyTable(Type type, const std::string& material) :
+    m_type(type)
+{
+    int side = 0;
+    for (char letter : material) {
+        if (letter == 'v') {
+            side = 1;
+            continue;
+        }
+        const int piece = pieceType(letter);
+        if (piece == 0 || m_pieceCount == maxPieces)
+            continue;
+        ++m_counts[side][piece];
+        ++m_pieceCount;
+    }
+    m_hasPawns = m_counts[0][Pawn] + m_counts[1][Pawn] > 0;
+    m_symmetric = std::equal(m_counts[0], m_counts[0] + 7, m_counts[1]);
+    for (int side=0;side<2;++side) {
+        for (int piece=Pawn;piece<King;++piece) {
+            if (m_counts[side][piece] == 1)
+                m_hasUniquePieces = true;
+        }
+    }
+    // The side with fewer pawns leads, as that compresses better.
+    const bool firstLeads = !m_counts[1][Pawn] || (m_counts[0][Pawn] && m_counts[1][Pawn] >= m_counts[0][Pawn]);
+    m_pawnCount[0] = m_counts[firstLeads ? 0 : 1][Pawn];
+    m_pawnCount[1] = m_counts[firstLeads ? 1 : 0][Pawn];
+}
+
+bool SyzygyTable::init(const uint8_t *data, size_t size)
+{
+    enum {
+        Split = 1,
+        HasPawns = 2
+    };
+
+    m_base = data;
+    m_end = data + size;
+    // Skip the magic, which the caller has checked.
+    const uint8_t *p = data + 4;
+    auto available = [this](const uint8_t *p, uint64_t n) {
+        return p && p <= m_end && n <= static_cast<uint64_t>(m_end - p);
+    };
+    if (!available(p, 1) || bool(*p & HasPawns) != m_hasPawns)
+        return false;
+    if (m_type == Wdl && bool(*p & Split) == m_symmetric)
+        return false;
+    ++p;
+
+    const int sides = (m_type == Wdl && !m_symmetric) ? 2 : 1;
+    const int maxFile = m_hasPawns ? 3 : 0;
+    // Pawns on both sides.
+    const bool pp = m_hasPawns && m_pawnCount[1];
+    for (int file=0;file<=maxFile;++file) {
+        if (!available(p, 1 + pp + m_pieceCount))
+            return false;
+        for (int i=0;i<sides;++i)
+            *get(i, file) = PairsData();
+        const int order[2][2] = {
+            { p[0] & 0xf, pp ? p[1] & 0xf : 0xf },
+            { p[0] >> 4, pp ? p[1] >> 4 : 0xf }
+        };
+        p += 1 + pp;
+        for (int k=0;k<m_pieceCount;++k,++p) {
+            for (int i=0;i<sides;++i)
+                get(i, file)->pieces[k] = static_cast<uint8_t>(i ? *p >> 4 : *p & 0xf);
+        }
+        for (int i=0;i<sides;++i)
+            setGroups(get(i, file), order[i], file);
+    }
+    p += (p - m_base) & 1;
+
+    for (int file=0;file<=maxFile;++file) {
+        for (int i=0;i<sides;++i) {
+            p = setSizes(get(i, file), p);
+            if (!p)
+                return false;
+        }
+    }
+    if (m_type == Dtz) {
+        p = setDtzMap(p, maxFile);
+        if (!p)
+            return false;
+    }
+
+    for (int file=0;file<=maxFile;++file) {
+        for (int i=0;i<sides;++i) {
+            PairsData *d = get(i, file);
+            if (!available(p, d->sparseIndexSize * 6))
+                return false;
+            d->sparseIndex = p;
+            p += d->sparseIndexSize * 6;
+        }
+    }
+    for (int file=0;file<=maxFile;++file) {
+        for (int i=0;i<sides;++i) {
+            PairsData *d = get(i, file);
+            if (!available(p, static_cast<uint64_t>(d->blockLengthSize) * 2))
+                return false;
+            d->blockLength = p;
+            p += static_cast<uint64_t>(d->blockLengthSize) * 2;
+        }
+    }
+    for (int file=0;file<=maxFile;++file) {
+        for (int i=0;i<sides;++i) {
+            PairsData *d = get(i, file);
+            // Compressed data is 64 byte aligned.
+            const uint64_t padding = (64 - (p - m_base) % 64) % 64;
+            if (!available(p, padding))
+                return false;
+            p += padding;
+            const uint64_t dataSize = static_cast<uint64_t>(d->numBlocks) * d->blockSize;
+            if (!available(p, dataSize))
+                return false;
+            d->data = p;
+            p += dataSize;
+        }
+    }
+    return true;
+}
+
+bool SyzygyTable::matches(const uint8_t *board) const
+{
+    int counts[2][7] = {};
+    for (int sq=0;sq<64;++sq) {
+        if (board[sq])
+            ++counts[(board[sq] & 8) ? 1 : 0][board[sq] & 7];
+    }
+    for (int first=0;first<2;++first) {
+        if (std::equal(counts[first], counts[first] + 7, m_counts[0]) &&
+            std::equal(counts[1 - first], counts[1 - first] + 7, m_counts[1]))
+            return true;
+    }
+    return false;
+}
+
+// Works out how the pieces are grouped for encoding. The first group is
+// the leading pawns, or the kings and one other unique piece, or just the
+// kings; each following group is all the pieces of one kind.
+void SyzygyTable::setGroups(PairsData *d, const int order[2], int file)
+{
+    const IndexTables& t = indexTables();
+    int n = 0;
+    int firstLen = m_hasPawns ? 0 : m_hasUniquePieces ? 3 : 2;
+    d->groupLen[n] = 1;
+    for (int i=1;i<m_pieceCount;++i) {
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1])
+            d->groupLen[n]++;
+        else
+            d->groupLen[++n] = 1;
+    }
+    d->groupLen[++n] = 0;
+
+    // The order in which the groups are encoded is stored in the table;
+    // the remaining pawns, if any, are second in the piece list.
+    const bool pp = m_hasPawns && m_pawnCount[1];
+    int next = pp ? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+    uint64_t idx = 1;
+    for (int k=0;next<n || k==order[0] || k==order[1];++k) {
+        if (k == order[0]) {
+            d->groupIdx[0] = idx;
+            idx *= m_hasPawns ? t.leadPawnsSize[d->groupLen[0]][file] : m_hasUniquePieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d->groupIdx[1] = idx;
+            idx *= t.binomial[d->groupLen[1]][48 - d->groupLen[0]];
+        } else {
+            d->groupIdx[next] = idx;
+            idx *= t.binomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next++];
+        }
+    }
+    d->groupIdx[n] = idx;
+}
+
+// Reads the sizes and the canonical Huffman code of one subtable.
+const uint8_t *SyzygyTable::setSizes(PairsData *d, const uint8_t *data)
+{
+    auto available = [this](const uint8_t *p, uint64_t n) {
+        return p <= m_end && n <= static_cast<uint64_t>(m_end - p);
+    };
+    if (!available(data, 1))
+        return nullptr;
+    d->flags = *data++;
+    if (d->flags & SingleValueFlag) {
+        // Every position has the same value, stored here.
+        d->numBlocks = 0;
+        d->span = 0;
+        d->blockLengthSize = 0;
+        d->sparseIndexSize = 0;
+        if (!available(data, 1))
+            return nullptr;
+        d->minSymLen = *data++;
+        return data;
+    }
+
+    if (!available(data, 10))
+        return nullptr;
+    int n = 0;
+    while (d->groupLen[n])
+        ++n;
+    const uint64_t tbSize = d->groupIdx[n];
+    if (data[0] >= 32 || data[1] >= 64)
+        return nullptr;
+    d->blockSize = 1ULL << data[0];
+    d->span = 1ULL << data[1];
+    data += 2;
+    d->sparseIndexSize = (tbSize + d->span - 1) / d->span;
+    const uint8_t padding = *data++;
+    d->numBlocks = readLe32(data);
+    data += 4;
+    // Padded so that the sparse index never points out of range.
+    d->blockLengthSize = d->numBlocks + padding;
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    if (d->maxSymLen < d->minSymLen || d->maxSymLen > 32)
+        return nullptr;
+    d->lowestSym = data;
+    d->base64.assign(d->maxSymLen - d->minSymLen + 1, 0);
+    if (!available(data, d->base64.size() * 2 + 2))
+        return nullptr;
+
+    // Longer codes have lower values, so base64[i] is the lowest code of
+    // length i + minSymLen, left-aligned in 64 bits.
+    for (int i=static_cast<int>(d->base64.size())-2;i>=0;--i) {
+        d->base64[i] = (d->base64[i + 1] + readLe16(d->lowestSym + 2 * i) -
+                        readLe16(d->lowestSym + 2 * (i + 1))) / 2;
+    }
+    for (size_t i=0;i<d->base64.size();++i) {
+        const size_t shift = 64 - i - d->minSymLen;
+        d->base64[i] = (shift < 64) ? d->base64[i] << shift : 0;
+    }
+
+    data += d->base64.size() * 2;
+    d->symlen.assign(readLe16(data), 0);
+    data += 2;
+    if (!available(data, d->symlen.size() * 3 + 1))
+        return nullptr;
+    d->btree = data;
+
+    // Symbols are compressed by recursive pairing: each expands into a pair
+    // of symbols, down to the values themselves. symlen is one less than the
+    // number of values a symbol expands into.
+    std::vector<bool> visited(d->symlen.size());
+    for (size_t sym=0;sym<d->symlen.size();++sym) {
+        if (!visited[sym])
+            d->symlen[sym] = setSymlen(d, static_cast<uint16_t>(sym), visited);
+    }
+    return data + d->symlen.size() * 3 + (d->symlen.size() & 1);
+}
+
+uint8_t SyzygyTable::setSymlen(PairsData *d, uint16_t sym, std::vector<bool>& visited)
+{
+    visited[sym] = true;
+    const uint16_t right = rightSymbol(d->btree, sym);
+    if (right == 0xfff)
+        return 0;
+    const uint16_t left = leftSymbol(d->btree, sym);
+    if (left >= d->symlen.size() || right >= d->symlen.size())
+        return 0;
+    if (!visited[left])
+        d->symlen[left] = setSymlen(d, left, visited);
+    if (!visited[right])
+        d->symlen[right] = setSymlen(d, right, visited);
+    return static_cast<uint8_t>(d->symlen[left] + d->symlen[right] + 1);
+}
+
+// DTZ tables may store their values through a map, one per result.
+const uint8_t *SyzygyTable::setDtzMap(const uint8_t *data, int maxFile)
+{
+    auto available = [this](const uint8_t *p, uint64_t n) {
+        return p <= m_end && n <= static_cast<uint64_t>(m_end - p);
+    };
+    m_map = data;
+    for (int file=0;file<=maxFile;++file) {
+        PairsData *d = get(0, file);
+        if (!(d->flags & MappedFlag))
+            continue;
+        if (d->flags & WideFlag) {
+            data += (data - m_base) & 1;
+            for (int i=0;i<4;++i) {
+                if (!available(data, 2))
+                    return nullptr;
+                d->mapIdx[i] = static_cast<uint32_t>(data - m_map + 2);
+                data += 2 * static_cast<uint64_t>(readLe16(data)) + 2;
+            }
+        } else {
+            for (int i=0;i<4;++i) {
+                if (!available(data, 1))
+                    return nullptr;
+                d->mapIdx[i] = static_cast<uint32_t>(data - m_map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+    if (data > m_end)
+        return nullptr;
+    return data + ((data - m_base) & 1);
+}
+
+int SyzygyTable::decompressPairs(const PairsData *d, uint64_t idx) const
+{
+    if (d->flags & SingleValueFlag)
+        return d->minSymLen;
+
+    // The sparse index gives the block and offset of every span'th value,
+    // measured from the middle of the span.
+    const uint64_t k = idx / d->span;
+    if (k >= d->sparseIndexSize)
+        return 0;
+    uint32_t block = readLe32(d->sparseIndex + 6 * k);
+    int64_t offset = readLe16(d->sparseIndex + 6 * k + 4);
+    offset += static_cast<int64_t>(idx % d->span) - static_cast<int64_t>(d->span / 2);
+
+    // Each block holds blockLength + 1 values.
+    while (offset < 0) {
+        if (block == 0)
+            return 0;
+        offset += readLe16(d->blockLength + 2 * --block) + 1;
+    }
+    while (offset > readLe16(d->blockLength + 2 * block)) {
+        offset -= readLe16(d->blockLength + 2 * block++) + 1;
+        if (block >= d->blockLengthSize)
+            return 0;
+    }
+    if (block >= d->numBlocks)
+        return 0;
+
+    const uint8_t *ptr = d->data + static_cast<uint64_t>(block) * d->blockSize;
+    const uint8_t *end = ptr + d->blockSize;
+    uint64_t buf64 = readBe64(ptr);
+    ptr += 8;
+    int buf64Size = 64;
+    uint16_t sym;
+    while (true) {
+        // Work out the length of the next code from the lowest code of each
+        // length; codes of one length are consecutive.
+        int len = 0;
+        while (len + 1 < static_cast<int>(d->base64.size()) && buf64 < d->base64[len])
+            ++len;
+        const int shift = 64 - len - d->minSymLen;
+        sym = static_cast<uint16_t>((shift < 64) ? (buf64 - d->base64[len]) >> shift : 0);
+        sym = static_cast<uint16_t>(sym + readLe16(d->lowestSym + 2 * len));
+        if (sym >= d->symlen.size())
+            return 0;
+        if (offset < d->symlen[sym] + 1)
+            break;
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+        if (buf64Size <= 32) {
+            if (ptr + 4 > end)
+                return 0;
+            buf64Size += 32;
+            buf64 |= static_cast<uint64_t>(readBe32(ptr)) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+
+    // Expand the symbol down to the value at the offset.
+    while (d->symlen[sym]) {
+        const uint16_t left = leftSymbol(d->btree, sym);
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = rightSymbol(d->btree, sym);
+        }
+    }
+    return leftSymbol(d->btree, sym);
+}
+
+int SyzygyTable::mapScore(int file, int value, int wdl) const
+{
+    if (m_type == Wdl)
+        return value - 2;
+
+    // Index of each result's map, by wdl + 2.
+    static const int wdlMap[] = { 1, 3, 0, 2, 0 };
+    const PairsData *d = get(0, file);
+    if (d->flags & MappedFlag) {
+        const uint32_t index = d->mapIdx[wdlMap[wdl + 2]];
+        if (d->flags & WideFlag)
+            value = readLe16(m_map + index + 2 * value);
+        else
+            value = m_map[index + value];
+    }
+    // Values are stored in moves rather than plies where that is exact.
+    if ((wdl == 2 && !(d->flags & WinPliesFlag)) ||
+        (wdl == -2 && !(d->flags & LossPliesFlag)) ||
+        wdl == 1 || wdl == -1)
+        value *= 2;
+    return value + 1;
+}
+
+int SyzygyTable::probe(const uint8_t *board, bool blackToMove, int wdl, Status *status) const
+{
+    const IndexTables& t = indexTables();
+    *status = Ok;
+
+    // Tables are stored with the first side in the file name as white. If
+    // black has that material, or the material is the same on both sides
+    // and black is to move, swap the colours and mirror the board.
+    int whiteCounts[7] = {};
+    for (int sq=0;sq<64;++sq) {
+        if (board[sq] && !(board[sq] & 8))
+            ++whiteCounts[board[sq] & 7];
+    }
+    const bool whiteFirst = std::equal(whiteCounts, whiteCounts + 7, m_counts[0]);
+    const bool flip = m_symmetric ? blackToMove : !whiteFirst;
+    const int flipColour = flip ? 8 : 0;
+    const int flipSquares = flip ? 56 : 0;
+    const int stm = (flip ? 1 : 0) ^ (blackToMove ? 1 : 0);
+
+    int squares[maxPieces];
+    uint8_t pieces[maxPieces] = {};
+    int size = 0;
+    int leadPawnsCnt = 0;
+    bool lead[64] = {};
+    int tbFile = 0;
+    auto pawnsComp = [&t](int a, int b) { return t.mapPawns[a] < t.mapPawns[b]; };
+
+    // Pawn tables are split by the file of the leading pawn: the one
+    // nearest the edge, then on the lowest rank.
+    if (m_hasPawns) {
+        const int leadPawn = get(0, 0)->pieces[0] ^ flipColour;
+        for (int sq=0;sq<64;++sq) {
+            if (board[sq] == leadPawn) {
+                if (size == maxPieces) {
+                    *status = Failed;
+                    return 0;
+                }
+                squares[size++] = sq ^ flipSquares;
+                lead[sq] = true;
+            }
+        }
+        if (size == 0) {
+            *status = Failed;
+            return 0;
+        }
+        leadPawnsCnt = size;
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCnt, pawnsComp));
+        tbFile = std::min(fileOf(squares[0]), 7 - fileOf(squares[0]));
+    }
+
+    if (m_type == Dtz && (get(stm, tbFile)->flags & StmFlag) != stm && !(m_symmetric && !m_hasPawns)) {
+        *status = ChangeSideToMove;
+        return 0;
+    }
+
+    for (int sq=0;sq<64;++sq) {
+        if (board[sq] && !lead[sq]) {
+            if (size == maxPieces) {
+                *status = Failed;
+                return 0;
+            }
+            squares[size] = sq ^ flipSquares;
+            pieces[size++] = static_cast<uint8_t>(board[sq] ^ flipColour);
+        }
+    }
+    if (size != m_pieceCount) {
+        *status = Failed;
+        return 0;
+    }
+
+    const PairsData *d = get(stm, tbFile);
+    // Put the pieces in the order the table encodes them.
+    for (int i=leadPawnsCnt;i<size-1;++i) {
+        for (int j=i+1;j<size;++j) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    // Mirror so that the leading piece is on files a-d.
+    if (fileOf(squares[0]) > 3) {
+        for (int i=0;i<size;++i)
+            squares[i] ^= 7;
+    }
+
+    uint64_t idx;
+    if (m_hasPawns) {
+        idx = t.leadPawnIdx[leadPawnsCnt][squares[0]];
+        std::stable_sort(squares + 1, squares + leadPawnsCnt, pawnsComp);
+        for (int i=1;i<leadPawnsCnt;++i)
+            idx += t.binomial[i][t.mapPawns[squares[i]]];
+    } else {
+        // Without pawns, also mirror so that the leading piece is on ranks
+        // 1-4 and the first of the leading group off the diagonal is below it.
+        if (rankOf(squares[0]) > 3) {
+            for (int i=0;i<size;++i)
+                squares[i] ^= 56;
+        }
+        for (int i=0;i<d->groupLen[0];++i) {
+            if (!offA1H8(squares[i]))
+                continue;
+            if (offA1H8(squares[i]) > 0) {
+                for (int j=i;j<size;++j)
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+
+        if (m_hasUniquePieces) {
+            // Three unique pieces, kings included, are encoded together.
+            const int adjust1 = squares[1] > squares[0];
+            const int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (offA1H8(squares[0])) {
+                idx = (static_cast<uint64_t>(t.mapA1D1D4[squares[0]]) * 63 + (squares[1] - adjust1)) * 62 +
+                      squares[2] - adjust2;
+            } else if (offA1H8(squares[1])) {
+                idx = (6 * 63 + static_cast<uint64_t>(rankOf(squares[0])) * 28 + t.mapB1H1H7[squares[1]]) * 62 +
+                      squares[2] - adjust2;
+            } else if (offA1H8(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + static_cast<uint64_t>(rankOf(squares[0])) * 7 * 28 +
+                      (rankOf(squares[1]) - adjust1) * 28 + t.mapB1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + static_cast<uint64_t>(rankOf(squares[0])) * 6 * 5 +
+                      (rankOf(squares[1]) - adjust1) * 5 + rankOf(squares[2]) - adjust2;
+            }
+        } else {
+            idx = t.mapKK[t.mapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    // The remaining groups each choose squares from those left over, in
+    // ascending order.
+    idx *= d->groupIdx[0];
+    int *groupSq = squares + d->groupLen[0];
+    bool remainingPawns = m_hasPawns && m_pawnCount[1];
+    for (int next=1;d->groupLen[next];++next) {
+        std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+        uint64_t n = 0;
+        for (int i=0;i<d->groupLen[next];++i) {
+            const int adjust = static_cast<int>(std::count_if(squares, groupSq, [&](int sq) {
+                return groupSq[i] > sq;
+            }));
+            n += t.binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+
+    return mapScore(tbFile, decompressPairs(d, idx), wdl);
+}
+
+}
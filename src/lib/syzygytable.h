@@ -0,0 +1,118 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYZYGYTABLE_H
+#define SYZYGYTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Chessboard {
+
+// Decoder for one Syzygy WDL (.rtbw) or DTZ (.rtbz) table, read in place
+// from memory the caller has mapped. The format is the one documented by
+// the Stockfish and Fathom probing code. Boards are 64 squares numbered
+// row * 8 + col, row 0 being rank 1, holding Syzygy piece codes: 1 to 6
+// for a white pawn, knight, bishop, rook, queen and king, 9 to 14 for the
+// black pieces and 0 for an empty square.
+class SyzygyTable
+{
+public:
+    enum Type {
+        Wdl,
+        Dtz
+    };
+    enum Status {
+        Ok,
+        // A DTZ table holds only one side to move; probe after a move.
+        ChangeSideToMove,
+        Failed
+    };
+    static const int maxPieces = 7;
+
+    // material is the file name without its suffix, e.g. "KRPvKR".
+    SyzygyTable(Type type, const std::string& material);
+    // Reads the table's headers. Returns false if the data is not a table
+    // for this material or is truncated.
+    bool init(const uint8_t *data, size_t size);
+    Type type() const { return m_type; }
+    int pieceCount() const { return m_pieceCount; }
+    // Whether the board has this table's material, with either colour as
+    // the first side in the file name.
+    bool matches(const uint8_t *board) const;
+    // For a WDL table, the result for the side to move from -2 (loss) to 2
+    // (win). For a DTZ table, the plies to the next capture or pawn move
+    // for a position with the result wdl. Captures and en passant are not
+    // taken into account; that is for the caller.
+    int probe(const uint8_t *board, bool blackToMove, int wdl, Status *status) const;
+
+private:
+    struct PairsData {
+        uint8_t flags {};
+        uint8_t maxSymLen {};
+        uint8_t minSymLen {};
+        uint32_t numBlocks {};
+        uint64_t blockSize {};
+        uint64_t span {};
+        const uint8_t *lowestSym {};
+        const uint8_t *btree {};
+        const uint8_t *blockLength {};
+        uint32_t blockLengthSize {};
+        const uint8_t *sparseIndex {};
+        uint64_t sparseIndexSize {};
+        const uint8_t *data {};
+        std::vector<uint64_t> base64;
+        std::vector<uint8_t> symlen;
+        uint8_t pieces[maxPieces] {};
+        uint64_t groupIdx[maxPieces + 1] {};
+        int groupLen[maxPieces + 1] {};
+        // Offsets into the DTZ value map for each WDL result.
+        uint32_t mapIdx[4] {};
+    };
+
+    PairsData *get(int stm, int file) { return &m_items[(m_type == Wdl) ? stm % 2 : 0][m_hasPawns ? file : 0]; }
+    const PairsData *get(int stm, int file) const { return &m_items[(m_type == Wdl) ? stm % 2 : 0][m_hasPawns ? file : 0]; }
+    void setGroups(PairsData *d, const int order[2], int file);
+    const uint8_t *setSizes(PairsData *d, const uint8_t *data);
+    const uint8_t *setDtzMap(const uint8_t *data, int maxFile);
+    uint8_t setSymlen(PairsData *d, uint16_t sym, std::vector<bool>& visited);
+    int decompressPairs(const PairsData *d, uint64_t idx) const;
+    int mapScore(int file, int value, int wdl) const;
+
+    Type m_type;
+    // Pieces of each side by Syzygy piece type, the first side in the file
+    // name first.
+    int m_counts[2][7] {};
+    int m_pieceCount {};
+    bool m_hasPawns {};
+    bool m_hasUniquePieces {};
+    bool m_symmetric {};
+    // Pawns of the leading colour, then of the other colour.
+    int m_pawnCount[2] {};
+    const uint8_t *m_base {};
+    const uint8_t *m_end {};
+    const uint8_t *m_map {};
+    PairsData m_items[2][4];
+};
+
+}
+
+#endif // SYZYGYTABLE_H
@@ -0,0 +1,606 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+
+#include <algorithm>
+#include <cstring>
+
+#include "chessboard.h"
+#include "syzygytable.h"
+
+namespace Chessboard {
+
+namespace {
+    const QLatin1String wdlSuffix(".rtbw");
+    const QLatin1String dtzSuffix(".rtbz");
+    const uchar wdlMagic[] = { 0x71, 0xe8, 0x23, 0x5d };
+    const uchar dtzMagic[] = { 0xd7, 0x66, 0x0c, 0xa5 };
+
+    // Pieces in the order they appear in Syzygy file names.
+    const Piece namePieceOrder[] = { Piece::King, Piece::Queen, Piece::Rook, Piece::Bishop, Piece::Knight, Piece::Pawn };
+
+    QChar pieceLetter(Piece piece)
+    {
+        switch (piece) {
+        case Piece::King:
+            return QLatin1Char('K');
+        case Piece::Queen:
+            return QLatin1Char('Q');
+        case Piece::Rook:
+            return QLatin1Char('R');
+        case Piece::Bishop:
+            return QLatin1Char('B');
+        case Piece::Knight:
+            return QLatin1Char('N');
+        case Piece::Pawn:
+        default:
+            return QLatin1Char('P');
+        }
+    }
+
+    QString sideKey(const BoardState& state, Colour colour)
+    {
+        QString ret;
+        for (Piece piece : namePieceOrder) {
+            for (int row=0;row<8;++row) {
+                for (int col=0;col<8;++col) {
+                    if (state[row][col] == ColouredPiece(colour, piece))
+                        ret.append(pieceLetter(piece));
+                }
+            }
+        }
+        return ret;
+    }
+
+    int letterRank(QChar letter)
+    {
+        return QStringLiteral("KQRBNP").indexOf(letter);
+    }
+
+    // The stronger side comes first: more pieces, then higher pieces.
+    bool isStronger(const QString& a, const QString& b)
+    {
+        if (a.size() != b.size())
+            return a.size() > b.size();
+        for (int i=0;i<a.size();++i) {
+            if (a[i] != b[i])
+                return letterRank(a[i]) < letterRank(b[i]);
+        }
+        return false;
+    }
+
+    bool isValidTable(const QString& fileName, const uchar *magic, QString *errorMessage)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            *errorMessage = QString(QLatin1String("%1: %2")).arg(fileName, file.errorString());
+            return false;
+        }
+        // Tables are padded so that the size is 16 more than a multiple of 64.
+        const QByteArray header = file.read(4);
+        if (header.size() != 4 || memcmp(header.constData(), magic, 4) != 0 || file.size() % 64 != 16) {
+            *errorMessage = QString(QLatin1String("%1: corrupt tablebase file")).arg(fileName);
+            return false;
+        }
+        return true;
+    }
+
+    // A legal move, with the piece a pawn promotes to.
+    struct Move {
+        Square from;
+        Square to;
+        bool promotion {};
+        Piece promotionPiece {Piece::Queen};
+    };
+
+    QList<Move> legalMoves(const BoardState& state)
+    {
+        static const Piece promotionPieces[] = { Piece::Queen, Piece::Rook, Piece::Bishop, Piece::Knight };
+        QList<Move> ret;
+        for (const QPair<Square, Square>& legalMove : state.legalMoves()) {
+            Move move;
+            move.from = legalMove.first;
+            move.to = legalMove.second;
+            if (state[move.from].piece() == Piece::Pawn && (move.to.row == 0 || move.to.row == 7)) {
+                move.promotion = true;
+                for (Piece piece : promotionPieces) {
+                    move.promotionPiece = piece;
+                    ret.append(move);
+                }
+            } else {
+                ret.append(move);
+            }
+        }
+        return ret;
+    }
+
+    bool isCapture(const BoardState& state, const Move& move)
+    {
+        return state[move.to].isValid() ||
+               (state[move.from].piece() == Piece::Pawn && move.from.col != move.to.col);
+    }
+
+    // Captures and pawn moves reset the fifty-move counter.
+    bool isZeroing(const BoardState& state, const Move& move)
+    {
+        return state[move.from].piece() == Piece::Pawn || isCapture(state, move);
+    }
+
+    BoardState play(const BoardState& state, const Move& move)
+    {
+        BoardState ret = state;
+        // Repetitions play no part in tablebase positions.
+        ret.history.clear();
+        bool promotionRequired = false;
+        ret.move(move.from, move.to, &promotionRequired);
+        if (promotionRequired)
+            ret.promote(move.promotionPiece);
+        return ret;
+    }
+
+    int sign(int value)
+    {
+        return (value > 0) - (value < 0);
+    }
+
+    // DTZ of a position whose best move zeroes the fifty-move counter.
+    int dtzBeforeZeroing(int wdl)
+    {
+        switch (wdl) {
+        case 2:
+            return 1;
+        case 1:
+            return 101;
+        case -1:
+            return -101;
+        case -2:
+            return -1;
+        default:
+            return 0;
+        }
+    }
+
+    TablebaseResult resultFromDtz(int dtz)
+    {
+        if (dtz > 100)
+            return TablebaseResult::CursedWin;
+        if (dtz > 0)
+            return TablebaseResult::Win;
+        if (dtz < -100)
+            return TablebaseResult::BlessedLoss;
+        if (dtz < 0)
+            return TablebaseResult::Loss;
+        return TablebaseResult::Draw;
+    }
+
+    uint8_t syzygyPiece(const ColouredPiece& piece)
+    {
+        static const uint8_t pieceTypes[] = { 0, 1, 4, 2, 3, 5, 6 };
+        const int type = static_cast<int>(piece.piece());
+        if (!piece.isValid() || type < 1 || type > 6)
+            return 0;
+        return static_cast<uint8_t>(pieceTypes[type] | (piece.colour() == Colour::Black ? 8 : 0));
+    }
+
+    enum ProbeState {
+        ProbeOk,
+        ProbeChangeSideToMove,
+        // The best move is a capture or pawn move, so DTZ follows from WDL.
+        ProbeZeroingBestMove,
+        ProbeFailed
+    };
+}
+
+class SyzygyTablebasesPrivate {
+public:
+    // Tables are mapped on first use: a full set runs to hundreds of files,
+    // most of which a game never reaches.
+    struct Table {
+        Table(SyzygyTable::Type type, const QString& key, const QString& fileName) :
+            table(type, key.toStdString()), file(fileName) {}
+        SyzygyTable table;
+        QFile file;
+        // 0 until mapped, then 1 if the table is usable or -1 if not.
+        QAtomicInt state;
+    };
+    typedef QHash<QString, QSharedPointer<Table> > Tables;
+
+    const SyzygyTable *table(const Tables& tables, const BoardState& state) const;
+    int probeTable(SyzygyTable::Type type, const BoardState& state, int wdlResult, ProbeState *result) const;
+    int search(const BoardState& state, bool checkZeroingMoves, ProbeState *result) const;
+    int probeWdl(const BoardState& state, ProbeState *result) const;
+    int probeDtz(const BoardState& state, ProbeState *result) const;
+    bool canProbe(const BoardState& state) const;
+
+    QString path;
+    Tables wdl;
+    Tables dtz;
+    int maxPieces {};
+    mutable QMutex mutex;
+};
+
+const SyzygyTable *SyzygyTablebasesPrivate::table(const Tables& tables, const BoardState& state) const
+{
+    const QString white = sideKey(state, Colour::White);
+    const QString black = sideKey(state, Colour::Black);
+    QSharedPointer<Table> table = tables.value(white + QLatin1Char('v') + black);
+    if (!table)
+        table = tables.value(black + QLatin1Char('v') + white);
+    if (!table)
+        return nullptr;
+    int mapped = table->state.loadAcquire();
+    if (mapped == 0) {
+        QMutexLocker locker(&mutex);
+        mapped = table->state.loadRelaxed();
+        if (mapped == 0) {
+            mapped = -1;
+            if (table->file.open(QIODevice::ReadOnly)) {
+                const qint64 size = table->file.size();
+                const uchar *data = table->file.map(0, size);
+                if (data && table->table.init(data, static_cast<size_t>(size)))
+                    mapped = 1;
+            }
+            if (mapped < 0)
+                qWarning("SyzygyTablebases: cannot read %s", qPrintable(table->file.fileName()));
+            table->state.storeRelease(mapped);
+        }
+    }
+    return (mapped > 0) ? &table->table : nullptr;
+}
+
+int SyzygyTablebasesPrivate::probeTable(SyzygyTable::Type type, const BoardState& state, int wdlResult, ProbeState *result) const
+{
+    uint8_t board[64];
+    int pieceCount = 0;
+    for (int row=0;row<8;++row) {
+        for (int col=0;col<8;++col) {
+            board[row * 8 + col] = syzygyPiece(state[row][col]);
+            if (board[row * 8 + col])
+                ++pieceCount;
+        }
+    }
+    // Bare kings are drawn, and have no table.
+    if (pieceCount == 2) {
+        *result = ProbeOk;
+        return 0;
+    }
+    const SyzygyTable *t = table((type == SyzygyTable::Wdl) ? wdl : dtz, state);
+    if (!t) {
+        *result = ProbeFailed;
+        return 0;
+    }
+    SyzygyTable::Status status;
+    const int value = t->probe(board, state.activeColour == Colour::Black, wdlResult, &status);
+    switch (status) {
+    case SyzygyTable::Ok:
+        *result = ProbeOk;
+        break;
+    case SyzygyTable::ChangeSideToMove:
+        *result = ProbeChangeSideToMove;
+        break;
+    case SyzygyTable::Failed:
+    default:
+        *result = ProbeFailed;
+        break;
+    }
+    return value;
+}
+
+// Tables do not know about captures, which the generator assumes are
+// played when they are best, so search them here. With checkZeroingMoves
+// pawn moves are searched too, which the DTZ probe needs. Returns the WDL
+// result for the side to move.
+int SyzygyTablebasesPrivate::search(const BoardState& state, bool checkZeroingMoves, ProbeState *result) const
+{
+    const QList<Move> moves = legalMoves(state);
+    int bestValue = -2;
+    int moveCount = 0;
+    for (const Move& move : moves) {
+        if (!isCapture(state, move) && (!checkZeroingMoves || state[move.from].piece() != Piece::Pawn))
+            continue;
+        ++moveCount;
+        const int value = -search(play(state, move), false, result);
+        if (*result == ProbeFailed)
+            return 0;
+        if (value > bestValue) {
+            bestValue = value;
+            if (value >= 2) {
+                *result = ProbeZeroingBestMove;
+                return value;
+            }
+        }
+    }
+
+    // If every move was searched there is no need to probe, which also
+    // covers checkmate and stalemate.
+    const bool noMoreMoves = moveCount && moveCount == moves.size();
+    int value;
+    if (noMoreMoves) {
+        value = bestValue;
+    } else {
+        value = probeTable(SyzygyTable::Wdl, state, 0, result);
+        if (*result == ProbeFailed)
+            return 0;
+    }
+    if (bestValue >= value) {
+        *result = (bestValue > 0 || noMoreMoves) ? ProbeZeroingBestMove : ProbeOk;
+        return bestValue;
+    }
+    *result = ProbeOk;
+    return value;
+}
+
+int SyzygyTablebasesPrivate::probeWdl(const BoardState& state, ProbeState *result) const
+{
+    *result = ProbeOk;
+    return search(state, false, result);
+}
+
+// Plies to the next capture or pawn move with best play, signed as the
+// WDL result and 100 more for a cursed win or blessed loss. May be one
+// more than the true value, as DTZ tables round some values up.
+int SyzygyTablebasesPrivate::probeDtz(const BoardState& state, ProbeState *result) const
+{
+    *result = ProbeOk;
+    const int outcome = search(state, true, result);
+    if (*result == ProbeFailed || outcome == 0)
+        return 0;
+    if (*result == ProbeZeroingBestMove)
+        return dtzBeforeZeroing(outcome);
+
+    int value = probeTable(SyzygyTable::Dtz, state, outcome, result);
+    if (*result == ProbeFailed)
+        return 0;
+    if (*result != ProbeChangeSideToMove)
+        return (value + 100 * (outcome == -1 || outcome == 1)) * sign(outcome);
+
+    // The table has the other side to move: look one ply ahead.
+    int minDtz = 0xffff;
+    for (const Move& move : legalMoves(state)) {
+        const bool zeroing = isZeroing(state, move);
+        const BoardState next = play(state, move);
+        value = zeroing ? -dtzBeforeZeroing(search(next, false, result)) : -probeDtz(next, result);
+        if (*result == ProbeFailed)
+            return 0;
+        if (value == 1 && next.isCheckmate())
+            minDtz = 1;
+        if (!zeroing)
+            value += sign(value);
+        if (value < minDtz && sign(value) == sign(outcome))
+            minDtz = value;
+    }
+    // With no moves this is checkmate.
+    return (minDtz == 0xffff) ? -1 : minDtz;
+}
+
+bool SyzygyTablebasesPrivate::canProbe(const BoardState& state) const
+{
+    // Tablebases never contain positions where castling is still possible.
+    if (state.whiteKingsideCastlingAvailable || state.whiteQueensideCastlingAvailable ||
+        state.blackKingsideCastlingAvailable || state.blackQueensideCastlingAvailable)
+        return false;
+    int pieceCount = 0;
+    for (int row=0;row<8;++row) {
+        for (int col=0;col<8;++col) {
+            if (state[row][col].isValid())
+                ++pieceCount;
+        }
+    }
+    return pieceCount <= qMin(maxPieces, static_cast<int>(SyzygyTable::maxPieces));
+}
+
+SyzygyTablebases::SyzygyTablebases() :
+    d_ptr(new SyzygyTablebasesPrivate)
+{
+}
+
+SyzygyTablebases::~SyzygyTablebases()
+{
+}
+
+int SyzygyTablebases::load(const QString& paths, QString *errorMessage)
+{
+    Q_D(SyzygyTablebases);
+    clear();
+    d->path = paths;
+    QString lastError;
+    for (const QString& path : paths.split(QDir::listSeparator(), Qt::SkipEmptyParts)) {
+        const QDir dir(path);
+        if (!dir.exists()) {
+            lastError = QString(QLatin1String("%1: no such directory")).arg(path);
+            continue;
+        }
+        const QStringList files = dir.entryList({ QLatin1String("*") + wdlSuffix, QLatin1String("*") + dtzSuffix }, QDir::Files);
+        for (const QString& file : files) {
+            const bool isWdl = file.endsWith(wdlSuffix);
+            const QString key = file.left(file.size() - wdlSuffix.size());
+            if (!isValidTable(dir.filePath(file), isWdl ? wdlMagic : dtzMagic, &lastError))
+                continue;
+            // Earlier directories take precedence.
+            SyzygyTablebasesPrivate::Tables& tables = isWdl ? d->wdl : d->dtz;
+            if (tables.contains(key))
+                continue;
+            tables.insert(key, QSharedPointer<SyzygyTablebasesPrivate::Table>::create(
+                              isWdl ? SyzygyTable::Wdl : SyzygyTable::Dtz, key, dir.filePath(file)));
+            if (isWdl)
+                d->maxPieces = qMax(d->maxPieces, static_cast<int>(key.size()) - 1);
+        }
+    }
+    if (errorMessage)
+        *errorMessage = lastError;
+    qDebug("SyzygyTablebases::load: %lld WDL, %lld DTZ tables, up to %d pieces",
+           static_cast<long long>(d->wdl.size()), static_cast<long long>(d->dtz.size()), d->maxPieces);
+    return static_cast<int>(d->wdl.size());
+}
+
+void SyzygyTablebases::clear()
+{
+    Q_D(SyzygyTablebases);
+    d->path.clear();
+    d->wdl.clear();
+    d->dtz.clear();
+    d->maxPieces = 0;
+}
+
+QString SyzygyTablebases::path() const
+{
+    Q_D(const SyzygyTablebases);
+    return d->path;
+}
+
+int SyzygyTablebases::tableCount(TableType type) const
+{
+    Q_D(const SyzygyTablebases);
+    return static_cast<int>((type == WinDrawLoss) ? d->wdl.size() : d->dtz.size());
+}
+
+int SyzygyTablebases::maxPieces() const
+{
+    Q_D(const SyzygyTablebases);
+    return d->maxPieces;
+}
+
+bool SyzygyTablebases::contains(const BoardState& state, TableType type) const
+{
+    Q_D(const SyzygyTablebases);
+    if (!d->canProbe(state))
+        return false;
+    const QString white = sideKey(state, Colour::White);
+    const QString black = sideKey(state, Colour::Black);
+    // As in Stockfish, look up both orderings: the generator names some
+    // tables with the side with fewer pieces first, e.g. KQvKRP.
+    const SyzygyTablebasesPrivate::Tables& tables = (type == WinDrawLoss) ? d->wdl : d->dtz;
+    return tables.contains(white + QLatin1Char('v') + black) ||
+           tables.contains(black + QLatin1Char('v') + white);
+}
+
+bool SyzygyTablebases::probeWdl(const BoardState& state, TablebaseResult *result) const
+{
+    Q_D(const SyzygyTablebases);
+    if (!d->canProbe(state))
+        return false;
+    ProbeState probeState;
+    const int wdl = d->probeWdl(state, &probeState);
+    if (probeState == ProbeFailed)
+        return false;
+    *result = static_cast<TablebaseResult>(wdl);
+    return true;
+}
+
+bool SyzygyTablebases::probeDtz(const BoardState& state, int *dtz) const
+{
+    Q_D(const SyzygyTablebases);
+    if (!d->canProbe(state))
+        return false;
+    ProbeState probeState;
+    const int value = d->probeDtz(state, &probeState);
+    if (probeState == ProbeFailed)
+        return false;
+    *dtz = value;
+    return true;
+}
+
+QList<TablebaseMove> SyzygyTablebases::moves(const BoardState& state) const
+{
+    Q_D(const SyzygyTablebases);
+    QList<TablebaseMove> ret;
+    if (!d->canProbe(state))
+        return ret;
+    QList<bool> checkmates;
+    for (const Move& move : legalMoves(state)) {
+        const BoardState next = play(state, move);
+        ProbeState probeState;
+        const int wdl = -d->probeWdl(next, &probeState);
+        if (probeState == ProbeFailed)
+            return QList<TablebaseMove>();
+        TablebaseMove tablebaseMove;
+        tablebaseMove.from = move.from;
+        tablebaseMove.to = move.to;
+        tablebaseMove.promotion = move.promotion;
+        tablebaseMove.promotionPiece = move.promotionPiece;
+        tablebaseMove.result = static_cast<TablebaseResult>(wdl);
+        // Without DTZ tables the result alone has to do.
+        int dtz;
+        if (isZeroing(state, move)) {
+            dtz = dtzBeforeZeroing(wdl);
+        } else {
+            dtz = -d->probeDtz(next, &probeState);
+            dtz += sign(dtz);
+        }
+        const bool checkmate = next.isCheckmate();
+        if (checkmate)
+            dtz = 1;
+        if (probeState != ProbeFailed) {
+            tablebaseMove.dtz = dtz;
+            TablebaseResult result = resultFromDtz(dtz);
+            // A win that needs more moves than the fifty-move rule has
+            // left is a draw, and so is the matching loss.
+            if (result == TablebaseResult::Win && dtz + state.halfMoveClock > 100)
+                result = TablebaseResult::CursedWin;
+            else if (result == TablebaseResult::Loss && -dtz + state.halfMoveClock > 100)
+                result = TablebaseResult::BlessedLoss;
+            tablebaseMove.result = result;
+        }
+        ret.append(tablebaseMove);
+        checkmates.append(checkmate);
+    }
+
+    // Best result first; then the quickest win, preferring mate, or the
+    // slowest loss.
+    QList<qsizetype> order(ret.size());
+    for (qsizetype i=0;i<order.size();++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&ret, &checkmates](qsizetype a, qsizetype b) {
+        if (ret[a].result != ret[b].result)
+            return ret[a].result > ret[b].result;
+        if (checkmates[a] != checkmates[b])
+            return checkmates[a];
+        return ret[a].dtz < ret[b].dtz;
+    });
+    QList<TablebaseMove> sorted;
+    sorted.reserve(ret.size());
+    for (qsizetype i : order)
+        sorted.append(ret[i]);
+    return sorted;
+}
+
+TablebaseMove SyzygyTablebases::selectMove(const BoardState& state) const
+{
+    const QList<TablebaseMove> candidates = moves(state);
+    if (candidates.isEmpty())
+        return TablebaseMove();
+    return candidates.first();
+}
+
+QString SyzygyTablebases::materialKey(const BoardState& state)
+{
+    const QString white = sideKey(state, Colour::White);
+    const QString black = sideKey(state, Colour::Black);
+    if (isStronger(black, white))
+        return black + QLatin1Char('v') + white;
+    return white + QLatin1Char('v') + black;
+}
+
+}
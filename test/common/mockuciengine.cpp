@@ -0,0 +1,297 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// A stand-in for Stockfish that speaks just enough UCI for
+// StockfishAiPlayer. Its behaviour is scripted through environment
+// variables so that tests can drive the real QProcess path without an
+// engine installed:
+//
+//   MOCKUCI_BOOT_DELAY    ms before answering uci; -1 never answers
+//   MOCKUCI_READY_DELAY   ms before answering isready; -1 never answers
+//   MOCKUCI_SEARCH_DELAY  ms a search takes; -1 searches until stop
+//   MOCKUCI_BESTMOVE      comma separated moves returned by successive
+//                         searches, the last one repeating; by default the
+//                         first legal move of the position
+//   MOCKUCI_SCORE         centipawn score reported by each search
+//   MOCKUCI_MATE          mate distance reported instead of the score
+//   MOCKUCI_DEPTH         depth reported by each search
+//   MOCKUCI_NODES         nodes reported by each search
+//   MOCKUCI_CRASH_ON      command[:n] exits abruptly on the nth time the
+//                         command is received (the first by default)
+//   MOCKUCI_LOG           file to which every command received is appended
+
+#include <QByteArrayList>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "chessboard.h"
+
+using namespace Chessboard;
+
+namespace {
+    struct Script {
+        int bootDelay {};
+        int readyDelay {};
+        int searchDelay {};
+        QByteArrayList bestMoves;
+        int score {};
+        int mate {};
+        int depth {1};
+        int nodes {1000};
+        QByteArray crashCommand;
+        int crashCount {1};
+        QString logPath;
+
+        static Script fromEnvironment();
+    };
+
+    int environmentInt(const char *name, int defaultValue)
+    {
+        bool ok;
+        const int value = qEnvironmentVariableIntValue(name, &ok);
+        return ok ? value : defaultValue;
+    }
+
+    Script Script::fromEnvironment()
+    {
+        Script script;
+        script.bootDelay = environmentInt("MOCKUCI_BOOT_DELAY", 0);
+        script.readyDelay = environmentInt("MOCKUCI_READY_DELAY", 0);
+        script.searchDelay = environmentInt("MOCKUCI_SEARCH_DELAY", 0);
+        const QByteArray bestMoves = qgetenv("MOCKUCI_BESTMOVE");
+        if (!bestMoves.isEmpty())
+            script.bestMoves = bestMoves.split(',');
+        script.score = environmentInt("MOCKUCI_SCORE", 0);
+        script.mate = environmentInt("MOCKUCI_MATE", 0);
+        script.depth = environmentInt("MOCKUCI_DEPTH", 1);
+        script.nodes = environmentInt("MOCKUCI_NODES", 1000);
+        const QByteArray crash = qgetenv("MOCKUCI_CRASH_ON");
+        const int colon = crash.indexOf(':');
+        script.crashCommand = colon == -1 ? crash : crash.left(colon);
+        if (colon != -1)
+            script.crashCount = crash.mid(colon + 1).toInt();
+        script.logPath = qEnvironmentVariable("MOCKUCI_LOG");
+        return script;
+    }
+
+    // Reads stdin on its own thread so that a stop can interrupt a search.
+    class CommandReader
+    {
+    public:
+        CommandReader()
+        {
+            // Never joined: the thread is blocked reading stdin when the
+            // engine quits and goes away with the process.
+            QThread *thread = QThread::create([this]() { run(); });
+            thread->start();
+        }
+
+        // Returns false if the deadline passes or stdin is closed first.
+        bool next(QDeadlineTimer deadline, QByteArray *command)
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_commands.isEmpty() && !m_atEnd) {
+                if (!m_available.wait(&m_mutex, deadline))
+                    return false;
+            }
+            if (m_commands.isEmpty())
+                return false;
+            *command = m_commands.dequeue();
+            return true;
+        }
+
+        bool atEnd()
+        {
+            QMutexLocker locker(&m_mutex);
+            return m_atEnd && m_commands.isEmpty();
+        }
+
+    private:
+        void run()
+        {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                QMutexLocker locker(&m_mutex);
+                m_commands.enqueue(QByteArray::fromStdString(line).simplified());
+                m_available.wakeAll();
+            }
+            QMutexLocker locker(&m_mutex);
+            m_atEnd = true;
+            m_available.wakeAll();
+        }
+
+        QMutex m_mutex;
+        QWaitCondition m_available;
+        QQueue<QByteArray> m_commands;
+        bool m_atEnd {};
+    };
+
+    void send(const QByteArray& line)
+    {
+        std::fputs(line.constData(), stdout);
+        std::fputc('\n', stdout);
+        std::fflush(stdout);
+    }
+
+    void delay(int milliseconds)
+    {
+        if (milliseconds > 0)
+            QThread::msleep(milliseconds);
+    }
+
+    QByteArray firstLegalMove(const BoardState& board)
+    {
+        const QList<QPair<Square, Square> > moves = board.legalMoves();
+        if (moves.isEmpty())
+            return "(none)";
+        const Square from = moves.first().first;
+        const Square to = moves.first().second;
+        QByteArray move = from.toString().toLatin1() + to.toString().toLatin1();
+        if (board[from].piece() == Piece::Pawn && (to.row == 0 || to.row == 7))
+            move += 'q';
+        return move;
+    }
+
+    // Handles "position startpos|fen <fen> [moves ...]".
+    BoardState parsePosition(const QByteArrayList& arguments)
+    {
+        BoardState board = BoardState::newGame();
+        int index = 1;
+        if (arguments.value(index) == "fen") {
+            QByteArrayList fields;
+            for (++index;index<arguments.size() && arguments[index] != "moves";++index)
+                fields.append(arguments[index]);
+            board = BoardState::fromFenString(QString::fromLatin1(fields.join(' ')));
+        } else {
+            ++index;
+        }
+        if (arguments.value(index) == "moves") {
+            for (++index;index<arguments.size();++index) {
+                const AlgebraicNotation an = AlgebraicNotation::fromString(QString::fromLatin1(arguments[index]));
+                board.move(an.fromRow, an.fromCol, an.toRow, an.toCol);
+                if (an.promotion)
+                    board.promote(an.promotionPiece);
+            }
+        }
+        return board;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Q_UNUSED(argc);
+    Q_UNUSED(argv);
+    const Script script = Script::fromEnvironment();
+    QFile log(script.logPath);
+    if (!script.logPath.isEmpty())
+        log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+    CommandReader reader;
+    BoardState board = BoardState::newGame();
+    QHash<QByteArray, int> commandCounts;
+    int searches = 0;
+    bool searching = false;
+    QByteArray searchMove;
+    QElapsedTimer searchTimer;
+    QDeadlineTimer searchDeadline;
+
+    auto finishSearch = [&]() {
+        const QByteArray score = script.mate ? "mate " + QByteArray::number(script.mate)
+                                             : "cp " + QByteArray::number(script.score);
+        const qint64 elapsed = searchTimer.elapsed();
+        send("info depth " + QByteArray::number(script.depth) +
+             " score " + score +
+             " nodes " + QByteArray::number(script.nodes) +
+             " nps " + QByteArray::number(script.nodes * 1000 / qMax<qint64>(1, elapsed)) +
+             " time " + QByteArray::number(elapsed) +
+             " pv " + searchMove);
+        send("bestmove " + searchMove);
+        searching = false;
+    };
+
+    for (;;) {
+        QByteArray line;
+        if (!reader.next(searching ? searchDeadline : QDeadlineTimer(QDeadlineTimer::Forever), &line)) {
+            if (reader.atEnd())
+                break;
+            finishSearch();
+            continue;
+        }
+        if (log.isOpen()) {
+            log.write(line + '\n');
+            log.flush();
+        }
+        const QByteArrayList arguments = line.split(' ');
+        const QByteArray command = arguments.first();
+        if (!script.crashCommand.isEmpty() && command == script.crashCommand &&
+            ++commandCounts[command] == script.crashCount)
+            std::_Exit(3);
+        if (command == "uci") {
+            if (script.bootDelay < 0)
+                continue;
+            delay(script.bootDelay);
+            send("id name MockUci");
+            send("id author bluecheese");
+            send("option name Threads type spin default 1 min 1 max 1024");
+            send("option name Hash type spin default 16 min 1 max 33554432");
+            send("option name UCI_LimitStrength type check default false");
+            send("option name UCI_Elo type spin default 1320 min 1320 max 3190");
+            send("option name SyzygyPath type string default <empty>");
+            send("uciok");
+        } else if (command == "isready") {
+            if (script.readyDelay < 0)
+                continue;
+            delay(script.readyDelay);
+            send("readyok");
+        } else if (command == "ucinewgame") {
+            board = BoardState::newGame();
+        } else if (command == "position") {
+            board = parsePosition(arguments);
+        } else if (command == "go") {
+            // Every go gets exactly one bestmove, as with a real engine.
+            if (searching)
+                finishSearch();
+            if (!script.bestMoves.isEmpty())
+                searchMove = script.bestMoves.value(qMin(searches, script.bestMoves.size() - 1));
+            else
+                searchMove = firstLegalMove(board);
+            ++searches;
+            searchTimer.start();
+            searching = true;
+            if (script.searchDelay < 0)
+                searchDeadline = QDeadlineTimer(QDeadlineTimer::Forever);
+            else
+                searchDeadline = QDeadlineTimer(script.searchDelay);
+        } else if (command == "stop") {
+            if (searching)
+                finishSearch();
+        } else if (command == "quit") {
+            break;
+        }
+    }
+    std::fflush(stdout);
+    return 0;
+}
@@ -16,6 +16,8 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <QEventLoop>
+#include <QSemaphore>
 #include <QSignalSpy>
 #include <QTest>
 
@@ -83,6 +85,24 @@ private:
     int startCallCount {};
 };
 
+// Counts each start as soon as it reaches the AI thread.
+class StartedAiPlayer : public FakeAiPlayer
+{
+public:
+    StartedAiPlayer(Chessboard::Colour colour, QObject *parent = nullptr) :
+        FakeAiPlayer(colour, parent)
+    {
+    }
+    void start(const Chessboard::BoardState&) override
+    {
+        started.release();
+    }
+
+    static QSemaphore started;
+};
+
+QSemaphore StartedAiPlayer::started;
+
 class SequentialAiPlayer : public FakeAiPlayer
 {
     Q_OBJECT
@@ -108,6 +128,31 @@ private:
     int startCallCount {};
 };
 
+// Keeps searching its first position until it is told to stop.
+class BusyAiPlayer : public FakeAiPlayer
+{
+    Q_OBJECT
+public:
+    BusyAiPlayer(Chessboard::Colour colour, QObject *parent = nullptr) :
+        FakeAiPlayer(colour, parent)
+    {
+    }
+    void start(const Chessboard::BoardState& state) override
+    {
+        if (startCallCount++ == 0) {
+            const CancellationToken token = cancellationToken();
+            while (!token.isStopRequested()) {}
+            emit stopped(token.isCancelled());
+        } else {
+            FakeAiPlayer::start(state);
+        }
+    }
+signals:
+    void stopped(bool cancelled);
+private:
+    int startCallCount {};
+};
+
 template<typename White, typename Black=White>
 class TestAiPlayerFactory : public AiPlayerFactory
 {
@@ -191,6 +236,78 @@ private slots:
         QCOMPARE(cancelledSpy.count(), 1);
     }
 
+    void cancellationToken()
+    {
+        CancellationToken token;
+        CancellationToken copy = token;
+        QVERIFY(!copy.isStopRequested());
+        QCOMPARE(copy.remainingTime(), -1);
+        token.cancel();
+        QVERIFY(copy.isCancelled());
+        QVERIFY(!copy.hasExpired());
+        CancellationToken timed(QDeadlineTimer(20));
+        QVERIFY(timed.remainingTime() <= 20);
+        QTRY_VERIFY(timed.hasExpired());
+        QVERIFY(timed.isStopRequested());
+        QVERIFY(!timed.isCancelled());
+    }
+
+    void supersededRequestStops()
+    {
+        TestAiPlayerFactory<BusyAiPlayer> busyAiPlayerFactory;
+        std::unique_ptr<AiController> controller(new AiController(&busyAiPlayerFactory));
+        Chessboard::BoardState board = Chessboard::BoardState::newGame();
+        QSignalSpy stoppedSpy(busyAiPlayerFactory.whiteAiPlayer(), &BusyAiPlayer::stopped);
+        QSignalSpy requestMoveSpy(controller.get(), &AiController::requestMove);
+        controller->start(Chessboard::Colour::White, board);
+        controller->start(Chessboard::Colour::White, board);
+        QVERIFY(stoppedSpy.wait());
+        QCOMPARE(stoppedSpy.first().at(0).toBool(), true);
+        if (requestMoveSpy.isEmpty())
+            QVERIFY(requestMoveSpy.wait());
+        QCOMPARE(requestMoveSpy.count(), 1);
+    }
+
+    void deadlineStopsRequest()
+    {
+        TestAiPlayerFactory<BusyAiPlayer> busyAiPlayerFactory;
+        std::unique_ptr<AiController> controller(new AiController(&busyAiPlayerFactory));
+        Chessboard::BoardState board = Chessboard::BoardState::newGame();
+        QSignalSpy stoppedSpy(busyAiPlayerFactory.whiteAiPlayer(), &BusyAiPlayer::stopped);
+        controller->start(Chessboard::Colour::White, board, QDeadlineTimer(50));
+        QVERIFY(stoppedSpy.wait());
+        QCOMPARE(stoppedSpy.first().at(0).toBool(), false);
+    }
+
+    // Round trip from AiController::start to the player's requestMove
+    // arriving back on this thread.
+    void startLatency()
+    {
+        TestAiPlayerFactory<FakeAiPlayer> fakeAiPlayerFactory;
+        std::unique_ptr<AiController> controller(new AiController(&fakeAiPlayerFactory));
+        const Chessboard::BoardState board = Chessboard::BoardState::newGame();
+        QEventLoop loop;
+        connect(controller.get(), &AiController::requestMove, &loop, &QEventLoop::quit);
+        QBENCHMARK {
+            controller->start(Chessboard::Colour::White, board);
+            loop.exec();
+        }
+    }
+
+    // One way, from AiController::start through AiPlayerControllerProxy to
+    // the player's start running on the AI thread. It uses only the public
+    // API, so it can be run before and after a change to the proxies.
+    void startToWorkerLatency()
+    {
+        TestAiPlayerFactory<StartedAiPlayer> startedAiPlayerFactory;
+        std::unique_ptr<AiController> controller(new AiController(&startedAiPlayerFactory));
+        const Chessboard::BoardState board = Chessboard::BoardState::newGame();
+        QBENCHMARK {
+            controller->start(Chessboard::Colour::White, board);
+            QVERIFY(StartedAiPlayer::started.tryAcquire(1, 5000));
+        }
+    }
+
     // If the main thread calls start / cancel / start, check it does not see
     // a requestMove from the first start.
     void cancelIsSerialized()
@@ -0,0 +1,102 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTest>
+
+#include "analysiscache.h"
+#include "chessboard.h"
+
+using namespace Chessboard;
+
+namespace {
+    AnalysisCache::Entry makeEntry(int budget, AssistanceColour colour)
+    {
+        AnalysisCache::Entry entry;
+        entry.budget = budget;
+        entry.colours = { colour, AssistanceColour::Blue };
+        entry.scores = { 10, -20 };
+        return entry;
+    }
+}
+
+class TestAnalysisCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void hit()
+    {
+        AnalysisCache cache;
+        const QByteArray key = BoardState::newGame().key();
+        QVERIFY(!cache.lookup(key, 3, 20, nullptr));
+        QVERIFY(cache.insert(key, 3, makeEntry(20, AssistanceColour::Green)));
+        AnalysisCache::Entry entry;
+        QVERIFY(cache.lookup(key, 3, 20, &entry));
+        QCOMPARE(entry.budget, 20);
+        QVERIFY(entry.colours.size() == 2);
+        QVERIFY(entry.colours.first() == AssistanceColour::Green);
+        QCOMPARE(entry.scores.last(), -20);
+        // A shallower request is satisfied by a deeper result.
+        QVERIFY(cache.lookup(key, 3, 10, &entry));
+    }
+
+    void levelIsPartOfKey()
+    {
+        AnalysisCache cache;
+        const QByteArray key = BoardState::newGame().key();
+        cache.insert(key, 3, makeEntry(20, AssistanceColour::Green));
+        QVERIFY(!cache.lookup(key, 4, 20, nullptr));
+    }
+
+    void deeperSearchUpgrades()
+    {
+        AnalysisCache cache;
+        const QByteArray key = BoardState::newGame().key();
+        cache.insert(key, 3, makeEntry(10, AssistanceColour::Red));
+        QVERIFY(!cache.lookup(key, 3, 20, nullptr));
+        QVERIFY(cache.insert(key, 3, makeEntry(20, AssistanceColour::Green)));
+        AnalysisCache::Entry entry;
+        QVERIFY(cache.lookup(key, 3, 20, &entry));
+        QVERIFY(entry.colours.first() == AssistanceColour::Green);
+        // A shallower result never replaces a deeper one.
+        QVERIFY(!cache.insert(key, 3, makeEntry(5, AssistanceColour::Red)));
+        QVERIFY(cache.lookup(key, 3, 20, &entry));
+        QVERIFY(entry.colours.first() == AssistanceColour::Green);
+    }
+
+    void leastRecentlyUsedIsEvicted()
+    {
+        AnalysisCache cache(2);
+        const QByteArray a = BoardState::newGame().key();
+        BoardState state = BoardState::newGame();
+        state.move(QLatin1String("e2e4"));
+        const QByteArray b = state.key();
+        state.move(QLatin1String("e7e5"));
+        const QByteArray c = state.key();
+        cache.insert(a, 3, makeEntry(10, AssistanceColour::Green));
+        cache.insert(b, 3, makeEntry(10, AssistanceColour::Green));
+        QVERIFY(cache.lookup(a, 3, 10, nullptr));
+        cache.insert(c, 3, makeEntry(10, AssistanceColour::Green));
+        QVERIFY(cache.size() == 2);
+        QVERIFY(cache.lookup(a, 3, 10, nullptr));
+        QVERIFY(!cache.lookup(b, 3, 10, nullptr));
+        QVERIFY(cache.lookup(c, 3, 10, nullptr));
+    }
+};
+
+QTEST_MAIN(TestAnalysisCache)
+#include "tst_analysiscache.moc"
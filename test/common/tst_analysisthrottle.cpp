@@ -0,0 +1,107 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTest>
+
+#include "analysisthrottle.h"
+
+namespace {
+    PositionAnalysis makeAnalysis(int depth)
+    {
+        PositionAnalysis analysis;
+        analysis.bestMove = QLatin1String("e2e4");
+        analysis.depth = depth;
+        return analysis;
+    }
+}
+
+class TestAnalysisThrottle : public QObject
+{
+    Q_OBJECT
+private slots:
+    void firstUpdateIsImmediate()
+    {
+        AnalysisThrottle throttle;
+        QList<int> depths;
+        connect(&throttle, &AnalysisThrottle::analysis, this, [&](const PositionAnalysis& analysis) {
+            depths.append(analysis.depth);
+        });
+        throttle.post(makeAnalysis(1));
+        QCOMPARE(depths, QList<int>({ 1 }));
+    }
+
+    void coalescesBurst()
+    {
+        AnalysisThrottle throttle;
+        throttle.setMaximumRate(10);
+        QList<int> depths;
+        connect(&throttle, &AnalysisThrottle::analysis, this, [&](const PositionAnalysis& analysis) {
+            depths.append(analysis.depth);
+        });
+        for (int depth=1;depth<=20;++depth)
+            throttle.post(makeAnalysis(depth));
+        QCOMPARE(depths, QList<int>({ 1 }));
+        // The last update of the burst arrives once the interval is up.
+        QTRY_COMPARE(depths, QList<int>({ 1, 20 }));
+    }
+
+    void flushDeliversPending()
+    {
+        AnalysisThrottle throttle;
+        throttle.setMaximumRate(1);
+        QList<int> depths;
+        connect(&throttle, &AnalysisThrottle::analysis, this, [&](const PositionAnalysis& analysis) {
+            depths.append(analysis.depth);
+        });
+        throttle.post(makeAnalysis(1));
+        throttle.post(makeAnalysis(2));
+        throttle.flush();
+        QCOMPARE(depths, QList<int>({ 1, 2 }));
+        throttle.flush();
+        QCOMPARE(depths, QList<int>({ 1, 2 }));
+    }
+
+    void clearDropsPending()
+    {
+        AnalysisThrottle throttle;
+        throttle.setMaximumRate(10);
+        QList<int> depths;
+        connect(&throttle, &AnalysisThrottle::analysis, this, [&](const PositionAnalysis& analysis) {
+            depths.append(analysis.depth);
+        });
+        throttle.post(makeAnalysis(1));
+        throttle.post(makeAnalysis(2));
+        throttle.clear();
+        QTest::qWait(200);
+        QCOMPARE(depths, QList<int>({ 1 }));
+    }
+
+    void zeroRateDeliversEverything()
+    {
+        AnalysisThrottle throttle;
+        throttle.setMaximumRate(0);
+        int count = 0;
+        connect(&throttle, &AnalysisThrottle::analysis, this, [&]() { ++count; });
+        for (int depth=1;depth<=5;++depth)
+            throttle.post(makeAnalysis(depth));
+        QCOMPARE(count, 5);
+    }
+};
+
+QTEST_MAIN(TestAnalysisThrottle)
+#include "tst_analysisthrottle.moc"
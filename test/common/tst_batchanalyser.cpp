@@ -0,0 +1,242 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QTest>
+
+#include "aiplayerfactory.h"
+#include "batchanalyser.h"
+#include "chessboard.h"
+#include "enginepool.h"
+
+using namespace Chessboard;
+
+namespace {
+    const char *twoGames =
+        "[Event \"One\"]\n"
+        "[Result \"*\"]\n"
+        "\n"
+        "1. e4 e5 2. Nf3 Nc6 *\n"
+        "\n"
+        "[Event \"Two\"]\n"
+        "[Result \"0-1\"]\n"
+        "\n"
+        "1. f3 e5 2. g4 Qh4# 0-1\n";
+}
+
+// Suggests the first legal move and thinks White is always 400cp up, so
+// every move by Black gives the advantage away.
+class FixedAiPlayer : public AiPlayer
+{
+public:
+    FixedAiPlayer(Colour colour, QObject *parent = nullptr) :
+        AiPlayer(colour, parent)
+    {
+    }
+    void startAnalysis(const BoardState& state, int) override
+    {
+        const QPair<Square, Square> move = state.legalMoves().first();
+        PositionAnalysis ret;
+        ret.bestMove = move.first.toString() + move.second.toString();
+        ret.score = (state.activeColour == Colour::White) ? 400 : 0;
+        ret.depth = 1;
+        emit analysis(ret);
+    }
+};
+
+class FixedAiPlayerFactory : public AiPlayerFactory
+{
+public:
+    AiPlayer *createAiPlayer(Colour colour, QObject *parent = nullptr) override
+    {
+        return new FixedAiPlayer(colour, parent);
+    }
+};
+
+class TestBatchAnalyser : public QObject
+{
+    Q_OBJECT
+private:
+    QList<QJsonObject> analyse(const QByteArray& pgn, const QSet<BatchAnalyser::MoveKey>& completed = {})
+    {
+        FixedAiPlayerFactory factory;
+        EnginePool pool(&factory, 2);
+        QBuffer input;
+        input.setData(pgn);
+        input.open(QIODevice::ReadOnly);
+        QBuffer output;
+        output.open(QIODevice::WriteOnly);
+        BatchAnalyser analyser(&pool, &output, BatchAnalyser::Json);
+        analyser.setCompleted(completed);
+        QSignalSpy finishedSpy(&analyser, &BatchAnalyser::finished);
+        analyser.analyse(&input);
+        if (finishedSpy.isEmpty() && !finishedSpy.wait())
+            return QList<QJsonObject>();
+        QList<QJsonObject> records;
+        for (const QByteArray& line : output.data().split('\n')) {
+            if (!line.isEmpty())
+                records.append(QJsonDocument::fromJson(line).object());
+        }
+        return records;
+    }
+
+private slots:
+    void gameReader()
+    {
+        QBuffer input;
+        input.setData(twoGames);
+        input.open(QIODevice::ReadOnly);
+        PgnGameReader reader(&input);
+        QVERIFY(reader.readGame().contains(QLatin1String("Nc6")));
+        QVERIFY(!reader.atEnd());
+        const QString second = reader.readGame();
+        QVERIFY(second.startsWith(QLatin1String("[Event \"Two\"]")));
+        QVERIFY(second.contains(QLatin1String("Qh4#")));
+        QVERIFY(reader.atEnd());
+    }
+
+    void records()
+    {
+        const QList<QJsonObject> records = analyse(twoGames);
+        QCOMPARE(records.size(), 8);
+        for (int i=0;i<records.size();++i) {
+            QCOMPARE(records[i].value(QLatin1String("game")).toInt(), i / 4 + 1);
+            QCOMPARE(records[i].value(QLatin1String("ply")).toInt(), i % 4 + 1);
+        }
+        const QJsonObject e4 = records[0];
+        QCOMPARE(e4.value(QLatin1String("fen")).toString(), BoardState::newGame().toFenString());
+        QCOMPARE(e4.value(QLatin1String("move")).toString(), QLatin1String("e2e4"));
+        QCOMPARE(e4.value(QLatin1String("best")).toString(), QLatin1String("b1a3"));
+        QCOMPARE(e4.value(QLatin1String("eval")).toInt(), 0);
+        QCOMPARE(e4.value(QLatin1String("loss")).toInt(), 400);
+        // Level after the move, but 400cp worse than the best move.
+        QCOMPARE(e4.value(QLatin1String("classification")).toString(), QLatin1String("blunder"));
+        const QJsonObject e5 = records[1];
+        QCOMPARE(e5.value(QLatin1String("move")).toString(), QLatin1String("e7e5"));
+        QCOMPARE(e5.value(QLatin1String("eval")).toInt(), 400);
+        QCOMPARE(e5.value(QLatin1String("loss")).toInt(), 400);
+        QCOMPARE(e5.value(QLatin1String("classification")).toString(), QLatin1String("blunder"));
+        // Checkmate has no evaluation but is never a mistake.
+        const QJsonObject mate = records[7];
+        QCOMPARE(mate.value(QLatin1String("move")).toString(), QLatin1String("d8h4"));
+        QVERIFY(mate.value(QLatin1String("eval")).isNull());
+        QVERIFY(mate.value(QLatin1String("mate")).isNull());
+        QCOMPARE(mate.value(QLatin1String("loss")).toInt(), 0);
+        QCOMPARE(mate.value(QLatin1String("classification")).toString(), QLatin1String("good"));
+    }
+
+    void resume()
+    {
+        QBuffer previous;
+        previous.open(QIODevice::WriteOnly);
+        const QByteArray complete =
+            "{\"game\":1,\"ply\":1}\n"
+            "{\"game\":1,\"ply\":2}\n";
+        previous.write(complete);
+        previous.write("{\"game\":1,\"pl");
+        previous.close();
+        previous.open(QIODevice::ReadOnly);
+        qint64 validSize = 0;
+        QSet<BatchAnalyser::MoveKey> completed;
+        QVERIFY(BatchAnalyser::readCompleted(&previous, BatchAnalyser::Json, &completed, &validSize));
+        QCOMPARE(validSize, qint64(complete.size()));
+        QCOMPARE(completed.size(), 2);
+
+        const QList<QJsonObject> records = analyse(twoGames, completed);
+        QCOMPARE(records.size(), 6);
+        QCOMPARE(records[0].value(QLatin1String("game")).toInt(), 1);
+        QCOMPARE(records[0].value(QLatin1String("ply")).toInt(), 3);
+    }
+
+    void csv()
+    {
+        FixedAiPlayerFactory factory;
+        EnginePool pool(&factory, 1);
+        QBuffer input;
+        input.setData("1. e4 e5 *\n");
+        input.open(QIODevice::ReadOnly);
+        QBuffer output;
+        output.open(QIODevice::ReadWrite);
+        BatchAnalyser analyser(&pool, &output, BatchAnalyser::Csv);
+        QSignalSpy finishedSpy(&analyser, &BatchAnalyser::finished);
+        analyser.analyse(&input);
+        QVERIFY(finishedSpy.wait());
+        const QList<QByteArray> lines = output.data().split('\n');
+        QCOMPARE(lines.size(), 4);
+        QVERIFY(lines[0].startsWith("game,ply,fen,move,best,eval"));
+        QVERIFY(lines[1].startsWith("1,1,"));
+        QVERIFY(lines[2].endsWith(",blunder,1"));
+        output.seek(0);
+        QSet<BatchAnalyser::MoveKey> completed;
+        QVERIFY(BatchAnalyser::readCompleted(&output, BatchAnalyser::Csv, &completed));
+        QCOMPARE(completed.size(), 2);
+    }
+
+    void resumeWrongFormat_data()
+    {
+        QTest::addColumn<QByteArray>("previous");
+        QTest::addColumn<int>("format");
+        QTest::addColumn<int>("lineNumber");
+        QTest::newRow("csv as json") << QByteArray("game,ply,fen,move\n1,1,x\n") << int(BatchAnalyser::Json) << 1;
+        QTest::newRow("json as csv") << QByteArray("{\"game\":1,\"ply\":1}\n") << int(BatchAnalyser::Csv) << 1;
+        QTest::newRow("unrelated") << QByteArray("{\"game\":1,\"ply\":1}\nhello\n{\"game\":1,\"pl")
+                                   << int(BatchAnalyser::Json) << 2;
+    }
+
+    void resumeWrongFormat()
+    {
+        QFETCH(QByteArray, previous);
+        QFETCH(int, format);
+        QFETCH(int, lineNumber);
+        QBuffer buffer(&previous);
+        buffer.open(QIODevice::ReadOnly);
+        QSet<BatchAnalyser::MoveKey> completed;
+        qint64 validSize = -1;
+        QString errorMessage;
+        QVERIFY(!BatchAnalyser::readCompleted(&buffer, static_cast<BatchAnalyser::Format>(format),
+                                              &completed, &validSize, &errorMessage));
+        QVERIFY(completed.isEmpty());
+        // The caller must not truncate the file.
+        QCOMPARE(validSize, qint64(-1));
+        QVERIFY(errorMessage.contains(QString::number(lineNumber)));
+    }
+
+    void illegalMove()
+    {
+        FixedAiPlayerFactory factory;
+        EnginePool pool(&factory, 1);
+        QBuffer input;
+        input.setData("1. e4 e5 2. Ke3 Nc6 *\n");
+        input.open(QIODevice::ReadOnly);
+        QBuffer output;
+        output.open(QIODevice::WriteOnly);
+        BatchAnalyser analyser(&pool, &output, BatchAnalyser::Json);
+        QSignalSpy warningSpy(&analyser, &BatchAnalyser::warning);
+        QSignalSpy finishedSpy(&analyser, &BatchAnalyser::finished);
+        analyser.analyse(&input);
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(warningSpy.count(), 1);
+        QCOMPARE(analyser.movesAnalysed(), 2);
+    }
+};
+
+QTEST_MAIN(TestBatchAnalyser)
+#include "tst_batchanalyser.moc"
@@ -0,0 +1,120 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QPointer>
+#include <QSignalSpy>
+#include <QTest>
+
+#include "boardroom.h"
+#include "chessboard.h"
+#include "compositeboard.h"
+
+using namespace Chessboard;
+
+// Runs games on simulated boards.
+class TestBoardRoom : public QObject
+{
+    Q_OBJECT
+private:
+    static BoardAddress simulator(const QString& options)
+    {
+        return BoardAddress::fromString(QLatin1String("simulator:") + options);
+    }
+
+    // Waits for the board to connect and report its position.
+    static CompositeBoard *connectBoard(BoardRoom *room, const BoardAddress& address)
+    {
+        QSignalSpy connectedSpy(room, &BoardRoom::boardConnected);
+        room->addBoard(address);
+        if (!connectedSpy.wait())
+            return nullptr;
+        CompositeBoard *game = room->game(address);
+        if (connectedSpy.first().at(1).value<CompositeBoard *>() != game)
+            return nullptr;
+        QSignalSpy stateSpy(game, &CompositeBoard::remoteBoardState);
+        if (!stateSpy.wait())
+            return nullptr;
+        return game;
+    }
+
+private slots:
+    void gamePerBoard()
+    {
+        BoardRoom room;
+        const BoardAddress first = simulator(QLatin1String("seed=1"));
+        const BoardAddress second = simulator(QLatin1String("seed=2"));
+        CompositeBoard *firstGame = connectBoard(&room, first);
+        QVERIFY(firstGame);
+        CompositeBoard *secondGame = connectBoard(&room, second);
+        QVERIFY(secondGame);
+        QVERIFY(firstGame != secondGame);
+        QCOMPARE(room.boards().size(), 2);
+        QVERIFY(!room.game(simulator(QLatin1String("seed=3"))));
+    }
+
+    // The game stays in the room while the link is down, and the board
+    // is sent the position when it comes back.
+    void reconnect()
+    {
+        BoardRoom room;
+        const BoardAddress address = simulator(QLatin1String("drop=500"));
+        CompositeBoard *game = connectBoard(&room, address);
+        QVERIFY(game);
+        QSignalSpy reconnectingSpy(room.connectionManager(), &MultiConnectionManager::reconnecting);
+        QSignalSpy reconnectedSpy(room.connectionManager(), &MultiConnectionManager::reconnected);
+        QSignalSpy stateSpy(game, &CompositeBoard::remoteBoardState);
+        QSignalSpy disconnectedSpy(&room, &BoardRoom::boardDisconnected);
+        const BoardState state = BoardState::fromFenString(QLatin1String("r3k2r/8/8/3pP3/8/8/8/R3K2R w KQkq d6 0 42"));
+        game->setBoardState(state);
+        QVERIFY(stateSpy.wait());
+        QCOMPARE(stateSpy.takeFirst().at(0).value<BoardState>().toFenString(), state.toFenString());
+
+        QVERIFY(reconnectedSpy.wait(5000));
+        QCOMPARE(reconnectingSpy.count(), 1);
+        QCOMPARE(room.game(address), game);
+        QCOMPARE(game->boardState().toFenString(), state.toFenString());
+        // The new board starts from the opening position, so it is sent
+        // the game's and reports it back.
+        QTRY_VERIFY_WITH_TIMEOUT(!stateSpy.isEmpty(), 2000);
+        QCOMPARE(stateSpy.last().at(0).value<BoardState>().toFenString(), state.toFenString());
+        QCOMPARE(game->boardState().toFenString(), state.toFenString());
+        QCOMPARE(disconnectedSpy.count(), 0);
+    }
+
+    void cleanupOnDisconnect()
+    {
+        BoardRoom room;
+        const BoardAddress kept = simulator(QLatin1String("seed=1"));
+        const BoardAddress removed = simulator(QLatin1String("seed=2"));
+        QVERIFY(connectBoard(&room, kept));
+        QPointer<CompositeBoard> game = connectBoard(&room, removed);
+        QVERIFY(game);
+        QSignalSpy disconnectedSpy(&room, &BoardRoom::boardDisconnected);
+        room.removeBoard(removed);
+        QTRY_COMPARE(disconnectedSpy.count(), 1);
+        QCOMPARE(disconnectedSpy.first().at(0).value<BoardAddress>().toString(), removed.toString());
+        QVERIFY(!room.game(removed));
+        QTRY_VERIFY(game.isNull());
+        QCOMPARE(room.boards().size(), 1);
+        QCOMPARE(room.boards().first().toString(), kept.toString());
+        QVERIFY(room.game(kept));
+    }
+};
+
+QTEST_MAIN(TestBoardRoom)
+#include "tst_boardroom.moc"
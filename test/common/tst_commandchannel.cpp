@@ -0,0 +1,148 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QEventLoop>
+#include <QSemaphore>
+#include <QTest>
+#include <QThread>
+
+#include "chessboard.h"
+#include "commandchannel.h"
+#include "spscqueue.h"
+
+class TestCommandChannel : public QObject
+{
+    Q_OBJECT
+private slots:
+    void queue()
+    {
+        SpscQueue<int> queue;
+        int value = 0;
+        QVERIFY(queue.isEmpty());
+        QVERIFY(!queue.pop(&value));
+        for (int round=0;round<3;++round) {
+            for (int i=0;i<10;++i)
+                queue.push(i);
+            for (int i=0;i<10;++i) {
+                QVERIFY(queue.pop(&value));
+                QCOMPARE(value, i);
+            }
+            QVERIFY(queue.isEmpty());
+        }
+    }
+
+    void commandsRunInOrderOnReceiverThread()
+    {
+        QThread thread;
+        thread.start();
+        CommandReceiver *receiver = new CommandReceiver;
+        receiver->moveToThread(&thread);
+        connect(&thread, &QThread::finished, receiver, &QObject::deleteLater);
+        CommandSender sender = receiver->sender();
+        QList<int> values;
+        bool sameThread = true;
+        for (int i=0;i<1000;++i) {
+            sender.post([&values, &sameThread, &thread, i]() {
+                sameThread = sameThread && QThread::currentThread() == &thread;
+                values.append(i);
+            });
+        }
+        QSemaphore done;
+        sender.post([&done]() {
+            done.release();
+        });
+        QVERIFY(done.tryAcquire(1, 5000));
+        thread.quit();
+        thread.wait();
+        QVERIFY(sameThread);
+        QCOMPARE(values.size(), 1000);
+        for (int i=0;i<values.size();++i)
+            QCOMPARE(values[i], i);
+    }
+
+    void commandsDroppedWithReceiver()
+    {
+        bool ran = false;
+        CommandSender sender;
+        {
+            CommandReceiver receiver;
+            sender = receiver.sender();
+            sender.post([&ran]() {
+                ran = true;
+            });
+        }
+        sender.post([&ran]() {
+            ran = true;
+        });
+        QCoreApplication::processEvents();
+        QVERIFY(!ran);
+    }
+
+    // Same payload as roundTripCommandChannel, over queued invokeMethod
+    // calls, so the two can be compared on the machine being tuned.
+    void roundTripInvokeMethod()
+    {
+        QThread thread;
+        thread.start();
+        QObject *worker = new QObject;
+        worker->moveToThread(&thread);
+        connect(&thread, &QThread::finished, worker, &QObject::deleteLater);
+        QObject controller;
+        QEventLoop loop;
+        const Chessboard::BoardState state = Chessboard::BoardState::newGame();
+        QBENCHMARK {
+            QMetaObject::invokeMethod(worker, [&controller, &loop, state]() {
+                    const QList<Chessboard::AssistanceColour> colours(state.legalMoves().size());
+                    QMetaObject::invokeMethod(&controller, [&loop, colours]() {
+                            loop.quit();
+                        }, Qt::QueuedConnection);
+                }, Qt::QueuedConnection);
+            loop.exec();
+        }
+        thread.quit();
+        thread.wait();
+    }
+
+    void roundTripCommandChannel()
+    {
+        QThread thread;
+        thread.start();
+        CommandReceiver *worker = new CommandReceiver;
+        worker->moveToThread(&thread);
+        connect(&thread, &QThread::finished, worker, &QObject::deleteLater);
+        CommandReceiver controller;
+        const CommandSender requests = worker->sender();
+        const CommandSender responses = controller.sender();
+        QEventLoop loop;
+        const Chessboard::BoardState state = Chessboard::BoardState::newGame();
+        QBENCHMARK {
+            requests.post([responses, &loop, state]() {
+                const QList<Chessboard::AssistanceColour> colours(state.legalMoves().size());
+                responses.post([&loop, colours]() {
+                    loop.quit();
+                });
+            });
+            loop.exec();
+        }
+        thread.quit();
+        thread.wait();
+    }
+};
+
+QTEST_MAIN(TestCommandChannel)
+#include "tst_commandchannel.moc"
@@ -16,7 +16,10 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <QDir>
+#include <QFile>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
 
 #include "compositeboard.h"
@@ -24,6 +27,19 @@
 
 using namespace Chessboard;
 
+namespace {
+    // A KQvK WDL table in which the side with the queen always wins.
+    bool writeKqkTable(const QDir& dir)
+    {
+        QFile file(dir.filePath(QLatin1String("KQvK.rtbw")));
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        QByteArray data("\x71\xe8\x23\x5d\x01\x00\x66\x55\xee\x00\x80\x04\x80\x00", 14);
+        data.resize(80, '\0');
+        return file.write(data) == data.size();
+    }
+}
+
 class MockRemoteBoard : public RemoteBoard
 {
 public:
@@ -32,6 +48,12 @@ public:
     void requestDraw(Colour)
     {
     }
+    void setBoardState(const BoardState& boardState) override
+    {
+        sentStates.append(boardState);
+    }
+
+    QList<BoardState> sentStates;
 };
 
 class TestCompositeBoard : public QObject
@@ -106,6 +128,172 @@ private slots:
         QCOMPARE(drawRequestedSpy.count(), 1);
         QCOMPARE(drawSpy.count(), 1);
     }
+
+    void resyncUnchanged()
+    {
+        CompositeBoard board;
+        const BoardState state = BoardState::fromFenString("rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2");
+        board.setBoardState(state);
+        MockRemoteBoard *remoteBoard = new MockRemoteBoard;
+        QSignalSpy stateChangedSpy(&board, &CompositeBoard::boardStateChanged);
+        QSignalSpy outOfSyncSpy(&board, &CompositeBoard::remoteOutOfSyncWithLocal);
+        board.resyncRemoteBoard(remoteBoard);
+        emit remoteBoard->remoteBoardState(state);
+        QVERIFY(remoteBoard->sentStates.isEmpty());
+        QCOMPARE(stateChangedSpy.count(), 0);
+        QCOMPARE(outOfSyncSpy.count(), 0);
+    }
+
+    void resyncChanged()
+    {
+        CompositeBoard board;
+        MockRemoteBoard *remoteBoard = new MockRemoteBoard;
+        board.setRemoteBoard(remoteBoard);
+        board.setRemoteBoard(nullptr);
+        // Moves made while the link was down stay in the game.
+        board.requestMove(Square::fromAlgebraicString("e2"), Square::fromAlgebraicString("e4"));
+        const QString local = board.boardState().toFenString();
+        remoteBoard = new MockRemoteBoard;
+        QSignalSpy outOfSyncSpy(&board, &CompositeBoard::remoteOutOfSyncWithLocal);
+        board.resyncRemoteBoard(remoteBoard);
+        emit remoteBoard->remoteBoardState(BoardState::newGame());
+        QCOMPARE(board.boardState().toFenString(), local);
+        QCOMPARE(remoteBoard->sentStates.size(), 1);
+        QCOMPARE(remoteBoard->sentStates.first().toFenString(), local);
+        QCOMPARE(outOfSyncSpy.count(), 0);
+        // Later reports are followed as usual.
+        emit remoteBoard->remoteBoardState(BoardState::newGame());
+        QCOMPARE(board.boardState().toFenString(), BoardState::newGame().toFenString());
+    }
+
+    // A move taken back on a simulated board is taken back in the game,
+    // which then matches the board both when read back and when a new
+    // link to the board is resynchronised.
+    void undoOnBoard()
+    {
+        ConnectionManager manager;
+        QSignalSpy connectedSpy(&manager, &ConnectionManager::connected);
+        manager.connectToBoard(BoardAddress::fromString(QLatin1String("simulator:script=e2e4/undo")));
+        QVERIFY(connectedSpy.wait());
+        CompositeBoard board;
+        QSignalSpy moveSpy(&board, &CompositeBoard::remoteMove);
+        QSignalSpy undoSpy(&board, &CompositeBoard::remoteUndo);
+        QSignalSpy outOfSyncSpy(&board, &CompositeBoard::localOutOfSyncWithRemote);
+        board.setRemoteBoard(connectedSpy.first().at(0).value<RemoteBoard *>());
+        QVERIFY(undoSpy.wait());
+        QCOMPARE(moveSpy.count(), 1);
+        QCOMPARE(board.boardState().toFenString(), BoardState::newGame().toFenString());
+        QVERIFY(!board.canUndo());
+
+        QSignalSpy stateSpy(&board, &CompositeBoard::remoteBoardState);
+        board.requestRemoteBoardState();
+        QVERIFY(stateSpy.wait());
+        QCOMPARE(stateSpy.first().at(0).value<BoardState>().toFenString(), BoardState::newGame().toFenString());
+
+        ConnectionManager newManager;
+        QSignalSpy newConnectedSpy(&newManager, &ConnectionManager::connected);
+        newManager.connectToBoard(BoardAddress::fromString(QLatin1String("simulator")));
+        QVERIFY(newConnectedSpy.wait());
+        QSignalSpy stateChangedSpy(&board, &CompositeBoard::boardStateChanged);
+        board.resyncRemoteBoard(newConnectedSpy.first().at(0).value<RemoteBoard *>());
+        QVERIFY(!stateChangedSpy.wait(500));
+        QCOMPARE(board.boardState().toFenString(), BoardState::newGame().toFenString());
+        QCOMPARE(outOfSyncSpy.count(), 0);
+        board.setRemoteBoard(nullptr);
+    }
+
+    void clock()
+    {
+        CompositeBoard board;
+        QVERIFY(!board.clock().isTimed());
+        GameOptions gameOptions;
+        gameOptions.timeControl.baseTime = 60000;
+        gameOptions.timeControl.increment = 2000;
+        board.requestNewGame(gameOptions);
+        QVERIFY(board.clock().isTimed());
+        QCOMPARE(board.remainingTime(Colour::Black), 60000);
+        QVERIFY(board.remainingTime(Colour::White) <= 60000);
+        board.requestMove(Square::fromAlgebraicString("e2"), Square::fromAlgebraicString("e4"));
+        // White gets the increment once its move is made.
+        QVERIFY(board.remainingTime(Colour::White) > 60000);
+        QCOMPARE(board.clock().increment, 2000);
+        board.stopClock();
+        const int blackTime = board.remainingTime(Colour::Black);
+        QTest::qWait(20);
+        QCOMPARE(board.remainingTime(Colour::Black), blackTime);
+    }
+
+    // Only moves earn the increment, not positions that change the side
+    // to move in other ways.
+    void clockNoIncrement()
+    {
+        CompositeBoard board;
+        GameOptions gameOptions;
+        gameOptions.timeControl.baseTime = 60000;
+        gameOptions.timeControl.increment = 2000;
+        board.requestNewGame(gameOptions);
+        board.requestMove(Square::fromAlgebraicString("e2"), Square::fromAlgebraicString("e4"));
+        QVERIFY(board.remainingTime(Colour::White) > 60000);
+        board.requestUndo();
+        QVERIFY(board.activeColour() == Colour::White);
+        QVERIFY(board.remainingTime(Colour::Black) <= 60000);
+        const int whiteTime = board.remainingTime(Colour::White);
+        board.setBoardState(BoardState::fromFenString("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"));
+        QVERIFY(board.remainingTime(Colour::White) <= whiteTime);
+        // The clock still follows the side to move.
+        const int blackTime = board.remainingTime(Colour::Black);
+        const int stoppedWhiteTime = board.remainingTime(Colour::White);
+        QTest::qWait(20);
+        QVERIFY(board.remainingTime(Colour::Black) < blackTime);
+        QCOMPARE(board.remainingTime(Colour::White), stoppedWhiteTime);
+    }
+
+    void timeExpired()
+    {
+        CompositeBoard board;
+        QSignalSpy timeExpiredSpy(&board, &CompositeBoard::timeExpired);
+        GameOptions gameOptions;
+        gameOptions.timeControl.baseTime = 50;
+        board.requestNewGame(gameOptions);
+        QTRY_COMPARE(timeExpiredSpy.count(), 1);
+        QVERIFY(timeExpiredSpy.first().at(0).value<Colour>() == Colour::White);
+        QCOMPARE(board.remainingTime(Colour::White), 0);
+    }
+
+    void tablebaseAdjudication()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(writeKqkTable(QDir(dir.path())));
+        QSharedPointer<SyzygyTablebases> tablebases(new SyzygyTablebases);
+        QCOMPARE(tablebases->load(dir.path()), 1);
+        CompositeBoard board;
+        QSignalSpy adjudicatedSpy(&board, &CompositeBoard::adjudicated);
+        QSignalSpy drawSpy(&board, &CompositeBoard::draw);
+        const BoardState won = BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3QK3 b - - 0 1"));
+        board.setBoardState(won);
+        QCOMPARE(adjudicatedSpy.count(), 0);
+
+        board.setTablebases(tablebases);
+        board.setBoardState(won);
+        QCOMPARE(adjudicatedSpy.count(), 1);
+        QVERIFY(adjudicatedSpy.takeFirst().at(0).value<Colour>() == Colour::White);
+        // Black can take the queen.
+        board.setBoardState(BoardState::fromFenString(QLatin1String("8/8/8/8/8/8/6kQ/K7 b - - 0 1")));
+        QCOMPARE(drawSpy.count(), 1);
+        QVERIFY(drawSpy.takeFirst().at(0).value<DrawReason>() == DrawReason::Tablebase);
+        // Too many pieces for the tables.
+        board.setBoardState(BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/3R4/3QK3 w - - 0 1")));
+        QCOMPARE(adjudicatedSpy.count(), 0);
+        board.requestMove(Square::fromAlgebraicString("d2"), Square::fromAlgebraicString("d8"));
+        QCOMPARE(adjudicatedSpy.count(), 0);
+        QCOMPARE(drawSpy.count(), 0);
+        // Reached by a move, leaving the queen to be taken.
+        board.setBoardState(BoardState::fromFenString(QLatin1String("8/8/8/4k3/3r4/8/8/3QK3 w - - 0 1")));
+        board.requestMove(Square::fromAlgebraicString("d1"), Square::fromAlgebraicString("d4"));
+        QCOMPARE(adjudicatedSpy.count(), 0);
+        QCOMPARE(drawSpy.count(), 1);
+    }
 };
 
 QTEST_MAIN(TestCompositeBoard)
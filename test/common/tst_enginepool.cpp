@@ -0,0 +1,218 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QSet>
+#include <QSignalSpy>
+#include <QTest>
+#include <QThread>
+
+#include "aiplayerfactory.h"
+#include "chessboard.h"
+#include "enginepool.h"
+
+using namespace Chessboard;
+
+// Plays the first legal move and gives one round of assistance.
+class InstantAiPlayer : public AiPlayer
+{
+public:
+    InstantAiPlayer(Colour colour, QObject *parent = nullptr) :
+        AiPlayer(colour, parent)
+    {
+    }
+    void start(const BoardState& state) override
+    {
+        const QPair<Square, Square> move = state.legalMoves().first();
+        emit requestMove(move.first.row, move.first.col, move.second.row, move.second.col);
+    }
+    void promotionRequired() override
+    {
+        emit requestPromotion(Piece::Knight);
+    }
+    void startAssistance(const BoardState& state) override
+    {
+        QList<AssistanceColour> colours(state.legalMoves().size(), AssistanceColour::Green);
+        emit assistance(colours);
+        emit assistanceComplete();
+    }
+};
+
+// Searches assistance until it is told to stop.
+class BusyAiPlayer : public InstantAiPlayer
+{
+public:
+    BusyAiPlayer(Colour colour, QObject *parent = nullptr) :
+        InstantAiPlayer(colour, parent)
+    {
+    }
+    void startAssistance(const BoardState&) override
+    {
+        const CancellationToken token = cancellationToken();
+        while (!token.isStopRequested()) {}
+    }
+};
+
+// Pushes the e-pawn to the back rank without naming a piece.
+class PromotingAiPlayer : public InstantAiPlayer
+{
+public:
+    PromotingAiPlayer(Colour colour, QObject *parent = nullptr) :
+        InstantAiPlayer(colour, parent)
+    {
+    }
+    void start(const BoardState&) override
+    {
+        const Square from = Square::fromAlgebraicString(QLatin1String("e7"));
+        const Square to = Square::fromAlgebraicString(QLatin1String("e8"));
+        emit requestMove(from.row, from.col, to.row, to.col);
+    }
+};
+
+template<typename T>
+class TestAiPlayerFactory : public AiPlayerFactory
+{
+public:
+    AiPlayer *createAiPlayer(Colour colour, QObject *parent = nullptr) override
+    {
+        return new T(colour, parent);
+    }
+};
+
+class TestEnginePool : public QObject
+{
+    Q_OBJECT
+private slots:
+    void defaultEngineCount()
+    {
+        TestAiPlayerFactory<InstantAiPlayer> factory;
+        EnginePool pool(&factory);
+        QCOMPARE(pool.engineCount(), qMax(1, QThread::idealThreadCount()));
+    }
+
+    void moveAndAssistance()
+    {
+        TestAiPlayerFactory<InstantAiPlayer> factory;
+        EnginePool pool(&factory, 2);
+        QSignalSpy finishedSpy(&pool, &EnginePool::finished);
+        QList<int> moveRequests;
+        connect(&pool, &EnginePool::moveFound, this, [&](int request, const AlgebraicNotation& move) {
+            QVERIFY(move.fromRow >= 0 && move.toRow >= 0);
+            moveRequests.append(request);
+        });
+        QList<int> assistanceRequests;
+        connect(&pool, &EnginePool::assistance, this, [&](int request, const QList<AssistanceColour>& colours) {
+            QVERIFY(colours.size() == 20);
+            assistanceRequests.append(request);
+        });
+        const int move = pool.requestMove(BoardState::newGame(), 1500);
+        const int assistance = pool.requestAssistance(BoardState::newGame(), 2);
+        QVERIFY(move != assistance);
+        QTRY_COMPARE(finishedSpy.count(), 2);
+        QCOMPARE(moveRequests, QList<int>({ move }));
+        QCOMPARE(assistanceRequests, QList<int>({ assistance }));
+        const EnginePool::Statistics statistics = pool.statistics();
+        QCOMPARE(statistics.completed, 2);
+        QCOMPARE(statistics.busyEngines, 0);
+        QVERIFY(statistics.utilisation() >= 0.0 && statistics.utilisation() <= 1.0);
+    }
+
+    void promotion()
+    {
+        TestAiPlayerFactory<PromotingAiPlayer> factory;
+        EnginePool pool(&factory, 1);
+        AlgebraicNotation found;
+        connect(&pool, &EnginePool::moveFound, this, [&](int, const AlgebraicNotation& move) {
+            found = move;
+        });
+        QSignalSpy finishedSpy(&pool, &EnginePool::finished);
+        pool.requestMove(BoardState::fromFenString(QLatin1String("8/4P3/8/8/8/8/8/k1K5 w - - 0 1")), 1500);
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(found.promotion);
+        QVERIFY(found.promotionPiece == Piece::Knight);
+        QCOMPARE(Square(found.toRow, found.toCol).toAlgebraicString(), QLatin1String("e8"));
+    }
+
+    void liveMovePreemptsBackground()
+    {
+        TestAiPlayerFactory<BusyAiPlayer> factory;
+        EnginePool pool(&factory, 1);
+        QSignalSpy moveSpy(&pool, &EnginePool::moveFound);
+        QSignalSpy finishedSpy(&pool, &EnginePool::finished);
+        const int background = pool.requestAssistance(BoardState::newGame(), 2, EnginePool::Background);
+        QCOMPARE(pool.statistics().busyEngines, 1);
+        const int move = pool.requestMove(BoardState::newGame(), 1500);
+        QVERIFY(moveSpy.wait());
+        QCOMPARE(moveSpy.at(0).at(0).toInt(), move);
+        QTRY_COMPARE(finishedSpy.count(), 1);
+        QCOMPARE(finishedSpy.at(0).at(0).toInt(), move);
+        // The background request went back on the queue and is running again.
+        EnginePool::Statistics statistics = pool.statistics();
+        QCOMPARE(statistics.preempted, 1);
+        QTRY_COMPARE(pool.statistics().busyEngines, 1);
+        pool.cancel(background);
+        QTRY_COMPARE(pool.statistics().busyEngines, 0);
+        statistics = pool.statistics();
+        QCOMPARE(statistics.cancelled, 1);
+        QCOMPARE(statistics.completed, 1);
+        QCOMPARE(finishedSpy.count(), 1);
+    }
+
+    void queuedByPriority()
+    {
+        TestAiPlayerFactory<BusyAiPlayer> factory;
+        EnginePool pool(&factory, 1);
+        QList<int> finished;
+        connect(&pool, &EnginePool::finished, this, [&](int request) {
+            finished.append(request);
+        });
+        const int busy = pool.requestAssistance(BoardState::newGame(), 2, EnginePool::LiveMove);
+        const int background = pool.requestMove(BoardState::newGame(), 1500, EnginePool::Background);
+        const int live = pool.requestMove(BoardState::newGame(), 1500, EnginePool::LiveMove);
+        // Nothing outranks the running request, so both wait.
+        EnginePool::Statistics statistics = pool.statistics();
+        QCOMPARE(statistics.queued[EnginePool::LiveMove], 1);
+        QCOMPARE(statistics.queued[EnginePool::Background], 1);
+        QCOMPARE(statistics.preempted, 0);
+        pool.cancel(busy);
+        QTRY_COMPARE(finished.size(), 2);
+        QCOMPARE(finished, QList<int>({ live, background }));
+    }
+
+    void manyRequests()
+    {
+        TestAiPlayerFactory<InstantAiPlayer> factory;
+        EnginePool pool(&factory, 4);
+        QSet<int> requests;
+        QSet<int> finished;
+        connect(&pool, &EnginePool::finished, this, [&](int request) {
+            finished.insert(request);
+        });
+        BoardState state = BoardState::newGame();
+        for (int i=0;i<64;++i)
+            requests.insert(pool.requestMove(state, 1500, static_cast<EnginePool::Priority>(i % EnginePool::priorityCount)));
+        QCOMPARE(requests.size(), 64);
+        QTRY_COMPARE(finished, requests);
+        const EnginePool::Statistics statistics = pool.statistics();
+        QCOMPARE(statistics.completed, 64);
+        QCOMPARE(statistics.started[EnginePool::LiveMove] + statistics.started[EnginePool::Assistance] +
+                 statistics.started[EnginePool::Background], 64);
+    }
+};
+
+QTEST_MAIN(TestEnginePool)
+#include "tst_enginepool.moc"
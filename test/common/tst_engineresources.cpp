@@ -0,0 +1,67 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTest>
+#include <QThread>
+
+#include "engineresources.h"
+
+class TestEngineResources : public QObject
+{
+    Q_OBJECT
+private slots:
+    void defaults()
+    {
+        const EngineResources resources = EngineResources::defaults();
+        QCOMPARE(resources.threads, qMax(1, QThread::idealThreadCount()));
+        QVERIFY(resources.hash >= EngineResources::minimumHash);
+        QVERIFY(resources.hash <= EngineResources::maximumHash);
+        // Always a power of two.
+        QCOMPARE(resources.hash & (resources.hash - 1), 0);
+    }
+
+    void physicalMemory()
+    {
+#if defined(Q_OS_LINUX) || defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+        QVERIFY(EngineResources::physicalMemory() > 0);
+#endif
+    }
+
+    void sharing()
+    {
+        EngineResources resources;
+        resources.threads = 8;
+        resources.hash = 512;
+        const EngineResources shared = resources.sharedBy(2);
+        QCOMPARE(shared.threads, 8);
+        QCOMPARE(shared.hash, 256);
+        const EngineResources partitioned = resources.partitionedBetween(3);
+        QCOMPARE(partitioned.threads, 2);
+        QCOMPARE(partitioned.hash, 170);
+        QCOMPARE(resources.forAssistance().threads, EngineResources::maximumAssistanceThreads);
+        QCOMPARE(resources.forAssistance().hash, 512);
+        // Never less than one thread and one MiB.
+        const EngineResources tiny = resources.partitionedBetween(1000);
+        QCOMPARE(tiny.threads, 1);
+        QCOMPARE(tiny.hash, 1);
+        QVERIFY(resources.partitionedBetween(1) == resources);
+    }
+};
+
+QTEST_MAIN(TestEngineResources)
+#include "tst_engineresources.moc"
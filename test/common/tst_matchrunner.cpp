@@ -0,0 +1,158 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QBuffer>
+#include <QSignalSpy>
+#include <QTest>
+
+#include "aiplayerfactory.h"
+#include "chessboard.h"
+#include "matchrunner.h"
+
+using namespace Chessboard;
+
+// Plays the first legal move.
+class FirstMoveAiPlayer : public AiPlayer
+{
+public:
+    FirstMoveAiPlayer(Colour colour, QObject *parent = nullptr) :
+        AiPlayer(colour, parent)
+    {
+    }
+    void start(const BoardState& state) override
+    {
+        const QPair<Square, Square> move = state.legalMoves().first();
+        emit requestMove(move.first.row, move.first.col, move.second.row, move.second.col);
+    }
+    void promotionRequired() override
+    {
+        emit requestPromotion(Piece::Queen);
+    }
+};
+
+// Moves the e-pawn three squares.
+class IllegalAiPlayer : public FirstMoveAiPlayer
+{
+public:
+    IllegalAiPlayer(Colour colour, QObject *parent = nullptr) :
+        FirstMoveAiPlayer(colour, parent)
+    {
+    }
+    void start(const BoardState& state) override
+    {
+        const int from = (state.activeColour == Colour::White) ? 1 : 6;
+        const int to = (state.activeColour == Colour::White) ? 4 : 3;
+        emit requestMove(from, 4, to, 4);
+    }
+};
+
+template<typename T>
+class TestAiPlayerFactory : public AiPlayerFactory
+{
+public:
+    AiPlayer *createAiPlayer(Colour colour, QObject *parent = nullptr) override
+    {
+        return new T(colour, parent);
+    }
+};
+
+class TestMatchRunner : public QObject
+{
+    Q_OBJECT
+private slots:
+    void playsEveryGame()
+    {
+        TestAiPlayerFactory<FirstMoveAiPlayer> factory;
+        MatchRunner runner({ QLatin1String("A"), &factory, 1500 }, { QLatin1String("B"), &factory, 1500 }, 2);
+        runner.setMaximumPlies(40);
+        QBuffer output;
+        output.open(QIODevice::WriteOnly);
+        runner.setOutput(&output);
+        QSignalSpy gameSpy(&runner, &MatchRunner::gameFinished);
+        QSignalSpy finishedSpy(&runner, &MatchRunner::finished);
+        runner.start(4);
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(gameSpy.count(), 4);
+        QCOMPARE(runner.statistics().games(), 4);
+        const QString pgn = QString::fromLatin1(output.data());
+        QCOMPARE(pgn.count(QLatin1String("[Round ")), 4);
+        QCOMPARE(pgn.count(QLatin1String("[White \"A\"]")), 2);
+        QCOMPARE(pgn.count(QLatin1String("[White \"B\"]")), 2);
+        // Each game parses back with the moves that were played.
+        const Pgn first = PgnParser().parse(pgn.left(pgn.indexOf(QLatin1String("[Event"), 1)));
+        QVERIFY(first.isValid());
+        QVERIFY(first.moves.size() <= 40);
+        QVERIFY(first.tags.contains(QLatin1String("Termination")));
+    }
+
+    void illegalMoveForfeits()
+    {
+        TestAiPlayerFactory<IllegalAiPlayer> illegal;
+        TestAiPlayerFactory<FirstMoveAiPlayer> legal;
+        MatchRunner runner({ QLatin1String("Illegal"), &illegal, 1500 }, { QLatin1String("Legal"), &legal, 1500 }, 1);
+        QList<QString> results;
+        connect(&runner, &MatchRunner::gameFinished, this, [&](int, const QString& result, const QString& termination) {
+            results.append(result);
+            QCOMPARE(termination, QLatin1String("rules infraction"));
+        });
+        QSignalSpy finishedSpy(&runner, &MatchRunner::finished);
+        runner.start(1);
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(results, QList<QString>({ QLatin1String("0-1") }));
+        QCOMPARE(runner.statistics().losses, 1);
+        QCOMPARE(runner.statistics().score(), 0.0);
+    }
+
+    void openings()
+    {
+        QBuffer epd;
+        epd.setData("4k3/8/8/8/8/8/4P3/4K3 w - - id \"pawn\";\n"
+                    "4k3/4p3/8/8/8/8/8/4K3 b - -\n");
+        epd.open(QIODevice::ReadOnly);
+        QString errorMessage;
+        QList<Pgn> openings = MatchRunner::readOpenings(&epd, &errorMessage);
+        QCOMPARE(errorMessage, QString());
+        QCOMPARE(openings.size(), 2);
+        QCOMPARE(openings[1].tags.value(QLatin1String("FEN")), QLatin1String("4k3/4p3/8/8/8/8/8/4K3 b - - 0 1"));
+
+        QBuffer pgn;
+        pgn.setData("[Event \"Ruy Lopez\"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bb5 *\n\n"
+                    "[Event \"Sicilian\"]\n\n1. e4 c5 *\n");
+        pgn.open(QIODevice::ReadOnly);
+        openings = MatchRunner::readOpenings(&pgn, &errorMessage);
+        QCOMPARE(openings.size(), 2);
+        QCOMPARE(openings[0].moves.size(), 5);
+
+        TestAiPlayerFactory<FirstMoveAiPlayer> factory;
+        MatchRunner runner({ QLatin1String("A"), &factory, 1500 }, { QLatin1String("B"), &factory, 1500 }, 2);
+        runner.setOpenings(openings);
+        runner.setMaximumPlies(6);
+        QBuffer output;
+        output.open(QIODevice::WriteOnly);
+        runner.setOutput(&output);
+        QSignalSpy finishedSpy(&runner, &MatchRunner::finished);
+        runner.start(2);
+        QVERIFY(finishedSpy.wait());
+        // The opening counts towards the limit, so Black gets one move.
+        const QString played = QString::fromLatin1(output.data());
+        QCOMPARE(played.count(QLatin1String("1. e4 e5 2. Nf3 Nc6 3. Bb5 Nb4 1/2-1/2")), 2);
+    }
+};
+
+QTEST_MAIN(TestMatchRunner)
+#include "tst_matchrunner.moc"
@@ -0,0 +1,147 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "chessboard.h"
+#include "nativeaiplayer.h"
+#include "nativeengine.h"
+
+using namespace Chessboard;
+
+namespace {
+    // A KQvK WDL table in which the side with the queen always wins.
+    bool writeKqkTable(const QDir& dir)
+    {
+        QFile file(dir.filePath(QLatin1String("KQvK.rtbw")));
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        QByteArray data("\x71\xe8\x23\x5d\x01\x00\x66\x55\xee\x00\x80\x04\x80\x00", 14);
+        data.resize(80, '\0');
+        return file.write(data) == data.size();
+    }
+}
+
+class TestNativeAiPlayer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void perft_data()
+    {
+        QTest::addColumn<QString>("fen");
+        QTest::addColumn<int>("depth");
+        QTest::addColumn<qulonglong>("nodes");
+        QTest::newRow("start") << QStringLiteral("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") << 3 << 8902ull;
+        QTest::newRow("kiwipete") << QStringLiteral("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1") << 2 << 2039ull;
+        QTest::newRow("enpassant") << QStringLiteral("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1") << 4 << 43238ull;
+        QTest::newRow("promotion") << QStringLiteral("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1") << 3 << 9467ull;
+    }
+
+    void perft()
+    {
+        QFETCH(QString, fen);
+        QFETCH(int, depth);
+        QFETCH(qulonglong, nodes);
+        NativeEngine::Board board;
+        QVERIFY(board.setFen(fen.toStdString()));
+        QCOMPARE(static_cast<qulonglong>(NativeEngine::perft(board, depth)), nodes);
+    }
+
+    void boardStateConversion()
+    {
+        const QString fen = QLatin1String("r3k2r/p1ppqpb1/bn2pnp1/3PN3/Pp2P3/2N2Q1p/1PPBBPPP/R3K2R b Kq a3 0 1");
+        NativeEngine::Board expected;
+        QVERIFY(expected.setFen(fen.toStdString()));
+        const NativeEngine::Board board = NativeAiPlayer::toNativeBoard(BoardState::fromFenString(fen));
+        QVERIFY(board.hash() == expected.hash());
+        QCOMPARE(board.enPassantSquare(), expected.enPassantSquare());
+        QCOMPARE(board.castlingRights(), expected.castlingRights());
+    }
+
+    void findsMateInOne()
+    {
+        NativeEngine::Board board;
+        QVERIFY(board.setFen("6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1"));
+        NativeEngine::Search search(1);
+        NativeEngine::SearchLimits limits;
+        limits.maxDepth = 4;
+        const NativeEngine::SearchResult result = search.search(board, limits);
+        QCOMPARE(QString::fromStdString(result.bestMove.toUci()), QLatin1String("a1a8"));
+        QVERIFY(result.score >= NativeEngine::MateThreshold);
+    }
+
+    void requestsLegalMove()
+    {
+        NativeAiPlayer player(Colour::White, nullptr, 1);
+        player.setStrength(600);
+        QSignalSpy spy(&player, &AiPlayer::requestMove);
+        const BoardState state = BoardState::newGame();
+        player.start(state);
+        QCOMPARE(spy.count(), 1);
+        const QList<QVariant> arguments = spy.takeFirst();
+        const QList<QPair<Square, Square> > moves = state.legalMoves();
+        const QPair<Square, Square> move(Square(arguments[0].toInt(), arguments[1].toInt()),
+                                         Square(arguments[2].toInt(), arguments[3].toInt()));
+        QVERIFY(moves.contains(move));
+    }
+
+    void cancelledSearchRequestsNothing()
+    {
+        NativeAiPlayer player(Colour::White, nullptr, 1);
+        QSignalSpy spy(&player, &AiPlayer::requestMove);
+        player.cancel();
+        player.start(BoardState::newGame());
+        QCOMPARE(spy.count(), 0);
+    }
+
+    void tablebases()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(writeKqkTable(QDir(dir.path())));
+        QSharedPointer<SyzygyTablebases> tablebases(new SyzygyTablebases);
+        QCOMPARE(tablebases->load(dir.path()), 1);
+        NativeAiPlayer player(Colour::Black, nullptr, 1);
+        player.setTablebases(tablebases);
+        player.setAssistanceLevel(5);
+        // Only taking the queen saves the game.
+        const BoardState state = BoardState::fromFenString(QLatin1String("8/8/8/8/8/8/6kQ/K7 b - - 0 1"));
+        QList<QList<AssistanceColour> > assistance;
+        connect(&player, &AiPlayer::assistance, this, [&assistance](const QList<AssistanceColour>& colours) {
+            assistance.append(colours);
+        });
+        player.startAssistance(state);
+        // Complete at once, without a search.
+        QCOMPARE(assistance.size(), 1);
+        // In sortedLegalMoves() order: Kf1, Kxh2, Kf3.
+        QCOMPARE(assistance.first(), QList<AssistanceColour>({ AssistanceColour::Red, AssistanceColour::Green,
+                                                               AssistanceColour::Red }));
+
+        QSignalSpy spy(&player, &AiPlayer::requestMove);
+        player.start(state);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.takeFirst(), QList<QVariant>({ 1, 6, 1, 7 }));
+    }
+};
+
+QTEST_MAIN(TestNativeAiPlayer)
+#include "tst_nativeaiplayer.moc"
@@ -0,0 +1,288 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+
+#include "cancellationtoken.h"
+#include "chessboard.h"
+#include "stockfishaiplayer.h"
+
+using namespace Chessboard;
+
+// Drives StockfishAiPlayer against the mock UCI engine, which is scripted
+// through MOCKUCI_* environment variables inherited by the engine process.
+class TestStockfishAiPlayer : public QObject
+{
+    Q_OBJECT
+private:
+    static QString enginePath()
+    {
+        return QStringLiteral(MOCKUCIENGINE_PATH);
+    }
+
+    static void cancelAfter(CancellationToken token, int milliseconds, QThread **thread)
+    {
+        *thread = QThread::create([token, milliseconds]() mutable {
+            QThread::msleep(milliseconds);
+            token.cancel();
+        });
+        (*thread)->start();
+    }
+
+private slots:
+    void init()
+    {
+        for (const char *name : { "MOCKUCI_BOOT_DELAY", "MOCKUCI_READY_DELAY", "MOCKUCI_SEARCH_DELAY",
+                                  "MOCKUCI_BESTMOVE", "MOCKUCI_SCORE", "MOCKUCI_MATE", "MOCKUCI_DEPTH",
+                                  "MOCKUCI_NODES", "MOCKUCI_CRASH_ON", "MOCKUCI_LOG" })
+            qunsetenv(name);
+    }
+
+    void requestsMove()
+    {
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        QSignalSpy spy(&player, &AiPlayer::requestMove);
+        player.start(BoardState::newGame());
+        QVERIFY(spy.wait());
+        // The mock plays the first legal move: b1a3.
+        QCOMPARE(spy.takeFirst(), QList<QVariant>({ 0, 1, 2, 0 }));
+    }
+
+    void ignoresStaleBestMove()
+    {
+        qputenv("MOCKUCI_SEARCH_DELAY", "200");
+        qputenv("MOCKUCI_BESTMOVE", "a2a3,h2h3");
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        QSignalSpy spy(&player, &AiPlayer::requestMove);
+        player.startAnalysis(BoardState::newGame(), 1000);
+        // Stops the analysis, whose bestmove must not be played.
+        player.start(BoardState::newGame());
+        QVERIFY(spy.wait());
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.takeFirst(), QList<QVariant>({ 1, 7, 2, 7 }));
+    }
+
+    void analysis_data()
+    {
+        QTest::addColumn<QByteArray>("score");
+        QTest::addColumn<QByteArray>("mate");
+        QTest::addColumn<int>("expectedScore");
+        QTest::addColumn<int>("expectedMate");
+        QTest::newRow("centipawns") << QByteArray("-42") << QByteArray() << -42 << 0;
+        QTest::newRow("mate") << QByteArray() << QByteArray("3") << 0 << 3;
+    }
+
+    void analysis()
+    {
+        QFETCH(QByteArray, score);
+        QFETCH(QByteArray, mate);
+        QFETCH(int, expectedScore);
+        QFETCH(int, expectedMate);
+        qputenv("MOCKUCI_SCORE", score);
+        qputenv("MOCKUCI_MATE", mate);
+        qputenv("MOCKUCI_DEPTH", "12");
+        qputenv("MOCKUCI_NODES", "5000");
+        qputenv("MOCKUCI_BESTMOVE", "e2e4");
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        PositionAnalysis result;
+        bool analysed = false;
+        connect(&player, &AiPlayer::analysis, this, [&](const PositionAnalysis& analysis) {
+            result = analysis;
+            analysed = true;
+        });
+        player.startAnalysis(BoardState::newGame(), 10);
+        QTRY_VERIFY(analysed);
+        QCOMPARE(result.bestMove, QLatin1String("e2e4"));
+        QCOMPARE(result.score, expectedScore);
+        QCOMPARE(result.mate, expectedMate);
+        QCOMPARE(result.depth, 12);
+        QCOMPARE(result.pv, QStringList(QLatin1String("e2e4")));
+        QCOMPARE(result.nodes, qint64(5000));
+        QVERIFY(result.nps > 0);
+        QCOMPARE(result.sanPv(BoardState::newGame()), QStringList(QLatin1String("e4")));
+    }
+
+    void analysisProgress()
+    {
+        qputenv("MOCKUCI_BESTMOVE", "g1f3");
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        QList<PositionAnalysis> progress;
+        bool analysed = false;
+        connect(&player, &AiPlayer::analysisProgress, this, [&](const PositionAnalysis& analysis) {
+            progress.append(analysis);
+        });
+        connect(&player, &AiPlayer::analysis, this, [&]() {
+            analysed = true;
+        });
+        player.startAnalysis(BoardState::newGame(), 10);
+        QTRY_VERIFY(analysed);
+        // The interim result arrives before the final one.
+        QCOMPARE(progress.size(), 1);
+        QCOMPARE(progress.first().bestMove, QLatin1String("g1f3"));
+    }
+
+    void crashDuringBoot()
+    {
+        qputenv("MOCKUCI_CRASH_ON", "uci");
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        QList<AiPlayer::Error> errors;
+        connect(&player, &AiPlayer::error, this, [&](AiPlayer::Error error) {
+            errors.append(error);
+        });
+        QElapsedTimer timer;
+        timer.start();
+        player.start(BoardState::newGame());
+        QVERIFY(errors.contains(AiPlayer::EngineNoBoot));
+        QVERIFY(timer.elapsed() < 5000);
+    }
+
+    void crashDuringSearch()
+    {
+        const QString logPath = QDir::temp().filePath(QStringLiteral("tst_stockfishaiplayer-crash-%1.log").arg(QCoreApplication::applicationPid()));
+        QFile::remove(logPath);
+        qputenv("MOCKUCI_LOG", QFile::encodeName(logPath));
+        qputenv("MOCKUCI_CRASH_ON", "go");
+        QTemporaryDir tablebaseDir;
+        QVERIFY(tablebaseDir.isValid());
+        QSharedPointer<SyzygyTablebases> tablebases(new SyzygyTablebases);
+        tablebases->load(tablebaseDir.path());
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        player.setStrength(1500);
+        player.setResources(EngineResources { 2, 64 });
+        player.setTablebases(tablebases);
+        QSignalSpy moveSpy(&player, &AiPlayer::requestMove);
+        QList<AiPlayer::Error> errors;
+        connect(&player, &AiPlayer::error, this, [&](AiPlayer::Error error) {
+            errors.append(error);
+        });
+        QElapsedTimer timer;
+        timer.start();
+        player.start(BoardState::newGame());
+        // Reported as soon as the engine goes, without another request.
+        QTRY_COMPARE(errors, QList<AiPlayer::Error>({ AiPlayer::EngineCrashed }));
+        QVERIFY(timer.elapsed() < 5000);
+        QCOMPARE(moveSpy.count(), 0);
+        // The next request starts a new engine, which crashes in turn.
+        player.start(BoardState::newGame());
+        QTRY_COMPARE(errors, QList<AiPlayer::Error>({ AiPlayer::EngineCrashed, AiPlayer::EngineCrashed }));
+        QFile log(logPath);
+        QVERIFY(log.open(QIODevice::ReadOnly | QIODevice::Text));
+        const QList<QByteArray> commands = log.readAll().split('\n');
+        QCOMPARE(commands.count("uci"), 2);
+        // The new engine is set up as the old one was.
+        QCOMPARE(commands.count("setoption name UCI_LimitStrength value true"), 2);
+        QCOMPARE(commands.count("setoption name UCI_Elo value 1500"), 2);
+        QCOMPARE(commands.count("setoption name Threads value 2"), 2);
+        QCOMPARE(commands.count("setoption name Hash value 64"), 2);
+        QCOMPARE(commands.count("setoption name SyzygyPath value " + QFile::encodeName(tablebaseDir.path())), 2);
+        QVERIFY(commands.lastIndexOf("setoption name UCI_Elo value 1500") > commands.lastIndexOf("uci"));
+        log.close();
+        QFile::remove(logPath);
+    }
+
+    void crashWhileWaitingForReady()
+    {
+        qputenv("MOCKUCI_CRASH_ON", "isready");
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        QSignalSpy moveSpy(&player, &AiPlayer::requestMove);
+        QList<AiPlayer::Error> errors;
+        connect(&player, &AiPlayer::error, this, [&](AiPlayer::Error error) {
+            errors.append(error);
+        });
+        QElapsedTimer timer;
+        timer.start();
+        player.start(BoardState::newGame());
+        QVERIFY(timer.elapsed() < 5000);
+        // A crash, not a timeout, and reported once.
+        QCOMPARE(errors, QList<AiPlayer::Error>({ AiPlayer::EngineCrashed }));
+        QTest::qWait(50);
+        QCOMPARE(errors, QList<AiPlayer::Error>({ AiPlayer::EngineCrashed }));
+        QCOMPARE(moveSpy.count(), 0);
+    }
+
+    void cancelWhileWaitingForReady()
+    {
+        qputenv("MOCKUCI_READY_DELAY", "-1");
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        QSignalSpy moveSpy(&player, &AiPlayer::requestMove);
+        QList<AiPlayer::Error> errors;
+        connect(&player, &AiPlayer::error, this, [&](AiPlayer::Error error) {
+            errors.append(error);
+        });
+        CancellationToken token;
+        player.setCancellationToken(token);
+        QThread *thread;
+        cancelAfter(token, 50, &thread);
+        QElapsedTimer timer;
+        timer.start();
+        player.start(BoardState::newGame());
+        const qint64 elapsed = timer.elapsed();
+        thread->wait();
+        delete thread;
+        QVERIFY(elapsed < 1000);
+        QCOMPARE(moveSpy.count(), 0);
+        QVERIFY(errors.isEmpty());
+    }
+
+    void logsCommands()
+    {
+        const QString logPath = QDir::temp().filePath(QStringLiteral("tst_stockfishaiplayer-%1.log").arg(QCoreApplication::applicationPid()));
+        QFile::remove(logPath);
+        qputenv("MOCKUCI_LOG", QFile::encodeName(logPath));
+        {
+            StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+            QSignalSpy spy(&player, &AiPlayer::requestMove);
+            player.setResources(EngineResources { 2, 64 });
+            player.start(BoardState::newGame());
+            QVERIFY(spy.wait());
+        }
+        QFile log(logPath);
+        QTRY_VERIFY(log.exists() && log.size() > 0);
+        QVERIFY(log.open(QIODevice::ReadOnly | QIODevice::Text));
+        const QList<QByteArray> commands = log.readAll().split('\n');
+        QCOMPARE(commands.first(), QByteArray("uci"));
+        QVERIFY(commands.contains("setoption name Threads value 2"));
+        QVERIFY(commands.contains("setoption name Hash value 64"));
+        QVERIFY(commands.contains("position fen rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+        log.close();
+        QFile::remove(logPath);
+    }
+
+    void moveLatency()
+    {
+        StockfishAiPlayer player(Colour::White, enginePath(), nullptr);
+        QSignalSpy spy(&player, &AiPlayer::requestMove);
+        const BoardState state = BoardState::newGame();
+        // Boot the engine outside the measurement.
+        player.start(state);
+        QVERIFY(spy.wait());
+        QBENCHMARK {
+            player.start(state);
+            QVERIFY(spy.wait());
+        }
+    }
+};
+
+QTEST_MAIN(TestStockfishAiPlayer)
+#include "tst_stockfishaiplayer.moc"
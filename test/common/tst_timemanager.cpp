@@ -0,0 +1,79 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTest>
+
+#include "chessboard.h"
+#include "timemanager.h"
+
+using namespace Chessboard;
+
+namespace {
+    BoardState play(const QString& moves)
+    {
+        BoardState state = BoardState::newGame();
+        for (const QString& move : moves.split(QLatin1Char(' '), Qt::SkipEmptyParts))
+            state.move(Square::fromAlgebraicString(move.left(2)), Square::fromAlgebraicString(move.mid(2)));
+        return state;
+    }
+}
+
+class TestTimeManager : public QObject
+{
+    Q_OBJECT
+private slots:
+    void untimed()
+    {
+        QCOMPARE(TimeManager::moveTime(BoardState::newGame(), GameClock(), 1000), 1000);
+    }
+
+    void forcedMove()
+    {
+        const BoardState state = BoardState::fromFenString(QLatin1String("k7/8/8/8/8/8/8/1R5K b - - 0 1"));
+        QVERIFY(TimeManager::isForced(state));
+        QCOMPARE(TimeManager::moveTime(state, GameClock(), 1000), TimeManager::forcedMoveTime);
+    }
+
+    void recapture()
+    {
+        const BoardState state = play(QLatin1String("e2e4 d7d5 e4d5"));
+        QVERIFY(TimeManager::isRecapture(state));
+        QCOMPARE(TimeManager::moveTime(state, GameClock(), 900), 300);
+        QVERIFY(!TimeManager::isRecapture(play(QLatin1String("e2e4 d7d5"))));
+        QVERIFY(!TimeManager::isRecapture(BoardState::newGame()));
+    }
+
+    void clockBudget()
+    {
+        GameClock clock;
+        clock.whiteTime = 60000;
+        clock.blackTime = 1000;
+        const BoardState state = BoardState::newGame();
+        const int budget = TimeManager::moveTime(state, clock, 5000);
+        QVERIFY(budget > 0);
+        QVERIFY(budget < 60000 / 4);
+        clock.increment = 2000;
+        QVERIFY(TimeManager::moveTime(state, clock, 5000) > budget);
+        // Never more than a quarter of what is left, however large the increment.
+        clock.whiteTime = 400;
+        QVERIFY(TimeManager::moveTime(state, clock, 5000) <= 100);
+    }
+};
+
+QTEST_MAIN(TestTimeManager)
+#include "tst_timemanager.moc"
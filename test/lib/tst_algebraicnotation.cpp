@@ -22,6 +22,24 @@
 
 using namespace Chessboard;
 
+namespace {
+    QString san(const BoardState& state, const QString& from, const QString& to, Piece promotion = Piece::Pawn)
+    {
+        AlgebraicNotation an;
+        const Square fromSquare = Square::fromAlgebraicString(from);
+        const Square toSquare = Square::fromAlgebraicString(to);
+        an.fromRow = fromSquare.row;
+        an.fromCol = fromSquare.col;
+        an.toRow = toSquare.row;
+        an.toCol = toSquare.col;
+        if (promotion != Piece::Pawn) {
+            an.promotion = true;
+            an.promotionPiece = promotion;
+        }
+        return an.toString(state);
+    }
+}
+
 class TestAlgebraicNotation : public QObject
 {
     Q_OBJECT
@@ -210,6 +228,29 @@ private slots:
         QVERIFY(an.isValid());
         QCOMPARE(an.checkStatus, CheckStatus::Checkmate);
     }
+    void toSan()
+    {
+        BoardState state = BoardState::newGame();
+        QCOMPARE(san(state, "e2", "e4"), QLatin1String("e4"));
+        QCOMPARE(san(state, "g1", "f3"), QLatin1String("Nf3"));
+        QCOMPARE(san(state, "e2", "e5"), QString());
+        state = BoardState::fromFenString("4k3/8/8/R7/8/8/8/RN1K1N2 w - - 0 1");
+        QCOMPARE(san(state, "b1", "d2"), QLatin1String("Nbd2"));
+        QCOMPARE(san(state, "a1", "a3"), QLatin1String("R1a3"));
+        state = BoardState::fromFenString("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+        QCOMPARE(san(state, "e1", "g1"), QLatin1String("O-O"));
+        QCOMPARE(san(state, "e1", "c1"), QLatin1String("O-O-O"));
+        state = BoardState::fromFenString("k7/4P3/8/8/8/8/8/4K3 w - - 0 1");
+        QCOMPARE(san(state, "e7", "e8"), QLatin1String("e8=Q+"));
+        QCOMPARE(san(state, "e7", "e8", Piece::Knight), QLatin1String("e8=N"));
+        state = BoardState::fromFenString("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1");
+        QCOMPARE(san(state, "e5", "d6"), QLatin1String("exd6"));
+        state = BoardState::newGame();
+        QVERIFY(state.move(QLatin1String("f3")));
+        QVERIFY(state.move(QLatin1String("e5")));
+        QVERIFY(state.move(QLatin1String("g4")));
+        QCOMPARE(san(state, "d8", "h4"), QLatin1String("Qh4#"));
+    }
 };
 
 QTEST_MAIN(TestAlgebraicNotation)
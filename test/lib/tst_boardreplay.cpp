@@ -0,0 +1,267 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "chessboard.h"
+
+using namespace Chessboard;
+
+namespace {
+    // Record types in a trace.
+    enum TraceEvent : char {
+        Write = 1,
+        Written = 2,
+        Received = 4
+    };
+
+    // A trace scripted by hand, with every event at the same moment.
+    bool writeTrace(const QString& fileName, const QList<QPair<TraceEvent, QByteArray> >& events)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        QByteArray data("BCTR\x01");
+        for (const QPair<TraceEvent, QByteArray>& event : events) {
+            // Lengths stay below 128, so each varint is a single byte.
+            data.append(static_cast<char>(event.first));
+            data.append('\0');
+            data.append(static_cast<char>(event.second.size()));
+            data.append(event.second);
+        }
+        return file.write(data) == data.size();
+    }
+
+    const QByteArray getState = QByteArray::fromHex("6700");
+    const QByteArray ok = QByteArray::fromHex("21");
+    // e2-e4 made on the board.
+    const QByteArray move = QByteArray::fromHex("a3 01 04 01 04 03");
+
+    QByteArray boardState()
+    {
+        QByteArray data(1, '\x67');
+        data.append(64, '\x40');
+        data.append(QByteArray::fromHex("00 00 00 00 00 ff 00 01"));
+        return data;
+    }
+}
+
+// Records sessions with the simulated board and replays them.
+class TestBoardReplay : public QObject
+{
+    Q_OBJECT
+private:
+    static RemoteBoard *connectToBoard(ConnectionManager *manager, const QString& address)
+    {
+        QSignalSpy connectedSpy(manager, &ConnectionManager::connected);
+        manager->connectToBoard(BoardAddress::fromString(address));
+        if (!connectedSpy.wait())
+            return nullptr;
+        RemoteBoard *board = connectedSpy.takeFirst().at(0).value<RemoteBoard *>();
+        QSignalSpy stateSpy(board, &RemoteBoard::remoteBoardState);
+        if (!stateSpy.wait()) {
+            delete board;
+            return nullptr;
+        }
+        return board;
+    }
+
+    // Plays a move, e4 by default, and returns the board's reply.
+    static QList<QVariant> playMove(RemoteBoard *board, const QString& from = QLatin1String("e2"), const QString& to = QLatin1String("e4"))
+    {
+        QSignalSpy moveSpy(board, &RemoteBoard::remoteMove);
+        board->requestMove(Square::fromAlgebraicString(from), Square::fromAlgebraicString(to));
+        if (!moveSpy.wait())
+            return QList<QVariant>();
+        return moveSpy.takeFirst();
+    }
+
+    // Records a game of one move against the simulator.
+    bool record(const QString& fileName, QList<QVariant> *reply)
+    {
+        qputenv("BLUECHEESE_TRACE", QFile::encodeName(fileName));
+        ConnectionManager manager;
+        RemoteBoard *board = connectToBoard(&manager, QLatin1String("simulator:reply"));
+        qunsetenv("BLUECHEESE_TRACE");
+        if (!board)
+            return false;
+        *reply = playMove(board);
+        delete board;
+        return !reply->isEmpty();
+    }
+
+    // Replays a trace and counts the moves the app is told of.
+    static bool replayTrace(const QString& fileName, int *moves, LinkStatistics *statistics)
+    {
+        ConnectionManager manager;
+        QSignalSpy disconnectedSpy(&manager, &ConnectionManager::disconnected);
+        RemoteBoard *board = nullptr;
+        *moves = 0;
+        // Before the board says anything.
+        connect(&manager, &ConnectionManager::connected, &manager, [&board, moves](RemoteBoard *connected) {
+            board = connected;
+            connect(board, &RemoteBoard::remoteMove, board, [moves]() {
+                ++*moves;
+            });
+        });
+        manager.connectToBoard(BoardAddress::fromString(QLatin1String("replay:speed=0:") + fileName));
+        if (!disconnectedSpy.wait() || !board) {
+            delete board;
+            return false;
+        }
+        *statistics = board->linkStatistics();
+        delete board;
+        return true;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+        m_traceFileName = m_dir.filePath(QLatin1String("session.bctr"));
+        QVERIFY(record(m_traceFileName, &m_reply));
+    }
+
+    void address_data()
+    {
+        QTest::addColumn<QString>("address");
+        QTest::addColumn<bool>("valid");
+        QTest::newRow("plain") << QString("replay:session.bctr") << true;
+        QTest::newRow("speed") << QString("replay:speed=4:session.bctr") << true;
+        QTest::newRow("colon in name") << QString("replay:C:/traces/session.bctr") << true;
+        QTest::newRow("no file") << QString("replay:") << false;
+        QTest::newRow("bad speed") << QString("replay:speed=fast:session.bctr") << false;
+    }
+
+    void address()
+    {
+        QFETCH(QString, address);
+        QFETCH(bool, valid);
+        const BoardAddress boardAddress = BoardAddress::fromString(address);
+        QCOMPARE(boardAddress.isValid(), valid);
+        if (!valid)
+            return;
+        QCOMPARE(boardAddress.connectionMethod(), CONNECTION_REPLAY);
+        QCOMPARE(boardAddress.toString(), address);
+        QVERIFY(BoardAddress::fromByteArray(boardAddress.toByteArray()) == boardAddress);
+    }
+
+    void replay()
+    {
+        ConnectionManager manager;
+        QSignalSpy disconnectedSpy(&manager, &ConnectionManager::disconnected);
+        RemoteBoard *board = connectToBoard(&manager, QLatin1String("replay:speed=0:") + m_traceFileName);
+        QVERIFY(board);
+        QCOMPARE(playMove(board), m_reply);
+        QVERIFY(disconnectedSpy.wait());
+        QCOMPARE(board->linkStatistics().failures, 0);
+        // The app repeated every write that was recorded.
+        QCOMPARE(board->linkStatistics().unexpectedWrites, 0);
+        delete board;
+    }
+
+    void divergence()
+    {
+        ConnectionManager manager;
+        QSignalSpy disconnectedSpy(&manager, &ConnectionManager::disconnected);
+        RemoteBoard *board = connectToBoard(&manager, QLatin1String("replay:speed=0:") + m_traceFileName);
+        QVERIFY(board);
+        // Not the move that was recorded; the recorded reply still comes.
+        QCOMPARE(playMove(board, QLatin1String("d2"), QLatin1String("d4")), m_reply);
+        QVERIFY(disconnectedSpy.wait());
+        QCOMPARE(board->linkStatistics().unexpectedWrites, 1);
+        delete board;
+    }
+
+    // A move made on the board while the app waits for the position is
+    // acknowledged at once, not after the position arrives.
+    void acknowledgeWhileAwaitingResponse()
+    {
+        const QString fileName = m_dir.filePath(QLatin1String("ack.bctr"));
+        QVERIFY(writeTrace(fileName, {
+            { Write, getState },
+            { Written, getState },
+            { Received, move },
+            { Write, ok },
+            { Written, ok },
+            { Received, boardState() }
+        }));
+        int moves;
+        LinkStatistics statistics;
+        QVERIFY(replayTrace(fileName, &moves, &statistics));
+        QCOMPARE(moves, 1);
+        QCOMPARE(statistics.unexpectedWrites, 0);
+        QCOMPARE(statistics.failures, 0);
+    }
+
+    // The board repeats a move until it sees the acknowledgement. Every
+    // repeat is acknowledged, but the move is only played once.
+    void repeatedMove()
+    {
+        const QString fileName = m_dir.filePath(QLatin1String("repeat.bctr"));
+        QVERIFY(writeTrace(fileName, {
+            { Write, getState },
+            { Written, getState },
+            { Received, boardState() },
+            { Received, move },
+            { Write, ok },
+            { Written, ok },
+            { Received, move },
+            { Write, ok },
+            { Written, ok }
+        }));
+        int moves;
+        LinkStatistics statistics;
+        QVERIFY(replayTrace(fileName, &moves, &statistics));
+        QCOMPARE(moves, 1);
+        QCOMPARE(statistics.unexpectedWrites, 0);
+    }
+
+    void missingTrace()
+    {
+        ConnectionManager manager;
+        QSignalSpy failedSpy(&manager, &ConnectionManager::connectionFailed);
+        manager.connectToBoard(BoardAddress::fromString(QLatin1String("replay:") + m_dir.filePath(QLatin1String("missing.bctr"))));
+        QVERIFY(failedSpy.wait());
+    }
+
+    void replaySpeed()
+    {
+        QBENCHMARK {
+            ConnectionManager manager;
+            QSignalSpy disconnectedSpy(&manager, &ConnectionManager::disconnected);
+            RemoteBoard *board = connectToBoard(&manager, QLatin1String("replay:speed=0:") + m_traceFileName);
+            QVERIFY(board);
+            QVERIFY(!playMove(board).isEmpty());
+            QVERIFY(disconnectedSpy.wait());
+            delete board;
+        }
+    }
+
+private:
+    QTemporaryDir m_dir;
+    QString m_traceFileName;
+    QList<QVariant> m_reply;
+};
+
+QTEST_MAIN(TestBoardReplay)
+#include "tst_boardreplay.moc"
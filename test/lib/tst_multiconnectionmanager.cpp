@@ -0,0 +1,161 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QSignalSpy>
+#include <QTest>
+
+#include "chessboard.h"
+
+using namespace Chessboard;
+
+// Connects to several simulated boards at once.
+class TestMultiConnectionManager : public QObject
+{
+    Q_OBJECT
+private:
+    static BoardAddress simulator(int seed)
+    {
+        return BoardAddress::fromString(QStringLiteral("simulator:seed=%1").arg(seed));
+    }
+
+    // Tracks how many boards are being set up at any one time.
+    struct SetupMonitor {
+        SetupMonitor(MultiConnectionManager *manager)
+        {
+            QObject::connect(manager, &MultiConnectionManager::connecting, manager, [this](const BoardAddress& address) {
+                order.append(address.toString());
+                maximum = qMax(maximum, ++pending);
+            });
+            QObject::connect(manager, &MultiConnectionManager::connected, manager, [this](const BoardAddress& address) {
+                Q_UNUSED(address);
+                --pending;
+                ++connected;
+            });
+            QObject::connect(manager, &MultiConnectionManager::reconnected, manager, [this](const BoardAddress& address) {
+                Q_UNUSED(address);
+                --pending;
+                ++reconnected;
+            });
+        }
+
+        QStringList order;
+        int pending {};
+        int maximum {};
+        int connected {};
+        int reconnected {};
+    };
+
+private slots:
+    void serialised()
+    {
+        MultiConnectionManager manager;
+        SetupMonitor monitor(&manager);
+        QStringList expectedOrder;
+        for (int seed=1;seed<=8;++seed) {
+            manager.connectToBoard(simulator(seed), this);
+            expectedOrder.append(simulator(seed).toString());
+        }
+        QCOMPARE(manager.addresses().size(), 8);
+        QTRY_COMPARE(monitor.connected, 8);
+        QCOMPARE(monitor.maximum, 1);
+        QCOMPARE(monitor.order, expectedOrder);
+        for (int seed=1;seed<=8;++seed)
+            QVERIFY(manager.board(simulator(seed)));
+
+        QSignalSpy disconnectedSpy(&manager, &MultiConnectionManager::disconnected);
+        manager.disconnectAll();
+        QTRY_COMPARE(disconnectedSpy.count(), 8);
+        QVERIFY(manager.addresses().isEmpty());
+    }
+
+    void maximumPending()
+    {
+        MultiConnectionManager manager;
+        manager.setMaximumPendingConnections(3);
+        SetupMonitor monitor(&manager);
+        for (int seed=1;seed<=8;++seed)
+            manager.connectToBoard(simulator(seed), this);
+        QTRY_COMPARE(monitor.connected, 8);
+        QCOMPARE(monitor.maximum, 3);
+        manager.disconnectAll();
+    }
+
+    void duplicate()
+    {
+        MultiConnectionManager manager;
+        QSignalSpy connectingSpy(&manager, &MultiConnectionManager::connecting);
+        manager.connectToBoard(simulator(1), this);
+        manager.connectToBoard(simulator(1), this);
+        QCOMPARE(manager.addresses().size(), 1);
+        QCOMPARE(connectingSpy.count(), 1);
+        manager.disconnectAll();
+    }
+
+    void disconnectQueued()
+    {
+        MultiConnectionManager manager;
+        QSignalSpy connectingSpy(&manager, &MultiConnectionManager::connecting);
+        QSignalSpy disconnectedSpy(&manager, &MultiConnectionManager::disconnected);
+        manager.connectToBoard(simulator(1), this);
+        manager.connectToBoard(simulator(2), this);
+        manager.disconnectFromBoard(simulator(2));
+        // The queued board goes at once without ever being connected.
+        QCOMPARE(disconnectedSpy.count(), 1);
+        QCOMPARE(disconnectedSpy.first().at(0).value<BoardAddress>().toString(), simulator(2).toString());
+        QCOMPARE(manager.addresses().size(), 1);
+        QSignalSpy connectedSpy(&manager, &MultiConnectionManager::connected);
+        QVERIFY(connectedSpy.wait());
+        QVERIFY(!connectedSpy.wait(200));
+        QCOMPARE(connectingSpy.count(), 1);
+        manager.disconnectAll();
+    }
+
+    void reconnect()
+    {
+        MultiConnectionManager manager;
+        manager.setAutoReconnect(true);
+        QSignalSpy reconnectedSpy(&manager, &MultiConnectionManager::reconnected);
+        const BoardAddress dropping = BoardAddress::fromString(QLatin1String("simulator:seed=1,drop=300"));
+        manager.connectToBoard(dropping, this);
+        manager.connectToBoard(simulator(2), this);
+        QVERIFY(reconnectedSpy.wait(5000));
+        QCOMPARE(reconnectedSpy.first().at(0).value<BoardAddress>().toString(), dropping.toString());
+        QCOMPARE(manager.addresses().size(), 2);
+        manager.disconnectAll();
+    }
+
+    // Attempts to reconnect wait their turn behind boards still being set
+    // up. The latency makes each setup outlast the first reconnect delay.
+    void reconnectQueued()
+    {
+        MultiConnectionManager manager;
+        manager.setAutoReconnect(true);
+        SetupMonitor monitor(&manager);
+        manager.connectToBoard(BoardAddress::fromString(QLatin1String("simulator:seed=1,drop=50")), this);
+        for (int seed=2;seed<=6;++seed)
+            manager.connectToBoard(BoardAddress::fromString(QStringLiteral("simulator:seed=%1,latency=40").arg(seed)), this);
+        QTRY_COMPARE_WITH_TIMEOUT(monitor.connected, 6, 10000);
+        QTRY_VERIFY_WITH_TIMEOUT(monitor.reconnected > 0, 10000);
+        QCOMPARE(monitor.maximum, 1);
+        manager.disconnectAll();
+    }
+};
+
+QTEST_MAIN(TestMultiConnectionManager)
+#include "tst_multiconnectionmanager.moc"
@@ -0,0 +1,163 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryFile>
+#include <QTest>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "chessboard.h"
+
+using namespace Chessboard;
+
+namespace {
+    struct Entry {
+        quint64 key;
+        quint16 move;
+        quint16 weight;
+    };
+
+    quint16 encodeMove(const char *from, const char *to, int promotion = 0)
+    {
+        const Square f = Square::fromAlgebraicString(QLatin1String(from));
+        const Square t = Square::fromAlgebraicString(QLatin1String(to));
+        return static_cast<quint16>(t.col | (t.row << 3) | (f.col << 6) | (f.row << 9) | (promotion << 12));
+    }
+
+    bool writeBook(QTemporaryFile *file, QList<Entry> entries)
+    {
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.key < b.key;
+        });
+        if (!file->open())
+            return false;
+        for (const Entry& entry : entries) {
+            uchar buffer[16] = {};
+            qToBigEndian(entry.key, buffer);
+            qToBigEndian(entry.move, buffer + 8);
+            qToBigEndian(entry.weight, buffer + 10);
+            file->write(reinterpret_cast<const char *>(buffer), sizeof(buffer));
+        }
+        file->close();
+        return true;
+    }
+}
+
+class TestOpeningBook : public QObject
+{
+    Q_OBJECT
+private slots:
+    void polyglotKey_data()
+    {
+        QTest::addColumn<QString>("moves");
+        QTest::addColumn<quint64>("key");
+        QTest::newRow("start") << QString() << Q_UINT64_C(0x463b96181691fc9c);
+        QTest::newRow("e4") << QStringLiteral("e2e4") << Q_UINT64_C(0x823c9b50fd114196);
+        QTest::newRow("e4 d5") << QStringLiteral("e2e4 d7d5") << Q_UINT64_C(0x0756b94461c50fb0);
+        QTest::newRow("e4 d5 e5") << QStringLiteral("e2e4 d7d5 e4e5") << Q_UINT64_C(0x662fafb965db29d4);
+        QTest::newRow("e4 d5 e5 f5") << QStringLiteral("e2e4 d7d5 e4e5 f7f5") << Q_UINT64_C(0x22a48b5a8e47ff78);
+        QTest::newRow("e4 d5 e5 f5 Ke2") << QStringLiteral("e2e4 d7d5 e4e5 f7f5 e1e2") << Q_UINT64_C(0x652a607ca3f242c1);
+        QTest::newRow("e4 d5 e5 f5 Ke2 Kf7") << QStringLiteral("e2e4 d7d5 e4e5 f7f5 e1e2 e8f7") << Q_UINT64_C(0x00fdd303c946bdd9);
+        QTest::newRow("a4 b5 h4 b4 c4") << QStringLiteral("a2a4 b7b5 h2h4 b5b4 c2c4") << Q_UINT64_C(0x3c8123ea7b067637);
+        QTest::newRow("a4 b5 h4 b4 c4 bxc3 Ra3") << QStringLiteral("a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3") << Q_UINT64_C(0x5c3f9b829b279560);
+    }
+
+    void polyglotKey()
+    {
+        QFETCH(QString, moves);
+        QFETCH(quint64, key);
+        BoardState state = BoardState::newGame();
+        for (const QString& move : moves.split(QLatin1Char(' '), Qt::SkipEmptyParts))
+            QVERIFY(state.move(Square::fromAlgebraicString(move.left(2)), Square::fromAlgebraicString(move.mid(2))));
+        QCOMPARE(OpeningBook::polyglotKey(state), key);
+    }
+
+    void lookup()
+    {
+        BoardState start = BoardState::newGame();
+        BoardState e4 = start;
+        e4.move(Square::fromAlgebraicString(QLatin1String("e2")), Square::fromAlgebraicString(QLatin1String("e4")));
+        QTemporaryFile file;
+        QVERIFY(writeBook(&file, {
+            { OpeningBook::polyglotKey(start), encodeMove("e2", "e4"), 10 },
+            { OpeningBook::polyglotKey(start), encodeMove("d2", "d4"), 20 },
+            // Illegal moves are ignored.
+            { OpeningBook::polyglotKey(start), encodeMove("e2", "e5"), 30 },
+            { OpeningBook::polyglotKey(e4), encodeMove("c7", "c5"), 1 },
+        }));
+
+        OpeningBook book;
+        QVERIFY(book.open(file.fileName()));
+        QVERIFY(book.entryCount() == 4);
+        const QList<BookMove> moves = book.moves(start);
+        QVERIFY(moves.size() == 2);
+        QCOMPARE(moves[0].from.toAlgebraicString(), QLatin1String("d2"));
+        QCOMPARE(moves[0].to.toAlgebraicString(), QLatin1String("d4"));
+        QVERIFY(moves[0].weight == 20);
+        QCOMPARE(moves[1].to.toAlgebraicString(), QLatin1String("e4"));
+
+        const BookMove best = book.selectMove(start, OpeningBook::BestMove);
+        QVERIFY(best.isValid());
+        QCOMPARE(best.to.toAlgebraicString(), QLatin1String("d4"));
+        for (int i=0;i<20;++i) {
+            const BookMove move = book.selectMove(start, OpeningBook::WeightedRandom);
+            QVERIFY(move.to.toAlgebraicString() == QLatin1String("d4") ||
+                    move.to.toAlgebraicString() == QLatin1String("e4"));
+        }
+
+        QVERIFY(book.moves(e4).size() == 1);
+        e4.move(Square::fromAlgebraicString(QLatin1String("c7")), Square::fromAlgebraicString(QLatin1String("c5")));
+        QVERIFY(book.moves(e4).isEmpty());
+        QVERIFY(!book.selectMove(e4).isValid());
+    }
+
+    void castling()
+    {
+        const BoardState state = BoardState::fromFenString(
+            QLatin1String("r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4"));
+        QTemporaryFile file;
+        QVERIFY(writeBook(&file, {
+            { OpeningBook::polyglotKey(state), encodeMove("e1", "h1"), 1 }
+        }));
+        OpeningBook book;
+        QVERIFY(book.open(file.fileName()));
+        const BookMove move = book.selectMove(state, OpeningBook::BestMove);
+        QVERIFY(move.isValid());
+        QCOMPARE(move.from.toAlgebraicString(), QLatin1String("e1"));
+        QCOMPARE(move.to.toAlgebraicString(), QLatin1String("g1"));
+    }
+
+    void invalidFile()
+    {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write("not a book");
+        file.close();
+        OpeningBook book;
+        QString errorMessage;
+        QVERIFY(!book.open(file.fileName(), &errorMessage));
+        QVERIFY(!errorMessage.isEmpty());
+        QVERIFY(!book.isOpen());
+        QVERIFY(book.moves(BoardState::newGame()).isEmpty());
+    }
+};
+
+QTEST_MAIN(TestOpeningBook)
+#include "tst_openingbook.moc"
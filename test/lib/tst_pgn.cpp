@@ -78,6 +78,61 @@ private slots:
         }
         QVERIFY(state.isCheckmate());
     }
+    void writeRoundTrip()
+    {
+        PgnParser parser;
+        QString errorMessage;
+        const Pgn pgn = parser.parse(QLatin1String(
+"[Event \"Casual Game\"]\n"
+"[Result \"1-0\"]\n"
+"[ECO \"C20\"]\n"
+"\n"
+"1. e4 e5 2. Qh5 Nc6 3. Bc4 Nf6 4. Qxf7# 1-0\n"
+        ), &errorMessage);
+        QCOMPARE(errorMessage, QString());
+        PgnWriter writer;
+        const QString written = writer.write(pgn, &errorMessage);
+        QCOMPARE(errorMessage, QString());
+        QCOMPARE(written, QLatin1String(
+"[Event \"Casual Game\"]\n"
+"[Site \"?\"]\n"
+"[Date \"?\"]\n"
+"[Round \"?\"]\n"
+"[White \"?\"]\n"
+"[Black \"?\"]\n"
+"[Result \"1-0\"]\n"
+"[ECO \"C20\"]\n"
+"\n"
+"1. e4 e5 2. Qh5 Nc6 3. Bc4 Nf6 4. Qxf7# 1-0\n"
+"\n"));
+        const Pgn reparsed = parser.parse(written, &errorMessage);
+        QCOMPARE(reparsed.moves.size(), pgn.moves.size());
+        QCOMPARE(reparsed.tags.value(QLatin1String("ECO")), QLatin1String("C20"));
+        QCOMPARE(reparsed.tags.value(QLatin1String("Site")), QLatin1String("?"));
+    }
+    void writeFromPosition()
+    {
+        Pgn pgn;
+        pgn.tags[QLatin1String("FEN")] = QLatin1String("4k3/8/8/8/8/8/4p3/K7 b - - 0 40");
+        pgn.tags[QLatin1String("SetUp")] = QLatin1String("1");
+        // A move as reported by a board: squares only.
+        AlgebraicNotation move;
+        move.fromRow = 1;
+        move.fromCol = 4;
+        move.toRow = 0;
+        move.toCol = 4;
+        move.promotion = true;
+        move.promotionPiece = Piece::Rook;
+        pgn.moves.append(move);
+        PgnWriter writer;
+        QString errorMessage;
+        const QString written = writer.write(pgn, &errorMessage);
+        QCOMPARE(errorMessage, QString());
+        QVERIFY(written.endsWith(QLatin1String("\n40... e1=R+ *\n\n")));
+        pgn.moves.append(move);
+        QVERIFY(writer.write(pgn, &errorMessage).isEmpty());
+        QCOMPARE(errorMessage, QLatin1String("move 2: illegal move"));
+    }
 };
 
 QTEST_MAIN(TestPgn)
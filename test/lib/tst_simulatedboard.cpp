@@ -0,0 +1,332 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "chessboard.h"
+
+using namespace Chessboard;
+
+namespace {
+    // Commands from the ChessUp protocol.
+    const uint8_t CMD_ASSISTANCE = 0x10;
+    const uint8_t CMD_SET_STATE  = 0x66;
+    const uint8_t CMD_PROMOTION  = 0x97;
+    const uint8_t CMD_SEND_MOVE  = 0x99;
+    const uint8_t CMD_WIN        = 0xb6;
+    const uint8_t CMD_SETTINGS   = 0xb9;
+
+    bool readVarint(const QByteArray& data, qsizetype *position, quint64 *value)
+    {
+        *value = 0;
+        for (int shift=0;shift<64;shift+=7) {
+            if (*position >= data.size())
+                return false;
+            const uint8_t byte = static_cast<uint8_t>(data[(*position)++]);
+            *value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    // The first byte of each packet written to the board, from a trace
+    // recorded through BLUECHEESE_TRACE.
+    QList<int> tracedCommands(const QString& fileName)
+    {
+        QList<int> commands;
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return commands;
+        const QByteArray data = file.readAll();
+        // After the magic and the version.
+        qsizetype position = 5;
+        while (position < data.size()) {
+            const uint8_t type = static_cast<uint8_t>(data[position++]);
+            quint64 delta, size;
+            if (!readVarint(data, &position, &delta) || !readVarint(data, &position, &size) ||
+                size > static_cast<quint64>(data.size() - position))
+                break;
+            // Write records.
+            if (type == 1 && size > 0)
+                commands.append(static_cast<uint8_t>(data[position]));
+            position += size;
+        }
+        return commands;
+    }
+}
+
+// Runs the ChessUp protocol end to end against the simulated board.
+class TestSimulatedBoard : public QObject
+{
+    Q_OBJECT
+private:
+    // Connects and waits for the board's first report of its position.
+    static RemoteBoard *connectToSimulator(ConnectionManager *manager, const QString& address)
+    {
+        QSignalSpy connectedSpy(manager, &ConnectionManager::connected);
+        manager->connectToBoard(BoardAddress::fromString(address));
+        if (!connectedSpy.wait())
+            return nullptr;
+        RemoteBoard *board = connectedSpy.takeFirst().at(0).value<RemoteBoard *>();
+        QSignalSpy stateSpy(board, &RemoteBoard::remoteBoardState);
+        if (!stateSpy.wait()) {
+            delete board;
+            return nullptr;
+        }
+        return board;
+    }
+
+private slots:
+    void address_data()
+    {
+        QTest::addColumn<QString>("address");
+        QTest::addColumn<bool>("valid");
+        QTest::newRow("plain") << QString("simulator") << true;
+        QTest::newRow("options") << QString("simulator:latency=20,loss=0.1,seed=7,reply") << true;
+        QTest::newRow("drop") << QString("simulator:drop=500") << true;
+        QTest::newRow("script") << QString("simulator:script=e2e4/touch-g8/undo") << true;
+        QTest::newRow("bad script step") << QString("simulator:script=e2e9") << false;
+        QTest::newRow("unknown option") << QString("simulator:speed=2") << false;
+        QTest::newRow("certain loss") << QString("simulator:loss=1") << false;
+    }
+
+    void address()
+    {
+        QFETCH(QString, address);
+        QFETCH(bool, valid);
+        const BoardAddress boardAddress = BoardAddress::fromString(address);
+        QCOMPARE(boardAddress.isValid(), valid);
+        if (!valid)
+            return;
+        QCOMPARE(boardAddress.connectionMethod(), CONNECTION_SIMULATED);
+        QCOMPARE(boardAddress.toString(), address);
+        QVERIFY(BoardAddress::fromByteArray(boardAddress.toByteArray()) == boardAddress);
+    }
+
+    void setBoardState()
+    {
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator"));
+        QVERIFY(board);
+        QSignalSpy stateSpy(board, &RemoteBoard::remoteBoardState);
+        const BoardState state = BoardState::fromFenString(QLatin1String("r3k2r/8/8/3pP3/8/8/8/R3K2R w KQkq d6 0 42"));
+        board->setBoardState(state);
+        QVERIFY(stateSpy.wait());
+        QCOMPARE(stateSpy.takeFirst().at(0).value<BoardState>().toFenString(), state.toFenString());
+        delete board;
+    }
+
+    void replyToMove()
+    {
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator:reply"));
+        QVERIFY(board);
+        QSignalSpy moveSpy(board, &RemoteBoard::remoteMove);
+        board->requestMove(Square::fromAlgebraicString(QLatin1String("e2")), Square::fromAlgebraicString(QLatin1String("e4")));
+        QVERIFY(moveSpy.wait());
+        BoardState state = BoardState::newGame();
+        state.move(QLatin1String("e4"));
+        const QPair<Square, Square> expected = state.legalMoves().first();
+        QCOMPARE(moveSpy.takeFirst(), QList<QVariant>({ expected.first.row, expected.first.col,
+                                                        expected.second.row, expected.second.col }));
+        delete board;
+    }
+
+    // The touch notification carries the column before the row; h2 tells
+    // them apart.
+    void touch()
+    {
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator:script=touch-h2"));
+        QVERIFY(board);
+        QSignalSpy liftedSpy(board, &RemoteBoard::remotePieceLifted);
+        QVERIFY(liftedSpy.wait());
+        QCOMPARE(liftedSpy.count(), 1);
+        const Square square = liftedSpy.first().at(0).value<Square>();
+        QCOMPARE(square.row, 1);
+        QCOMPARE(square.col, 7);
+        delete board;
+    }
+
+    // A move taken back on the board leaves it where it was before, as
+    // read back by the app.
+    void undo()
+    {
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator:script=e2e4/undo"));
+        QVERIFY(board);
+        QSignalSpy moveSpy(board, &RemoteBoard::remoteMove);
+        QSignalSpy undoSpy(board, &RemoteBoard::remoteUndo);
+        QVERIFY(undoSpy.wait());
+        QCOMPARE(moveSpy.count(), 1);
+        QCOMPARE(moveSpy.first(), QList<QVariant>({ 1, 4, 3, 4 }));
+        QSignalSpy stateSpy(board, &RemoteBoard::remoteBoardState);
+        board->requestRemoteBoardState();
+        QVERIFY(stateSpy.wait());
+        QCOMPARE(stateSpy.first().at(0).value<BoardState>().toFenString(), BoardState::newGame().toFenString());
+        delete board;
+    }
+
+    void latency()
+    {
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator:latency=20"));
+        QVERIFY(board);
+        // Out and back, allowing for coarse timers.
+        QVERIFY(board->linkStatistics().lastLatency >= 30);
+        QCOMPARE(board->linkStatistics().failures, 0);
+        // The position was answered after its request was confirmed.
+        QVERIFY(board->linkStatistics().notifications > 0);
+        QVERIFY(board->linkStatistics().lastNotificationLatency <= board->linkStatistics().lastLatency);
+        // A game is expected once connected; the simulator has no
+        // connection parameters to report.
+        QVERIFY(board->linkStatistics().lowLatency);
+        QCOMPARE(board->linkStatistics().connectionInterval, 0.0);
+        delete board;
+    }
+
+    void reconnect()
+    {
+        ConnectionManager manager;
+        manager.setAutoReconnect(true);
+        QSignalSpy reconnectingSpy(&manager, &ConnectionManager::reconnecting);
+        QSignalSpy reconnectedSpy(&manager, &ConnectionManager::reconnected);
+        QSignalSpy disconnectedSpy(&manager, &ConnectionManager::disconnected);
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator:drop=200"));
+        QVERIFY(board);
+        QVERIFY(reconnectedSpy.wait(2000));
+        QCOMPARE(reconnectingSpy.count(), 1);
+        QCOMPARE(reconnectingSpy.first().at(0).toInt(), 1);
+        QCOMPARE(disconnectedSpy.count(), 0);
+        RemoteBoard *newBoard = reconnectedSpy.first().at(0).value<RemoteBoard *>();
+        QVERIFY(newBoard != board);
+        // A disconnect while waiting to reconnect stops for good.
+        QVERIFY(reconnectingSpy.wait(2000));
+        manager.disconnectFromBoard();
+        QCOMPARE(disconnectedSpy.count(), 1);
+        QVERIFY(!reconnectedSpy.wait(1000));
+        delete newBoard;
+        delete board;
+    }
+
+    // Lost commands and answers are retried, and moves are never sent
+    // again once the board may have played them: the simulator would
+    // reply to a repeated move a second time and the game would drift.
+    // Moves whose answer was lost are given up on (counted as failures)
+    // and the position is read back instead.
+    void lossyLink()
+    {
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator:loss=0.1,seed=3,reply"));
+        QVERIFY(board);
+        QSignalSpy moveSpy(board, &RemoteBoard::remoteMove);
+        QSignalSpy stateSpy(board, &RemoteBoard::remoteBoardState);
+        BoardState local = BoardState::newGame();
+        for (int i=0;i<8;++i) {
+            const QPair<Square, Square> move = local.legalMoves().first();
+            QVERIFY(local.move(move.first, move.second));
+            board->requestMove(move.first, move.second);
+            QTRY_VERIFY_WITH_TIMEOUT(!moveSpy.isEmpty(), 5000);
+            const QList<QVariant> reply = moveSpy.takeFirst();
+            QVERIFY(local.move(reply.at(0).toInt(), reply.at(1).toInt(), reply.at(2).toInt(), reply.at(3).toInt()));
+        }
+        QVERIFY(!moveSpy.wait(500));
+        stateSpy.clear();
+        board->requestRemoteBoardState();
+        QTRY_VERIFY_WITH_TIMEOUT(!stateSpy.isEmpty(), 5000);
+        QCOMPARE(stateSpy.last().at(0).value<BoardState>().toFenString(), local.toFenString());
+        const LinkStatistics statistics = board->linkStatistics();
+        QVERIFY(statistics.retries > 0);
+        QVERIFY(statistics.completed > 0);
+        delete board;
+    }
+
+    // Superseded settings, positions and hints still waiting to be sent
+    // are dropped, but never across a move, promotion or resignation.
+    void coalescing()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString traceFileName = dir.filePath(QLatin1String("coalescing.bctr"));
+        qputenv("BLUECHEESE_TRACE", QFile::encodeName(traceFileName));
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator"));
+        qunsetenv("BLUECHEESE_TRACE");
+        QVERIFY(board);
+        QSignalSpy stateSpy(board, &RemoteBoard::remoteBoardState);
+
+        // The reset settings of a new game give way to the game's own.
+        qsizetype start = tracedCommands(traceFileName).size();
+        board->requestNewGame(GameOptions());
+        QVERIFY(stateSpy.wait());
+        QList<int> commands = tracedCommands(traceFileName).mid(start);
+        QCOMPARE(commands.count(CMD_SET_STATE), 1);
+        QCOMPARE(commands.count(CMD_SETTINGS), 1);
+
+        // Only the last of a burst of hints is sent.
+        const qsizetype moves = BoardState::newGame().legalMoves().size();
+        const QList<AssistanceColour> red(moves, AssistanceColour::Red);
+        const QList<AssistanceColour> blue(moves, AssistanceColour::Blue);
+        const QList<AssistanceColour> green(moves, AssistanceColour::Green);
+        start = tracedCommands(traceFileName).size();
+        board->sendAssistance(red);
+        board->sendAssistance(blue);
+        board->sendAssistance(green);
+        QTRY_COMPARE(tracedCommands(traceFileName).mid(start).count(CMD_ASSISTANCE), 1);
+        QTest::qWait(100);
+        QCOMPARE(tracedCommands(traceFileName).mid(start), QList<int>({ CMD_ASSISTANCE }));
+
+        start = tracedCommands(traceFileName).size();
+        board->sendAssistance(red);
+        board->requestMove(Square::fromAlgebraicString(QLatin1String("e2")), Square::fromAlgebraicString(QLatin1String("e4")));
+        board->sendAssistance(blue);
+        board->requestPromotion(Piece::Queen);
+        board->sendAssistance(green);
+        board->setGameOptions(GameOptions());
+        board->requestResignation(Colour::White);
+        board->setGameOptions(GameOptions());
+        const QList<int> expected({ CMD_ASSISTANCE, CMD_SEND_MOVE, CMD_ASSISTANCE, CMD_PROMOTION,
+                                    CMD_ASSISTANCE, CMD_SETTINGS, CMD_WIN, CMD_SETTINGS });
+        QTRY_COMPARE(tracedCommands(traceFileName).mid(start), expected);
+        delete board;
+    }
+
+    void moveRoundTrip()
+    {
+        ConnectionManager manager;
+        RemoteBoard *board = connectToSimulator(&manager, QLatin1String("simulator:reply"));
+        QVERIFY(board);
+        QSignalSpy stateSpy(board, &RemoteBoard::remoteBoardState);
+        QSignalSpy moveSpy(board, &RemoteBoard::remoteMove);
+        QBENCHMARK {
+            board->setBoardState(BoardState::newGame());
+            QVERIFY(stateSpy.wait());
+            board->requestMove(Square::fromAlgebraicString(QLatin1String("e2")), Square::fromAlgebraicString(QLatin1String("e4")));
+            QVERIFY(moveSpy.wait());
+        }
+        delete board;
+    }
+};
+
+QTEST_MAIN(TestSimulatedBoard)
+#include "tst_simulatedboard.moc"
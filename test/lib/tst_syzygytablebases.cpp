@@ -0,0 +1,310 @@
+/*
+ * bluecheese
+ * Copyright (C) 2023 Chris January
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "chessboard.h"
+
+using namespace Chessboard;
+
+namespace {
+    bool writeTable(const QDir& dir, const QString& fileName, const QByteArray& magic, int size = 80)
+    {
+        QFile file(dir.filePath(fileName));
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        QByteArray data = magic;
+        data.resize(size, '\0');
+        return file.write(data) == data.size();
+    }
+
+    const QByteArray wdlMagic("\x71\xe8\x23\x5d", 4);
+    const QByteArray dtzMagic("\xd7\x66\x0c\xa5", 4);
+
+    // KQvK tables in which every position has one value for each side to
+    // move, enough to follow a probe from the board to the file: the side
+    // with the queen wins, in 9 plies by the DTZ table.
+    bool writeKqkTables(const QDir& dir, bool withDtz)
+    {
+        // Split between sides to move; pieces K, Q, k for both sides, then
+        // a single value for each side.
+        const QByteArray wdl("\x01\x00\x66\x55\xee\x00\x80\x04\x80\x00", 10);
+        // White to move only; a single value.
+        const QByteArray dtz("\x00\x00\x06\x05\x0e\x00\x80\x04", 8);
+        return writeTable(dir, QLatin1String("KQvK.rtbw"), wdlMagic + wdl) &&
+               (!withDtz || writeTable(dir, QLatin1String("KQvK.rtbz"), dtzMagic + dtz));
+    }
+
+    int sign(int value)
+    {
+        return (value > 0) - (value < 0);
+    }
+
+    // Tables from the environment, for probing known positions.
+    QString realTablesPath()
+    {
+        return qEnvironmentVariable("BLUECHEESE_SYZYGY_PATH");
+    }
+}
+
+class TestSyzygyTablebases : public QObject
+{
+    Q_OBJECT
+private slots:
+    void materialKey_data()
+    {
+        QTest::addColumn<QString>("fen");
+        QTest::addColumn<QString>("key");
+        QTest::newRow("KQvK") << QStringLiteral("8/8/8/4k3/8/8/8/3QK3 w - - 0 1") << QStringLiteral("KQvK");
+        QTest::newRow("KvKQ") << QStringLiteral("8/8/8/3qk3/8/8/8/4K3 w - - 0 1") << QStringLiteral("KQvK");
+        QTest::newRow("KRPvKR") << QStringLiteral("8/8/4k3/r7/4P3/8/8/R3K3 w - - 0 1") << QStringLiteral("KRPvKR");
+        QTest::newRow("KRvKQ") << QStringLiteral("3qk3/8/8/8/8/8/8/R3K3 w - - 0 1") << QStringLiteral("KQvKR");
+        QTest::newRow("KBNvK") << QStringLiteral("4k3/8/8/8/8/8/8/1N2KB2 w - - 0 1") << QStringLiteral("KBNvK");
+    }
+
+    void materialKey()
+    {
+        QFETCH(QString, fen);
+        QFETCH(QString, key);
+        QCOMPARE(SyzygyTablebases::materialKey(BoardState::fromFenString(fen)), key);
+    }
+
+    void load()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KQvK.rtbw"), wdlMagic));
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KQvK.rtbz"), dtzMagic));
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KRPvKR.rtbw"), wdlMagic));
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KRvK.rtbw"), wdlMagic));
+        // Wrong magic and wrong size are both rejected.
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KNvK.rtbw"), dtzMagic));
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KBvK.rtbw"), wdlMagic, 64));
+
+        SyzygyTablebases tablebases;
+        QString errorMessage;
+        QCOMPARE(tablebases.load(dir.path(), &errorMessage), 3);
+        QVERIFY(!errorMessage.isEmpty());
+        QCOMPARE(tablebases.tableCount(SyzygyTablebases::DistanceToZero), 1);
+        QCOMPARE(tablebases.maxPieces(), 5);
+        QCOMPARE(tablebases.path(), dir.path());
+
+        const BoardState kqk = BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3QK3 w - - 0 1"));
+        QVERIFY(tablebases.contains(kqk));
+        QVERIFY(tablebases.contains(kqk, SyzygyTablebases::DistanceToZero));
+        const BoardState krpkr = BoardState::fromFenString(QLatin1String("8/8/4k3/r7/4P3/8/8/R3K3 w - - 0 1"));
+        QVERIFY(tablebases.contains(krpkr));
+        QVERIFY(!tablebases.contains(krpkr, SyzygyTablebases::DistanceToZero));
+        QVERIFY(!tablebases.contains(BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3NK3 w - - 0 1"))));
+        QVERIFY(tablebases.contains(BoardState::fromFenString(QLatin1String("4k3/8/8/8/8/8/8/R3K3 w - - 0 1"))));
+        // Castling rights rule out a tablebase position.
+        QVERIFY(!tablebases.contains(BoardState::fromFenString(QLatin1String("4k3/8/8/8/8/8/8/R3K3 w Q - 0 1"))));
+        QVERIFY(!tablebases.contains(BoardState::newGame()));
+    }
+
+    void weakerSideFirst_data()
+    {
+        QTest::addColumn<QString>("fen");
+        QTest::newRow("white KQ") << QStringLiteral("4k3/4p3/8/8/8/8/r7/3QK3 w - - 0 1");
+        QTest::newRow("black KQ") << QStringLiteral("3qk3/R7/8/8/8/8/4P3/4K3 b - - 0 1");
+    }
+
+    void weakerSideFirst()
+    {
+        QFETCH(QString, fen);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        // Named with the two piece side first, as the real table is.
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KQvKRP.rtbw"), wdlMagic));
+        SyzygyTablebases tablebases;
+        QCOMPARE(tablebases.load(dir.path()), 1);
+        const BoardState state = BoardState::fromFenString(fen);
+        QCOMPARE(SyzygyTablebases::materialKey(state), QLatin1String("KRPvKQ"));
+        QVERIFY(tablebases.contains(state));
+        QVERIFY(!tablebases.contains(state, SyzygyTablebases::DistanceToZero));
+    }
+
+    void probeWdl_data()
+    {
+        QTest::addColumn<QString>("fen");
+        QTest::addColumn<int>("result");
+        QTest::newRow("white wins") << QStringLiteral("8/8/8/4k3/8/8/8/3QK3 w - - 0 1") << static_cast<int>(TablebaseResult::Win);
+        QTest::newRow("black loses") << QStringLiteral("8/8/8/4k3/8/8/8/3QK3 b - - 0 1") << static_cast<int>(TablebaseResult::Loss);
+        // The colours are swapped to match the table.
+        QTest::newRow("black wins") << QStringLiteral("8/8/8/3qk3/8/8/8/4K3 b - - 0 1") << static_cast<int>(TablebaseResult::Win);
+        QTest::newRow("white loses") << QStringLiteral("8/8/8/3qk3/8/8/8/4K3 w - - 0 1") << static_cast<int>(TablebaseResult::Loss);
+        // The table knows nothing of captures: taking the queen draws.
+        QTest::newRow("capture") << QStringLiteral("8/8/8/8/8/8/6kQ/K7 b - - 0 1") << static_cast<int>(TablebaseResult::Draw);
+        QTest::newRow("bare kings") << QStringLiteral("8/8/8/4k3/8/8/8/4K3 w - - 0 1") << static_cast<int>(TablebaseResult::Draw);
+    }
+
+    void probeWdl()
+    {
+        QFETCH(QString, fen);
+        QFETCH(int, result);
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(writeKqkTables(QDir(dir.path()), false));
+        SyzygyTablebases tablebases;
+        QCOMPARE(tablebases.load(dir.path()), 1);
+        TablebaseResult probed;
+        QVERIFY(tablebases.probeWdl(BoardState::fromFenString(fen), &probed));
+        QCOMPARE(static_cast<int>(probed), result);
+        // Without a DTZ table only captures can be resolved.
+        int dtz;
+        QCOMPARE(tablebases.probeDtz(BoardState::fromFenString(fen), &dtz), result == 0);
+    }
+
+    void probeDtz()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(writeKqkTables(QDir(dir.path()), true));
+        SyzygyTablebases tablebases;
+        QCOMPARE(tablebases.load(dir.path()), 1);
+        int dtz = 0;
+        QVERIFY(tablebases.probeDtz(BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3QK3 w - - 0 1")), &dtz));
+        QCOMPARE(dtz, 9);
+        // Only white to move is stored, so black's moves are searched.
+        QVERIFY(tablebases.probeDtz(BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3QK3 b - - 0 1")), &dtz));
+        QCOMPARE(dtz, -10);
+        QVERIFY(tablebases.probeDtz(BoardState::fromFenString(QLatin1String("8/8/8/8/8/8/6kQ/K7 b - - 0 1")), &dtz));
+        QCOMPARE(dtz, 0);
+        // Not in the tables.
+        QVERIFY(!tablebases.probeDtz(BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3RK3 w - - 0 1")), &dtz));
+        QVERIFY(!tablebases.probeDtz(BoardState::newGame(), &dtz));
+    }
+
+    void moves()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(writeKqkTables(QDir(dir.path()), true));
+        SyzygyTablebases tablebases;
+        QCOMPARE(tablebases.load(dir.path()), 1);
+        const BoardState state = BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3QK3 w - - 0 1"));
+        const QList<TablebaseMove> moves = tablebases.moves(state);
+        QCOMPARE(moves.size(), state.legalMoves().size());
+        QVERIFY(moves.first().result == TablebaseResult::Win);
+        QCOMPARE(moves.first().dtz, 11);
+        // Qd4+ hangs the queen.
+        bool found = false;
+        for (const TablebaseMove& move : moves) {
+            if (move.from == Square::fromAlgebraicString(QLatin1String("d1")) &&
+                move.to == Square::fromAlgebraicString(QLatin1String("d4"))) {
+                QVERIFY(move.result == TablebaseResult::Draw);
+                found = true;
+            }
+        }
+        QVERIFY(found);
+        QVERIFY(moves.last().result == TablebaseResult::Draw);
+
+        // Late in the fifty moves the same win is only a cursed one.
+        const BoardState late = BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3QK3 w - - 95 80"));
+        QVERIFY(tablebases.selectMove(late).result == TablebaseResult::CursedWin);
+
+        // Mate is preferred to any other winning move.
+        const BoardState mateInOne = BoardState::fromFenString(QLatin1String("k7/8/1K6/8/8/8/8/7Q w - - 0 1"));
+        const TablebaseMove mate = tablebases.selectMove(mateInOne);
+        QVERIFY(mate.isValid());
+        QCOMPARE(mate.dtz, 1);
+        BoardState next = mateInOne;
+        QVERIFY(next.move(mate.from, mate.to));
+        QVERIFY(next.isCheckmate());
+
+        QVERIFY(tablebases.moves(BoardState::newGame()).isEmpty());
+        QVERIFY(!tablebases.selectMove(BoardState::newGame()).isValid());
+    }
+
+    void corruptTable()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        // The right magic and size, but no headers.
+        QVERIFY(writeTable(QDir(dir.path()), QLatin1String("KQvK.rtbw"), wdlMagic));
+        SyzygyTablebases tablebases;
+        QCOMPARE(tablebases.load(dir.path()), 1);
+        const BoardState state = BoardState::fromFenString(QLatin1String("8/8/8/4k3/8/8/8/3QK3 w - - 0 1"));
+        QVERIFY(tablebases.contains(state));
+        TablebaseResult result;
+        QVERIFY(!tablebases.probeWdl(state, &result));
+        QVERIFY(tablebases.moves(state).isEmpty());
+    }
+
+    void knownPositions_data()
+    {
+        QTest::addColumn<QString>("fen");
+        QTest::addColumn<int>("result");
+        QTest::newRow("KQvK") << QStringLiteral("8/8/8/4k3/8/8/8/3QK3 w - - 0 1") << static_cast<int>(TablebaseResult::Win);
+        QTest::newRow("KvKQ") << QStringLiteral("8/8/8/4k3/8/8/8/3QK3 b - - 0 1") << static_cast<int>(TablebaseResult::Loss);
+        QTest::newRow("KRvKR") << QStringLiteral("8/8/3k4/7r/8/3K4/8/R7 w - - 0 1") << static_cast<int>(TablebaseResult::Draw);
+        // The king on the sixth rank in front of its pawn wins whoever moves.
+        QTest::newRow("KPvK win") << QStringLiteral("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1") << static_cast<int>(TablebaseResult::Win);
+        QTest::newRow("KPvK loss") << QStringLiteral("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1") << static_cast<int>(TablebaseResult::Loss);
+        QTest::newRow("KPvK blocked") << QStringLiteral("8/8/8/8/8/4k3/4P3/4K3 w - - 0 1") << static_cast<int>(TablebaseResult::Draw);
+        QTest::newRow("stalemate") << QStringLiteral("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1") << static_cast<int>(TablebaseResult::Draw);
+    }
+
+    // Against real tables, found through BLUECHEESE_SYZYGY_PATH.
+    void knownPositions()
+    {
+        QFETCH(QString, fen);
+        QFETCH(int, result);
+        if (realTablesPath().isEmpty())
+            QSKIP("BLUECHEESE_SYZYGY_PATH is not set");
+        SyzygyTablebases tablebases;
+        tablebases.load(realTablesPath());
+        const BoardState state = BoardState::fromFenString(fen);
+        if (!tablebases.contains(state, SyzygyTablebases::DistanceToZero))
+            QSKIP("No tables for this material");
+        TablebaseResult probed;
+        QVERIFY(tablebases.probeWdl(state, &probed));
+        QCOMPARE(static_cast<int>(probed), result);
+        int dtz;
+        QVERIFY(tablebases.probeDtz(state, &dtz));
+        QCOMPARE(sign(dtz), sign(result));
+        // The best move keeps the result.
+        if (state.hasLegalMove())
+            QCOMPARE(static_cast<int>(tablebases.selectMove(state).result), result);
+    }
+
+    void knownMateInOne()
+    {
+        if (realTablesPath().isEmpty())
+            QSKIP("BLUECHEESE_SYZYGY_PATH is not set");
+        SyzygyTablebases tablebases;
+        tablebases.load(realTablesPath());
+        const BoardState state = BoardState::fromFenString(QLatin1String("k7/8/1K6/8/8/8/8/7Q w - - 0 1"));
+        if (!tablebases.contains(state, SyzygyTablebases::DistanceToZero))
+            QSKIP("No KQvK tables");
+        int dtz;
+        QVERIFY(tablebases.probeDtz(state, &dtz));
+        QCOMPARE(dtz, 1);
+        const TablebaseMove move = tablebases.selectMove(state);
+        BoardState next = state;
+        QVERIFY(next.move(move.from, move.to));
+        QVERIFY(next.isCheckmate());
+    }
+};
+
+QTEST_MAIN(TestSyzygyTablebases)
+#include "tst_syzygytablebases.moc"